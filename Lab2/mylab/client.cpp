@@ -54,23 +54,132 @@ bool readFileContent(const std::string& filename, std::vector<char>& content) {
 
 
 
-// ===== 传输单个文件 =====
-bool transferFile(SOCKET clientSocket, sockaddr_in& serverAddr, 
-                  const std::string& filename, uint32_t& clientSeq) {
-    std::vector<char> content;// 存储文件内容
-    if (!readFileContent(filename, content)) {
-        return false;
+// ========================================================= 连接参数缓存 ==================================================//
+// 按服务端地址缓存上一次传输结束时的cwnd、ssthresh、平滑RTT和MSS，新连接直接从这些值开始（热启动）
+// 缓存文件每行一个服务端：<ip:port> <cwnd> <ssthresh> <srtt_ms> <mss> <保存时间>
+struct ConnCacheEntry {
+    uint32_t cwnd;
+    uint32_t ssthresh;
+    double srtt_ms;
+    uint16_t mss;
+};
+
+// 本次连接查到的缓存（handshake开始时加载）
+static ConnCacheEntry g_connCache;
+static bool g_connCacheHit = false;
+
+// 缓存键：服务端的 ip:port
+static std::string connCacheKey(const sockaddr_in& addr) {
+    char key[64];
+    snprintf(key, sizeof(key), "%s:%d", inet_ntoa(addr.sin_addr), ntohs(addr.sin_port));
+    return key;
+}
+
+// 查找服务端对应的缓存条目，不存在、格式错误或已过期时返回false
+static bool loadConnCache(const sockaddr_in& serverAddr, ConnCacheEntry& entry) {
+    if (!CONN_CACHE_ENABLED) return false;
+    std::ifstream in(CONN_CACHE_FILE);
+    if (!in.is_open()) return false;
+    
+    std::string key = connCacheKey(serverAddr);
+    std::string line;
+    while (std::getline(in, line)) {
+        char lineKey[64];
+        unsigned int cwnd, ssthresh, mss;
+        double srtt;
+        long long savedAt;
+        if (sscanf(line.c_str(), "%63s %u %u %lf %u %lld", lineKey, &cwnd, &ssthresh, &srtt, &mss, &savedAt) != 6) continue;
+        if (key != lineKey) continue;
+        if ((long long)time(NULL) - savedAt > CONN_CACHE_TTL_SEC) return false;  // 过期
+        if (cwnd == 0 || ssthresh == 0 || mss == 0 || mss > MAX_DATA_SIZE) return false;
+        entry.cwnd = cwnd;
+        entry.ssthresh = ssthresh;
+        entry.srtt_ms = srtt;
+        entry.mss = (uint16_t)mss;
+        return true;
     }
-    
+    return false;
+}
+
+// 保存（或替换）服务端对应的缓存条目，其他服务端的条目原样保留
+static void saveConnCache(const sockaddr_in& serverAddr, const SendWindow& w) {
+    if (!CONN_CACHE_ENABLED) return;
+    std::string key = connCacheKey(serverAddr);
+    std::vector<std::string> lines;
+    std::ifstream in(CONN_CACHE_FILE);
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.compare(0, key.size() + 1, key + " ") != 0 && !line.empty()) lines.push_back(line);
+    }
+    in.close();
+    
+    // 快速恢复阶段的cwnd被重复ACK临时膨胀过，按恢复完成后的值（ssthresh）保存
+    uint32_t cwnd = (w.reno_phase == FAST_RECOVERY) ? w.ssthresh : w.cwnd;
+    char entry[160];
+    snprintf(entry, sizeof(entry), "%s %u %u %.3f %u %lld", key.c_str(), cwnd, w.ssthresh,
+             w.srtt_ms, (unsigned int)w.mss, (long long)time(NULL));
+    lines.push_back(entry);
+    
+    std::ofstream out(CONN_CACHE_FILE, std::ios::out | std::ios::trunc);
+    if (!out.is_open()) {
+        std::cout << "[Cache] Warning: cannot write " << CONN_CACHE_FILE << std::endl;
+        return;
+    }
+    for (size_t i = 0; i < lines.size(); i++) out << lines[i] << "\n";
+    std::cout << "[Cache] Saved " << key << ": cwnd=" << cwnd << ", ssthresh=" << w.ssthresh
+              << ", srtt=" << w.srtt_ms << "ms, mss=" << w.mss << std::endl;
+}
+
+// 初始化发送窗口：重置后按缓存热启动（cwnd/ssthresh/RTT从上一次连接结束时的值开始）
+static void prepareSendWindow(uint32_t baseSeq) {
+    g_sendWindow.reset(baseSeq);
+    if (!g_connCacheHit) return;
+    g_sendWindow.cwnd = (g_connCache.cwnd < FIXED_WINDOW_SIZE) ? g_connCache.cwnd : FIXED_WINDOW_SIZE;
+    g_sendWindow.ssthresh = (g_connCache.ssthresh > MIN_SSTHRESH) ? g_connCache.ssthresh : MIN_SSTHRESH;
+    g_sendWindow.srtt_ms = g_connCache.srtt_ms;
+    g_sendWindow.reno_phase = (g_sendWindow.cwnd >= g_sendWindow.ssthresh) ? CONGESTION_AVOIDANCE : SLOW_START;
+}
+
+// 0-RTT：把首个窗口的数据按 FAST_OPEN_DATA_SIZE 切分放入发送窗口（从next_seq开始），返回放入的字节数
+// 数量受有效窗口和 FAST_OPEN_MAX_PACKETS 限制，第一块由SYN携带，其余由handshake紧随SYN发出
+static int stageEarlyData(const char* data, int dataLen) {
+    int staged = 0;
+    int packets = 0;
+    while (staged < dataLen && packets < FAST_OPEN_MAX_PACKETS && g_sendWindow.canSend()) {
+        int idx = g_sendWindow.getIndex(g_sendWindow.next_seq);
+        int len = (dataLen - staged > FAST_OPEN_DATA_SIZE) ? FAST_OPEN_DATA_SIZE : (dataLen - staged);
+        memcpy(g_sendWindow.data_buf[idx], data + staged, len);
+        g_sendWindow.data_len[idx] = len;
+        g_sendWindow.is_sent[idx] = 1;
+        g_sendWindow.is_ack[idx] = 0;
+        g_sendWindow.is_retx[idx] = 0;
+        g_sendWindow.send_time[idx] = clock();
+        g_sendWindow.total_packets_sent++;
+        g_sendWindow.total_bytes_sent += len;
+        g_sendWindow.next_seq++;
+        staged += len;
+        packets++;
+    }
+    return staged;
+}
+
+
+
+// ===== 传输单个文件 =====
+// content为已读入的文件内容，earlySent为握手阶段随SYN发出的字节数（0-RTT，未启用时为0）
+bool transferFile(SOCKET clientSocket, sockaddr_in& serverAddr, const std::string& filename,
+                  const std::vector<char>& content, uint32_t& clientSeq, int earlySent) {
     std::cout << "\n[Transfer] Starting transfer of '" << filename << "'..." << std::endl;
     
     // 使用pipelineSend发送文件内容
-    bool result = pipelineSend(clientSocket, serverAddr, content.data(), content.size(), clientSeq);
+    bool result = pipelineSend(clientSocket, serverAddr, content.data(), content.size(), clientSeq, earlySent);
     
     if (result) {
         std::cout << "[Transfer] File '" << filename << "' transferred successfully!" << std::endl;
         // 更新序列号
         clientSeq = g_sendWindow.next_seq;
+        // 保存本次结束时的拥塞控制参数，下次连接同一服务端时热启动
+        saveConnCache(serverAddr, g_sendWindow);
     } else {
         std::cerr << "[Transfer] Failed to transfer file '" << filename << "'" << std::endl;
     }
@@ -78,25 +187,116 @@ bool transferFile(SOCKET clientSocket, sockaddr_in& serverAddr,
     return result;
 }
 
+// ===== 选择要传输的文件：列出testfile目录并读取用户输入，成功时读入文件内容 =====
+bool selectFile(std::string& filename, std::vector<char>& content) {
+    // 获取testfile目录下的文件列表
+    std::vector<std::string> files = getTestFiles();
+    
+    // 打印文件列表
+    std::cout << "\n========== testfile Directory Files ==========" << std::endl;
+    if (files.empty()) {
+        std::cout << "  (No files found)" << std::endl;
+    } else {
+        for (size_t i = 0; i < files.size(); i++) {
+            std::cout << "  [" << (i + 1) << "] " << files[i] << std::endl;
+        }
+    }
+    std::cout << "===============================================" << std::endl;
+    std::cout << "Please enter the filename to transfer: ";
+    
+    // 读取用户输入
+    std::string input;
+    std::getline(std::cin, input);
+    
+    // 去除首尾空格
+    size_t start = input.find_first_not_of(" \t");
+    size_t end = input.find_last_not_of(" \t");
+    if (start != std::string::npos && end != std::string::npos) {
+        input = input.substr(start, end - start + 1);
+    } else {
+        input.clear();
+    }
+    
+    // 检查用户输入
+    if (input.empty()) {
+        std::cout << "[Error] Empty input, exiting..." << std::endl;
+        return false;
+    }
+    
+    // 检查输入的文件名是否存在
+    bool found = false;
+    for (const auto& file : files) {
+        if (file == input) {
+            found = true;
+            break;
+        }
+    }
+    if (!found) {
+        std::cout << "[Error] File '" << input << "' not found in testfile directory." << std::endl;
+        return false;
+    }
+    
+    filename = input;
+    return readFileContent(filename, content);
+}
+
 
 
 // ========================================================= 流水线发送 ==================================================//
 // 全局发送窗口：管理流水线发送的滑动窗口状态
 SendWindow g_sendWindow;
 
+// 全局指标记录器：定时采样发送窗口状态
+MetricsRecorder g_metrics;
+
+// UDP分段卸载：发送一批连续序列化的数据包（每个segSize字节，最后一个可以更短）
+// offload为true时一次sendto交给协议栈切分；失败则关闭卸载（offload置false）并逐包重发这一批
+static bool sendBatch(SOCKET clientSocket, sockaddr_in& serverAddr,
+                      const char* buffer, int len, int segSize, bool& offload) {
+    if (len <= 0) return true;
+    if (offload) {
+        int bytesSent = sendto(clientSocket, buffer, len, 0, (sockaddr*)&serverAddr, sizeof(serverAddr));
+        if (bytesSent != SOCKET_ERROR) return true;
+        LOG_WARN("[Offload] USO send failed (%d), falling back to per-packet send", WSAGetLastError());
+        offload = false;
+        enableSendOffload(clientSocket, 0);
+    }
+    for (int offset = 0; offset < len; offset += segSize) {
+        int packetLen = (len - offset > segSize) ? segSize : (len - offset);
+        if (sendto(clientSocket, buffer + offset, packetLen, 0,
+                   (sockaddr*)&serverAddr, sizeof(serverAddr)) == SOCKET_ERROR) {
+            LOG_ERROR("[错误] 发送数据包失败: %d", WSAGetLastError());
+            return false;
+        }
+    }
+    return true;
+}
+
 // 流水线发送数据（支持SACK和RENO拥塞控制）
+// earlySent > 0 表示握手阶段已经随SYN发出了前earlySent字节（0-RTT），发送窗口中保留着这些包，从其后继续发送
 bool pipelineSend(SOCKET clientSocket, sockaddr_in& serverAddr, 
-                  const char* data, int dataLen, uint32_t baseSeq) {
-    // 初始化发送窗口
-    g_sendWindow.reset(baseSeq);
+                  const char* data, int dataLen, uint32_t baseSeq, int earlySent) {
+    // 初始化发送窗口（0-RTT时handshake已经初始化过，不能再重置）
+    if (earlySent <= 0) {
+        earlySent = 0;
+        prepareSendWindow(baseSeq);
+    }
     
-    int totalPackets = (dataLen + MAX_DATA_SIZE - 1) / MAX_DATA_SIZE;  // 计算总包数，这里+MDS-1是为了向上取整
+    const int mss = g_sendWindow.mss;  // 本连接握手时协商的MSS（路径MTU探测结果）
+    // 计算总包数：早期数据包按 FAST_OPEN_DATA_SIZE 切分，其余按MSS切分（+mss-1是为了向上取整）
+    int earlyPackets = (int)(g_sendWindow.next_seq - g_sendWindow.base);
+    int totalPackets = earlyPackets + (dataLen - earlySent + mss - 1) / mss;
     int sentPackets = 0;    // 已完成发送（已确认）的包数
-    int dataOffset = 0;     // 数据偏移量
+    int dataOffset = earlySent;     // 数据偏移量
     
     std::cout << "\n[Pipeline Send] Starting to send data, total length=" << dataLen 
               << ", total packets=" << totalPackets 
+              << ", MSS=" << mss
               << ", initial window size=" << FIXED_WINDOW_SIZE << std::endl;
+    if (earlySent > 0) {
+        std::cout << "[0-RTT] " << earlyPackets << " packets (" << earlySent
+                  << " bytes) already sent during handshake" << std::endl;
+    }
     std::cout << "[RENO] Initial state: cwnd=" << g_sendWindow.cwnd 
               << ", ssthresh=" << g_sendWindow.ssthresh 
               << ", phase=" << getRenoPhaseName(g_sendWindow.reno_phase) << std::endl;
@@ -105,20 +305,46 @@ bool pipelineSend(SOCKET clientSocket, sockaddr_in& serverAddr,
     int timeout = 100;  // 100ms短超时，用于轮询
     setsockopt(clientSocket, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout));
     
+    // UDP分段卸载（USO）：按完整数据包大小切分，一批至少要能放下两个包才有意义
+    const int segSize = HEADER_SIZE + mss;
+    bool offload = false;
+    if (UDP_OFFLOAD_ENABLED && segSize * 2 <= UDP_OFFLOAD_MAX_BYTES) {
+        offload = enableSendOffload(clientSocket, segSize);
+        std::cout << "[Offload] USO " << (offload ? "enabled" : "not supported, using per-packet send")
+                  << " (segment size=" << segSize << ")" << std::endl;
+    }
+    g_sendWindow.offload_active = offload;
+    static char batchBuffer[UDP_OFFLOAD_MAX_BYTES];  // 一批待发送数据包的连续缓冲区
+    double cpuStart = getProcessCpuTimeMs();
+    
+    // 开始指标采样，先记录初始状态
+    g_metrics.start("sender");
+    g_metrics.record(metricsFromSendWindow(g_sendWindow), clock());
+    
     while (sentPackets < totalPackets) {
+        // ===== 指标采样：距上次采样超过 METRICS_SAMPLE_INTERVAL_MS 时记录一次窗口快照 =====
+        clock_t loopTime = clock();
+        if (g_metrics.due(loopTime)) {
+            g_metrics.record(metricsFromSendWindow(g_sendWindow), loopTime);
+        }
+        
         // ===== 步骤1：发送窗口内所有可发送的包（流水线发送，受 RENO 拥塞窗口限制） =====
+        // 启用USO时本轮的包依次序列化到batchBuffer，攒满或本轮结束时一次发出；
+        // 数据按MSS切分，只有文件最后一块可能不足MSS，正好满足"只有最后一个段可以更短"的要求
+        int batchLen = 0;
         while (g_sendWindow.canSend() && dataOffset < dataLen) {   // 检查序号是否在窗口内，且还有数据还没发完
             int idx = g_sendWindow.getIndex(g_sendWindow.next_seq);// 获取窗口内索引
             
             // 计算当前包的数据长度
-            int packetDataLen = (dataLen - dataOffset > MAX_DATA_SIZE) ? 
-                                MAX_DATA_SIZE : (dataLen - dataOffset);//MSS或剩余数据长度
+            int packetDataLen = (dataLen - dataOffset > mss) ? 
+                                mss : (dataLen - dataOffset);//MSS或剩余数据长度
             
             // 将数据复制到发送窗口缓冲区（用于可能的重传）
             memcpy(g_sendWindow.data_buf[idx], data + dataOffset, packetDataLen);//参数：目标地址，源地址，复制长度，data是要传输文件的基地址
             g_sendWindow.data_len[idx] = packetDataLen;
             g_sendWindow.is_sent[idx] = 1;
             g_sendWindow.is_ack[idx] = 0;
+            g_sendWindow.is_retx[idx] = 0;
             g_sendWindow.send_time[idx] = clock();  // 记录发送时间，用于计时器
             
             // 构造并发送数据包
@@ -129,29 +355,46 @@ bool pipelineSend(SOCKET clientSocket, sockaddr_in& serverAddr,
             dataPacket.header.win = FIXED_WINDOW_SIZE;  // 用不上，暂时设置为固定窗口大小
             dataPacket.setData(g_sendWindow.data_buf[idx], packetDataLen);//加载数据到数据包的负载部分
             
-            char sendBuffer[MAX_PACKET_SIZE];
-            dataPacket.serialize(sendBuffer);
-            int bytesSent = sendto(clientSocket, sendBuffer, dataPacket.getTotalLen(), 0,
-                                  (sockaddr*)&serverAddr, sizeof(serverAddr));//参数：套接字，发送数据缓冲区，数据长度，标志，目标地址，地址长度
-            
-            if (bytesSent == SOCKET_ERROR) {
-                std::cerr << "[错误] 发送数据包失败: " << WSAGetLastError() << std::endl;
-                return false;
+            if (offload) {
+                // 放入当前批次，再放一个完整包就会超出上限时先把这一批发出去
+                dataPacket.serialize(batchBuffer + batchLen);
+                batchLen += dataPacket.getTotalLen();
+                if (batchLen + segSize > UDP_OFFLOAD_MAX_BYTES) {
+                    if (!sendBatch(clientSocket, serverAddr, batchBuffer, batchLen, segSize, offload)) {
+                        logFlush();
+                        return false;
+                    }
+                    batchLen = 0;
+                }
+            } else {
+                char sendBuffer[MAX_PACKET_SIZE];
+                dataPacket.serialize(sendBuffer);
+                int bytesSent = sendto(clientSocket, sendBuffer, dataPacket.getTotalLen(), 0,
+                                      (sockaddr*)&serverAddr, sizeof(serverAddr));//参数：套接字，发送数据缓冲区，数据长度，标志，目标地址，地址长度
+                
+                if (bytesSent == SOCKET_ERROR) {
+                    LOG_ERROR("[错误] 发送数据包失败: %d", WSAGetLastError());
+                    logFlush();
+                    return false;
+                }
             }
             
             // 更新统计信息
             g_sendWindow.total_packets_sent++;
             g_sendWindow.total_bytes_sent += packetDataLen;
             
-            std::cout << "[Send] Data packet seq=" << g_sendWindow.next_seq 
-                     << ", length=" << packetDataLen 
-                     << ", window[" << g_sendWindow.base << "," 
-                     << (g_sendWindow.base + g_sendWindow.getEffectiveWindow() - 1) << "]"
-                     << ", cwnd=" << g_sendWindow.cwnd << std::endl;
+            LOG_TRACE("[Send] Data packet seq=%u, length=%d, window[%u,%u], cwnd=%u",
+                      g_sendWindow.next_seq, packetDataLen, g_sendWindow.base,
+                      g_sendWindow.base + g_sendWindow.getEffectiveWindow() - 1, g_sendWindow.cwnd);
             
             dataOffset += packetDataLen;
             g_sendWindow.next_seq++;
         }
+        // 发出本轮剩余的一批
+        if (!sendBatch(clientSocket, serverAddr, batchBuffer, batchLen, segSize, offload)) {
+            logFlush();
+            return false;
+        }
         
         // ===== 步骤2：接收ACK/SACK并处理（整合 RENO 拥塞控制） =====
         char recvBuffer[MAX_PACKET_SIZE];
@@ -164,12 +407,16 @@ bool pipelineSend(SOCKET clientSocket, sockaddr_in& serverAddr,
         if (bytesReceived > 0) {
             Packet ackPacket;
             if (ackPacket.deserialize(recvBuffer, bytesReceived)) {//解析接收到的包
-                // 检查是否为ACK包
-                if (ackPacket.header.flag & FLAG_ACK) {
-                    std::cout << "[Receive] ACK packet ack=" << ackPacket.header.ack;
+                // 检查是否为ACK包（忽略迟到的重复SYN+ACK：服务端会对每个重传的SYN回送一次）
+                if ((ackPacket.header.flag & FLAG_ACK) && !(ackPacket.header.flag & FLAG_SYN)) {
+                    LOG_TRACE("[Receive] ACK packet ack=%u%s", ackPacket.header.ack,
+                              (ackPacket.header.flag & FLAG_SACK) ? " (with SACK)" : "");
                     
                     // ===== RENO 拥塞控制：处理 ACK =====
                     bool isNewACK = g_sendWindow.handleNewACK(ackPacket.header.ack);
+                    if (isNewACK) {
+                        g_sendWindow.sampleRTT(ackPacket.header.ack);  // 在滑动窗口之前采样RTT
+                    }
                     
                     // 检查是否带有SACK标志
                     if (ackPacket.header.flag & FLAG_SACK) {
@@ -177,10 +424,8 @@ bool pipelineSend(SOCKET clientSocket, sockaddr_in& serverAddr,
                         SACKInfo sackInfo;
                         if (ackPacket.dataLen > 0 && 
                             sackInfo.deserialize(ackPacket.data, ackPacket.dataLen)) {
-                            std::cout << ", SACK blocks=[";
                             for (int i = 0; i < sackInfo.count; i++) {
-                                if (i > 0) std::cout << ",";
-                                std::cout << sackInfo.sack_blocks[i];
+                                LOG_TRACE("[Receive]   SACK block seq=%u", sackInfo.sack_blocks[i]);
                                 // 标记SACK中的序列号为已确认
                                 // 根据SACK信息标记已接收的包，避免超时重传
                                 if (sackInfo.sack_blocks[i] >= g_sendWindow.base &&
@@ -193,10 +438,8 @@ bool pipelineSend(SOCKET clientSocket, sockaddr_in& serverAddr,
                                     }
                                 }
                             }
-                            std::cout << "]" << std::endl;
                         }
                     }
-                    std::cout << std::endl;
                     
                     // 标记所有序列号 < ack 的包为已确认
                     for (uint32_t seq = g_sendWindow.base; seq < ackPacket.header.ack; seq++) {
@@ -213,7 +456,7 @@ bool pipelineSend(SOCKET clientSocket, sockaddr_in& serverAddr,
                     uint32_t oldBase = g_sendWindow.base;
                     g_sendWindow.slideWindow();
                     if (g_sendWindow.base > oldBase) {
-                        std::cout << "[Window Slide] base: " << oldBase << " -> " << g_sendWindow.base << std::endl;
+                        LOG_TRACE("[Window Slide] base: %u -> %u", oldBase, g_sendWindow.base);
                     }
                     
                     // ===== RENO 快速重传处理 =====
@@ -225,7 +468,7 @@ bool pipelineSend(SOCKET clientSocket, sockaddr_in& serverAddr,
                         if (lostSeq >= g_sendWindow.base && lostSeq < g_sendWindow.next_seq) {//确保丢失包在发送窗口内
                             int lostIdx = g_sendWindow.getIndex(lostSeq);//获取丢失包的窗口索引
                             
-                            std::cout << "[RENO] Fast Retransmit: retransmitting seq=" << lostSeq << std::endl;
+                            LOG_INFO("[RENO] Fast Retransmit: retransmitting seq=%u", lostSeq);
                             
                             Packet retxPacket;
                             retxPacket.header.seq = lostSeq;
@@ -244,6 +487,7 @@ bool pipelineSend(SOCKET clientSocket, sockaddr_in& serverAddr,
                             g_sendWindow.total_retransmissions++;
                             
                             g_sendWindow.send_time[lostIdx] = clock();  // 更新发送时间
+                            g_sendWindow.is_retx[lostIdx] = 1;
                         }
                     }
                 }
@@ -269,7 +513,7 @@ bool pipelineSend(SOCKET clientSocket, sockaddr_in& serverAddr,
                     }
                     
                     // 超时重传该包
-                    std::cout << "[Timeout Retransmit] seq=" << seq << ", elapsed " << (int)elapsedMs << "ms" << std::endl;
+                    LOG_INFO("[Timeout Retransmit] seq=%u, elapsed %dms", seq, (int)elapsedMs);
                     
                     Packet retxPacket;
                     retxPacket.header.seq = seq;
@@ -288,11 +532,20 @@ bool pipelineSend(SOCKET clientSocket, sockaddr_in& serverAddr,
                     g_sendWindow.total_retransmissions++;
                     
                     g_sendWindow.send_time[idx] = clock();  // 重置发送时间
+                    g_sendWindow.is_retx[idx] = 1;
                 }
             }
         }
     }
     
+    // 等待日志线程写完本次传输的日志，之后才能直接使用std::cout
+    logFlush();
+    
+    // 关闭USO，统计传输阶段的CPU开销
+    if (offload) enableSendOffload(clientSocket, 0);
+    g_sendWindow.cpu_time_ms = getProcessCpuTimeMs() - cpuStart;
+    g_metrics.record(metricsFromSendWindow(g_sendWindow), clock());  // 结束时的最终样本
+    
     std::cout << "[Pipeline Send] Data transmission completed, sent " << totalPackets << " packets" << std::endl;
     std::cout << "[RENO] Final state: cwnd=" << g_sendWindow.cwnd 
               << ", ssthresh=" << g_sendWindow.ssthresh 
@@ -306,43 +559,128 @@ bool pipelineSend(SOCKET clientSocket, sockaddr_in& serverAddr,
 
 // ========================================================== 连接管理 ==================================================//
 // 三次握手：建立连接
-bool handshake(SOCKET clientSocket, sockaddr_in& serverAddr, uint32_t& clientSeq, uint32_t& serverSeq) {
+// 路径MTU探测：SYN包按 PMTU_PROBE_SIZES 填充到候选大小并设置DF标志，
+// 超时或本机报WSAEMSGSIZE则回退到下一个候选，服务端在SYN+ACK中回送确认的MSS
+// 0-RTT：earlyData非空时SYN携带第一块数据，首个窗口的其余数据紧随SYN发出，earlySent返回已发出的字节数
+bool handshake(SOCKET clientSocket, sockaddr_in& serverAddr, uint32_t& clientSeq, uint32_t& serverSeq,
+               const char* earlyData, int earlyLen, int& earlySent) {
     ConnectionState state = CLOSED;//连接状态，定义在client.h中
     int retries = 0;  // 重传次数
     
+    // 路径MTU探测的候选包大小（协议头+数据），探测完所有候选后使用保底大小
+    static const int probeSizes[] = PMTU_PROBE_SIZES;
+    const int probeCount = PMTU_DISCOVERY_ENABLED ? (int)(sizeof(probeSizes) / sizeof(probeSizes[0])) : 0;
+    int probeIdx = 0;  // 当前探测的候选下标，probeIdx >= probeCount 表示探测结束
+    
+    if (PMTU_DISCOVERY_ENABLED && !setDontFragment(clientSocket, true)) {
+        std::cout << "[PMTU] Warning: failed to set DF flag, probing may be inaccurate" << std::endl;
+    }
+    
+    // 连接参数缓存：命中时跳过比缓存MSS更大的探测候选，并按缓存的RTT缩短SYN重传超时
+    int synTimeout = TIMEOUT_MS;
+    g_connCacheHit = loadConnCache(serverAddr, g_connCache);
+    if (g_connCacheHit) {
+        synTimeout = (int)(4 * g_connCache.srtt_ms);
+        if (synTimeout < FAST_OPEN_MIN_SYN_TIMEOUT_MS) synTimeout = FAST_OPEN_MIN_SYN_TIMEOUT_MS;
+        if (synTimeout > TIMEOUT_MS) synTimeout = TIMEOUT_MS;
+        while (probeIdx < probeCount && probeSizes[probeIdx] > g_connCache.mss + HEADER_SIZE) probeIdx++;
+        std::cout << "[Cache] Warm start for " << connCacheKey(serverAddr) << ": cwnd=" << g_connCache.cwnd
+                  << ", ssthresh=" << g_connCache.ssthresh << ", srtt=" << g_connCache.srtt_ms
+                  << "ms, mss=" << g_connCache.mss << ", SYN timeout=" << synTimeout << "ms" << std::endl;
+    } else if (CONN_CACHE_ENABLED) {
+        std::cout << "[Cache] No cached parameters for " << connCacheKey(serverAddr) << ", cold start" << std::endl;
+    }
+    
     // 生成客户端初始序列号
     clientSeq = generateInitialSeq();
     std::cout << "\n[Three-way Handshake] Starting connection establishment..." << std::endl;
     
+    // 0-RTT：初始化发送窗口并放入首个窗口的数据（序列号从clientSeq+1开始），第一块由SYN携带
+    earlySent = 0;
+    int synDataIdx = -1;     // SYN携带的数据在发送窗口中的下标，-1表示SYN不携带数据
+    int synSendCount = 0;    // SYN已发送次数（携带的数据重发过则不能用于RTT采样）
+    bool burstSent = false;  // 首个窗口的其余数据包是否已发出
+    if (FAST_OPEN_ENABLED && earlyData != NULL && earlyLen > 0) {
+        prepareSendWindow(clientSeq + 1);
+        earlySent = stageEarlyData(earlyData, earlyLen);
+        synDataIdx = g_sendWindow.getIndex(clientSeq + 1);
+        std::cout << "[0-RTT] SYN carries " << g_sendWindow.data_len[synDataIdx] << " bytes, "
+                  << (g_sendWindow.next_seq - g_sendWindow.base - 1) << " more packets follow immediately ("
+                  << earlySent << " bytes in total)" << std::endl;
+    }
+    
     // First handshake: Send SYN packet
     // 第一次握手：客户端发送SYN包
     state = SYN_SENT;//把连接状态改为SYN_SENT
     std::cout << "[State Transition] CLOSED -> SYN_SENT" << std::endl;
     
-    Packet synPacket;//构造SYN包
-    synPacket.header.seq = clientSeq;//设置序列号
-    synPacket.header.ack = 0;//初始ACK为0，表示这不是确认包
-    synPacket.header.flag = FLAG_SYN; // 设置SYN标志，作用是告诉接收方这是一个连接请求包
-    synPacket.dataLen = 0;//数据长度为0，因为SYN包不携带数据
-    synPacket.header.len = 0;  // 同步设置协议头中的数据长度字段
-    synPacket.header.calculateChecksum(synPacket.data, 0); // 计算校验和
-    
     while (retries < MAX_RETRIES) {//MAX_RETRIES定义在config.h中，表示建立、关闭连接时的最大重传次数
-        // 发送SYN包
+        // 计算本次SYN的总长度：探测阶段使用候选大小，探测结束后使用保底大小（关闭探测时使用MAX_PACKET_SIZE）
+        bool probing = probeIdx < probeCount;
+        int packetSize = probing ? probeSizes[probeIdx]
+                                 : (PMTU_DISCOVERY_ENABLED ? PMTU_BASE_PACKET_SIZE : MAX_PACKET_SIZE);
+        if (packetSize > MAX_PACKET_SIZE) packetSize = MAX_PACKET_SIZE;
+        
+        Packet synPacket;//构造SYN包
+        synPacket.header.seq = clientSeq;//设置序列号
+        synPacket.header.ack = 0;//初始ACK为0，表示这不是确认包
+        synPacket.header.flag = FLAG_SYN; // 设置SYN标志，作用是告诉接收方这是一个连接请求包
+        synPacket.header.mss = (uint16_t)(packetSize - HEADER_SIZE); // MSS选项：本次探测的数据负载大小
+        if (synDataIdx >= 0) {
+            // 0-RTT：携带第一块数据（序列号clientSeq+1），FAST_OPEN_DATA_SIZE不超过任何候选大小
+            synPacket.setData(g_sendWindow.data_buf[synDataIdx], g_sendWindow.data_len[synDataIdx]);
+        } else {
+            synPacket.dataLen = 0;//数据长度为0，因为SYN包不携带数据
+            synPacket.header.len = 0;  // 同步设置协议头中的数据长度字段
+            synPacket.header.calculateChecksum(synPacket.data, 0); // 计算校验和
+        }
+        
+        // 发送SYN包：数据之后用0填充到packetSize，填充部分不计入len，接收方反序列化时会忽略
         char sendBuffer[MAX_PACKET_SIZE];//定义发送缓冲区
         synPacket.serialize(sendBuffer);//序列化SYN包到发送缓冲区
-        int bytesSent = sendto(clientSocket, sendBuffer, synPacket.getTotalLen(), 0,
+        memset(sendBuffer + synPacket.getTotalLen(), 0, packetSize - synPacket.getTotalLen());
+        int bytesSent = sendto(clientSocket, sendBuffer, packetSize, 0,
                               (sockaddr*)&serverAddr, sizeof(serverAddr));//发送SYN包，返回发送的字节数
         if (bytesSent == SOCKET_ERROR) {//发送失败
+            if (probing && WSAGetLastError() == WSAEMSGSIZE) {
+                // 超过本机出口MTU，直接回退到下一个候选
+                std::cout << "[PMTU] Probe size " << packetSize << " exceeds local MTU, falling back" << std::endl;
+                probeIdx++;
+                continue;
+            }
             std::cerr << "[Error] Failed to send SYN packet: " << WSAGetLastError() << std::endl;
             return false;
         }
         
-        std::cout << "[Sent] SYN packet (seq=" << clientSeq << ", retry count=" << retries << ")" << std::endl;
+        std::cout << "[Sent] SYN packet (seq=" << clientSeq << ", size=" << packetSize
+                  << ", data=" << synPacket.dataLen << ", retry count=" << retries << ")" << std::endl;
+        
+        if (synDataIdx >= 0) {
+            g_sendWindow.send_time[synDataIdx] = clock();
+            if (++synSendCount > 1) g_sendWindow.is_retx[synDataIdx] = 1;
+        }
+        
+        // 0-RTT：首个窗口的其余数据包紧随第一个SYN发出，不等待SYN+ACK（只发一次，丢失的由pipelineSend超时重传）
+        if (!burstSent && synDataIdx >= 0) {
+            burstSent = true;
+            for (uint32_t seq = clientSeq + 2; seq < g_sendWindow.next_seq; seq++) {
+                int idx = g_sendWindow.getIndex(seq);
+                Packet dataPacket;
+                dataPacket.header.seq = seq;
+                dataPacket.header.ack = 0;
+                dataPacket.header.flag = FLAG_ACK;
+                dataPacket.header.win = FIXED_WINDOW_SIZE;
+                dataPacket.setData(g_sendWindow.data_buf[idx], g_sendWindow.data_len[idx]);
+                dataPacket.serialize(sendBuffer);
+                sendto(clientSocket, sendBuffer, dataPacket.getTotalLen(), 0,
+                       (sockaddr*)&serverAddr, sizeof(serverAddr));
+                g_sendWindow.send_time[idx] = clock();
+            }
+        }
         
         // 设置接收超时
-        // 握手阶段的超时重传机制
-        int timeout = TIMEOUT_MS;//设置超时时间，TIMEOUT_MS定义在config.h中，表示超时时间
+        // 握手阶段的超时重传机制：探测阶段使用较短的探测超时，有缓存时按缓存的RTT缩短超时
+        int timeout = probing ? PMTU_PROBE_TIMEOUT_MS : synTimeout;//设置超时时间，TIMEOUT_MS定义在config.h中，表示超时时间
         setsockopt(clientSocket, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout));//设置套接字选项，指定接收超时时间，这五个参数分别是：套接字描述符、级别（SOL_SOCKET表示套接字级别）、选项名称（SO_RCVTIMEO表示接收超时选项）、指向超时值的指针、超时值的大小
         
         // 等待接收SYN+ACK包
@@ -355,6 +693,12 @@ bool handshake(SOCKET clientSocket, sockaddr_in& serverAddr, uint32_t& clientSeq
         
         if (bytesReceived == SOCKET_ERROR) {
             if (WSAGetLastError() == WSAETIMEDOUT) {//接收超时导致的错误
+                if (probing) {
+                    // 探测失败（包过大被丢弃或SYN丢失），回退到下一个候选，不计入重传次数
+                    std::cout << "[PMTU] No SYN+ACK for probe size " << packetSize << ", falling back" << std::endl;
+                    probeIdx++;
+                    continue;
+                }
                 retries++;
                 std::cout << "[Timeout] SYN+ACK not received, retransmitting SYN (attempt " << retries << ")" << std::endl;
                 continue;
@@ -376,8 +720,17 @@ bool handshake(SOCKET clientSocket, sockaddr_in& serverAddr, uint32_t& clientSeq
         if ((recvPacket.header.flag & FLAG_SYN) && (recvPacket.header.flag & FLAG_ACK)) {//检查标志位是否同时包含SYN和ACK
             if (recvPacket.header.ack == clientSeq + 1) {//确认号正确
                 serverSeq = recvPacket.header.seq;//记录服务器的初始序列号
+                
+                // 记录协商后的MSS：SYN+ACK回送的是服务端实际收到的那个探测包对应的MSS，
+                // 可能是较早发出的更大候选（SYN+ACK迟到），同样有效；服务端不支持该选项时回退到本次大小
+                uint16_t mss = recvPacket.header.mss;
+                if (mss == 0 || mss > MAX_DATA_SIZE) mss = (uint16_t)(packetSize - HEADER_SIZE);
+                g_sendWindow.mss = mss;
+                
                 std::cout << "[Received] SYN+ACK packet (seq=" << serverSeq 
-                         << ", ack=" << recvPacket.header.ack << ")" << std::endl;
+                         << ", ack=" << recvPacket.header.ack << ", mss=" << recvPacket.header.mss << ")" << std::endl;
+                std::cout << "[PMTU] Negotiated MSS=" << g_sendWindow.mss
+                         << " (packet size " << (g_sendWindow.mss + HEADER_SIZE) << " bytes)" << std::endl;
                 
                 // 第三次握手：发送ACK包
                 Packet ackPacket;//第一次握手发送的包叫synPacket，第二次握手收到的包叫recvPacket，第三次握手发送的包叫ackPacket
@@ -527,6 +880,9 @@ bool closeConnection(SOCKET clientSocket, sockaddr_in& serverAddr, uint32_t clie
         std::cout << "\n========== Client Transmission Statistics ==========" << std::endl;
         std::cout << "Total Packets Sent (incl. retrans): " << g_sendWindow.total_packets_sent << std::endl;
         std::cout << "Total Retransmissions: " << g_sendWindow.total_retransmissions << std::endl;
+        std::cout << "UDP Send Offload (USO): " << (g_sendWindow.offload_active ? "on" : "off") << std::endl;
+        std::cout << "CPU Time: " << g_sendWindow.cpu_time_ms << " ms" << std::endl;
+        std::cout << "CPU per GB: " << cpuMsPerGB(g_sendWindow.cpu_time_ms, g_sendWindow.total_bytes_sent) << " ms" << std::endl;
         std::cout << "====================================================\n" << std::endl;
         
         return true;
@@ -568,6 +924,10 @@ int main() {
     std::cout.rdbuf(&teeBuf);
     std::cerr.rdbuf(&teeErrBuf);
 
+    // 启动异步日志线程，热路径日志经由它写入控制台（同时进入client.txt）
+    logSetSink(LOG_SINK_CONSOLE, &std::cout);
+    logStart();
+
     // 1. 初始化Winsock库
     WSADATA wsaData;
     int result = WSAStartup(MAKEWORD(2, 2), &wsaData);  // 请求版本2.2的Winsock
@@ -604,83 +964,56 @@ int main() {
     serverAddr.sin_addr.s_addr = inet_addr(SERVER_IP);
     serverAddr.sin_port = htons(SERVER_PORT);  // 端口号，htons将主机字节序转换为网络字节序
 
-    // 4. 执行三次握手，建立连接
+    // 4. 选择要传输的文件：0-RTT模式下首个窗口的数据随SYN发出，需要在建立连接之前选好
+    std::string filename;
+    std::vector<char> content;
+    bool fileReady = false;
+    if (FAST_OPEN_ENABLED) {
+        fileReady = selectFile(filename, content);
+    }
+
+    // 5. 执行三次握手，建立连接
     uint32_t clientSeq = 0;  // 客户端序列号
     uint32_t serverSeq = 0;  // 服务端序列号
+    int earlySent = 0;       // 握手阶段随SYN发出的字节数（0-RTT）
     
-    if (!handshake(clientSocket, serverAddr, clientSeq, serverSeq)) {
+    if (!handshake(clientSocket, serverAddr, clientSeq, serverSeq,
+                   fileReady ? content.data() : NULL, fileReady ? (int)content.size() : 0, earlySent)) {
         std::cerr << "Connection establishment failed!" << std::endl;
+        logStop();
         closesocket(clientSocket);
         WSACleanup();
         return 1;
     }
 
-    // 5. 连接已建立，进入单文件传输模式
+    // 6. 连接已建立，进入单文件传输模式
     std::cout << "\n===== Single File Transfer Mode (window size=" << FIXED_WINDOW_SIZE << ") =====" << std::endl;
     std::cout << "[RENO] RENO congestion control enabled" << std::endl;
     
     bool transferSuccess = false;
-    
-    // 获取testfile目录下的文件列表
-    std::vector<std::string> files = getTestFiles();
-    
-    // 打印文件列表
-    std::cout << "\n========== testfile Directory Files ==========" << std::endl;
-    if (files.empty()) {
-        std::cout << "  (No files found)" << std::endl;
-    } else {
-        for (size_t i = 0; i < files.size(); i++) {
-            std::cout << "  [" << (i + 1) << "] " << files[i] << std::endl;
-        }
+    if (!FAST_OPEN_ENABLED) {
+        fileReady = selectFile(filename, content);
     }
-    std::cout << "===============================================" << std::endl;
-    std::cout << "Please enter the filename to transfer: ";
-    
-    // 读取用户输入
-    std::string input;
-    std::getline(std::cin, input);
-    
-    // 去除首尾空格
-    size_t start = input.find_first_not_of(" \t");
-    size_t end = input.find_last_not_of(" \t");
-    if (start != std::string::npos && end != std::string::npos) {
-        input = input.substr(start, end - start + 1);
-    } else {
-        input.clear();
-    }
-    
-    // 检查用户输入
-    if (input.empty()) {
-        std::cout << "[Error] Empty input, exiting..." << std::endl;
-    } else {
-        // 检查输入的文件名是否存在
-        bool found = false;
-        for (const auto& file : files) {
-            if (file == input) {
-                found = true;
-                break;
-            }
-        }
+    if (fileReady) {
+        // 传输指定文件
+        transferSuccess = transferFile(clientSocket, serverAddr, filename, content, clientSeq, earlySent);
         
-        if (!found) {
-            std::cout << "[Error] File '" << input << "' not found in testfile directory." << std::endl;
-        } else {
-            // 传输指定文件
-            transferSuccess = transferFile(clientSocket, serverAddr, input, clientSeq);
-            
-            // 传输完成后稍作等待
-            Sleep(500);
-        }
+        // 传输完成后稍作等待
+        Sleep(500);
     }
     
     std::cout << "\n[Summary] File transfer " << (transferSuccess ? "succeeded" : "failed or skipped") << std::endl;
 
-    // 6. 执行四次挥手关闭连接
+    // 7. 执行四次挥手关闭连接
     if (!closeConnection(clientSocket, serverAddr, clientSeq, serverSeq)) {
         std::cerr << "Connection closure process encountered an exception" << std::endl;
     }
 
-    // 7. 清理资源
+    // 8. 导出传输指标时间序列
+    g_metrics.dump("metrics_client");
+
+    // 9. 清理资源
+    logStop();
     closesocket(clientSocket);
     WSACleanup();
 
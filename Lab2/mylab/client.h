@@ -10,17 +10,24 @@
 #include <ws2tcpip.h>
 #include "config.h"
 #include "protocol.h"
+#include "metrics.h"
 
 // 全局发送窗口：管理流水线发送的滑动窗口状态
 extern SendWindow g_sendWindow;
 
+// 全局指标记录器：定时采样发送窗口状态，结束时导出为 metrics_client.csv/.json
+extern MetricsRecorder g_metrics;
+
 // 流水线发送数据（支持SACK和RENO拥塞控制）
+// earlySent为握手阶段已随SYN发出的字节数（0-RTT），为0时从头开始发送
 bool pipelineSend(SOCKET clientSocket, sockaddr_in& serverAddr, 
-                  const char* data, int dataLen, uint32_t baseSeq);
+                  const char* data, int dataLen, uint32_t baseSeq, int earlySent);
 
 // 三次握手：建立连接
+// 0-RTT：earlyData非空时首个窗口的数据随SYN发出，earlySent返回已发出的字节数
 bool handshake(SOCKET clientSocket, sockaddr_in& serverAddr, 
-               uint32_t& clientSeq, uint32_t& serverSeq);
+               uint32_t& clientSeq, uint32_t& serverSeq,
+               const char* earlyData, int earlyLen, int& earlySent);
 
 // 四次挥手：关闭连接
 bool closeConnection(SOCKET clientSocket, sockaddr_in& serverAddr, 
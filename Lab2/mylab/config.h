@@ -69,7 +69,7 @@
 
 /**
  * 最大数据包大小（字节）
- * 含义：单个UDP数据包的最大总长度（协议头+数据）
+ * 含义：单个UDP数据包的最大总长度（协议头+数据），也是收发缓冲区的容量上限
  * 修改方法：建议在512-1472之间调整（1472=1500MTU-28IP/UDP头）
  * 修改效果：
  *   - 增大（如1400）：
@@ -78,6 +78,10 @@
  *   - 减小（如512）：
  *     * 更多小包，增加网络开销
  *     * 降低单包丢失的影响
+ * 说明：
+ *   - 启用路径MTU探测（PMTU_DISCOVERY_ENABLED）后，实际每个包的大小由握手时
+ *     协商出的MSS决定，这里的值只作为探测的最大候选值和缓冲区大小
+ *   - 本地回环（MTU=65536）下8192可以直接通过；经过以太网时会自动回退到1472
  */
 #define MAX_PACKET_SIZE 8192
 
@@ -363,6 +367,232 @@
 // int timeout = 100;  // 在client.cpp pipelineSend函数中
 
 
+// ============================================================================
+// 八、路径MTU探测参数（PMTU Discovery）
+// ============================================================================
+
+/**
+ * 是否启用路径MTU探测
+ * 含义：客户端握手时设置DF（禁止分片）标志，用填充到候选大小的SYN包探测路径MTU，
+ *       服务端在SYN+ACK中回送协商后的MSS，之后所有数据包都不超过该MSS
+ * 修改方法：
+ *   - true：启用探测，按 PMTU_PROBE_SIZES 从大到小依次尝试
+ *   - false：关闭探测，直接使用 MAX_DATA_SIZE 作为MSS（旧行为，可能产生IP分片）
+ * 修改效果：
+ *   - 启用时：数据包不会被IP分片，单个分片丢失不再导致整个8KB数据包丢失
+ *   - 启用时：握手阶段最多多花 PMTU_PROBE_TIMEOUT_MS × 候选数量 的时间
+ */
+#define PMTU_DISCOVERY_ENABLED true
+
+/**
+ * 探测候选包大小列表（字节，协议头+数据，从大到小）
+ * 含义：客户端依次尝试的SYN包总长度，某个大小超时或发送时报WSAEMSGSIZE则回退到下一个
+ * 修改方法：按从大到小的顺序增删数值，第一个值不应超过 MAX_PACKET_SIZE
+ * 修改效果：
+ *   - MAX_PACKET_SIZE：本地回环等大MTU链路
+ *   - 1472：标准以太网（1500 - 20IP头 - 8UDP头）
+ *   - 1452：PPPoE链路（1492 - 28）
+ *   - 1280：隧道/VPN等MTU较小的链路
+ *   - 候选越多，在小MTU路径上握手越慢
+ */
+#define PMTU_PROBE_SIZES { MAX_PACKET_SIZE, 1472, 1452, 1280 }
+
+/**
+ * 保底包大小（字节，协议头+数据）
+ * 含义：所有候选都探测失败后使用的包大小，此后按普通SYN重传流程（TIMEOUT_MS、MAX_RETRIES）继续握手
+ * 修改方法：建议不小于548（576最小重组长度 - 28），一般保持1200
+ * 修改效果：
+ *   - 增大：保底情况下效率更高，但在极小MTU路径上可能仍被分片
+ *   - 减小：几乎所有路径都能通过，但每包携带的数据更少
+ */
+#define PMTU_BASE_PACKET_SIZE 1200
+
+/**
+ * 单个候选大小的探测超时（毫秒）
+ * 含义：发送某个大小的SYN后等待SYN+ACK的时间，超时即认为该大小无法通过（或SYN丢失），回退到下一个候选
+ * 修改方法：建议略大于一个RTT，本地测试100-300ms，广域网500-1000ms
+ * 修改效果：
+ *   - 增大：在高延迟网络中不会误判，但小MTU路径上握手更慢
+ *   - 减小：回退更快，但可能因为RTT较大而错误地选用较小的MSS
+ */
+#define PMTU_PROBE_TIMEOUT_MS 300
+
+
+// ============================================================================
+// 九、UDP分段卸载参数（USO/URO，Windows版的GSO/GRO）
+// ============================================================================
+
+/**
+ * 是否启用UDP分段卸载
+ * 含义：发送端通过 UDP_SEND_MSG_SIZE（USO）把窗口内连续的多个数据包拼成一个大缓冲区，
+ *       一次sendto交给协议栈按MSS切分；接收端通过 UDP_RECV_MAX_COALESCED_SIZE（URO）
+ *       一次recvfrom收到多个合并的数据包，再由pipelineRecv按包长拆分
+ * 修改方法：
+ *   - true：启用卸载，系统不支持时（Windows 10 2004之前的版本/网卡驱动）自动回退到逐包收发
+ *   - false：逐包调用sendto/recvfrom（旧行为）
+ * 修改效果：
+ *   - 启用时：系统调用次数大幅减少，每GB数据消耗的CPU时间降低
+ *   - 启用时：一批数据包一起进入网络，突发更大
+ * 测试方法（CPU/GB对比）：
+ *   - 分别以 true/false 编译，传输同一个大文件
+ *   - 比较客户端/服务端结束时输出的 "CPU per GB" 一行
+ */
+#define UDP_OFFLOAD_ENABLED false
+
+/**
+ * 单次卸载发送/接收的最大字节数
+ * 含义：USO一次sendto的缓冲区上限，以及URO合并后的最大长度
+ * 修改方法：不能超过65507（UDP数据报上限），一般保持60000左右
+ * 修改效果：
+ *   - 增大：每次系统调用携带更多数据包
+ *   - 减小：突发更小，但节省的系统调用变少
+ */
+#define UDP_OFFLOAD_MAX_BYTES 60000
+
+
+// ============================================================================
+// 十、传输指标采样参数
+// ============================================================================
+
+/**
+ * 是否启用指标采样
+ * 含义：传输过程中定时记录cwnd、ssthresh、RTT、吞吐率、重传/重复/丢包计数，
+ *       结束时导出为 metrics_client.csv/.json（发送端）和 metrics_server.csv/.json（接收端）
+ * 修改方法：
+ *   - true：启用采样并导出
+ *   - false：不采样，不生成文件
+ * 修改效果：
+ *   - 启用时：可以用同一个脚本绘制两端的时间序列，对比不同参数下的拥塞控制行为
+ *   - 采样本身只是结构体拷贝，对传输效率几乎没有影响
+ */
+#define METRICS_ENABLED true
+
+/**
+ * 采样间隔（毫秒）
+ * 含义：两个样本之间的最小时间间隔（在收发循环中检查，空闲等待期间不会采样）
+ * 修改方法：建议范围10-1000ms
+ * 修改效果：
+ *   - 减小（如10）：曲线更精细，但同样容量下能覆盖的时间更短
+ *   - 增大（如1000）：适合长时间的大文件传输
+ */
+#define METRICS_SAMPLE_INTERVAL_MS 100
+
+/**
+ * 样本环形缓冲区容量（样本个数）
+ * 含义：最多保存的样本数，写满后覆盖最早的样本（JSON中的overwritten字段记录被覆盖的数量）
+ * 修改方法：按 传输时长 / 采样间隔 估算，每个样本约64字节
+ * 修改效果：
+ *   - 增大：能完整保存更长的传输过程，占用更多内存
+ *   - 减小：只保留最近一段时间的样本
+ */
+#define METRICS_RING_CAPACITY 4096
+
+
+// ============================================================================
+// 十一、热路径日志参数（logger.h）
+// ============================================================================
+
+/**
+ * 编译期日志级别
+ * 含义：流水线收发路径上低于该级别的日志在编译时被去掉（宏展开为空，参数不求值）
+ * 取值：LOG_LEVEL_TRACE(0) / LOG_LEVEL_DEBUG(1) / LOG_LEVEL_INFO(2) / LOG_LEVEL_WARN(3) / LOG_LEVEL_ERROR(4) / LOG_LEVEL_OFF(5)
+ * 修改方法：直接修改数值
+ * 修改效果：
+ *   - 0（TRACE）：输出每个数据包/ACK的收发、窗口滑动、模拟延迟等逐包日志（调试用，大文件传输明显变慢）
+ *   - 1（DEBUG）：额外输出模拟丢包等调试信息
+ *   - 2（INFO，默认）：只输出重传、RENO阶段切换等关键事件
+ *   - 5（OFF）：流水线收发过程中不输出任何日志
+ */
+#define LOG_COMPILE_LEVEL 2
+
+/**
+ * 日志环形缓冲区容量（记录条数）
+ * 含义：主线程写入、日志线程格式化的无锁环形缓冲区大小，每条记录约120字节
+ * 修改方法：建议1024-65536
+ * 修改效果：
+ *   - 增大：日志突发时不容易丢弃，占用更多内存
+ *   - 减小：缓冲区满时多出来的日志会被丢弃（结束时会输出丢弃条数），但不会阻塞收发
+ */
+#define LOG_RING_CAPACITY 8192
+
+/**
+ * 日志线程的格式化缓冲区大小（字节）
+ * 含义：日志线程把一批记录格式化到该缓冲区后一次写出并刷新
+ * 修改方法：一般无需修改
+ */
+#define LOG_FORMAT_BUFFER_SIZE 65536
+
+/**
+ * 单行日志最大长度（字节），超出部分被截断
+ */
+#define LOG_MAX_LINE_LENGTH 256
+
+
+// ============================================================================
+// 十二、快速建连参数（0-RTT数据与连接参数缓存）
+// ============================================================================
+
+/**
+ * 是否启用0-RTT数据
+ * 含义：客户端在握手前先选好文件，SYN包携带第一块数据，首个窗口的其余数据紧随SYN发出，
+ *       不必等三次握手完成；服务端在握手阶段把这些早期数据缓存在接收窗口中
+ * 修改方法：
+ *   - true：启用（客户端先输入文件名再建立连接）
+ *   - false：关闭，握手完成后才开始发送数据（旧行为）
+ * 修改效果：
+ *   - 启用时：短文件传输节省一个RTT，首个窗口能装下的小文件在握手完成时已经全部发出
+ *   - 服务端需使用同一版本（旧版本服务端在等待ACK时收到数据包会直接放弃握手）
+ */
+#define FAST_OPEN_ENABLED true
+
+/**
+ * 早期数据包的数据负载大小（字节）
+ * 含义：SYN携带的数据以及握手完成前发出的数据包都按该大小切分。握手前MSS尚未协商，
+ *       取保底包大小对应的负载，保证不超过任何一次探测协商出的MSS
+ * 修改方法：不要超过 PMTU_BASE_PACKET_SIZE - HEADER_SIZE
+ */
+#define FAST_OPEN_DATA_SIZE (PMTU_BASE_PACKET_SIZE - HEADER_SIZE)
+
+/**
+ * 握手完成前最多发出的数据包数（含SYN本身携带的一块）
+ * 含义：实际数量还受拥塞窗口限制：没有缓存时cwnd = INITIAL_CWND，只有SYN携带数据；
+ *       有缓存时按缓存的cwnd发出首个窗口
+ * 修改方法：建议不超过 FIXED_WINDOW_SIZE
+ * 修改效果：
+ *   - 增大：握手期间发出更多数据，但SYN丢失时这些包都要等超时重传
+ *   - 减小：早期数据更少，更保守
+ */
+#define FAST_OPEN_MAX_PACKETS 16
+
+/**
+ * 是否启用连接参数缓存
+ * 含义：每次传输成功后按服务端地址保存最后的cwnd、ssthresh、平滑RTT和MSS，
+ *       下次连接同一服务端时直接从这些值开始（热启动），而不是从 INITIAL_CWND 慢启动，
+ *       同时跳过比缓存MSS更大的路径MTU探测候选，并按缓存的RTT缩短SYN重传超时
+ * 修改方法：true（启用）/ false（每次都冷启动）
+ */
+#define CONN_CACHE_ENABLED true
+
+/**
+ * 连接参数缓存文件（客户端工作目录下的文本文件，每个服务端地址一行）
+ */
+#define CONN_CACHE_FILE "conn_cache.txt"
+
+/**
+ * 缓存有效期（秒）
+ * 含义：超过该时间的缓存条目视为过期，按冷启动处理（网络状况可能已经变化）
+ * 修改方法：建议几分钟到一小时
+ */
+#define CONN_CACHE_TTL_SEC 600
+
+/**
+ * 有缓存时SYN重传超时的下限（毫秒）
+ * 含义：有缓存的RTT时SYN超时取 max(本值, 4 × RTT)，且不超过 TIMEOUT_MS；没有缓存时使用 TIMEOUT_MS
+ * 修改方法：建议100-500ms
+ */
+#define FAST_OPEN_MIN_SYN_TIMEOUT_MS 200
+
+
 // ============================================================================
 // 参数调优建议总结
 // ============================================================================
@@ -0,0 +1,308 @@
+/**
+ * logger.h - 热路径日志（编译期分级、无内存分配、后台线程格式化）
+ *
+ * 流水线收发循环中每个包都会输出若干行日志，原来直接用 std::cout << ... << std::endl，
+ * 每行都会刷新一次控制台和 client.txt/server.txt，大文件传输时控制台I/O成为主要开销。
+ * 这里的做法：
+ *   - 编译期分级：低于 LOG_COMPILE_LEVEL 的日志宏展开为空语句，参数不会被求值，没有任何开销
+ *   - 二进制记录：热路径只把格式串指针和参数（整数/浮点/静态字符串）拷贝进一条定长记录
+ *   - 无锁环形缓冲区：单生产者（主线程）单消费者（日志线程），缓冲区满时丢弃并计数，不阻塞收发
+ *   - 后台格式化：日志线程批量取出记录、格式化后一次写入输出流并刷新
+ *
+ * 使用约定：
+ *   - 格式串必须是字符串字面量（只保存指针），%s 参数也必须是静态字符串
+ *   - 支持的转换：%d %i %u %x %X %c %s %f %e %g %%（宽度/精度/标志保留，长度修饰符忽略）
+ *   - 日志线程写入的是 std::cout / 模拟日志文件，主线程在 logStart() 之后、logFlush() 之前
+ *     不要再直接使用这些流，两者交替使用时先调用 logFlush()
+ */
+
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <stdint.h>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <atomic>
+#include <ostream>
+#include <windows.h>
+#include "config.h"
+
+// ===== 日志级别 =====
+#define LOG_LEVEL_TRACE 0   // 逐包跟踪：每个数据包/ACK的收发、窗口滑动
+#define LOG_LEVEL_DEBUG 1   // 调试信息：模拟丢包等
+#define LOG_LEVEL_INFO  2   // 关键事件：重传、RENO阶段切换
+#define LOG_LEVEL_WARN  3   // 警告
+#define LOG_LEVEL_ERROR 4   // 错误
+#define LOG_LEVEL_OFF   5   // 关闭所有日志
+
+// ===== 日志输出目标 =====
+#define LOG_SINK_CONSOLE    0   // 控制台（main中已重定向为同时输出到终端和client.txt/server.txt）
+#define LOG_SINK_SIMULATION 1   // 服务端模拟日志 simulation.txt
+#define LOG_SINK_COUNT      2
+
+#define LOG_MAX_ARGS 6          // 每条记录最多携带的参数个数
+
+// 单个日志参数：记录参数类型，格式化时按转换符转换
+struct LogArg {
+    char type;                  // 'i' 有符号整数，'u' 无符号整数，'d' 浮点数，'s' 静态字符串
+    union {
+        long long i;
+        unsigned long long u;
+        double d;
+        const char* s;
+    };
+};
+
+inline LogArg logArg(int v)                { LogArg a; a.type = 'i'; a.i = v; return a; }
+inline LogArg logArg(long v)               { LogArg a; a.type = 'i'; a.i = v; return a; }
+inline LogArg logArg(long long v)          { LogArg a; a.type = 'i'; a.i = v; return a; }
+inline LogArg logArg(unsigned int v)       { LogArg a; a.type = 'u'; a.u = v; return a; }
+inline LogArg logArg(unsigned long v)      { LogArg a; a.type = 'u'; a.u = v; return a; }
+inline LogArg logArg(unsigned long long v) { LogArg a; a.type = 'u'; a.u = v; return a; }
+inline LogArg logArg(double v)             { LogArg a; a.type = 'd'; a.d = v; return a; }
+inline LogArg logArg(const char* v)        { LogArg a; a.type = 's'; a.s = v; return a; }
+
+// 一条二进制日志记录（定长，热路径只做拷贝）
+struct LogRecord {
+    const char* fmt;            // 格式串（字符串字面量）
+    uint8_t sink;               // 输出目标
+    uint8_t argc;               // 参数个数
+    LogArg args[LOG_MAX_ARGS];  // 参数
+};
+
+// ===== 日志器：单生产者单消费者无锁环形缓冲区 + 后台格式化线程 =====
+struct FastLogger {
+    LogRecord ring[LOG_RING_CAPACITY];
+    std::atomic<uint32_t> head;         // 生产者写入位置（只由主线程修改）
+    std::atomic<uint32_t> tail;         // 消费者读取位置（只由日志线程修改）
+    std::atomic<uint32_t> dropped;      // 缓冲区满时丢弃的记录数
+    std::atomic<bool> running;          // 日志线程是否继续运行
+    std::ostream* sinks[LOG_SINK_COUNT];
+    HANDLE thread;
+    char text[LOG_FORMAT_BUFFER_SIZE];  // 日志线程的格式化缓冲区（攒够一批再写出）
+
+    FastLogger() : head(0), tail(0), dropped(0), running(false), thread(NULL) {
+        for (int i = 0; i < LOG_SINK_COUNT; i++) sinks[i] = NULL;
+    }
+
+    // 生产者：写入一条记录，缓冲区满则丢弃
+    void push(const LogRecord& rec) {
+        uint32_t h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) >= LOG_RING_CAPACITY) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        ring[h % LOG_RING_CAPACITY] = rec;
+        head.store(h + 1, std::memory_order_release);
+    }
+
+    bool empty() const {
+        return tail.load(std::memory_order_acquire) == head.load(std::memory_order_acquire);
+    }
+
+    // 消费者：取出当前所有记录，按输出目标分别格式化、批量写出，返回处理的记录数
+    int drain() {
+        uint32_t t = tail.load(std::memory_order_relaxed);
+        uint32_t h = head.load(std::memory_order_acquire);
+        int processed = 0;
+        for (int sink = 0; sink < LOG_SINK_COUNT; sink++) {
+            size_t len = 0;
+            for (uint32_t i = t; i != h; i++) {
+                const LogRecord& rec = ring[i % LOG_RING_CAPACITY];
+                if (rec.sink != sink) continue;
+                if (len + LOG_MAX_LINE_LENGTH >= sizeof(text)) {
+                    flushText(sink, len);
+                    len = 0;
+                }
+                len += format(rec, text + len, LOG_MAX_LINE_LENGTH);
+                text[len++] = '\n';
+            }
+            flushText(sink, len);
+        }
+        processed = (int)(h - t);
+        tail.store(h, std::memory_order_release);
+        return processed;
+    }
+
+    void flushText(int sink, size_t len) {
+        if (len == 0 || sinks[sink] == NULL) return;
+        sinks[sink]->write(text, (std::streamsize)len);
+        sinks[sink]->flush();
+    }
+
+    // 按格式串格式化一条记录，返回写入的字符数（不含结尾的'\0'）
+    static size_t format(const LogRecord& rec, char* out, size_t cap) {
+        size_t len = 0;
+        int argi = 0;
+        for (const char* p = rec.fmt; *p != '\0' && len + 1 < cap; p++) {
+            if (*p != '%') {
+                out[len++] = *p;
+                continue;
+            }
+            if (p[1] == '%') {
+                out[len++] = '%';
+                p++;
+                continue;
+            }
+            // 解析 %[flags][width][.precision][length]conv，重新拼出只含标志/宽度/精度的转换说明
+            char spec[32];
+            size_t sl = 0;
+            spec[sl++] = '%';
+            p++;
+            while (*p != '\0' && strchr("-+ #0123456789.", *p) != NULL && sl < sizeof(spec) - 4) {
+                spec[sl++] = *p++;
+            }
+            while (*p == 'h' || *p == 'l' || *p == 'z' || *p == 'L') p++;  // 长度修饰符按参数实际类型决定
+            char conv = *p;
+            if (conv == '\0') break;
+            LogArg arg;
+            arg.type = 'i';
+            arg.i = 0;
+            if (argi < rec.argc) arg = rec.args[argi++];
+            int n = 0;
+            switch (conv) {
+                case 'd': case 'i': case 'u': case 'x': case 'X': {
+                    long long iv = (arg.type == 'd') ? (long long)arg.d : arg.i;
+                    spec[sl++] = 'l'; spec[sl++] = 'l'; spec[sl++] = conv; spec[sl] = '\0';
+                    n = (conv == 'd' || conv == 'i') ? snprintf(out + len, cap - len, spec, iv)
+                                                     : snprintf(out + len, cap - len, spec, (unsigned long long)iv);
+                    break;
+                }
+                case 'f': case 'e': case 'g': {
+                    double dv = (arg.type == 'd') ? arg.d : (arg.type == 'u') ? (double)arg.u : (double)arg.i;
+                    spec[sl++] = conv; spec[sl] = '\0';
+                    n = snprintf(out + len, cap - len, spec, dv);
+                    break;
+                }
+                case 'c':
+                    spec[sl++] = 'c'; spec[sl] = '\0';
+                    n = snprintf(out + len, cap - len, spec, (int)arg.i);
+                    break;
+                case 's':
+                    spec[sl++] = 's'; spec[sl] = '\0';
+                    n = snprintf(out + len, cap - len, spec, (arg.type == 's' && arg.s) ? arg.s : "(null)");
+                    break;
+                default:
+                    n = 0;
+                    break;
+            }
+            if (n > 0) len += ((size_t)n < cap - len) ? (size_t)n : (cap - len - 1);
+        }
+        out[len] = '\0';
+        return len;
+    }
+};
+
+// 全局日志器实例（函数内静态变量，保证一个程序只有一份）
+inline FastLogger& getLogger() {
+    static FastLogger logger;
+    return logger;
+}
+
+// 日志线程：有记录就批量处理，没有记录时短暂休眠；停止后处理完剩余记录再退出
+inline DWORD WINAPI logThreadMain(void* param) {
+    FastLogger* logger = (FastLogger*)param;
+    while (logger->running.load(std::memory_order_acquire)) {
+        if (logger->drain() == 0) Sleep(1);
+    }
+    logger->drain();
+    return 0;
+}
+
+// 设置输出目标（在logStart之前调用，未设置的目标其日志会被丢弃）
+inline void logSetSink(int sink, std::ostream* os) {
+    if (sink >= 0 && sink < LOG_SINK_COUNT) getLogger().sinks[sink] = os;
+}
+
+// 启动日志线程；线程创建失败时退化为在logFlush中同步格式化
+inline void logStart() {
+    FastLogger& logger = getLogger();
+    if (logger.running.load()) return;
+    logger.running.store(true, std::memory_order_release);
+    logger.thread = CreateThread(NULL, 0, logThreadMain, &logger, 0, NULL);
+    if (logger.thread == NULL) logger.running.store(false);
+}
+
+// 等待缓冲区中的记录全部写出（主线程需要直接使用std::cout前调用）
+inline void logFlush() {
+    FastLogger& logger = getLogger();
+    if (logger.thread == NULL) {
+        logger.drain();
+        return;
+    }
+    while (!logger.empty()) Sleep(1);
+}
+
+// 停止日志线程，写出剩余记录，并报告丢弃的记录数
+inline void logStop() {
+    FastLogger& logger = getLogger();
+    if (logger.thread != NULL) {
+        logger.running.store(false, std::memory_order_release);
+        WaitForSingleObject(logger.thread, INFINITE);
+        CloseHandle(logger.thread);
+        logger.thread = NULL;
+    }
+    logger.drain();
+    uint32_t dropped = logger.dropped.load();
+    if (dropped > 0 && logger.sinks[LOG_SINK_CONSOLE] != NULL) {
+        *logger.sinks[LOG_SINK_CONSOLE] << "[Logger] " << dropped << " log records dropped (ring buffer full)" << std::endl;
+    }
+}
+
+// 热路径写日志：只把格式串指针和参数拷贝进记录
+inline void logFillArgs(LogRecord&) {}
+
+template <typename T, typename... Rest>
+inline void logFillArgs(LogRecord& rec, T value, Rest... rest) {
+    if (rec.argc < LOG_MAX_ARGS) rec.args[rec.argc++] = logArg(value);
+    logFillArgs(rec, rest...);
+}
+
+template <typename... Args>
+inline void logWrite(uint8_t sink, const char* fmt, Args... args) {
+    LogRecord rec;
+    rec.fmt = fmt;
+    rec.sink = sink;
+    rec.argc = 0;
+    logFillArgs(rec, args...);
+    getLogger().push(rec);
+}
+
+// ===== 日志宏：低于编译期级别的宏展开为空，参数不求值 =====
+// 级别只在编译期起作用，不写入记录；消息自带的[标签]已经标明了事件类型
+#if LOG_COMPILE_LEVEL <= LOG_LEVEL_TRACE
+#define LOG_TRACE(...) logWrite(LOG_SINK_CONSOLE, __VA_ARGS__)
+#define SIM_TRACE(...) logWrite(LOG_SINK_SIMULATION, __VA_ARGS__)
+#else
+#define LOG_TRACE(...) ((void)0)
+#define SIM_TRACE(...) ((void)0)
+#endif
+
+#if LOG_COMPILE_LEVEL <= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(...) logWrite(LOG_SINK_CONSOLE, __VA_ARGS__)
+#define SIM_DEBUG(...) logWrite(LOG_SINK_SIMULATION, __VA_ARGS__)
+#else
+#define LOG_DEBUG(...) ((void)0)
+#define SIM_DEBUG(...) ((void)0)
+#endif
+
+#if LOG_COMPILE_LEVEL <= LOG_LEVEL_INFO
+#define LOG_INFO(...) logWrite(LOG_SINK_CONSOLE, __VA_ARGS__)
+#else
+#define LOG_INFO(...) ((void)0)
+#endif
+
+#if LOG_COMPILE_LEVEL <= LOG_LEVEL_WARN
+#define LOG_WARN(...) logWrite(LOG_SINK_CONSOLE, __VA_ARGS__)
+#else
+#define LOG_WARN(...) ((void)0)
+#endif
+
+#if LOG_COMPILE_LEVEL <= LOG_LEVEL_ERROR
+#define LOG_ERROR(...) logWrite(LOG_SINK_CONSOLE, __VA_ARGS__)
+#else
+#define LOG_ERROR(...) ((void)0)
+#endif
+
+#endif // LOGGER_H
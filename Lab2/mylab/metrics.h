@@ -0,0 +1,187 @@
+/**
+ * metrics.h - 传输指标采样记录器
+ * 按固定时间间隔对发送窗口/接收窗口的状态做快照，保存在环形缓冲区中，
+ * 传输结束后导出为CSV和JSON，用于绘制cwnd、RTT、吞吐率、丢包等随时间的变化曲线
+ *
+ * 发送端和接收端使用同一套字段（MetricsSample），不适用于本端的字段填0，
+ * 这样两端的输出可以直接用同一个脚本绘图、对比不同参数下的拥塞控制行为
+ */
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+#include <cstdio>
+#include <iostream>
+#include <ctime>
+#include "config.h"
+#include "protocol.h"
+
+// ===== 指标样本（发送端与接收端共用的字段定义）=====
+struct MetricsSample {
+    uint32_t time_ms;           // 采样时刻（距开始记录的毫秒数）
+    uint32_t cwnd;              // 拥塞窗口（包数），接收端为0
+    uint32_t ssthresh;          // 慢启动阈值（包数），接收端为0
+    uint32_t phase;             // RENO阶段（RenoPhase的数值），接收端为0
+    uint32_t base;              // 窗口左边界序列号
+    uint32_t next_seq;          // 发送端：下一个要发送的序列号；接收端：窗口右边界（base + 窗口大小）
+    uint32_t in_flight;         // 发送端：已发送未确认的包数；接收端：窗口内已缓存的乱序包数
+    double   rtt_ms;            // 平滑RTT（毫秒），接收端为0
+    uint32_t bytes;             // 累计有效数据字节数（发送端为已发送，接收端为已接收）
+    double   goodput_kbps;      // 与上一个样本之间的有效吞吐率（KB/s）
+    uint32_t packets;           // 累计收发包数（发送端含重传，接收端含重复）
+    uint32_t retransmissions;   // 累计重传包数，接收端为0
+    uint32_t duplicates;        // 发送端：累计重复ACK数；接收端：累计重复包数
+    uint32_t drops;             // 累计模拟丢包数，发送端为0
+};
+
+// CSV表头与JSON字段名，顺序与MetricsSample成员一致
+static const char* const METRICS_FIELDS[] = {
+    "time_ms", "cwnd", "ssthresh", "phase", "base", "next_seq", "in_flight",
+    "rtt_ms", "bytes", "goodput_kbps", "packets", "retransmissions", "duplicates", "drops"
+};
+
+// ===== 指标记录器：定时采样 + 环形缓冲区 =====
+// 缓冲区写满后覆盖最早的样本，始终保留最近 METRICS_RING_CAPACITY 个样本
+struct MetricsRecorder {
+    MetricsSample samples[METRICS_RING_CAPACITY];
+    uint32_t head;              // 下一个写入位置
+    uint32_t count;             // 有效样本数（不超过容量）
+    uint32_t overwritten;       // 被覆盖的旧样本数
+    const char* role;           // "sender" 或 "receiver"
+    clock_t start_time;         // 开始记录的时间
+    clock_t last_sample_time;   // 上一次采样的时间
+    bool started;
+
+    MetricsRecorder() : head(0), count(0), overwritten(0), role(""), start_time(0),
+                        last_sample_time(0), started(false) {}
+
+    // 开始记录（每次传输开始时调用），清空之前的样本
+    void start(const char* r) {
+        head = 0;
+        count = 0;
+        overwritten = 0;
+        role = r;
+        start_time = clock();
+        last_sample_time = start_time;
+        started = true;
+    }
+
+    // 距上一次采样是否已超过采样间隔
+    bool due(clock_t now) const {
+        if (!METRICS_ENABLED || !started) return false;
+        return (double)(now - last_sample_time) * 1000.0 / CLOCKS_PER_SEC >= METRICS_SAMPLE_INTERVAL_MS;
+    }
+
+    // 写入一个样本：补齐时间戳，并根据与上一个样本的字节差计算吞吐率
+    void record(MetricsSample s, clock_t now) {
+        if (!METRICS_ENABLED || !started) return;
+        s.time_ms = (uint32_t)((double)(now - start_time) * 1000.0 / CLOCKS_PER_SEC);
+        s.goodput_kbps = 0;
+        if (count > 0) {
+            const MetricsSample& prev = samples[(head + METRICS_RING_CAPACITY - 1) % METRICS_RING_CAPACITY];
+            if (s.time_ms > prev.time_ms && s.bytes >= prev.bytes) {
+                s.goodput_kbps = (double)(s.bytes - prev.bytes) / 1024.0 * 1000.0 / (s.time_ms - prev.time_ms);
+            }
+        }
+        samples[head] = s;
+        head = (head + 1) % METRICS_RING_CAPACITY;
+        if (count < METRICS_RING_CAPACITY) count++;
+        else overwritten++;
+        last_sample_time = now;
+    }
+
+    // 按时间顺序取第i个样本（0为最早）
+    const MetricsSample& at(uint32_t i) const {
+        return samples[(head + METRICS_RING_CAPACITY - count + i) % METRICS_RING_CAPACITY];
+    }
+
+    // 导出CSV：第一行为字段名，之后每行一个样本
+    bool dumpCSV(const char* path) const {
+        FILE* fp = fopen(path, "w");
+        if (fp == NULL) return false;
+        for (size_t f = 0; f < sizeof(METRICS_FIELDS) / sizeof(METRICS_FIELDS[0]); f++) {
+            fprintf(fp, "%s%s", f ? "," : "", METRICS_FIELDS[f]);
+        }
+        fprintf(fp, "\n");
+        for (uint32_t i = 0; i < count; i++) {
+            const MetricsSample& s = at(i);
+            fprintf(fp, "%u,%u,%u,%u,%u,%u,%u,%.3f,%u,%.3f,%u,%u,%u,%u\n",
+                    s.time_ms, s.cwnd, s.ssthresh, s.phase, s.base, s.next_seq, s.in_flight,
+                    s.rtt_ms, s.bytes, s.goodput_kbps, s.packets, s.retransmissions, s.duplicates, s.drops);
+        }
+        fclose(fp);
+        return true;
+    }
+
+    // 导出JSON：{"role":..., "interval_ms":..., "fields":[...], "samples":[[...], ...]}
+    // 样本按fields的顺序存为数组，和CSV的列一一对应
+    bool dumpJSON(const char* path) const {
+        FILE* fp = fopen(path, "w");
+        if (fp == NULL) return false;
+        fprintf(fp, "{\n  \"role\": \"%s\",\n  \"interval_ms\": %d,\n  \"overwritten\": %u,\n  \"fields\": [",
+                role, METRICS_SAMPLE_INTERVAL_MS, overwritten);
+        for (size_t f = 0; f < sizeof(METRICS_FIELDS) / sizeof(METRICS_FIELDS[0]); f++) {
+            fprintf(fp, "%s\"%s\"", f ? ", " : "", METRICS_FIELDS[f]);
+        }
+        fprintf(fp, "],\n  \"samples\": [\n");
+        for (uint32_t i = 0; i < count; i++) {
+            const MetricsSample& s = at(i);
+            fprintf(fp, "    [%u, %u, %u, %u, %u, %u, %u, %.3f, %u, %.3f, %u, %u, %u, %u]%s\n",
+                    s.time_ms, s.cwnd, s.ssthresh, s.phase, s.base, s.next_seq, s.in_flight,
+                    s.rtt_ms, s.bytes, s.goodput_kbps, s.packets, s.retransmissions, s.duplicates, s.drops,
+                    (i + 1 < count) ? "," : "");
+        }
+        fprintf(fp, "  ]\n}\n");
+        fclose(fp);
+        return true;
+    }
+
+    // 同时导出CSV和JSON（文件名为 prefix.csv / prefix.json）
+    void dump(const char* prefix) const {
+        if (!METRICS_ENABLED || !started) return;
+        char path[256];
+        snprintf(path, sizeof(path), "%s.csv", prefix);
+        bool csvOk = dumpCSV(path);
+        snprintf(path, sizeof(path), "%s.json", prefix);
+        bool jsonOk = dumpJSON(path);
+        std::cout << "[Metrics] " << count << " samples written to " << prefix << ".csv/.json"
+                  << ((csvOk && jsonOk) ? "" : " (write failed)") << std::endl;
+    }
+};
+
+// 发送端快照：从SendWindow提取一个样本
+inline MetricsSample metricsFromSendWindow(const SendWindow& w) {
+    MetricsSample s;
+    memset(&s, 0, sizeof(s));
+    s.cwnd = w.cwnd;
+    s.ssthresh = w.ssthresh;
+    s.phase = (uint32_t)w.reno_phase;
+    s.base = w.base;
+    s.next_seq = w.next_seq;
+    s.in_flight = w.next_seq - w.base;
+    s.rtt_ms = w.srtt_ms;
+    s.bytes = (uint32_t)w.total_bytes_sent;
+    s.packets = w.total_packets_sent;
+    s.retransmissions = w.total_retransmissions;
+    s.duplicates = w.total_dup_acks;
+    return s;
+}
+
+// 接收端快照：从RecvWindow提取一个样本
+inline MetricsSample metricsFromRecvWindow(const RecvWindow& w) {
+    MetricsSample s;
+    memset(&s, 0, sizeof(s));
+    s.base = w.base;
+    s.next_seq = w.base + FIXED_WINDOW_SIZE;
+    for (int i = 0; i < FIXED_WINDOW_SIZE; i++) {
+        if (w.is_received[i]) s.in_flight++;
+    }
+    s.bytes = (uint32_t)w.total_bytes_received;
+    s.packets = w.total_packets_received;
+    s.duplicates = w.total_duplicate_packets;
+    s.drops = w.total_packets_dropped;
+    return s;
+}
+
+#endif // METRICS_H
@@ -5,6 +5,7 @@
 #include <ctime>
 #include <cstring>
 #include "config.h"  // 引入配置文件，所有可配置参数集中在config.h中管理
+#include "logger.h"  // 热路径日志（RENO状态变化在收发循环中调用，统一走日志线程输出）
 
 // ===== 连接状态枚举 =====
 // 描述：用于跟踪连接的当前状态
@@ -48,6 +49,8 @@ struct SendWindow {
     char data_buf[FIXED_WINDOW_SIZE][MSS];      // 窗口内包的数据缓存（用于重传机制）
     int data_len[FIXED_WINDOW_SIZE];            // 窗口内包的实际数据长度
     clock_t send_time[FIXED_WINDOW_SIZE];       // 计时器：每个包的发送时间（用于计算RTO和超时判断）
+    uint8_t is_retx[FIXED_WINDOW_SIZE];         // 标记窗口内包是否被重传过（重传过的包不用于RTT采样，Karn算法）
+    uint16_t mss;                               // 本连接的MSS（握手时通过路径MTU探测协商，reset时保持不变）
     
     // ===== RENO 拥塞控制相关字段 =====
     // 描述：实现 TCP RENO 拥塞控制算法的核心参数
@@ -60,19 +63,26 @@ struct SendWindow {
     // ===== 统计信息字段 =====
     uint32_t total_packets_sent;                // 发送的总包数（含重传）
     uint32_t total_retransmissions;             // 重传的总包数
+    uint32_t total_dup_acks;                    // 收到的重复ACK总数
+    double srtt_ms;                             // 平滑RTT（毫秒，srtt = 7/8*srtt + 1/8*sample），0表示尚无样本
     clock_t transmission_start_time;            // 传输开始时间
     int total_bytes_sent;                       // 发送的总字节数（不含协议头）
+    double cpu_time_ms;                         // 传输阶段消耗的CPU时间（毫秒，用于统计CPU/GB）
+    bool offload_active;                        // 传输阶段是否实际启用了UDP分段卸载（USO）
     
     // 默认构造函数
-    SendWindow() : base(0), next_seq(0), cwnd(INITIAL_CWND), ssthresh(INITIAL_SSTHRESH),
+    SendWindow() : base(0), next_seq(0), mss(MAX_DATA_SIZE), cwnd(INITIAL_CWND), ssthresh(INITIAL_SSTHRESH),
                    dup_ack_count(0), last_ack(0), reno_phase(SLOW_START),
-                   total_packets_sent(0), total_retransmissions(0), transmission_start_time(0), total_bytes_sent(0) {
+                   total_packets_sent(0), total_retransmissions(0), total_dup_acks(0), srtt_ms(0),
+                   transmission_start_time(0), total_bytes_sent(0),
+                   cpu_time_ms(0), offload_active(false) {
         // 初始化所有数组为0
         memset(is_sent, 0, sizeof(is_sent));
         memset(is_ack, 0, sizeof(is_ack));
         memset(data_buf, 0, sizeof(data_buf));
         memset(data_len, 0, sizeof(data_len));
         memset(send_time, 0, sizeof(send_time));
+        memset(is_retx, 0, sizeof(is_retx));
     }
     
     // 重置窗口到初始状态
@@ -84,6 +94,7 @@ struct SendWindow {
         memset(data_buf, 0, sizeof(data_buf));
         memset(data_len, 0, sizeof(data_len));
         memset(send_time, 0, sizeof(send_time));
+        memset(is_retx, 0, sizeof(is_retx));
         
         // 重置 RENO 拥塞控制参数到初始状态
         // 4、慢启动：初始cwnd设为1（或配置的初始值）
@@ -96,8 +107,12 @@ struct SendWindow {
         // 重置统计信息
         total_packets_sent = 0;
         total_retransmissions = 0;
+        total_dup_acks = 0;
+        srtt_ms = 0;
         transmission_start_time = clock();
         total_bytes_sent = 0;
+        cpu_time_ms = 0;
+        offload_active = false;
     }
     
     // 获取有效发送窗口大小（cwnd与固定窗口的最小值）
@@ -127,11 +142,22 @@ struct SendWindow {
             int idx = getIndex(base);
             is_sent[idx] = 0;
             is_ack[idx] = 0;
+            is_retx[idx] = 0;
             data_len[idx] = 0;
             base++;  // 窗口左边界向前滑动
         }
     }
     
+    // RTT采样：收到新的累积ACK时，用被确认的最后一个包（ack_num-1）的发送时间计算一个样本
+    // 该包重传过则跳过（无法区分确认的是哪一次发送，Karn算法）；需在slideWindow之前调用
+    void sampleRTT(uint32_t ack_num) {
+        if (ack_num == 0 || ack_num <= base || ack_num > next_seq) return;
+        int idx = getIndex(ack_num - 1);
+        if (!is_sent[idx] || is_retx[idx]) return;
+        double sample = (double)(clock() - send_time[idx]) * 1000.0 / CLOCKS_PER_SEC;
+        srtt_ms = (srtt_ms == 0) ? sample : (srtt_ms * 7.0 / 8.0 + sample / 8.0);
+    }
+    
     // RENO 拥塞控制：处理新 ACK，返回 true 表示是新 ACK。核心状态机更新
     bool handleNewACK(uint32_t ack_num) {
         // 检查是否是新 ACK（确认了新的数据）
@@ -148,11 +174,10 @@ struct SendWindow {
                 // 检查是否达到慢启动阈值，切换到拥塞避免阶段
                 if (cwnd >= ssthresh) {
                     reno_phase = CONGESTION_AVOIDANCE;
-                    std::cout << "[RENO] Phase transition: SLOW_START -> CONGESTION_AVOIDANCE (cwnd=" 
-                             << cwnd << ", ssthresh=" << ssthresh << ")" << std::endl;
+                    LOG_INFO("[RENO] Phase transition: SLOW_START -> CONGESTION_AVOIDANCE (cwnd=%u, ssthresh=%u)",
+                             cwnd, ssthresh);
                 } else {
-                    std::cout << "[RENO] Slow Start: cwnd=" << cwnd 
-                             << ", ssthresh=" << ssthresh << std::endl;
+                    LOG_TRACE("[RENO] Slow Start: cwnd=%u, ssthresh=%u", cwnd, ssthresh);
                 }
             } else if (reno_phase == CONGESTION_AVOIDANCE) {
                 // ===== 拥塞避免阶段：每收到 1 个新 ACK，cwnd += 1/cwnd（线性增长） =====
@@ -163,22 +188,22 @@ struct SendWindow {
                 if (ack_count >= cwnd) {
                     cwnd++;
                     ack_count = 0;
-                    std::cout << "[RENO] Congestion Avoidance: cwnd increased to " << cwnd << std::endl;
+                    LOG_TRACE("[RENO] Congestion Avoidance: cwnd increased to %u", cwnd);
                 }
             } else if (reno_phase == FAST_RECOVERY) {
                 // ===== 快速恢复阶段：收到新 ACK，退出快速恢复，进入拥塞避免 =====
                 cwnd = ssthresh;
                 reno_phase = CONGESTION_AVOIDANCE;// 进入拥塞避免阶段
-                std::cout << "[RENO] Fast Recovery completed, transition to CONGESTION_AVOIDANCE (cwnd=" 
-                         << cwnd << ", ssthresh=" << ssthresh << ")" << std::endl;
+                LOG_INFO("[RENO] Fast Recovery completed, transition to CONGESTION_AVOIDANCE (cwnd=%u, ssthresh=%u)",
+                         cwnd, ssthresh);
             }
             
             return true;  // 是新 ACK
         } else if (ack_num == last_ack) {
             // ===== 收到重复 ACK =====
             dup_ack_count++;
-            std::cout << "[RENO] Duplicate ACK received (count=" << dup_ack_count 
-                     << ", ack=" << ack_num << ")" << std::endl;
+            total_dup_acks++;
+            LOG_TRACE("[RENO] Duplicate ACK received (count=%u, ack=%u)", dup_ack_count, ack_num);
             
             // 检查是否达到快速重传阈值（3 个重复 ACK）
             if (dup_ack_count == DUP_ACK_THRESHOLD) {
@@ -187,7 +212,7 @@ struct SendWindow {
             } else if (reno_phase == FAST_RECOVERY) {
                 // ===== 快速恢复阶段：每收到 1 个重复 ACK，cwnd += 1 =====
                 cwnd++;
-                std::cout << "[RENO] Fast Recovery: cwnd inflated to " << cwnd << std::endl;
+                LOG_TRACE("[RENO] Fast Recovery: cwnd inflated to %u", cwnd);
             }else{
                 cwnd++; //接收到三个重复ack之前，cwnd也增加
             }
@@ -200,7 +225,7 @@ struct SendWindow {
     
     // RENO 拥塞控制：处理快速重传（3个重复ACK触发）
     void handleFastRetransmit() {
-        std::cout << "[RENO] Fast Retransmit triggered (3 duplicate ACKs)" << std::endl;
+        LOG_INFO("[RENO] Fast Retransmit triggered (%d duplicate ACKs)", DUP_ACK_THRESHOLD);
         
         // 1. 更新慢启动阈值：ssthresh = max(ssthresh/2, 2)
         ssthresh = (ssthresh / 2 > MIN_SSTHRESH) ? (ssthresh / 2) : MIN_SSTHRESH;
@@ -211,15 +236,14 @@ struct SendWindow {
         // 3. 进入快速恢复阶段
         reno_phase = FAST_RECOVERY;
         
-        std::cout << "[RENO] Entering FAST_RECOVERY (cwnd=" << cwnd 
-                 << ", ssthresh=" << ssthresh << ")" << std::endl;
+        LOG_INFO("[RENO] Entering FAST_RECOVERY (cwnd=%u, ssthresh=%u)", cwnd, ssthresh);
         
         // 在主发送循环中检测并重传丢失的包
     }
     
     // RENO 拥塞控制：处理超时，重置拥塞窗口并进入慢启动
     void handleTimeout() {
-        std::cout << "[RENO] Timeout detected" << std::endl;
+        LOG_INFO("[RENO] Timeout detected");
         
         // 1. 更新慢启动阈值：ssthresh = max(cwnd/2, 2)
         ssthresh = (cwnd / 2 > MIN_SSTHRESH) ? (cwnd / 2) : MIN_SSTHRESH;
@@ -233,8 +257,7 @@ struct SendWindow {
         // 4. 进入慢启动阶段
         reno_phase = SLOW_START;
         
-        std::cout << "[RENO] Timeout recovery: entering SLOW_START (cwnd=" << cwnd 
-                 << ", ssthresh=" << ssthresh << ")" << std::endl;
+        LOG_INFO("[RENO] Timeout recovery: entering SLOW_START (cwnd=%u, ssthresh=%u)", cwnd, ssthresh);
     }
 };
 
@@ -255,10 +278,12 @@ struct RecvWindow {
     uint32_t total_duplicate_packets;           // 接收到的重复包/旧包数量
     clock_t transmission_start_time;            // 传输开始时间
     int total_bytes_received;                   // 接收的总字节数（不含协议头）
+    double cpu_time_ms;                         // 接收阶段消耗的CPU时间（毫秒，用于统计CPU/GB）
+    bool offload_active;                        // 接收阶段是否实际启用了UDP接收合并（URO）
     
     // 默认构造函数
     RecvWindow() : base(0), total_packets_received(0), total_packets_dropped(0), total_duplicate_packets(0),
-                   transmission_start_time(0), total_bytes_received(0) {
+                   transmission_start_time(0), total_bytes_received(0), cpu_time_ms(0), offload_active(false) {
         memset(data_buf, 0, sizeof(data_buf));
         memset(data_len, 0, sizeof(data_len));
         memset(is_received, 0, sizeof(is_received));
@@ -277,6 +302,8 @@ struct RecvWindow {
         total_packets_dropped = 0;
         transmission_start_time = clock();
         total_bytes_received = 0;
+        cpu_time_ms = 0;
+        offload_active = false;
     }
     
     // 检查序列号是否在窗口范围内
@@ -449,16 +476,17 @@ struct UDPHeader {
     uint16_t win;         // 窗口大小：接收端通告的窗口大小，用于流量控制
     uint16_t checksum;    // 校验和：用于检测数据在传输过程中是否发生错误
     uint16_t len;         // 数据长度：UDP数据载荷的长度（不含头部）
-    uint8_t  reserved[5]; // 保留字段：用于字节对齐或未来扩展，初始化为0
+    uint16_t mss;         // MSS选项：仅在SYN/SYN+ACK中有效，SYN中为客户端探测的MSS，SYN+ACK中为服务端确认的MSS，0表示未携带
+    uint8_t  reserved[3]; // 保留字段：用于字节对齐或未来扩展，初始化为0
     
     UDPHeader() : seq(0), ack(0), flag(0), win(DEFAULT_WINDOW_SIZE), 
-                  checksum(0), len(0) {
+                  checksum(0), len(0), mss(0) {
         memset(reserved, 0, sizeof(reserved));  // 保留字段清零，确保数据纯净
     }
     
     UDPHeader(uint32_t s, uint32_t a, uint8_t f) 
         : seq(s), ack(a), flag(f), win(DEFAULT_WINDOW_SIZE), 
-          checksum(0), len(0) {
+          checksum(0), len(0), mss(0) {
         memset(reserved, 0, sizeof(reserved));  // 保留字段清零
     }
     
@@ -519,8 +547,66 @@ struct Packet {
 
 
 // 生成初始序列号
+// 按时间生成（类似TCP的ISN时钟），避免上一次连接残留的SYN/早期数据被当作本次连接的数据（0-RTT时尤其重要）；
+// 序列号按包计数且比较时不处理回绕，因此只取低28位，留出足够的空间不会在一次传输中溢出
 inline uint32_t generateInitialSeq() {
-    return 0;
+    uint32_t t = (uint32_t)time(NULL) * 250000u + (uint32_t)clock() * 250u;
+    return t & 0x0FFFFFFF;
+}
+
+// 路径MTU探测：设置套接字的DF（Don't Fragment）标志
+// 设置后超过路径MTU的包不会被IP分片，而是被丢弃（或在本机直接返回WSAEMSGSIZE）
+// 返回：true = 设置成功，false = 系统不支持该选项
+inline bool setDontFragment(SOCKET sockfd, bool enable) {
+#ifdef IP_DONTFRAGMENT
+    int value = enable ? 1 : 0;
+    return setsockopt(sockfd, IPPROTO_IP, IP_DONTFRAGMENT, (const char*)&value, sizeof(value)) == 0;
+#else
+    (void)sockfd; (void)enable;
+    return false;
+#endif
+}
+
+// ===== UDP分段卸载（USO/URO）=====
+// 旧版本SDK头文件（如MinGW 8.1）中没有这两个选项，按ws2ipdef.h中的取值补充定义
+#ifndef UDP_SEND_MSG_SIZE
+#define UDP_SEND_MSG_SIZE 2             // USO：发送时协议栈按该大小切分缓冲区
+#endif
+#ifndef UDP_RECV_MAX_COALESCED_SIZE
+#define UDP_RECV_MAX_COALESCED_SIZE 3   // URO：接收时允许合并的最大字节数
+#endif
+
+// 启用发送分段卸载：之后一次sendto的缓冲区会被切分为多个segmentSize大小的数据报（最后一个可以更短）
+// 返回：true = 系统支持并已启用，false = 不支持（调用方应回退到逐包发送）
+inline bool enableSendOffload(SOCKET sockfd, uint32_t segmentSize) {
+    DWORD value = segmentSize;
+    return setsockopt(sockfd, IPPROTO_UDP, UDP_SEND_MSG_SIZE, (const char*)&value, sizeof(value)) == 0;
+}
+
+// 启用接收合并卸载：一次recvfrom可能收到多个连续的、等长的数据报（最后一个可以更短）
+// 返回：true = 系统支持并已启用，false = 不支持（recvfrom仍然每次返回一个数据报）
+inline bool enableRecvOffload(SOCKET sockfd, uint32_t maxCoalescedSize) {
+    DWORD value = maxCoalescedSize;
+    return setsockopt(sockfd, IPPROTO_UDP, UDP_RECV_MAX_COALESCED_SIZE, (const char*)&value, sizeof(value)) == 0;
+}
+
+// 获取本进程已消耗的CPU时间（用户态+内核态，毫秒），用于统计每GB数据的CPU开销
+inline double getProcessCpuTimeMs() {
+    FILETIME createTime, exitTime, kernelTime, userTime;
+    if (!GetProcessTimes(GetCurrentProcess(), &createTime, &exitTime, &kernelTime, &userTime)) {
+        return 0;
+    }
+    ULARGE_INTEGER k, u;
+    k.LowPart = kernelTime.dwLowDateTime;
+    k.HighPart = kernelTime.dwHighDateTime;
+    u.LowPart = userTime.dwLowDateTime;
+    u.HighPart = userTime.dwHighDateTime;
+    return (double)(k.QuadPart + u.QuadPart) / 10000.0;  // FILETIME单位为100ns
+}
+
+// 计算每GB数据消耗的CPU时间（毫秒/GB）
+inline double cpuMsPerGB(double cpuMs, long long bytes) {
+    return (bytes > 0) ? cpuMs * (1024.0 * 1024.0 * 1024.0) / (double)bytes : 0;
 }
 
 // 获取当前时间戳（毫秒）
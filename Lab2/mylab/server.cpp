@@ -27,6 +27,12 @@ static bool g_firstPacketReceived = false;  // 是否已接收到第一个数据
 // 全局接收窗口：管理流水线接收的滑动窗口状态
 RecvWindow g_recvWindow;
 
+// 0-RTT：握手阶段是否已经把早期数据（SYN携带的数据、ACK之前到达的数据包）缓存在接收窗口中
+static bool g_earlyDataBuffered = false;
+
+// 全局指标记录器：定时采样接收窗口状态
+MetricsRecorder g_metrics;
+
 // 模拟日志文件流：记录丢包和延迟信息
 std::ofstream g_simulationLog;
 // 初始化模拟日志
@@ -58,13 +64,9 @@ bool shouldDropPacket(uint32_t recvSeq) {
     int randomValue = rand() % 100;
     if (randomValue < SIMULATE_LOSS_RATE) {
         // 记录丢包信息
-        std::cout << "[Simulation] DROPPED packet seq=" << recvSeq 
-                  << " (random=" << randomValue << ", threshold=" << SIMULATE_LOSS_RATE << ")" << std::endl;
-        if (g_simulationLog.is_open()) {
-            g_simulationLog << "[DROP] seq=" << recvSeq 
-                           << ", random=" << randomValue 
-                           << ", threshold=" << SIMULATE_LOSS_RATE << "%" << std::endl;
-        }
+        LOG_DEBUG("[Simulation] DROPPED packet seq=%u (random=%d, threshold=%d)",
+                  recvSeq, randomValue, SIMULATE_LOSS_RATE);
+        SIM_DEBUG("[DROP] seq=%u, random=%d, threshold=%d%%", recvSeq, randomValue, SIMULATE_LOSS_RATE);
         return true;
     }
     return false;
@@ -75,12 +77,8 @@ void simulateDelay(uint32_t recvSeq) {
         return;
     }
     
-    std::cout << "[Simulation] DELAY packet seq=" << recvSeq 
-              << " for " << SIMULATE_DELAY_MS << "ms" << std::endl << std::endl;
-    if (g_simulationLog.is_open()) {
-        g_simulationLog << "[DELAY] seq=" << recvSeq 
-                       << ", delay=" << SIMULATE_DELAY_MS << "ms" << std::endl;
-    }
+    LOG_TRACE("[Simulation] DELAY packet seq=%u for %dms", recvSeq, SIMULATE_DELAY_MS);
+    SIM_TRACE("[DELAY] seq=%u, delay=%dms", recvSeq, SIMULATE_DELAY_MS);
     Sleep(SIMULATE_DELAY_MS);
 }
 
@@ -109,17 +107,15 @@ void sendACK(SOCKET serverSocket, sockaddr_in& clientAddr, int addrLen,
         int sackLen = sackInfo.serialize(sackData);
         ackPacket.setData(sackData, sackLen);
         
-        std::cout << "[Send] ACK+SACK packet ack=" << ackNum << ", SACK blocks=[";
+        LOG_TRACE("[Send] ACK+SACK packet ack=%u, %d SACK blocks", ackNum, sackInfo.count);
         for (int i = 0; i < sackInfo.count; i++) {
-            if (i > 0) std::cout << ",";
-            std::cout << sackInfo.sack_blocks[i];
+            LOG_TRACE("[Send]   SACK block seq=%u", sackInfo.sack_blocks[i]);
         }
-        std::cout << "]," << std::endl;
     } else {
         ackPacket.header.len = 0;
         ackPacket.dataLen = 0;
         ackPacket.header.calculateChecksum(ackPacket.data, 0);
-        std::cout << "[Send] ACK packet ack=" << ackNum << "," << std::endl;
+        LOG_TRACE("[Send] ACK packet ack=%u", ackNum);
     }
     
     char sendBuffer[MAX_PACKET_SIZE];
@@ -134,8 +130,10 @@ void sendACK(SOCKET serverSocket, sockaddr_in& clientAddr, int addrLen,
 int pipelineRecv(SOCKET serverSocket, sockaddr_in& clientAddr, int addrLen,
                  uint32_t baseSeq, uint32_t& serverSeq, bool& finReceived, uint32_t& finSeq,
                  char* outBuffer, int outBufferSize) {
-    // 初始化接收窗口
-    g_recvWindow.reset(baseSeq);
+    // 初始化接收窗口（0-RTT时握手阶段缓存的早期数据还在窗口中，不能清空）
+    if (!g_earlyDataBuffered) {
+        g_recvWindow.reset(baseSeq);
+    }
     
     // 初始化FIN标志
     finReceived = false;
@@ -147,6 +145,13 @@ int pipelineRecv(SOCKET serverSocket, sockaddr_in& clientAddr, int addrLen,
     std::cout << "\n[Pipeline Receive] Starting to receive data, window size=" << FIXED_WINDOW_SIZE 
               << ", starting sequence number=" << baseSeq << std::endl;
     
+    // 先取出握手阶段已经收到的连续早期数据
+    if (g_earlyDataBuffered) {
+        totalReceived = g_recvWindow.slideAndGetData(outBuffer, outBufferSize);
+        std::cout << "[0-RTT] Delivered " << totalReceived << " bytes received during handshake, base="
+                  << g_recvWindow.base << std::endl;
+    }
+    
     // 设置接收超时
     int timeout = 5000;  // 5秒超时
     setsockopt(serverSocket, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout));
@@ -154,137 +159,225 @@ int pipelineRecv(SOCKET serverSocket, sockaddr_in& clientAddr, int addrLen,
     int idleCount = 0;  // 空闲计数器
     int maxIdleCount = 3;  // 最大空闲次数
     
+    // UDP接收合并（URO）：一次recvfrom可能收到多个等长的数据包，缓冲区按合并上限分配
+    bool offload = false;
+    if (UDP_OFFLOAD_ENABLED) {
+        offload = enableRecvOffload(serverSocket, UDP_OFFLOAD_MAX_BYTES);
+        std::cout << "[Offload] URO " << (offload ? "enabled" : "not supported, using per-packet receive") << std::endl;
+    }
+    g_recvWindow.offload_active = offload;
+    static char recvBuffer[(UDP_OFFLOAD_MAX_BYTES > MAX_PACKET_SIZE) ? UDP_OFFLOAD_MAX_BYTES : MAX_PACKET_SIZE];
+    const int recvBufferSize = offload ? (int)sizeof(recvBuffer) : MAX_PACKET_SIZE;
+    double cpuStart = getProcessCpuTimeMs();
+    
+    // 开始指标采样，先记录初始状态
+    g_metrics.start("receiver");
+    g_metrics.record(metricsFromRecvWindow(g_recvWindow), clock());
+    
     while (idleCount < maxIdleCount) {
-        char recvBuffer[MAX_PACKET_SIZE];
+        // ===== 指标采样：距上次采样超过 METRICS_SAMPLE_INTERVAL_MS 时记录一次窗口快照 =====
+        clock_t loopTime = clock();
+        if (g_metrics.due(loopTime)) {
+            g_metrics.record(metricsFromRecvWindow(g_recvWindow), loopTime);
+        }
+        
         sockaddr_in fromAddr;//定义发送方地址结构体，用于接收数据包的来源信息
         int fromAddrLen = sizeof(fromAddr);//发送方地址结构体大小
         
-        int bytesReceived = recvfrom(serverSocket, recvBuffer, MAX_PACKET_SIZE, 0,
+        int bytesReceived = recvfrom(serverSocket, recvBuffer, recvBufferSize, 0,
                                      (sockaddr*)&fromAddr, &fromAddrLen);
         
         if (bytesReceived == SOCKET_ERROR) {
             if (WSAGetLastError() == WSAETIMEDOUT) {
                 idleCount++;
-                std::cout << "[Timeout] Waiting for data packet timeout (" << idleCount << "/" << maxIdleCount << ")" << std::endl;
+                LOG_INFO("[Timeout] Waiting for data packet timeout (%d/%d)", idleCount, maxIdleCount);
                 continue;
             }
-            std::cerr << "[Error] Receive failed: " << WSAGetLastError() << std::endl;
+            LOG_ERROR("[Error] Receive failed: %d", WSAGetLastError());
+            logFlush();
             return -1;
         }
         
         idleCount = 0;  // 重置空闲计数器
         
-        // 解析接收到的包
-        Packet recvPacket;
-        if (!recvPacket.deserialize(recvBuffer, bytesReceived)) {
-            std::cout << "[Error] Packet checksum failed, discarded" << std::endl;
-            continue;
-        }
-        
-        // 检查是否为FIN包（客户端请求关闭连接）
-        if (recvPacket.header.flag & FLAG_FIN) {
-            std::cout << "[Receive] FIN packet seq=" << recvPacket.header.seq << std::endl;
-            // 设置FIN标志并返回
-            finReceived = true;
-            finSeq = recvPacket.header.seq;
-            return totalReceived;
-        }
-        
-        uint32_t recvSeq = recvPacket.header.seq;
-        
-        // ===== 模拟丢包 =====
-        if (shouldDropPacket(recvSeq)) {
-            g_recvWindow.total_packets_dropped++;
-            continue;  // 丢弃该包，不做任何处理
-        }
-        
-        // 更新接收统计
-        g_recvWindow.total_packets_received++;
-        
-        // ===== 模拟延迟 =====
-        simulateDelay(recvSeq);
-        
-        // 检查序列号是否在接收窗口 [base, base+N) 内
-        if (g_recvWindow.inWindow(recvSeq)) {
-            int idx = g_recvWindow.getIndex(recvSeq);
+        // 按数据包拆分：未启用URO时缓冲区中只有一个包，包后面的字节（如迟到的路径MTU探测SYN的填充）
+        // 直接忽略；启用时各包等长（最后一个可以更短），以第一个包的长度作为步长依次拆分，
+        // 第一个包校验失败则无法确定步长，整批丢弃（由发送端重传）。SYN不会与数据包合并，不拆分
+        int segSize = bytesReceived;
+        for (int offset = 0; offset < bytesReceived; offset += segSize) {
+            // 解析接收到的包
+            Packet recvPacket;
+            if (!recvPacket.deserialize(recvBuffer + offset, bytesReceived - offset)) {
+                LOG_WARN("[Error] Packet checksum failed, discarded");
+                if (offset == 0) break;
+                continue;
+            }
+            if (offset == 0 && offload && !(recvPacket.header.flag & FLAG_SYN)) {
+                segSize = recvPacket.getTotalLen();
+            }
             
-            // 检查是否是重复包
-            if (g_recvWindow.is_received[idx]) {
-                std::cout << "[Duplicate] Received duplicate packet seq=" << recvSeq << ", sending ACK" << std::endl;
-                g_recvWindow.total_duplicate_packets++;
-            } else {
-                // 记录接收时间（第一个数据包开始计时）
-                if (!g_firstPacketReceived) {
-                    g_firstPacketTime = clock();
-                    g_firstPacketReceived = true;
-                }
-                g_lastPacketTime = clock();  // 每次接收到新包都更新
-                
-                // 缓存数据包数据到接收窗口
-                memcpy(g_recvWindow.data_buf[idx], recvPacket.data, recvPacket.dataLen);//参数含义：目标地址，源地址，拷贝长度
-                g_recvWindow.data_len[idx] = recvPacket.dataLen;
-                g_recvWindow.is_received[idx] = 1;
-                
-                // 更新接收字节数
-                g_recvWindow.total_bytes_received += recvPacket.dataLen;
-                
-                std::cout << "[Receive] Data packet seq=" << recvSeq 
-                         << ", length=" << recvPacket.dataLen
-                         << ", window[" << g_recvWindow.base << "," 
-                         << (g_recvWindow.base + FIXED_WINDOW_SIZE - 1) << "]";
-                
-                // 显示数据内容（如果是可打印字符）
-                /*
-                if (recvPacket.dataLen > 0 && recvPacket.dataLen < 100) {
-                    char tempBuf[128];
-                    memcpy(tempBuf, recvPacket.data, recvPacket.dataLen);
-                    tempBuf[recvPacket.dataLen] = '\0';
-                    std::cout << ", content: " << tempBuf;
-                }
-                */
-                std::cout << std::endl;
+            // 检查是否为FIN包（客户端请求关闭连接）
+            if (recvPacket.header.flag & FLAG_FIN) {
+                LOG_INFO("[Receive] FIN packet seq=%u", recvPacket.header.seq);
+                // 设置FIN标志并返回
+                finReceived = true;
+                finSeq = recvPacket.header.seq;
+                g_recvWindow.cpu_time_ms = getProcessCpuTimeMs() - cpuStart;
+                g_metrics.record(metricsFromRecvWindow(g_recvWindow), clock());  // 结束时的最终样本
+                logFlush();
+                return totalReceived;
             }
             
-            // 尝试滑动窗口并取出连续数据
-            uint32_t oldBase = g_recvWindow.base;
-            int dataLen = g_recvWindow.slideAndGetData(outBuffer + totalReceived, 
-                                                       outBufferSize - totalReceived);
-            totalReceived += dataLen;
+            uint32_t recvSeq = recvPacket.header.seq;
             
-            if (g_recvWindow.base > oldBase) {
-                std::cout << "[Window Slide] base: " << oldBase << " -> " << g_recvWindow.base << std::endl;
+            // ===== 模拟丢包 =====
+            if (shouldDropPacket(recvSeq)) {
+                g_recvWindow.total_packets_dropped++;
+                continue;  // 丢弃该包，不做任何处理
             }
             
-            // 检查是否需要发送SACK（窗口内有非连续的已接收包）
-            bool needSACK = false;
-            for (uint32_t seq = g_recvWindow.base + 1; seq < g_recvWindow.base + FIXED_WINDOW_SIZE; seq++) {
-                int checkIdx = g_recvWindow.getIndex(seq);
-                if (g_recvWindow.is_received[checkIdx] && seq > g_recvWindow.base) {
-                    // 存在非连续的已接收包，需要SACK
-                    needSACK = true;
-                    break;
-                }
-            }
+            // 更新接收统计
+            g_recvWindow.total_packets_received++;
             
-            // 发送ACK/SACK
-            sendACK(serverSocket, clientAddr, addrLen, g_recvWindow.base, serverSeq, needSACK);
+            // ===== 模拟延迟 =====
+            simulateDelay(recvSeq);
             
-        } else if (recvSeq < g_recvWindow.base) {
-            // 收到旧包（序列号小于窗口base），说明之前的ACK可能丢失，重发ACK
-            std::cout << "[Old Packet] seq=" << recvSeq << " < base=" << g_recvWindow.base 
-                     << ", resending ACK" << std::endl;
-            g_recvWindow.total_duplicate_packets++;
-            sendACK(serverSocket, clientAddr, addrLen, g_recvWindow.base, serverSeq, false);
-        } else {
-            // 序列号超出窗口范围，丢弃（流量控制）
-            std::cout << "[Out of Window] seq=" << recvSeq << " out of window range, discarded" << std::endl;
+            // 检查序列号是否在接收窗口 [base, base+N) 内
+            if (g_recvWindow.inWindow(recvSeq)) {
+                int idx = g_recvWindow.getIndex(recvSeq);
+                
+                // 检查是否是重复包
+                if (g_recvWindow.is_received[idx]) {
+                    LOG_TRACE("[Duplicate] Received duplicate packet seq=%u, sending ACK", recvSeq);
+                    g_recvWindow.total_duplicate_packets++;
+                } else {
+                    // 记录接收时间（第一个数据包开始计时）
+                    if (!g_firstPacketReceived) {
+                        g_firstPacketTime = clock();
+                        g_firstPacketReceived = true;
+                    }
+                    g_lastPacketTime = clock();  // 每次接收到新包都更新
+                    
+                    // 缓存数据包数据到接收窗口
+                    memcpy(g_recvWindow.data_buf[idx], recvPacket.data, recvPacket.dataLen);//参数含义：目标地址，源地址，拷贝长度
+                    g_recvWindow.data_len[idx] = recvPacket.dataLen;
+                    g_recvWindow.is_received[idx] = 1;
+                    
+                    // 更新接收字节数
+                    g_recvWindow.total_bytes_received += recvPacket.dataLen;
+                    
+                    LOG_TRACE("[Receive] Data packet seq=%u, length=%d, window[%u,%u]",
+                              recvSeq, recvPacket.dataLen, g_recvWindow.base,
+                              g_recvWindow.base + FIXED_WINDOW_SIZE - 1);
+                }
+                
+                // 尝试滑动窗口并取出连续数据
+                uint32_t oldBase = g_recvWindow.base;
+                int dataLen = g_recvWindow.slideAndGetData(outBuffer + totalReceived, 
+                                                           outBufferSize - totalReceived);
+                totalReceived += dataLen;
+                
+                if (g_recvWindow.base > oldBase) {
+                    LOG_TRACE("[Window Slide] base: %u -> %u", oldBase, g_recvWindow.base);
+                }
+                
+                // 检查是否需要发送SACK（窗口内有非连续的已接收包）
+                bool needSACK = false;
+                for (uint32_t seq = g_recvWindow.base + 1; seq < g_recvWindow.base + FIXED_WINDOW_SIZE; seq++) {
+                    int checkIdx = g_recvWindow.getIndex(seq);
+                    if (g_recvWindow.is_received[checkIdx] && seq > g_recvWindow.base) {
+                        // 存在非连续的已接收包，需要SACK
+                        needSACK = true;
+                        break;
+                    }
+                }
+                
+                // 发送ACK/SACK
+                sendACK(serverSocket, clientAddr, addrLen, g_recvWindow.base, serverSeq, needSACK);
+                
+            } else if (recvSeq < g_recvWindow.base) {
+                // 收到旧包（序列号小于窗口base），说明之前的ACK可能丢失，重发ACK
+                LOG_TRACE("[Old Packet] seq=%u < base=%u, resending ACK", recvSeq, g_recvWindow.base);
+                g_recvWindow.total_duplicate_packets++;
+                sendACK(serverSocket, clientAddr, addrLen, g_recvWindow.base, serverSeq, false);
+            } else {
+                // 序列号超出窗口范围，丢弃（流量控制）
+                LOG_TRACE("[Out of Window] seq=%u out of window range, discarded", recvSeq);
+            }
         }
     }
     
-        std::cout << "[Pipeline Receive] Reception completed, received " << totalReceived << " bytes of data" << std::endl;
+    g_recvWindow.cpu_time_ms = getProcessCpuTimeMs() - cpuStart;
+    g_metrics.record(metricsFromRecvWindow(g_recvWindow), clock());  // 结束时的最终样本
+    logFlush();
+    std::cout << "[Pipeline Receive] Reception completed, received " << totalReceived << " bytes of data" << std::endl;
     return totalReceived;
 }
 
+// 路径MTU探测：根据收到的SYN包确定本连接的MSS
+// 取客户端探测的MSS、SYN实际到达的负载长度（含填充）和本地缓冲区上限三者的最小值
+// 客户端未携带MSS选项（旧版本）时返回0，表示不协商
+static uint16_t selectMSS(const UDPHeader& synHeader, int bytesReceived) {
+    if (synHeader.mss == 0) return 0;
+    int mss = synHeader.mss;
+    if (mss > bytesReceived - HEADER_SIZE) mss = bytesReceived - HEADER_SIZE;
+    if (mss > MAX_DATA_SIZE) mss = MAX_DATA_SIZE;
+    return (uint16_t)mss;
+}
+
+// 发送SYN+ACK包（第二次握手），mss为回送给客户端的协商结果
+static bool sendSynAck(SOCKET serverSocket, sockaddr_in& clientAddr, int clientAddrLen,
+                       uint32_t clientSeq, uint32_t serverSeq, uint16_t mss) {
+    Packet synAckPacket;
+    synAckPacket.header.seq = serverSeq;
+    synAckPacket.header.ack = clientSeq + 1;
+    synAckPacket.header.flag = FLAG_SYN | FLAG_ACK;
+    synAckPacket.header.mss = mss;  // MSS选项：确认本连接使用的MSS
+    synAckPacket.dataLen = 0;
+    synAckPacket.header.len = 0;  // 同步设置协议头中的数据长度字段
+    synAckPacket.header.calculateChecksum(synAckPacket.data, 0);
+    
+    char sendBuffer[MAX_PACKET_SIZE];
+    synAckPacket.serialize(sendBuffer);
+    int bytesSent = sendto(serverSocket, sendBuffer, synAckPacket.getTotalLen(), 0,
+                          (sockaddr*)&clientAddr, clientAddrLen);
+    
+    if (bytesSent == SOCKET_ERROR) {
+        std::cerr << "[Error] Failed to send SYN+ACK packet: " << WSAGetLastError() << std::endl;
+        return false;
+    }
+    
+    std::cout << "[Sent] SYN+ACK packet (seq=" << serverSeq << ", ack=" << synAckPacket.header.ack
+              << ", mss=" << mss << ")" << std::endl;
+    return true;
+}
+
+// 0-RTT：把握手阶段到达的数据包缓存到接收窗口（seq为该数据的序列号），pipelineRecv开始时再按序取出
+static void bufferEarlyData(uint32_t seq, const Packet& packet) {
+    if (packet.dataLen <= 0 || !g_recvWindow.inWindow(seq)) return;
+    int idx = g_recvWindow.getIndex(seq);
+    g_recvWindow.total_packets_received++;
+    if (g_recvWindow.is_received[idx]) {
+        g_recvWindow.total_duplicate_packets++;  // SYN重传携带的同一块数据
+        return;
+    }
+    
+    // 传输计时从第一个早期数据包开始
+    if (!g_firstPacketReceived) {
+        g_firstPacketTime = clock();
+        g_firstPacketReceived = true;
+    }
+    g_lastPacketTime = clock();
+    
+    memcpy(g_recvWindow.data_buf[idx], packet.data, packet.dataLen);
+    g_recvWindow.data_len[idx] = packet.dataLen;
+    g_recvWindow.is_received[idx] = 1;
+    g_recvWindow.total_bytes_received += packet.dataLen;
+    g_earlyDataBuffered = true;
+    
+    std::cout << "[0-RTT] Buffered early data seq=" << seq << ", length=" << packet.dataLen << std::endl;
+}
+
 // 服务端三次握手：处理客户端连接请求
 bool acceptConnection(SOCKET serverSocket, sockaddr_in& clientAddr, uint32_t& clientSeq, uint32_t& serverSeq) {
     ConnectionState state = CLOSED;
@@ -293,14 +386,15 @@ bool acceptConnection(SOCKET serverSocket, sockaddr_in& clientAddr, uint32_t& cl
     // 第一次握手：接收客户端的SYN包
     char recvBuffer[MAX_PACKET_SIZE];
     int clientAddrLen = sizeof(clientAddr);
+    int bytesReceived = 0;
     
     Packet recvPacket;
     
     // 循环等待有效的SYN包
     while (true) {
         clientAddrLen = sizeof(clientAddr);  // 每次recvfrom前重置长度
-        int bytesReceived = recvfrom(serverSocket, recvBuffer, MAX_PACKET_SIZE, 0,
-                                     (sockaddr*)&clientAddr, &clientAddrLen);
+        bytesReceived = recvfrom(serverSocket, recvBuffer, MAX_PACKET_SIZE, 0,
+                                 (sockaddr*)&clientAddr, &clientAddrLen);
         
         if (bytesReceived == SOCKET_ERROR) {
             std::cerr << "[Error] Failed to receive SYN packet: " << WSAGetLastError() << std::endl;
@@ -325,62 +419,97 @@ bool acceptConnection(SOCKET serverSocket, sockaddr_in& clientAddr, uint32_t& cl
     // 收到有效的SYN包
     if (recvPacket.header.flag & FLAG_SYN) {
         clientSeq = recvPacket.header.seq;
-        std::cout << "[Received] SYN packet (seq=" << clientSeq << ") from " 
+        uint16_t mss = selectMSS(recvPacket.header, bytesReceived);
+        std::cout << "[Received] SYN packet (seq=" << clientSeq << ", size=" << bytesReceived
+                 << ", mss=" << recvPacket.header.mss << ") from " 
                  << inet_ntoa(clientAddr.sin_addr) << ":" << ntohs(clientAddr.sin_port) << std::endl;
         
         state = SYN_RCVD;
         std::cout << "[State Transition] CLOSED -> SYN_RCVD" << std::endl;
         
+        // 0-RTT：接收窗口从clientSeq+1开始，SYN携带的数据就是该序列号的数据
+        g_recvWindow.reset(clientSeq + 1);
+        g_earlyDataBuffered = false;
+        bufferEarlyData(clientSeq + 1, recvPacket);
+        
         // 第二次握手：发送SYN+ACK包
         serverSeq = generateInitialSeq();
-        
-        Packet synAckPacket;
-        synAckPacket.header.seq = serverSeq;
-        synAckPacket.header.ack = clientSeq + 1;
-        synAckPacket.header.flag = FLAG_SYN | FLAG_ACK;
-        synAckPacket.dataLen = 0;
-        synAckPacket.header.len = 0;  // 同步设置协议头中的数据长度字段
-        synAckPacket.header.calculateChecksum(synAckPacket.data, 0);
-        
-        char sendBuffer[MAX_PACKET_SIZE];
-        synAckPacket.serialize(sendBuffer);
-        int bytesSent = sendto(serverSocket, sendBuffer, synAckPacket.getTotalLen(), 0,
-                              (sockaddr*)&clientAddr, clientAddrLen);
-        
-        if (bytesSent == SOCKET_ERROR) {
-            std::cerr << "[Error] Failed to send SYN+ACK packet: " << WSAGetLastError() << std::endl;
+        if (!sendSynAck(serverSocket, clientAddr, clientAddrLen, clientSeq, serverSeq, mss)) {
             return false;
         }
         
-        std::cout << "[Sent] SYN+ACK packet (seq=" << serverSeq << ", ack=" << synAckPacket.header.ack << ")" << std::endl;
-        
         // 第三次握手：接收客户端的ACK包
         // 设置接收超时
         int timeout = TIMEOUT_MS;
         setsockopt(serverSocket, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout));
         
-        int bytesReceived = recvfrom(serverSocket, recvBuffer, MAX_PACKET_SIZE, 0,
-                                (sockaddr*)&clientAddr, &clientAddrLen);
-        
-        if (bytesReceived == SOCKET_ERROR) {
-            std::cerr << "[Timeout] Client ACK not received" << std::endl;
-            return false;
-        }
-        
-        if (!recvPacket.deserialize(recvBuffer, bytesReceived)) {
-            std::cout << "[Error] Packet checksum failed" << std::endl;
-            return false;
-        }
-        
-        if ((recvPacket.header.flag & FLAG_ACK) && recvPacket.header.ack == serverSeq + 1) {
-            std::cout << "[Received] ACK packet (ack=" << recvPacket.header.ack << ")" << std::endl;
-            state = ESTABLISHED;
-            std::cout << "[State Transition] SYN_RCVD -> ESTABLISHED" << std::endl;
-            std::cout << "[Success] Connection established!\n" << std::endl;
+        // 路径MTU探测时客户端可能在收到SYN+ACK之前又发出了更小的探测SYN，
+        // 此时重新回送SYN+ACK（按新SYN重新选择MSS）并继续等待ACK；
+        // 0-RTT时紧随SYN发出的数据包也会在ACK之前到达，缓存后继续等待（不计入重试次数）。
+        // 数据包会让recvfrom一直不超时，所以整个等待过程另有总时限
+        clock_t deadline = clock() + (clock_t)MAX_RETRIES * TIMEOUT_MS * CLOCKS_PER_SEC / 1000;
+        int attempt = 0;
+        while (attempt < MAX_RETRIES && clock() < deadline) {
+            bytesReceived = recvfrom(serverSocket, recvBuffer, MAX_PACKET_SIZE, 0,
+                                    (sockaddr*)&clientAddr, &clientAddrLen);
+            
+            if (bytesReceived == SOCKET_ERROR) {
+                std::cerr << "[Timeout] Client ACK not received" << std::endl;
+                return false;
+            }
+            
+            if (!recvPacket.deserialize(recvBuffer, bytesReceived)) {
+                std::cout << "[Error] Packet checksum failed" << std::endl;
+                return false;
+            }
+            
+            if ((recvPacket.header.flag & FLAG_SYN) && recvPacket.header.seq == clientSeq) {
+                mss = selectMSS(recvPacket.header, bytesReceived);
+                std::cout << "[Received] Retransmitted SYN packet (size=" << bytesReceived
+                         << ", mss=" << recvPacket.header.mss << ")" << std::endl;
+                bufferEarlyData(clientSeq + 1, recvPacket);
+                if (!sendSynAck(serverSocket, clientAddr, clientAddrLen, clientSeq, serverSeq, mss)) {
+                    return false;
+                }
+                attempt++;
+                continue;
+            }
             
-            serverSeq++;  // 更新序列号
-            clientSeq++;  // 更新客户端序列号
-            return true;
+            bool handshakeAcked = (recvPacket.header.flag & FLAG_ACK) && recvPacket.header.ack == serverSeq + 1;
+            if (handshakeAcked) {
+                std::cout << "[Received] ACK packet (ack=" << recvPacket.header.ack << ")" << std::endl;
+            } else if (!(recvPacket.header.flag & (FLAG_SYN | FLAG_FIN)) && recvPacket.dataLen > 0) {
+                // 客户端只有收到SYN+ACK后才会发送数据包（0-RTT的早期数据除外，它们只随第一个SYN发出一次）。
+                // 所以SYN未携带数据时收到的任何数据包，或者0-RTT时重复到达的数据包（客户端的超时重传），
+                // 都说明客户端已经进入ESTABLISHED，只是第三次握手的ACK丢了
+                bool retransmitted = g_recvWindow.inWindow(recvPacket.header.seq) &&
+                                     g_recvWindow.is_received[g_recvWindow.getIndex(recvPacket.header.seq)];
+                handshakeAcked = !g_earlyDataBuffered || retransmitted;
+                bufferEarlyData(recvPacket.header.seq, recvPacket);
+                if (!handshakeAcked) continue;
+                std::cout << "[Received] Data packet (seq=" << recvPacket.header.seq
+                         << ") in SYN_RCVD, treating the lost ACK as received" << std::endl;
+            }
+            
+            if (handshakeAcked) {
+                state = ESTABLISHED;
+                std::cout << "[State Transition] SYN_RCVD -> ESTABLISHED" << std::endl;
+                std::cout << "[Success] Connection established!\n" << std::endl;
+                
+                serverSeq++;  // 更新序列号
+                clientSeq++;  // 更新客户端序列号
+                
+                // 0-RTT：立即确认已缓存的早期数据（累积确认到第一个缺失的序列号），客户端不必等超时重传
+                if (g_earlyDataBuffered) {
+                    uint32_t ackNum = g_recvWindow.base;
+                    while (g_recvWindow.inWindow(ackNum) && g_recvWindow.is_received[g_recvWindow.getIndex(ackNum)]) {
+                        ackNum++;
+                    }
+                    sendACK(serverSocket, clientAddr, clientAddrLen, ackNum, serverSeq, false);
+                }
+                return true;
+            }
+            break;
         }
     }
     
@@ -478,6 +607,9 @@ bool handleClose(SOCKET serverSocket, sockaddr_in& clientAddr, uint32_t clientSe
         std::cout << "Total Bytes Received: " << g_recvWindow.total_bytes_received << " bytes" << std::endl;
         std::cout << "Transmission Time: " << transmissionTime << " seconds" << std::endl;
         std::cout << "Average Throughput: " << throughput << " KB/s" << std::endl;
+        std::cout << "UDP Receive Offload (URO): " << (g_recvWindow.offload_active ? "on" : "off") << std::endl;
+        std::cout << "CPU Time: " << g_recvWindow.cpu_time_ms << " ms" << std::endl;
+        std::cout << "CPU per GB: " << cpuMsPerGB(g_recvWindow.cpu_time_ms, g_recvWindow.total_bytes_received) << " ms" << std::endl;
         std::cout << "====================================================\n" << std::endl;
         
         return true;
@@ -505,6 +637,9 @@ bool handleClose(SOCKET serverSocket, sockaddr_in& clientAddr, uint32_t clientSe
         std::cout << "Total Bytes Received: " << g_recvWindow.total_bytes_received << " bytes" << std::endl;
         std::cout << "Transmission Time: " << transmissionTime << " seconds" << std::endl;
         std::cout << "Average Throughput: " << throughput << " KB/s" << std::endl;
+        std::cout << "UDP Receive Offload (URO): " << (g_recvWindow.offload_active ? "on" : "off") << std::endl;
+        std::cout << "CPU Time: " << g_recvWindow.cpu_time_ms << " ms" << std::endl;
+        std::cout << "CPU per GB: " << cpuMsPerGB(g_recvWindow.cpu_time_ms, g_recvWindow.total_bytes_received) << " ms" << std::endl;
         std::cout << "====================================================\n" << std::endl;
         
         return true;
@@ -549,6 +684,11 @@ int main() {
     // 初始化模拟日志
     initSimulationLog();
     
+    // 启动异步日志线程：热路径日志写控制台（同时进入server.txt），丢包/延迟记录写simulation.txt
+    logSetSink(LOG_SINK_CONSOLE, &std::cout);
+    logSetSink(LOG_SINK_SIMULATION, &g_simulationLog);
+    logStart();
+    
     // 输出模拟配置信息
     std::cout << "\n===== Network Simulation Configuration =====" << std::endl;
     std::cout << "Loss Simulation: " << (SIMULATE_LOSS_ENABLED ? "Enabled" : "Disabled") << std::endl;
@@ -623,10 +763,12 @@ int main() {
     bool finReceived = false;
     uint32_t finSeq = 0;
     
-    // 重置计时变量
-    g_firstPacketReceived = false;
-    g_firstPacketTime = 0;
-    g_lastPacketTime = 0;
+    // 重置计时变量（0-RTT时握手阶段收到早期数据已经开始计时）
+    if (!g_earlyDataBuffered) {
+        g_firstPacketReceived = false;
+        g_firstPacketTime = 0;
+        g_lastPacketTime = 0;
+    }
     
     // 重置文件名
     g_currentFilename.clear();
@@ -695,7 +837,11 @@ int main() {
         }
     }
 
-    // 7. 清理资源
+    // 7. 导出传输指标时间序列
+    g_metrics.dump("metrics_server");
+
+    // 8. 清理资源
+    logStop();             // 先写完所有日志，再关闭模拟日志文件
     closeSimulationLog();  // 关闭模拟日志
     closesocket(serverSocket);
     WSACleanup();
@@ -10,10 +10,14 @@
 #include <ws2tcpip.h>
 #include "config.h"
 #include "protocol.h"
+#include "metrics.h"
 
 // 全局接收窗口：管理流水线接收的滑动窗口状态
 extern RecvWindow g_recvWindow;
 
+// 全局指标记录器：定时采样接收窗口状态，结束时导出为 metrics_server.csv/.json
+extern MetricsRecorder g_metrics;
+
 // 发送ACK/SACK响应：支持累积确认和选择确认
 void sendACK(SOCKET serverSocket, sockaddr_in& clientAddr, int addrLen,
              uint32_t ackNum, uint32_t serverSeq, bool useSACK);
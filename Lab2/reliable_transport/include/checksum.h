@@ -76,6 +76,38 @@ uint16_t calculate_frame_checksum(const Frame* frame);
  */
 bool verify_frame_checksum(const Frame* frame);
 
+// ==================== CRC32C校验函数 ====================
+
+/**
+ * 计算CRC32C（Castagnoli多项式0x1EDC6F41，反射形式0x82F63B78）
+ * 
+ * 用作协商后的帧尾校验（见packet.h中的CHECKSUM_CRC32C）
+ * CPU支持SSE4.2时使用硬件CRC32指令，否则使用slicing-by-8查表
+ * 
+ * 可以分段计算：crc32c_update(crc32c_update(0, a, n), b, m)
+ * 等于对a、b拼接后的数据一次计算的结果
+ * 
+ * @param crc 之前数据的CRC32C（首段传0）
+ * @param data 数据指针
+ * @param length 数据长度（字节数）
+ * @return 计算得到的32位CRC32C
+ * 
+ * 举例：crc32c_update(0, "123456789", 9) = 0xE3069283
+ */
+uint32_t crc32c_update(uint32_t crc, const void* data, size_t length);
+
+/**
+ * 计算CRC32C（只使用slicing-by-8查表实现）
+ * 参数与返回值同crc32c_update()，用于对比测试和基准测试
+ */
+uint32_t crc32c_update_software(uint32_t crc, const void* data, size_t length);
+
+/**
+ * 当前CPU是否支持硬件CRC32C指令（SSE4.2）
+ * @return 支持返回true
+ */
+bool crc32c_hardware_available();
+
 // ==================== 其他工具函数 ====================
 
 /**
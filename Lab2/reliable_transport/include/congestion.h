@@ -8,10 +8,14 @@
 #include "reliable_transport.h"
 #include "packet.h"
 
+// ==================== 常量定义 ====================
+
+#define DUP_ACK_THRESHOLD 3             // 快速重传的重复ACK阈值（发送端据此触发重传）
+
 // ==================== 拥塞控制状态枚举 ====================
 
 /**
- * TCP RENO拥塞控制算法的三个阶段
+ * TCP NewReno拥塞控制算法的三个阶段
  * 
  * 状态转换图：
  * 
@@ -19,8 +23,8 @@
  *     ↓
  * [SLOW_START] ─(cwnd >= ssthresh)→ [CONGESTION_AVOIDANCE]
  *     ↓(3个重复ACK或超时)              ↓(3个重复ACK)
- *     └──────────────────→ [FAST_RECOVERY] ─(新ACK)→ [CONGESTION_AVOIDANCE]
- *                              ↓(超时)
+ *     └──────────────────→ [FAST_RECOVERY] ─(确认到recovery_point)→ [CONGESTION_AVOIDANCE]
+ *                            ↓(超时)   ↺(部分ACK：重传下一个空洞)
  *                         回到 [SLOW_START]
  */
 typedef enum {
@@ -29,6 +33,16 @@ typedef enum {
     FAST_RECOVERY = 2                  // 快速恢复：处理重复ACK
 } CongestionState;
 
+/**
+ * update_congestion_control处理ACK后要求发送方执行的动作
+ */
+typedef enum {
+    CC_ACTION_NONE = 0,                // 无需重传
+    CC_ACTION_FAST_RETRANSMIT = 1,     // 第3个重复ACK：进入快速恢复，重传窗口首部的包
+    CC_ACTION_PARTIAL_ACK = 2          // 部分ACK（快速恢复中，或超时后尚未确认到recovery_point）：
+                                       // 重传下一个空洞（新的窗口首部）
+} CongestionAction;
+
 // ==================== 拥塞控制结构体 ====================
 
 /**
@@ -46,12 +60,14 @@ typedef struct {
     uint32_t cwnd_inc;                 // 拥塞窗口增量（用于精确计算）
     CongestionState state;             // 当前拥塞控制状态
     int dup_ack_count;                 // 重复ACK计数器（0-3+）
-    uint32_t recovery_point;           // 快速恢复起始点序列号
+    uint32_t recovery_point;           // 进入快速恢复（或超时）时已发送的最高序列号，确认到它才退出恢复
+    bool recovery_active;              // recovery_point是否有效（尚未被新ACK越过），按模2^32比较
+    uint32_t last_ack;                 // 最近一次新ACK的确认号（计算部分ACK确认的帧数）
     
-    // RTT相关（用于RTO计算）
-    uint32_t rtt;                      // 往返时间估计（毫秒）
-    uint32_t rttvar;                   // RTT方差（毫秒）
-    uint32_t rto;                      // 重传超时时间（毫秒）
+    // RTT相关（用于RTO计算，单位均为微秒，基于单调时钟测量）
+    uint32_t rtt_us;                   // 平滑RTT估计（0表示尚无采样）
+    uint32_t rttvar_us;                // RTT方差
+    uint32_t rto_us;                   // 重传超时时间
     
     // 统计信息
     uint32_t congestion_events;        // 拥塞事件计数
@@ -73,24 +89,48 @@ CongestionControl* create_congestion_control();
 /**
  * 更新拥塞控制状态
  * 
- * 处理新ACK事件，根据当前状态更新cwnd
+ * 处理ACK事件，根据当前状态更新cwnd（NewReno，RFC 6582）：
+ * - 第3个重复ACK进入快速恢复，记录recovery_point = highest_sent；
+ *   上一次恢复（或超时）的recovery_point尚未被确认时不再进入，避免同一窗口内重复减半
+ * - 快速恢复中的新ACK未确认到recovery_point时为部分ACK：留在快速恢复，
+ *   cwnd扣除新确认的数据量后加回1 MSS，发送方重传下一个空洞
+ * - 确认到recovery_point时退出快速恢复，cwnd收缩到ssthresh
  * 
  * @param cc 拥塞控制指针
- * @param ack_num 确认号
+ * @param ack_num 确认号（下一个期望的序列号）
  * @param is_duplicate_ack 是否为重复ACK
- * @return 成功返回true，失败返回false
+ * @param highest_sent 已发送的最高序列号
+ * @return 发送方需要执行的重传动作
  */
-bool update_congestion_control(CongestionControl* cc, uint32_t ack_num, bool is_duplicate_ack);
+CongestionAction update_congestion_control(CongestionControl* cc, uint32_t ack_num, bool is_duplicate_ack,
+                                           uint32_t highest_sent);
+
+/**
+ * 处理NACK（接收端发现空洞时立即发送）
+ * 
+ * 与第3个重复ACK同等对待：进入快速恢复并记录recovery_point = highest_sent；
+ * 已在快速恢复中，或上一次恢复（超时）的recovery_point尚未被确认时不再减半。
+ * 空洞由发送方按NACK的选择确认位图重传，这里只调整窗口
+ * 
+ * @param cc 拥塞控制指针
+ * @param ack_num NACK的确认号
+ * @param highest_sent 已发送的最高序列号
+ * @return 进入快速恢复时返回CC_ACTION_FAST_RETRANSMIT，否则CC_ACTION_NONE
+ */
+CongestionAction handle_congestion_nack(CongestionControl* cc, uint32_t ack_num, uint32_t highest_sent);
 
 /**
  * 处理超时事件
  * 
- * 当发生重传超时时调用，回退到慢启动
+ * 当发生重传超时时调用，回退到慢启动；
+ * recovery_point记为highest_sent，超时前发出的包引起的重复ACK不再触发快速重传，
+ * 之后未确认到recovery_point的新ACK按部分ACK处理，由ACK时钟逐个补发其余空洞
  * 
  * @param cc 拥塞控制指针
+ * @param highest_sent 已发送的最高序列号
  * @return 成功返回true，失败返回false
  */
-bool handle_congestion_timeout(CongestionControl* cc);
+bool handle_congestion_timeout(CongestionControl* cc, uint32_t highest_sent);
 
 /**
  * 获取当前拥塞窗口大小
@@ -101,15 +141,22 @@ bool handle_congestion_timeout(CongestionControl* cc);
 uint32_t get_congestion_window(CongestionControl* cc);
 
 /**
- * 获取当前可发送字节数
+ * 获取当前还可以发送的字节数
+ * 
+ * allowance = max(0, min(cwnd, peer_window) - bytes_in_flight)
+ * 在途字节数由发送窗口维护（SendWindow::bytes_in_flight），
+ * 发送方每次发送前查询，正好填满管道而不突发
  * 
- * 取决于拥塞窗口和接收方窗口的最小值
- * （这里只考虑拥塞窗口）
+ * 受限传输（RFC 3042）：快速恢复之外收到第1、2个重复ACK时，
+ * 每个重复ACK允许在cwnd之外多发送1 MSS新数据（cwnd本身不变），
+ * 让小窗口也能凑够3个重复ACK触发快速重传，而不是等待超时
  * 
  * @param cc 拥塞控制指针
+ * @param peer_window 对端通告的接收窗口（字节）
+ * @param bytes_in_flight 已发送未确认的字节数
  * @return 可发送字节数
  */
-uint32_t get_send_allowance(CongestionControl* cc);
+uint32_t get_send_allowance(CongestionControl* cc, uint32_t peer_window, uint32_t bytes_in_flight);
 
 /**
  * 获取拥塞控制状态字符串
@@ -125,16 +172,16 @@ const char* congestion_state_to_string(CongestionState state);
  * 使用Karn/Partridge算法估计RTT和RTO
  * 
  * @param cc 拥塞控制指针
- * @param sample_rtt 采样的RTT值（毫秒）
+ * @param sample_rtt_us 采样的RTT值（微秒），只能取自未重传过的包
  * @return 成功返回true，失败返回false
  */
-bool update_rtt(CongestionControl* cc, uint32_t sample_rtt);
+bool update_rtt(CongestionControl* cc, uint32_t sample_rtt_us);
 
 /**
  * 获取当前的重传超时时间
  * 
  * @param cc 拥塞控制指针
- * @return RTO值（毫秒）
+ * @return RTO值（微秒）
  */
 uint32_t get_rto(CongestionControl* cc);
 
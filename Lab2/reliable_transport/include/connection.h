@@ -3,6 +3,7 @@
 
 #include <cstdint>
 #include <cstddef>
+#include <cstdio>
 #include <ctime>
 
 // Platform-specific socket headers
@@ -18,6 +19,9 @@
 
 #include "reliable_transport.h"
 #include "packet.h"
+#include "window.h"
+#include "congestion.h"
+#include "file_io.h"
 
 // ==================== 连接状态枚举 ====================
 
@@ -54,8 +58,9 @@ typedef enum {
  * 可靠传输协议连接结构
  * 
  * 包含连接的基本信息和状态管理
+ * sockfd >= 0时，状态机各函数通过该套接字向peer_addr实际发送响应帧
  */
-typedef struct {
+typedef struct Connection {
     // ===== 套接字和地址信息 =====
     int sockfd;                        // UDP套接字文件描述符
     struct sockaddr_in peer_addr;      // 对端地址（IP和端口）
@@ -72,26 +77,121 @@ typedef struct {
     
     // ===== 流量控制 =====
     uint16_t window_size;              // 接收窗口大小（本地）
-    uint16_t peer_window_size;         // 对端窗口大小
+    uint32_t peer_window_size;         // 对端通告的接收窗口（字节，已按peer_wscale解码）
+    uint8_t wscale;                    // 本端通告窗口时的移位数（未协商窗口缩放时为0）
+    uint8_t peer_wscale;               // 对端通告窗口的移位数（未协商窗口缩放时为0）
     
-    // ===== 拥塞控制（RENO算法） =====
-    uint32_t cwnd;                     // 拥塞窗口大小
-    uint32_t ssthresh;                 // 慢启动阈值
-    uint32_t inflight;                 // 已发送但未确认的字节数
+    // ===== 拥塞控制（RENO算法，发送端镜像CongestionControl的当前值） =====
+    uint32_t cwnd;                     // 拥塞窗口大小（字节）
+    uint32_t ssthresh;                 // 慢启动阈值（字节）
     
     // ===== 超时和重传 =====
     time_t last_activity;              // 最后活动时间（秒）
-    uint32_t rto;                      // 重传超时时间（毫秒）
-    uint32_t rtt;                      // 往返时间估计（毫秒）
-    uint32_t retransmit_count;         // 重传次数统计
+    uint32_t rto_us;                   // 重传超时时间（微秒）
+    uint32_t rtt_us;                   // 平滑RTT估计（微秒，0表示尚无采样）
     
     // ===== 统计信息 =====
-    uint32_t bytes_sent;               // 已发送的总字节数
-    uint32_t bytes_received;           // 已接收的总字节数
-    uint32_t frames_sent;              // 已发送的帧数
-    uint32_t frames_received;          // 已接收的帧数
+    // 64位计数器：数据路径用connection_count累加，监控线程通过connection_get_stats无锁读取
+    uint64_t bytes_sent;               // 已发送的数据字节数（含重传）
+    uint64_t bytes_acked;              // 已被对端累积确认的数据字节数（发送端有效载荷）
+    uint64_t bytes_received;           // 已按序交付的数据字节数（接收端有效载荷）
+    uint64_t frames_sent;              // 已发送的帧数
+    uint64_t frames_received;          // 已接收的帧数
+    uint64_t retransmit_count;         // 重传次数（接收端为收到的重复帧数）
+    uint64_t start_time_us;            // 连接创建时刻（单调时钟，计算有效吞吐量）
+
+    // ===== 接收端状态（多客户端服务器） =====
+    ChecksumMode checksum_mode;        // 握手协商的校验模式
+    bool sack_enabled;                 // 握手协商了OPT_SACK：ACK携带选择确认位图，发现空洞时发送NACK
+    ReceiveWindow* recv_window;        // 接收窗口（缓冲乱序帧），未打开接收端时为NULL
+    FileWriter* output;                // 该连接的输出文件（后台线程批量写盘）
+
+    // ===== 连接表 =====
+    struct Connection* hash_next;      // 同一哈希桶中的下一个连接
 } Connection;
 
+// ==================== 连接统计快照 ====================
+
+/**
+ * connection_get_stats返回的统计快照
+ * 
+ * 各字段分别以relaxed原子读取，彼此之间不保证是同一时刻的值，
+ * 用于监控和报告，不用于协议判断
+ */
+typedef struct {
+    ConnectionState state;             // 连接状态
+    uint64_t bytes_sent;               // 已发送的数据字节数（含重传）
+    uint64_t bytes_acked;              // 已被确认的数据字节数
+    uint64_t bytes_received;           // 已按序交付的数据字节数
+    uint64_t frames_sent;              // 已发送的帧数
+    uint64_t frames_received;          // 已接收的帧数
+    uint64_t retransmit_count;         // 重传次数
+    uint32_t cwnd;                     // 拥塞窗口（字节）
+    uint32_t ssthresh;                 // 慢启动阈值（字节）
+    uint32_t rtt_us;                   // 平滑RTT（微秒）
+    uint32_t rto_us;                   // 重传超时（微秒）
+    uint64_t elapsed_us;               // 连接创建至今的时间（微秒）
+    double goodput_mbps;               // 有效吞吐量：(已确认 + 已交付字节) / elapsed，Mbps
+} ConnectionStats;
+
+/**
+ * 累加连接统计计数器
+ * 
+ * 每个计数器只有持有该连接的线程写入，因此用relaxed原子读加写即可，
+ * 不需要带锁前缀的原子加；监控线程读到的总是完整的64位值
+ * 
+ * @param counter 计数器指针（Connection中的统计字段）
+ * @param delta 增量
+ */
+static inline void connection_count(uint64_t* counter, uint64_t delta)
+{
+    __atomic_store_n(counter, __atomic_load_n(counter, __ATOMIC_RELAXED) + delta, __ATOMIC_RELAXED);
+}
+
+// ==================== 帧分派 ====================
+
+/**
+ * 状态机动作：connection_action按[连接状态][帧类型]查表得到
+ * 
+ * 表中只登记各状态下有意义的帧，其余为CONN_ACTION_DROP，直接丢弃，
+ * 不进入处理函数，也不产生警告日志（重复帧和迟到帧在正常传输中很常见）
+ */
+typedef enum {
+    CONN_ACTION_DROP = 0,              // 当前状态不接受该帧
+    CONN_ACTION_SYN = 1,               // handle_syn：接受连接或重发SYN-ACK
+    CONN_ACTION_SYN_ACK = 2,           // handle_syn_ack：客户端完成握手
+    CONN_ACTION_ACK = 3,               // handle_ack：握手第3步或零窗口探测
+    CONN_ACTION_DATA = 4,              // handle_data：缓冲数据并回复累积ACK（发现空洞时回复NACK）
+    CONN_ACTION_FIN = 5,               // handle_fin：被动关闭或重发FIN-ACK
+    CONN_ACTION_FIN_ACK = 6,           // handle_fin_ack
+    CONN_ACTION_PARITY = 7             // handle_parity：用FEC校验帧还原丢失的数据帧
+} ConnectionAction;
+
+#define CONN_STATE_COUNT 10            // ConnectionState的取值个数
+#define CONN_FRAME_TYPE_COUNT 8        // FrameType的取值个数（SYN..PARITY）
+
+// ==================== 连接表 ====================
+
+/**
+ * 按对端地址（IP + 端口）索引的连接哈希表
+ * 
+ * 拉链法解决冲突，桶数为2的幂；连接数超过桶数时桶数翻倍
+ * 不加锁：多线程服务器中每个工作线程持有自己的连接表
+ */
+typedef struct {
+    Connection** buckets;              // 哈希桶数组
+    int bucket_count;                  // 桶数（2的幂）
+    int count;                         // 表中的连接数
+} ConnectionTable;
+
+/**
+ * 判断两个地址是否为同一对端（IP和端口都相同）
+ */
+static inline bool same_peer(const struct sockaddr_in* a, const struct sockaddr_in* b)
+{
+    return a->sin_addr.s_addr == b->sin_addr.s_addr && a->sin_port == b->sin_port;
+}
+
 // ==================== 连接管理函数 ====================
 
 /**
@@ -115,6 +215,25 @@ Connection* create_server_connection(int port);
  */
 Connection* create_client_connection(const char* server_ip, int port);
 
+/**
+ * 为服务器连接打开接收端：创建接收窗口和输出文件
+ * 
+ * @param conn 连接指针
+ * @param window_size 接收窗口大小（帧数），SYN中对端的窗口更大时会再扩大
+ * @param output_path 输出文件路径
+ * @param write_queue 共享写回线程（多客户端服务器的工作线程），NULL时输出文件使用自己的写回线程
+ * @return 成功返回true，失败返回false
+ */
+bool connection_open_receiver(Connection* conn, int window_size, const char* output_path,
+                              FileWriteQueue* write_queue);
+
+/**
+ * 关闭连接的接收端：关闭输出文件，释放接收窗口
+ * 
+ * @param conn 连接指针
+ */
+void connection_close_receiver(Connection* conn);
+
 /**
  * 服务器开始监听
  * 
@@ -139,6 +258,8 @@ bool client_connect(Connection* conn);
  * 处理接收到的SYN帧（三次握手第2步）
  * 
  * 服务器接收SYN，发送SYN-ACK，状态转为SYN_RECEIVED
+ * 在SYN_RECEIVED状态再次收到SYN（SYN-ACK丢失）时重发SYN-ACK
+ * 已打开接收端时协商CRC32C选项，并按对端窗口扩大接收窗口
  * 
  * @param conn 连接指针
  * @param frame 接收到的帧
@@ -169,6 +290,30 @@ bool handle_syn_ack(Connection* conn, const Frame* frame);
  */
 bool handle_ack(Connection* conn, const Frame* frame);
 
+/**
+ * 处理接收到的DATA帧（服务器接收端）
+ * 
+ * 数据缓冲到接收窗口，连续部分写入输出文件，然后回复累积ACK
+ * 在SYN_RECEIVED状态收到DATA说明握手的最后一个ACK丢失，视为连接建立
+ * 
+ * @param conn 连接指针（须已打开接收端）
+ * @param view 接收到的帧视图
+ * @return 成功处理返回true，否则返回false
+ */
+bool handle_data(Connection* conn, const FrameView* view);
+
+/**
+ * 处理接收到的PARITY帧（服务器接收端，握手协商了OPT_FEC）
+ * 
+ * 校验帧还原出组内丢失的一帧时，照常交付连续数据并回复累积ACK；
+ * 没有还原出帧时不回复
+ * 
+ * @param conn 连接指针（须已打开接收端）
+ * @param view 接收到的帧视图
+ * @return 成功处理返回true，否则返回false
+ */
+bool handle_parity(Connection* conn, const FrameView* view);
+
 /**
  * 发送FIN帧启动关闭过程（四次挥手第1步）
  * 
@@ -182,7 +327,9 @@ bool send_fin(Connection* conn);
 /**
  * 处理接收到的FIN帧（四次挥手）
  * 
- * 被动关闭连接，发送ACK，状态转为CLOSE_WAIT
+ * 被动关闭连接，回复FIN_ACK
+ * FIN_ACK同时确认对端的FIN并携带本端的FIN，状态经CLOSE_WAIT转为LAST_ACK；
+ * 在LAST_ACK状态再次收到FIN（FIN_ACK丢失）时重发FIN_ACK
  * 
  * @param conn 连接指针
  * @param frame 接收到的帧
@@ -211,6 +358,29 @@ bool handle_fin_ack(Connection* conn, const Frame* frame);
  */
 bool close_connection(Connection* conn);
 
+/**
+ * 查询状态机动作
+ * 
+ * @param state 连接状态
+ * @param frame_type 帧类型（越界时视为未知帧）
+ * @return 该状态下处理该帧的动作，未知状态或帧类型返回CONN_ACTION_DROP
+ */
+ConnectionAction connection_action(ConnectionState state, uint8_t frame_type);
+
+/**
+ * 按状态机表处理同一连接的一批帧
+ * 
+ * 按顺序逐帧查表并调用对应的处理函数，前一帧引起的状态变化对后一帧生效；
+ * 最后活动时间每批只更新一次
+ * 视图须已按连接的校验模式解析，且在本函数返回前有效（通常引用同一批接收缓冲区）
+ * 
+ * @param conn 连接指针
+ * @param views 帧视图数组
+ * @param count 帧数
+ * @return 被处理函数接受的帧数（丢弃和处理失败的帧不计）
+ */
+int connection_dispatch(Connection* conn, const FrameView* views, int count);
+
 /**
  * 更新连接状态
  * 
@@ -240,15 +410,25 @@ const char* connection_state_to_string(ConnectionState state);
 bool is_valid_state_transition(ConnectionState from_state, ConnectionState to_state);
 
 /**
- * 获取连接统计信息
+ * 获取连接统计快照
+ * 
+ * 不加锁，可以在其他线程中轮询正在传输的连接
  * 
  * @param conn 连接指针
- * @param sent 已发送字节数指针
- * @param received 已接收字节数指针
- * @param retransmits 重传次数指针
+ * @param stats 输出的统计快照
  * @return 成功返回true，失败返回false
  */
-bool connection_get_stats(const Connection* conn, uint32_t* sent, uint32_t* received, uint32_t* retransmits);
+bool connection_get_stats(const Connection* conn, ConnectionStats* stats);
+
+/**
+ * 把拥塞控制的当前值（cwnd、ssthresh、RTT、RTO）镜像到连接中，供统计快照读取
+ * 
+ * 发送端在处理完ACK或超时后调用
+ * 
+ * @param conn 连接指针
+ * @param cc 拥塞控制对象
+ */
+void connection_update_congestion(Connection* conn, const CongestionControl* cc);
 
 /**
  * 打印连接信息（调试用）
@@ -264,4 +444,49 @@ void connection_print(const Connection* conn);
  */
 void connection_free(Connection* conn);
 
+// ==================== 连接表函数 ====================
+
+/**
+ * 创建连接表
+ * 
+ * @param bucket_count 初始桶数（向上取整到2的幂）
+ * @return 返回分配的连接表指针，失败返回NULL
+ */
+ConnectionTable* create_connection_table(int bucket_count);
+
+/**
+ * 按对端地址查找连接
+ * 
+ * @param table 连接表指针
+ * @param addr 对端地址
+ * @return 找到返回连接指针，否则返回NULL
+ */
+Connection* connection_table_find(ConnectionTable* table, const struct sockaddr_in* addr);
+
+/**
+ * 插入连接（以conn->peer_addr为键，调用方保证键不重复）
+ * 
+ * @param table 连接表指针
+ * @param conn 连接指针
+ * @return 成功返回true，失败返回false
+ */
+bool connection_table_insert(ConnectionTable* table, Connection* conn);
+
+/**
+ * 从连接表中移除连接（不释放连接）
+ * 
+ * @param table 连接表指针
+ * @param conn 连接指针
+ * @return 找到并移除返回true，否则返回false
+ */
+bool connection_table_remove(ConnectionTable* table, Connection* conn);
+
+/**
+ * 释放连接表及表中所有连接
+ * 表中的连接共用工作线程的套接字，释放时不向任何对端发送帧
+ * 
+ * @param table 连接表指针
+ */
+void free_connection_table(ConnectionTable* table);
+
 #endif // CONNECTION_H
@@ -0,0 +1,178 @@
+#ifndef FILE_IO_H
+#define FILE_IO_H
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <pthread.h>
+
+// ==================== 异步文件I/O配置 ====================
+
+#define FILE_IO_BUFFER_SIZE (4 * 1024 * 1024)   // 单个I/O缓冲区大小（字节）
+#define FILE_IO_BUFFER_COUNT 3                   // 缓冲区个数（预读/写回的深度）
+#define FILE_IO_ALIGNMENT 4096                   // I/O缓冲区对齐（页大小）
+#define FILE_WRITER_INITIAL_CAPACITY (64 * 1024) // 写入器缓冲区首次分配的大小，之后按需翻倍
+
+// ==================== I/O缓冲区 ====================
+
+/**
+ * 读写线程与网络循环之间传递的一个大缓冲区
+ */
+typedef struct {
+    uint8_t* data;                     // 按页对齐的缓冲区
+    size_t len;                        // 有效字节数
+    size_t capacity;                   // 已分配的字节数（写入器的缓冲区按需增长）
+} IoBuffer;
+
+// ==================== 预读文件读取器 ====================
+
+/**
+ * 预读文件读取器
+ *
+ * 后台线程把文件按大块顺序读入环形排列的缓冲区，始终领先于发送窗口；
+ * 网络循环只从已读好的缓冲区复制数据，不直接调用fread。
+ * 只有预读落后（缓冲区全部读空）时读取才会等待
+ */
+typedef struct {
+    FILE* file;                        // 输入文件（无stdio缓冲，直接读入IoBuffer）
+    IoBuffer* buffers;                 // 环形缓冲区数组
+    int buffer_count;                  // 缓冲区个数
+    size_t buffer_size;                // 单个缓冲区大小
+    int head;                          // 网络循环正在读取的缓冲区
+    int filled;                        // 已读好、尚未用完的缓冲区数（含head）
+    size_t offset;                     // head缓冲区中的读取位置
+    bool eof;                          // 后台线程已读到文件末尾
+    bool error;                        // 读取出错
+    bool stop;                         // 请求后台线程退出
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    pthread_t thread;
+} FileReader;
+
+/**
+ * 打开文件并启动预读线程
+ * @param filename 文件名
+ * @param buffer_size 单个缓冲区大小
+ * @param buffer_count 缓冲区个数（至少2）
+ * @return 读取器指针，失败返回NULL
+ */
+FileReader* create_file_reader(const char* filename, size_t buffer_size, int buffer_count);
+
+/**
+ * 读取数据
+ * @param reader 读取器指针
+ * @param buffer 输出缓冲区
+ * @param length 最多读取的字节数
+ * @return 实际读取的字节数，文件结束返回0
+ */
+size_t file_reader_read(FileReader* reader, uint8_t* buffer, size_t length);
+
+/**
+ * 停止预读线程，关闭文件并释放读取器
+ * @param reader 读取器指针
+ * @return 读取过程中没有出错返回true
+ */
+bool close_file_reader(FileReader* reader);
+
+// ==================== 批量文件写入器 ====================
+
+struct FileWriteQueue;
+
+/**
+ * 批量文件写入器
+ *
+ * 网络循环把连续数据追加到当前缓冲区，缓冲区写满后交给后台线程一次写入，
+ * 每次系统调用写入数MB；只有所有缓冲区都在等待写盘时追加才会等待。
+ * 缓冲区在第一次使用时才分配，从FILE_WRITER_INITIAL_CAPACITY开始按需翻倍到buffer_size，
+ * 只有持续写入大量数据的连接才会占满
+ */
+typedef struct FileWriter {
+    FILE* file;                        // 输出文件（无stdio缓冲，IoBuffer直接写出）
+    IoBuffer* buffers;                 // 环形缓冲区数组
+    int buffer_count;                  // 缓冲区个数
+    size_t buffer_size;                // 单个缓冲区大小
+    int head;                          // 最早提交、等待写盘的缓冲区
+    int queued;                        // 已提交给后台线程的缓冲区数
+    int current;                       // 网络循环正在填充的缓冲区
+    uint64_t bytes_written;            // 已写入文件的字节数
+    bool error;                        // 写入出错
+    bool stop;                         // 请求后台线程退出
+    struct FileWriteQueue* queue;      // 共享写回线程，NULL表示使用自己的写回线程
+    struct FileWriter* next_pending;   // 共享写回线程队列中的下一个写入器
+    bool pending;                      // 在共享写回线程的队列中（或正在被写盘），由queue->lock保护
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    pthread_t thread;
+} FileWriter;
+
+/**
+ * 共享写回线程
+ *
+ * 多个写入器把提交的缓冲区交给同一个后台线程，由它轮流为各写入器写出一个缓冲区；
+ * 多客户端服务器的每个工作线程只需要一个写回线程，连接数不影响线程数
+ */
+typedef struct FileWriteQueue {
+    FileWriter* head;                  // 有缓冲区等待写盘的写入器（按排队顺序）
+    FileWriter* tail;
+    bool stop;                         // 请求后台线程退出
+    pthread_mutex_t lock;
+    pthread_cond_t cond;               // 有写入器排队，或有写入器离开队列
+    pthread_t thread;
+} FileWriteQueue;
+
+/**
+ * 启动共享写回线程
+ * @return 队列指针，失败返回NULL
+ */
+FileWriteQueue* create_file_write_queue(void);
+
+/**
+ * 停止共享写回线程并释放队列（调用前必须已关闭所有使用它的写入器）
+ * @param queue 队列指针
+ */
+void free_file_write_queue(FileWriteQueue* queue);
+
+/**
+ * 创建文件并启动写回线程
+ * @param filename 文件名
+ * @param buffer_size 单个缓冲区大小
+ * @param buffer_count 缓冲区个数（至少2）
+ * @param queue 共享写回线程，NULL时为该写入器启动自己的写回线程
+ * @return 写入器指针，失败返回NULL
+ */
+FileWriter* create_file_writer(const char* filename, size_t buffer_size, int buffer_count,
+                               FileWriteQueue* queue);
+
+/**
+ * 在当前缓冲区中预留length字节，供调用方直接写入数据（如get_contiguous_data）
+ * 当前缓冲区剩余空间不足时先把它提交给写回线程
+ * @param writer 写入器指针
+ * @param length 预留的字节数（不超过buffer_size）
+ * @return 预留空间的起始地址，失败返回NULL
+ */
+uint8_t* file_writer_reserve(FileWriter* writer, size_t length);
+
+/**
+ * 提交file_writer_reserve预留空间中实际写入的字节数
+ * @param writer 写入器指针
+ * @param length 实际写入的字节数（不超过预留的大小）
+ */
+void file_writer_commit(FileWriter* writer, size_t length);
+
+/**
+ * 追加数据（复制到当前缓冲区）
+ * @param writer 写入器指针
+ * @param data 数据指针
+ * @param length 数据长度
+ * @return 成功返回true，失败返回false
+ */
+bool file_writer_write(FileWriter* writer, const uint8_t* data, size_t length);
+
+/**
+ * 写出剩余数据，停止写回线程，关闭文件并释放写入器
+ * @param writer 写入器指针
+ * @return 所有数据都成功写入返回true
+ */
+bool close_file_writer(FileWriter* writer);
+
+#endif // FILE_IO_H
@@ -0,0 +1,114 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <cstdint>
+#include <cstddef>
+#include "reliable_transport.h"
+
+// ==================== 异步日志配置 ====================
+
+#define LOG_LEVEL_DEBUG (-1)             // 日志级别：调试（各模块的LOG_DEBUG）
+#define LOG_LEVEL_INFO 0                 // 日志级别：信息
+#define LOG_LEVEL_WARNING 1              // 日志级别：警告
+#define LOG_LEVEL_ERROR 2                // 日志级别：错误
+#define LOG_LEVEL_NONE 3                 // 关闭所有日志
+
+#define LOG_RECORD_SIZE 256              // 单条日志记录大小（字节，含头部）
+#define LOG_MAX_ARGS 8                   // 单条记录最多捕获的参数个数，更多时在调用线程格式化
+#define LOG_LINE_MAX 1024                // 后台线程格式化出的单行最大长度（过长时截断）
+#define LOG_RING_CAPACITY 4096           // 每个线程的环形缓冲区容量（记录数，2的幂）
+// 最多登记的生产者线程数：主线程 + 多客户端服务器的每个工作线程，另留一个余量；
+// 超出后该线程同步写日志
+#define LOG_MAX_RINGS (MAX_SERVER_WORKERS + 2)
+#define LOG_FLUSH_INTERVAL_MS 10         // 后台线程空闲时的最长刷新间隔（毫秒）
+#define LOG_LEVEL_ENV "RT_LOG_LEVEL"     // 通过环境变量设置初始日志级别（-1到3）
+
+// ==================== 日志记录和环形缓冲区 ====================
+
+/**
+ * 日志参数：按格式串中的转换符从可变参数中取出，整数统一扩展为64位
+ */
+typedef union {
+    long long i;                         // %d %i（按长度修饰符符号扩展）、%c
+    unsigned long long u;                // %u %x %X %o；%s时为字符串副本在text中的偏移
+    double d;                            // %f %e %g %a
+    const void* p;                       // %p
+} LogArg;
+
+/**
+ * 定长日志记录
+ *
+ * 生产者只按格式串把参数原样取出放进记录：数值直接保存，%s的字符串复制到text
+ * （调用返回后原字符串可能失效），不做数字到文本的转换；后台线程再按格式串格式化、
+ * 加级别前缀并批量写出。格式串中有不支持的转换（如*宽度）或参数过多时，
+ * 退回在调用线程内用vsnprintf把消息格式化到text，format置为NULL
+ */
+typedef struct {
+    const char* format;                  // 格式串（字符串字面量，只保存指针）；NULL表示text是格式化好的消息
+    int8_t level;                        // 日志级别
+    uint8_t argc;                        // 捕获的参数个数
+    uint16_t text_len;                   // text中的有效字节数
+    LogArg args[LOG_MAX_ARGS];           // 捕获的参数
+    char text[LOG_RECORD_SIZE - 16 - LOG_MAX_ARGS * 8];   // %s参数的副本（各以'\0'结尾，过长时截断）
+} LogRecord;
+
+/**
+ * 单生产者单消费者（SPSC）环形缓冲区
+ * 每个生产者线程独占一个：生产者只写tail，后台线程只写head，
+ * 两端都不需要加锁；head/tail单调递增，槽位为 index % LOG_RING_CAPACITY
+ */
+typedef struct {
+    LogRecord* records;                  // 记录数组（LOG_RING_CAPACITY项）
+    uint32_t head;                       // 下一条待写出的记录（后台线程写）
+    uint32_t tail;                       // 下一条空闲的槽位（生产者写）
+    uint64_t dropped;                    // 缓冲区满时丢弃的记录数
+} LogRing;
+
+// ==================== 日志函数 ====================
+
+/**
+ * 日志输出函数
+ *
+ * 低于当前级别的日志直接返回；异步模式下只把格式串指针和参数写入本线程的环形缓冲区，
+ * 格式化由后台线程完成，调用线程不做系统调用；缓冲区满时丢弃并计数
+ *
+ * @param level 日志级别（-1=DEBUG, 0=INFO, 1=WARNING, 2=ERROR）
+ * @param format 格式字符串（必须是字符串字面量，后台线程格式化时才读取）
+ * @param ... 可变参数
+ */
+void log_message(int level, const char* format, ...);
+
+/**
+ * 初始化日志系统并启动后台写日志线程
+ * 初始日志级别取自环境变量RT_LOG_LEVEL（未设置时为DEBUG，即全部输出）
+ * 后台线程启动失败时退回同步写日志
+ * @param filename 日志文件名（NULL表示输出到标准输出）
+ * @return 成功返回0，失败返回-1
+ */
+int log_init(const char* filename);
+
+/**
+ * 关闭日志系统：写出缓冲区中剩余的日志，停止后台线程，关闭日志文件
+ * 之后的日志同步写出
+ */
+void log_cleanup();
+
+/**
+ * 设置运行时日志级别
+ * @param level 最低输出级别（LOG_LEVEL_DEBUG .. LOG_LEVEL_NONE）
+ */
+void log_set_level(int level);
+
+/**
+ * 获取当前日志级别
+ * @return 最低输出级别
+ */
+int log_get_level();
+
+/**
+ * 获取因环形缓冲区已满而丢弃的日志条数（所有线程合计）
+ * @return 丢弃的条数
+ */
+uint64_t log_get_dropped();
+
+#endif // LOGGER_H
@@ -17,6 +17,8 @@
  * - FIN: 结束帧，请求关闭连接
  * - FIN_ACK: 结束确认帧，响应FIN请求
  * - DATA: 数据帧，传输实际数据
+ * - NACK: 否定确认帧，接收端发现序列号空洞时立即发送，请求重传缺失的帧
+ * - PARITY: FEC校验帧，每K个DATA帧之后发送一个，接收端用它恢复组内丢失的一帧
  */
 typedef enum {
     SYN = 0,           // 同步帧
@@ -24,7 +26,9 @@ typedef enum {
     ACK = 2,           // 确认帧
     FIN = 3,           // 结束帧
     FIN_ACK = 4,       // 结束-确认帧
-    DATA = 5           // 数据帧
+    DATA = 5,          // 数据帧
+    NACK = 6,          // 否定确认帧
+    PARITY = 7         // FEC校验帧
 } FrameType;
 
 // ==================== 帧结构定义 ====================
@@ -38,7 +42,9 @@ typedef enum {
  * 
  * 数据部分（可变长度，最大MAX_DATA_LENGTH字节）
  * 
- * 总大小：帧头部(14字节) + 数据长度，不超过MAX_PACKET_SIZE
+ * 帧尾（可选，4字节）：协商为CHECKSUM_CRC32C后附加的CRC32C
+ * 
+ * 总大小：帧头部(14字节) + 数据长度 + 帧尾，不超过MAX_PACKET_SIZE
  */
 typedef struct {
     // === 帧头部（14字节）===
@@ -56,7 +62,185 @@ typedef struct {
 // ==================== 帧头部常量 ====================
 
 #define FRAME_HEADER_SIZE 14           // 帧头部大小（字节）
-#define FRAME_MAX_SIZE (FRAME_HEADER_SIZE + MAX_DATA_LENGTH)  // 帧的最大大小
+#define FRAME_TRAILER_SIZE 4           // CRC32C帧尾大小（字节）
+#define FRAME_MAX_SIZE (FRAME_HEADER_SIZE + MAX_DATA_LENGTH + FRAME_TRAILER_SIZE)  // 帧的最大大小
+
+// ==================== 序列号运算 ====================
+
+/**
+ * 32位序列号的模运算比较（RFC 1982串行数算术）
+ *
+ * 初始序列号随机，长时间传输必然越过2^32回绕，序列号之间不能直接用 < 和 > 比较。
+ * 两个序列号相差不到2^31时，按差值的符号判断先后，回绕前后结果一致
+ * （窗口和在途数据远小于2^31帧）
+ */
+
+/**
+ * 序列号之差 a - b（有符号）
+ * @return a在b之后为正，之前为负，相等为0
+ */
+static inline int32_t seq_diff(uint32_t a, uint32_t b)
+{
+    return (int32_t)(a - b);
+}
+
+static inline bool seq_lt(uint32_t a, uint32_t b)  { return seq_diff(a, b) < 0; }   // a在b之前
+static inline bool seq_leq(uint32_t a, uint32_t b) { return seq_diff(a, b) <= 0; }  // a不在b之后
+static inline bool seq_gt(uint32_t a, uint32_t b)  { return seq_diff(a, b) > 0; }   // a在b之后
+static inline bool seq_geq(uint32_t a, uint32_t b) { return seq_diff(a, b) >= 0; }  // a不在b之前
+
+// ==================== 校验模式 ====================
+
+/**
+ * 帧校验模式（握手时协商）
+ * - CHECKSUM_LEGACY: 只有帧头中1字节的checksum字段，不附加帧尾
+ * - CHECKSUM_CRC32C: 数据之后附加4字节CRC32C帧尾（网络字节序），
+ *   覆盖帧头（checksum字段按0计算）和数据；校验失败的帧被丢弃
+ * 
+ * SYN和SYN_ACK用于协商，无论哪种模式都不带帧尾
+ */
+typedef enum {
+    CHECKSUM_LEGACY = 0,
+    CHECKSUM_CRC32C = 1
+} ChecksumMode;
+
+// ==================== 握手选项 ====================
+
+/**
+ * SYN/SYN_ACK的数据部分携带TLV格式的选项：
+ *   类型(1字节) | 长度(1字节) | 值(长度字节)
+ * 对端不认识的选项直接跳过；SYN_ACK只回显本端同意启用的选项
+ */
+#define OPT_CRC32C 1                   // 启用CRC32C帧尾（无值）
+#define OPT_WSCALE 2                   // 窗口缩放（值为1字节移位数）
+#define OPT_SACK 3                     // 选择确认：ACK/NACK携带乱序接收位图（无值）
+#define OPT_FEC 4                      // 前向纠错（值为1字节分组大小K）
+
+// ==================== 窗口缩放 ====================
+
+/**
+ * 窗口缩放（参照RFC 7323）
+ *
+ * window_size字段只有16位，按字节通告时上限不到64 KB。双方在SYN/SYN_ACK中
+ * 各自携带OPT_WSCALE，值为本端通告窗口时右移的位数；只有SYN中带了该选项，
+ * SYN_ACK才回显，双方都带时才启用，否则两个方向的移位数都为0。
+ * SYN和SYN_ACK本身的window_size字段不缩放
+ */
+#define MAX_WSCALE 14                  // 移位数上限（与TCP一致）
+
+/**
+ * 计算能完整通告max_bytes所需的最小移位数
+ * @param max_bytes 本端可能通告的最大接收窗口（字节）
+ * @return 移位数（0-MAX_WSCALE）
+ */
+static inline uint8_t window_scale_for(uint32_t max_bytes)
+{
+    uint8_t shift = 0;
+    while (shift < MAX_WSCALE && (max_bytes >> shift) > 0xFFFF) {
+        shift++;
+    }
+    return shift;
+}
+
+/**
+ * 把可用接收缓冲（字节）编码为window_size字段
+ * 向上取整：空闲空间总是整帧，向下取整会让最后一帧看起来放不下
+ */
+static inline uint16_t window_encode(uint32_t bytes, uint8_t shift)
+{
+    uint64_t field = ((uint64_t)bytes + ((1u << shift) - 1)) >> shift;
+    return (field > 0xFFFF) ? 0xFFFF : (uint16_t)field;
+}
+
+/**
+ * 把对端通告的window_size字段解码为字节数
+ */
+static inline uint32_t window_decode(uint16_t field, uint8_t shift)
+{
+    return (uint32_t)field << shift;
+}
+
+// ==================== 选择确认 ====================
+
+/**
+ * 选择确认位图（协商了OPT_SACK时，放在ACK和NACK的数据部分）
+ *
+ * 第i位（字节i/8中的第i%8位，低位在前）表示序列号 ack_num + 1 + i 的帧
+ * 已被接收端缓冲；ack_num本身总是缺失的，不占位。位图长度只到最后一个
+ * 置位所在的字节，没有乱序缓冲的帧时为空
+ *
+ * ACK中的位图只供发送端标记已到达的帧（不再超时重传）；
+ * NACK表示接收端刚发现空洞，发送端立即重传位图中缺失的帧
+ */
+#define SACK_MAX_BYTES (MAX_WINDOW_FRAMES / 8)   // 位图的最大长度（字节）
+
+/**
+ * 检查位图中序列号seq对应的位
+ * @param bitmap 位图
+ * @param len 位图长度（字节）
+ * @param ack_num 位图所属帧的确认号
+ * @param seq 要检查的序列号
+ * @return 该帧已被接收端缓冲返回true
+ */
+static inline bool sack_test(const uint8_t* bitmap, uint16_t len, uint32_t ack_num, uint32_t seq)
+{
+    int32_t bit = seq_diff(seq, ack_num) - 1;
+    if (bit < 0 || bit >= (int32_t)len * 8) {
+        return false;
+    }
+    return (bitmap[bit >> 3] >> (bit & 7)) & 1;
+}
+
+// ==================== 前向纠错 ====================
+
+/**
+ * XOR校验（客户端-fec K开启，SYN/SYN_ACK协商OPT_FEC）
+ *
+ * DATA帧从第一帧（客户端ISN + 1）起每K帧分为一组，每组发完后发送一个PARITY帧：
+ *   seq_num     = 组内第一帧的序列号
+ *   ack_num     = 组内的帧数（最后一组可能不足K帧）
+ *   window_size = 组内各帧data_len的异或
+ *   数据        = 组内各帧数据（不足最长帧的部分补0）的异或，长度为最长帧的长度
+ * 组内只丢一帧时，接收端用校验帧与其余各帧异或即可还原它，不需要等待重传。
+ * 校验帧不占序列号、不进发送窗口，丢失后也不重传
+ */
+#define FEC_MAX_GROUP 64               // 分组大小K的上限
+
+/**
+ * 按字节异或：dst[i] ^= src[i]
+ * 按8字节分块处理，编译器可以向量化
+ */
+static inline void fec_xor(uint8_t* dst, const uint8_t* src, size_t len)
+{
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t a, b;
+        memcpy(&a, dst + i, 8);
+        memcpy(&b, src + i, 8);
+        a ^= b;
+        memcpy(dst + i, &a, 8);
+    }
+    for (; i < len; i++) {
+        dst[i] ^= src[i];
+    }
+}
+
+// ==================== 帧视图定义 ====================
+
+/**
+ * 帧视图：直接引用接收缓冲区中的一帧
+ * 帧头字段解码到结构体中，数据部分不复制，payload指向缓冲区内部，
+ * 因此视图只在接收缓冲区被下一次接收覆盖之前有效
+ */
+typedef struct {
+    uint32_t seq_num;                  // 序列号
+    uint32_t ack_num;                  // 确认号
+    uint16_t window_size;              // 窗口大小
+    uint8_t frame_type;                // 帧类型
+    uint16_t data_len;                 // 数据长度
+    uint8_t checksum;                  // 1字节校验和字段
+    const uint8_t* payload;            // 数据部分（指向接收缓冲区）
+} FrameView;
 
 // ==================== 帧处理函数 ====================
 
@@ -75,13 +259,15 @@ Frame create_frame(uint32_t seq_num, uint32_t ack_num, uint16_t window_size,
 
 /**
  * 将帧序列化为网络字节序的字节缓冲区
- * 将Frame结构体转换为可传输的字节流，包含字节序转换
+ * 将Frame结构体转换为可传输的字节流，数据部分复制一次
  * @param frame 帧指针
  * @param buffer 输出缓冲区
  * @param buf_size 缓冲区大小
+ * @param mode 校验模式，CHECKSUM_CRC32C时追加CRC32C帧尾
  * @return 成功返回序列化的字节数，失败返回-1
  */
-int frame_serialize(const Frame* frame, uint8_t* buffer, size_t buf_size);
+int frame_serialize(const Frame* frame, uint8_t* buffer, size_t buf_size,
+                    ChecksumMode mode = CHECKSUM_LEGACY);
 
 /**
  * 将字节缓冲区反序列化为帧结构
@@ -89,9 +275,76 @@ int frame_serialize(const Frame* frame, uint8_t* buffer, size_t buf_size);
  * @param buffer 输入缓冲区
  * @param buf_size 缓冲区大小
  * @param frame 输出帧结构指针
- * @return 成功返回0，失败返回-1
+ * @param mode 校验模式，CHECKSUM_CRC32C时要求并验证CRC32C帧尾
+ * @return 成功返回0，格式错误返回-1，CRC32C校验失败返回-2
+ */
+int frame_deserialize(const uint8_t* buffer, size_t buf_size, Frame* frame,
+                      ChecksumMode mode = CHECKSUM_LEGACY);
+
+/**
+ * 在预分配的I/O缓冲区中原地构建帧
+ * 调用方先把数据写到 buffer + FRAME_HEADER_SIZE 处，这里在数据前写入帧头，
+ * 并按需在数据后追加CRC32C帧尾，数据本身不再移动
+ * @param buffer I/O缓冲区（数据已位于FRAME_HEADER_SIZE偏移处）
+ * @param buf_size 缓冲区大小
+ * @param seq_num 序列号
+ * @param ack_num 确认号
+ * @param window_size 窗口大小
+ * @param frame_type 帧类型
+ * @param data_len 数据长度
+ * @param mode 校验模式，CHECKSUM_CRC32C时追加CRC32C帧尾
+ * @return 成功返回帧的总字节数（可直接发送），失败返回-1
+ */
+int frame_build_in_place(uint8_t* buffer, size_t buf_size, uint32_t seq_num, uint32_t ack_num,
+                         uint16_t window_size, FrameType frame_type, uint16_t data_len,
+                         ChecksumMode mode = CHECKSUM_LEGACY);
+
+/**
+ * 在接收缓冲区上解析帧视图（不复制数据部分）
+ * @param view 输出帧视图
+ * @param buffer 接收缓冲区
+ * @param buf_size 接收到的字节数
+ * @param mode 校验模式，CHECKSUM_CRC32C时要求并验证CRC32C帧尾
+ * @return 成功返回0，格式错误返回-1，CRC32C校验失败返回-2
+ */
+int frame_view_parse(FrameView* view, const uint8_t* buffer, size_t buf_size,
+                     ChecksumMode mode = CHECKSUM_LEGACY);
+
+/**
+ * 将帧视图复制为独立的Frame（复制数据部分）
+ * 用于需要在接收缓冲区被覆盖后继续持有帧的场合，如按Frame处理的控制帧
+ * @param view 帧视图指针
+ * @param frame 输出帧指针
+ */
+void frame_view_to_frame(const FrameView* view, Frame* frame);
+
+/**
+ * 向帧的数据部分追加一个握手选项（TLV）
+ * @param frame 帧指针（SYN或SYN_ACK）
+ * @param type 选项类型
+ * @param value 选项值（可为NULL）
+ * @param len 选项值长度
+ * @return 成功返回true，空间不足返回false
+ */
+bool frame_add_option(Frame* frame, uint8_t type, const uint8_t* value, uint8_t len);
+
+/**
+ * 在帧的数据部分查找握手选项
+ * @param frame 帧指针
+ * @param type 选项类型
+ * @param len 输出选项值长度（可为NULL）
+ * @return 找到返回选项值的指针（无值时指向选项末尾），未找到返回NULL
+ */
+const uint8_t* frame_find_option(const Frame* frame, uint8_t type, uint8_t* len);
+
+/**
+ * 在帧视图的数据部分查找握手选项
+ * @param view 帧视图指针
+ * @param type 选项类型
+ * @param len 输出选项值长度（可为NULL）
+ * @return 找到返回选项值的指针（指向接收缓冲区），未找到返回NULL
  */
-int frame_deserialize(const uint8_t* buffer, size_t buf_size, Frame* frame);
+const uint8_t* frame_view_find_option(const FrameView* view, uint8_t type, uint8_t* len);
 
 /**
  * 计算帧的校验和
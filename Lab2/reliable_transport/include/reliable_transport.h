@@ -10,13 +10,19 @@
 #define WINDOW_SIZE 8                  // 最大窗口大小
 #define MAX_PACKET_SIZE 1024           // 最大数据包大小（字节）
 #define MAX_DATA_LENGTH 1000           // 数据包中数据部分的最大长度（字节）
+#define MAX_WINDOW_FRAMES 1024         // 窗口大小上限（与-w参数的取值范围一致）
 
 // 超时和重传配置
-#define TIMEOUT_MS 1000                // 超时时间（毫秒）
+#define TIMEOUT_MS 1000                // 超时时间（毫秒），也是首次RTT采样前的初始RTO
+#define MIN_RTO_MS 50                  // RTO下限（毫秒），局域网上允许亚秒级重传
+#define MAX_RTO_MS 60000               // RTO上限（毫秒），指数退避不超过该值
 #define MAX_RETRIES 5                  // 最大重传次数
+#define MAX_RETRIES_LIMIT 20           // -retries允许的上限（RTO按2倍退避，再大没有意义）
 
 // 网络配置
 #define DEFAULT_PORT 8888              // 默认端口号
+#define MAX_SERVER_WORKERS 64          // 多客户端服务器的工作线程数上限
+#define SOCKET_BUFFER_SIZE (2 * MAX_WINDOW_FRAMES * MAX_PACKET_SIZE)  // 套接字收发缓冲区，容纳最大窗口的突发
 
 // ==================== 全局函数声明 ====================
 
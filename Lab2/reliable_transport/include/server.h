@@ -0,0 +1,33 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <cstdint>
+#include "reliable_transport.h"
+
+// ==================== 服务器配置 ====================
+
+#define SERVER_RX_BATCH 64              // 每次唤醒最多连续接收的数据报数（按连接分批交给状态机）
+
+// ==================== 多客户端服务器 ====================
+
+/**
+ * 多客户端并发服务器
+ *
+ * 每个工作线程创建自己的UDP套接字，以SO_REUSEPORT绑定同一端口，
+ * 内核按四元组把同一客户端的数据报始终分发到同一个套接字。
+ * 工作线程内部按对端地址把数据报分派到各自的Connection（连接表），
+ * 同一对端连续到达的数据报作为一批交给connection_dispatch，按状态机表处理。
+ * 连接只属于一个线程，连接表和连接状态都不需要加锁。
+ *
+ * 每个连接的数据写入 "<output_prefix>.<客户端IP>_<客户端端口>"。
+ * 服务器持续运行，收到SIGINT/SIGTERM后退出。
+ *
+ * @param port 监听端口
+ * @param output_prefix 输出文件名前缀
+ * @param window_size 每个连接的初始接收窗口大小（帧数）
+ * @param workers 工作线程数（不支持SO_REUSEPORT的平台上固定为1）
+ * @return 正常退出返回0，失败返回-1
+ */
+int multi_server_main(int port, const char* output_prefix, int window_size, int workers);
+
+#endif // SERVER_H
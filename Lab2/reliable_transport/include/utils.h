@@ -22,6 +22,7 @@
 
 // Include packet.h for Frame definition (needed by send/receive functions)
 #include "packet.h"
+#include "logger.h"
 
 /**
  * 获取当前时间戳（毫秒）
@@ -37,6 +38,13 @@ uint64_t get_timestamp_ms();
  */
 uint64_t get_time_diff_ms(uint64_t end_time, uint64_t start_time);
 
+/**
+ * 获取单调时钟时间（微秒）
+ * 不受系统时间调整影响，用于RTT测量和重传定时
+ * @return 单调递增的时间戳（起点不确定，只用于求差）
+ */
+uint64_t get_monotonic_time_us();
+
 
 /**
  * 打印缓冲区内容（十六进制，调试用）
@@ -54,26 +62,6 @@ void print_buffer_hex(const uint8_t* buffer, size_t len, const char* label);
  */
 void print_buffer_ascii(const uint8_t* buffer, size_t len, const char* label);
 
-/**
- * 日志输出函数
- * @param level 日志级别（0=INFO, 1=WARNING, 2=ERROR）
- * @param format 格式字符串
- * @param ... 可变参数
- */
-void log_message(int level, const char* format, ...);
-
-/**
- * 初始化日志系统
- * @param filename 日志文件名（NULL表示输出到标准输出）
- * @return 成功返回0，失败返回-1
- */
-int log_init(const char* filename);
-
-/**
- * 关闭日志系统
- */
-void log_cleanup();
-
 /**
  * 生成随机序列号
  * @return 随机的32位序列号
@@ -124,23 +112,68 @@ int create_udp_socket();
  */
 bool bind_socket(int sockfd, int port);
 
+/**
+ * 允许多个套接字绑定同一端口（SO_REUSEPORT），内核按四元组把数据报分发到各套接字
+ * 必须在bind之前调用；平台不支持时返回false
+ * @param sockfd 套接字文件描述符
+ * @return 成功返回true，失败返回false
+ */
+bool set_socket_reuseport(int sockfd);
+
+/**
+ * 设置套接字的内核收发缓冲区大小（SO_RCVBUF/SO_SNDBUF）
+ * 通告的接收窗口超过默认缓冲区时，一个窗口的突发会在内核中溢出而被静默丢弃；
+ * 实际大小受系统上限（如net.core.rmem_max）约束，设置失败不影响正确性
+ * @param sockfd 套接字文件描述符
+ * @param bytes 期望的缓冲区大小（字节）
+ * @return 成功返回true，失败返回false
+ */
+bool set_socket_buffers(int sockfd, int bytes);
+
 /**
  * 向指定地址发送数据包
  * @param sockfd 套接字文件描述符
  * @param addr 目标地址
  * @param frame 要发送的Frame指针
+ * @param mode 校验模式（握手协商的结果）
  * @return 发送的字节数，失败返回-1
  */
-ssize_t send_packet(int sockfd, const struct sockaddr_in* addr, const Frame* frame);
+ssize_t send_packet(int sockfd, const struct sockaddr_in* addr, const Frame* frame,
+                    ChecksumMode mode = CHECKSUM_LEGACY);
 
 /**
  * 从套接字接收数据包
  * @param sockfd 套接字文件描述符
  * @param addr 发送方地址（输出）
  * @param frame 接收的Frame指针（输出）
+ * @param mode 校验模式（握手协商的结果），校验失败的帧被丢弃
  * @return 接收的字节数，失败返回-1
  */
-ssize_t receive_packet(int sockfd, struct sockaddr_in* addr, Frame* frame);
+ssize_t receive_packet(int sockfd, struct sockaddr_in* addr, Frame* frame,
+                       ChecksumMode mode = CHECKSUM_LEGACY);
+
+/**
+ * 发送已在I/O缓冲区中构建好的帧（见frame_build_in_place），不再序列化
+ * @param sockfd 套接字文件描述符
+ * @param addr 目标地址
+ * @param wire 帧字节流
+ * @param wire_len 帧长度
+ * @return 发送的字节数，失败返回-1
+ */
+ssize_t send_wire_packet(int sockfd, const struct sockaddr_in* addr, const uint8_t* wire, size_t wire_len);
+
+/**
+ * 接收数据包到调用方的I/O缓冲区，并在其上解析帧视图（数据部分不复制）
+ * @param sockfd 套接字文件描述符
+ * @param addr 发送方地址（输出）
+ * @param buffer 接收缓冲区（至少MAX_PACKET_SIZE字节），视图引用其中的数据
+ * @param buf_size 缓冲区大小
+ * @param view 帧视图（输出）
+ * @param mode 校验模式（握手协商的结果），校验失败的帧被丢弃
+ * @return 接收的字节数，失败返回-1
+ */
+ssize_t receive_packet_view(int sockfd, struct sockaddr_in* addr, uint8_t* buffer, size_t buf_size,
+                            FrameView* view, ChecksumMode mode = CHECKSUM_LEGACY);
 
 /**
  * 设置套接字超时
@@ -150,6 +183,53 @@ ssize_t receive_packet(int sockfd, struct sockaddr_in* addr, Frame* frame);
  */
 bool set_socket_timeout(int sockfd, int timeout_ms);
 
+/**
+ * 将套接字设为非阻塞模式
+ * 配合事件循环使用：被唤醒后即使数据报已被内核丢弃，接收也不会阻塞
+ * @param sockfd 套接字文件描述符
+ * @return 成功返回true，失败返回false
+ */
+bool set_socket_nonblocking(int sockfd);
+
+// ==================== 事件循环 ====================
+
+/**
+ * 单套接字事件循环
+ * 
+ * 阻塞等待套接字可读或截止时间到达，取代“接收超时 + sleep_ms”的轮询：
+ * 数据报到达立即唤醒，空闲时不产生多余的唤醒
+ * Linux上使用epoll，其他POSIX平台使用poll，Windows使用select
+ */
+typedef struct {
+    int sockfd;                        // 监听的套接字
+    int epoll_fd;                      // epoll实例（仅Linux，其他平台为-1）
+} EventLoop;
+
+#define EVENT_READABLE 1               // 套接字可读
+#define EVENT_TIMEOUT 0                // 截止时间已到
+#define EVENT_ERROR -1                 // 等待出错
+
+/**
+ * 创建事件循环
+ * @param sockfd 要监听的套接字（建议先调用set_socket_nonblocking）
+ * @return 事件循环指针，失败返回NULL
+ */
+EventLoop* create_event_loop(int sockfd);
+
+/**
+ * 等待套接字可读或截止时间到达
+ * @param loop 事件循环指针
+ * @param deadline_us 截止时间（get_monotonic_time_us()的时间轴，微秒），0表示无限等待
+ * @return EVENT_READABLE、EVENT_TIMEOUT或EVENT_ERROR
+ */
+int event_loop_wait(EventLoop* loop, uint64_t deadline_us);
+
+/**
+ * 释放事件循环（不关闭套接字）
+ * @param loop 事件循环指针
+ */
+void free_event_loop(EventLoop* loop);
+
 // ==================== 文件操作函数 ====================
 
 /**
@@ -187,15 +267,15 @@ size_t write_file_chunk(FILE* file, const char* buffer, size_t length);
 // ==================== 统计和日志函数（扩展） ====================
 
 /**
- * 打印传输统计信息
+ * 打印传输统计信息（附带本进程的CPU时间和峰值内存）
  * @param filename 输出文件名（如果为NULL则输出到stdout）
  * @param total_bytes 传输总字节数
  * @param total_time_ms 传输总耗时（毫秒）
  * @param total_packets 总包数
  * @param retransmitted_packets 重传包数
  */
-void print_statistics(const char* filename, size_t total_bytes, 
-                      long total_time_ms, int total_packets, int retransmitted_packets);
+void print_statistics(const char* filename, uint64_t total_bytes, 
+                      long total_time_ms, uint64_t total_packets, uint64_t retransmitted_packets);
 
 // ==================== 命令行参数解析 ====================
 
@@ -209,10 +289,14 @@ void print_statistics(const char* filename, size_t total_bytes,
  * @param input_file 输入文件名（输出）
  * @param output_file 输出文件名（输出）
  * @param window_size 窗口大小（输出）
+ * @param workers 多客户端服务器的工作线程数（输出），0表示单连接模式
+ * @param fec_group FEC分组大小（输出），0表示不发送校验帧
+ * @param max_retries 同一个包允许的超时重传次数（输出），默认MAX_RETRIES
  * @return 解析成功返回true，失败返回false
  */
 bool parse_command_line(int argc, char* argv[], 
                        bool& is_server, char* server_ip, int& port, 
-                       char* input_file, char* output_file, int& window_size);
+                       char* input_file, char* output_file, int& window_size,
+                       int& workers, int& fec_group, int& max_retries);
 
 #endif // UTILS_H
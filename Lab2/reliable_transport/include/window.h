@@ -2,7 +2,6 @@
 #define WINDOW_H
 
 #include <cstdint>
-#include <ctime>
 #include <cstdbool>
 #include "reliable_transport.h"
 #include "packet.h"
@@ -14,16 +13,42 @@
  * 
  * 用于跟踪已发送但尚未被确认的数据包
  * 包含重传信息和超时管理
+ * 
+ * 数据包以发送时的字节流形式保存（帧头 + 数据 + 可选帧尾），
+ * 首次发送和重传都直接发送wire，不再重复序列化
  */
 typedef struct {
-    Frame frame;                       // 数据包内容
-    time_t send_time;                  // 发送时间戳（秒）
-    int retry_count;                   // 重传次数（初始为0）
+    uint8_t wire[FRAME_MAX_SIZE];      // 序列化后的帧（发送缓冲区）
+    int wire_len;                      // 帧的总字节数
+    uint16_t data_len;                 // 帧的数据字节数（计入在途字节数）
+    uint64_t send_time;                // 发送时间戳（单调时钟，微秒）
+    int retry_count;                   // 重传次数（初始为0，包括NACK/快速重传）
+    int timeout_count;                 // 重传定时器到期次数，只有它计入重传上限
     bool is_retransmitted;             // 是否为重传数据包
+    bool timed_out;                    // 已超时、等待调用方重传
+    bool sacked;                       // 已被接收端选择确认（缓冲在对端），不再超时重传
     uint32_t seq_num;                  // 序列号（便于查找）
     bool is_valid;                     // 该槽位是否有效
 } UnackedPacket;
 
+// ==================== 发送定时器结构 ====================
+
+/**
+ * 发送定时器队列中的一项
+ * 
+ * 每次发送/重传都在队尾追加一项；发送时间单调不减，
+ * 因此队首总是最早到期的定时器。包被确认或重传后，旧的项不删除，
+ * 在到达队首时按send_time比对后丢弃（惰性删除）
+ * 
+ * 到期时刻为 max(send_time, SendWindow::timer_restart) + RTO：
+ * 每次确认新数据都重新计时（RFC 6298 5.3），累积ACK停滞期间
+ * （如快速恢复中等待重传的空洞）已到达对端的后续包不会被误判超时
+ */
+typedef struct {
+    uint32_t seq_num;                  // 对应的序列号
+    uint64_t send_time;                // 入队时该包的发送时间（微秒）
+} SendTimer;
+
 // ==================== 发送窗口结构 ====================
 
 /**
@@ -31,16 +56,65 @@ typedef struct {
  * 
  * 用于管理已发送但未确认的数据包
  * 支持流水线传输和超时重传
+ * 
+ * packets为环形缓冲区，序列号seq对应槽位 (head + (seq - base)) % max_packets，
+ * 查找和确认都不需要扫描整个窗口
  */
 typedef struct {
-    UnackedPacket* packets;            // 未确认数据包数组
+    UnackedPacket* packets;            // 未确认数据包数组（环形缓冲区）
+    int head;                          // base对应的槽位下标
     int window_size;                   // 窗口大小（最多同时发送的包数）
     uint32_t base;                     // 窗口基序列号（最早的未确认包）
     uint32_t next_seq_num;             // 下一个要发送的序列号
     int max_packets;                   // 最大未确认数据包数量
     int packet_count;                  // 当前窗口中的包数量
+    uint32_t bytes_in_flight;          // 在途字节数：已发送未确认包的数据字节之和（提交时加，确认时减）
+
+    SendTimer* timers;                 // 发送定时器队列（环形缓冲区，按发送时间排列）
+    int timer_head;                    // 队首下标
+    int timer_count;                   // 队列中的项数（含待惰性删除的项）
+    int timer_capacity;                // 队列容量（满时翻倍）
+    uint64_t timer_restart;            // 最近一次确认新数据的时间（微秒）：定时器从这里重新计时
 } SendWindow;
 
+// ==================== 前向纠错结构 ====================
+
+/**
+ * 接收端的一个FEC分组（格式见packet.h）
+ * 
+ * 数据帧到达时就异或进acc（交付后原始数据不再保留），校验帧到达时也异或进去；
+ * 组内只差一帧且已收到校验帧时，acc就是缺失帧的数据，len_xor就是它的长度
+ */
+typedef struct {
+    uint32_t first_seq;                // 组内第一帧的序列号
+    uint16_t received;                 // 组内已收到的数据帧数
+    uint16_t count;                    // 组内的帧数（收到校验帧后才知道）
+    uint16_t len_xor;                  // 已收到各帧长度与校验帧长度字段的异或
+    uint16_t acc_len;                  // acc中的有效字节数
+    bool has_parity;                   // 是否已收到校验帧
+    bool in_use;                       // 槽位是否有效
+    uint8_t acc[MAX_DATA_LENGTH];      // 已收到各帧数据与校验数据的异或
+} FecGroup;
+
+/**
+ * 发送端的FEC编码器
+ * 
+ * 每提交一个DATA帧就异或进当前组，凑满K帧（或文件结束）时生成校验帧；
+ * 同时记录各组校验帧的发送时间，发送端据此判断空洞是否还可能被校验帧恢复
+ */
+typedef struct {
+    int k;                             // 分组大小
+    uint32_t origin;                   // 第一个DATA帧的序列号（分组的起点）
+    uint32_t first_seq;                // 当前组第一帧的序列号
+    int count;                         // 当前组已累加的帧数
+    uint16_t len_xor;                  // 当前组各帧长度的异或
+    uint16_t parity_len;               // 当前组最长帧的长度
+    uint8_t parity[MAX_DATA_LENGTH];   // 当前组各帧数据的异或
+    uint32_t* sent_first;              // 各组校验帧对应的组首序列号（环形，按组号取模）
+    uint64_t* sent_time;               // 各组校验帧的发送时间（微秒）
+    int slots;                         // 环形数组的长度
+} FecEncoder;
+
 // ==================== 接收窗口结构 ====================
 
 /**
@@ -48,15 +122,30 @@ typedef struct {
  * 
  * 用于接收和重组数据，支持乱序接收
  * 缓冲超出序列的数据包，直到所有数据到达
+ * 
+ * 内存布局：所有缓冲区放在一块按缓存行对齐的slab中
+ *   [received标志 × N][data_len × N][数据槽 × N（每槽slot_stride字节）]
+ * 标志和长度按结构数组（SoA）连续存放，扫描窗口时只触及少量缓存行
+ * 槽位按环形使用：expected_seq在head槽，交付后只清标志并前移head，数据不搬动
  */
 typedef struct {
-    uint8_t** buffer;                  // 接收数据缓冲区（指针数组）
-    uint16_t* data_len;                // 每个缓冲区的数据长度
-    bool* received;                    // 标记每个位置是否已接收
+    uint8_t* slab;                     // 单块对齐内存（整个窗口只分配一次）
+    uint8_t* received;                 // 标记每个位置是否已接收（指向slab内部）
+    uint16_t* data_len;                // 每个槽的数据长度（指向slab内部）
+    uint8_t* data;                     // 数据槽起始地址（指向slab内部）
+    size_t slot_stride;                // 单个数据槽的跨度（按缓存行对齐）
     int window_size;                   // 窗口大小
+    int head;                          // expected_seq所在的槽位
+    int received_count;                // 已接收、尚未交付的槽位数（通告窗口时不必扫描）
     uint32_t base;                     // 窗口基序列号（最早的未交付包）
     uint32_t expected_seq;             // 期望接收的下一个序列号
     int max_buffer_size;               // 单个数据包的最大缓冲区大小
+
+    FecGroup* fec_groups;              // FEC分组（环形，按组号取模），未启用FEC时为NULL
+    int fec_slots;                     // FEC分组槽位数
+    int fec_k;                         // 分组大小（0表示未启用）
+    uint32_t fec_origin;               // 第一个DATA帧的序列号
+    uint32_t fec_recovered;            // 由校验帧恢复的帧数
 } ReceiveWindow;
 
 // ==================== 发送窗口函数 ====================
@@ -81,7 +170,30 @@ SendWindow* create_send_window(int window_size, int max_packets);
  * @param frame 要发送的帧
  * @return 成功返回true，失败返回false
  */
-bool add_to_send_window(SendWindow* window, const Frame* frame);
+bool add_to_send_window(SendWindow* window, const Frame* frame, ChecksumMode mode = CHECKSUM_LEGACY);
+
+/**
+ * 预留发送窗口尾部的槽位，供调用方原地构建帧
+ * 
+ * 调用方把数据直接写到返回缓冲区的FRAME_HEADER_SIZE偏移处，
+ * 用frame_build_in_place补齐帧头（序列号为window->next_seq_num），
+ * 再调用commit_send_slot；不提交则槽位不生效
+ * 
+ * @param window 发送窗口指针
+ * @return 槽位的发送缓冲区（FRAME_MAX_SIZE字节），窗口已满返回NULL
+ */
+uint8_t* reserve_send_slot(SendWindow* window);
+
+/**
+ * 提交reserve_send_slot预留的槽位，记录发送时间并启动定时器，
+ * 帧的数据字节数计入在途字节数
+ * 
+ * @param window 发送窗口指针
+ * @param wire_len 构建好的帧的总字节数
+ * @param data_len 帧的数据字节数
+ * @return 成功返回true；窗口已满或定时器无法登记时返回false，槽位不提交
+ */
+bool commit_send_slot(SendWindow* window, int wire_len, uint16_t data_len);
 
 /**
  * 检查发送窗口是否已满
@@ -113,7 +225,7 @@ UnackedPacket* get_unacked_packet(SendWindow* window, uint32_t seq_num);
 /**
  * 处理收到的ACK，更新发送窗口
  * 
- * 根据ACK号滑动窗口，释放已确认的数据包
+ * 根据ACK号滑动窗口，释放已确认的数据包，并从在途字节数中扣除
  * 
  * @param window 发送窗口指针
  * @param ack_num 收到的ACK号
@@ -121,6 +233,24 @@ UnackedPacket* get_unacked_packet(SendWindow* window, uint32_t seq_num);
  */
 bool update_send_window(SendWindow* window, uint32_t ack_num);
 
+/**
+ * 处理ACK/NACK携带的选择确认位图
+ * 
+ * 把位图中置位的包标记为sacked，并找出空洞：最高的已选择确认包之前
+ * 仍未到达接收端的包。调用方先用update_send_window处理累积确认号，
+ * 确认号落后于窗口首部的旧ACK中的位图按序列号对齐后同样适用
+ * 
+ * @param window 发送窗口指针
+ * @param ack_num 位图所属帧的确认号
+ * @param bitmap 选择确认位图（格式见packet.h）
+ * @param len 位图长度（字节）
+ * @param holes 可选，输出空洞的序列号（从小到大）
+ * @param max_holes holes数组的容量
+ * @return 返回空洞数量
+ */
+int apply_send_sack(SendWindow* window, uint32_t ack_num, const uint8_t* bitmap, uint16_t len,
+                    uint32_t* holes, int max_holes);
+
 /**
  * 获取可用的发送窗口大小
  * 
@@ -167,6 +297,26 @@ ReceiveWindow* create_receive_window(int window_size, int buffer_size);
  */
 bool receive_packet(ReceiveWindow* window, const Frame* frame);
 
+/**
+ * 接收数据到接收窗口（不经过Frame，直接从接收缓冲区复制）
+ * 
+ * @param window 接收窗口指针
+ * @param seq_num 数据包序列号
+ * @param data 数据指针（通常为FrameView的payload）
+ * @param data_len 数据长度
+ * @return 成功返回true，失败返回false
+ */
+bool receive_payload(ReceiveWindow* window, uint32_t seq_num, const uint8_t* data, uint16_t data_len);
+
+/**
+ * 查询窗口内某个序列号的帧是否已缓冲
+ * 
+ * @param window 接收窗口指针
+ * @param seq_num 序列号
+ * @return 在窗口内且已接收返回true，否则返回false
+ */
+bool is_seq_received(const ReceiveWindow* window, uint32_t seq_num);
+
 /**
  * 获取连续的已接收数据
  * 
@@ -181,10 +331,68 @@ int get_contiguous_data(ReceiveWindow* window, uint8_t* output);
 /**
  * 获取当前可用的接收窗口大小
  * 
+ * 结果经window_encode按协商的移位数编码后写入ACK的window_size字段，
+ * 向发送端通告剩余缓冲空间；由received_count直接算出，不扫描窗口
+ * 
  * @param window 接收窗口指针
- * @return 可用窗口大小（字节数）
+ * @return 可用窗口大小（字节数，不截断）
  */
-uint16_t get_receive_window_available(ReceiveWindow* window);
+uint32_t get_receive_window_available(ReceiveWindow* window);
+
+/**
+ * 启用前向纠错
+ * 
+ * 分组槽位按最大窗口分配，之后扩大接收窗口不需要重新分配；
+ * 启用后receive_payload把每个新到的帧累加到所在分组
+ * 
+ * @param window 接收窗口指针
+ * @param k 分组大小（2 - FEC_MAX_GROUP）
+ * @param origin 第一个DATA帧的序列号
+ * @return 成功返回true，失败返回false
+ */
+bool enable_receive_fec(ReceiveWindow* window, int k, uint32_t origin);
+
+/**
+ * 接收FEC校验帧
+ * 
+ * 组内只缺一帧时立即还原它并放入窗口，之后照常由get_contiguous_data交付；
+ * 缺两帧以上时保留校验数据，重传补上其中一帧后再还原另一帧
+ * 
+ * @param window 接收窗口指针
+ * @param first_seq 组内第一帧的序列号
+ * @param count 组内的帧数
+ * @param len_xor 组内各帧长度的异或
+ * @param data 校验数据
+ * @param data_len 校验数据长度
+ * @return 还原了一帧返回true，否则返回false
+ */
+bool receive_parity(ReceiveWindow* window, uint32_t first_seq, uint16_t count, uint16_t len_xor,
+                    const uint8_t* data, uint16_t data_len);
+
+/**
+ * 生成选择确认位图
+ * 
+ * 按packet.h中的格式描述窗口内已缓冲的乱序帧（expected_seq之后），
+ * 位图只到最后一个已接收的帧为止
+ * 
+ * @param window 接收窗口指针
+ * @param bitmap 输出缓冲区
+ * @param max_bytes 输出缓冲区大小（字节）
+ * @return 位图长度（字节），没有乱序帧时返回0
+ */
+int get_receive_sack(ReceiveWindow* window, uint8_t* bitmap, int max_bytes);
+
+/**
+ * 扩大接收窗口
+ * 
+ * 按新的窗口大小重新分配slab，已缓冲的数据按序列号顺序从新slab的开头放起
+ * 只支持扩大，new_size小于当前窗口时返回false
+ * 
+ * @param window 接收窗口指针
+ * @param new_size 新的窗口大小
+ * @return 成功返回true，失败返回false（原窗口保持不变）
+ */
+bool resize_receive_window(ReceiveWindow* window, int new_size);
 
 /**
  * 释放接收窗口资源
@@ -200,26 +408,92 @@ void free_receive_window(ReceiveWindow* window);
  */
 void print_receive_window(ReceiveWindow* window);
 
+// ==================== FEC编码函数 ====================
+
+/**
+ * 创建FEC编码器
+ * 
+ * @param k 分组大小（2 - FEC_MAX_GROUP）
+ * @param origin 第一个DATA帧的序列号
+ * @param window_size 发送窗口大小（帧数），决定需要记录发送时间的组数
+ * @return 返回编码器指针，失败返回NULL
+ */
+FecEncoder* create_fec_encoder(int k, uint32_t origin, int window_size);
+
+/**
+ * 把一个新的DATA帧累加到当前组（重传的帧不再累加）
+ * 
+ * @param enc 编码器指针
+ * @param seq_num 帧的序列号（必须依次递增）
+ * @param data 帧数据
+ * @param data_len 帧数据长度
+ * @return 当前组已凑满K帧、应发送校验帧时返回true
+ */
+bool fec_encoder_add(FecEncoder* enc, uint32_t seq_num, const uint8_t* data, uint16_t data_len);
+
+/**
+ * 为当前组生成校验帧，记录发送时间并开始下一组
+ * 
+ * @param enc 编码器指针
+ * @param wire 输出缓冲区（FRAME_MAX_SIZE字节）
+ * @param mode 校验模式
+ * @return 校验帧的总字节数，当前组为空时返回0
+ */
+int fec_encoder_flush(FecEncoder* enc, uint8_t* wire, ChecksumMode mode);
+
+/**
+ * 获取seq_num所在组的组首序列号
+ */
+uint32_t fec_group_first(const FecEncoder* enc, uint32_t seq_num);
+
+/**
+ * 获取seq_num所在组的校验帧发送时间
+ * 
+ * @return 发送时间（微秒），该组的校验帧尚未发送时返回0
+ */
+uint64_t fec_parity_sent_time(const FecEncoder* enc, uint32_t seq_num);
+
+/**
+ * 释放FEC编码器
+ */
+void free_fec_encoder(FecEncoder* enc);
+
 // ==================== 超时重传函数 ====================
 
 /**
  * 检查发送窗口中的超时包
  * 
- * 扫描所有未确认的数据包，检查是否超时
- * 如果超时，触发重传
+ * 从定时器队列队首取出所有已到期的项，检查是否超时
+ * 超时的包被标记为timed_out，由调用方通过retransmit_packet()
+ * 更新重传信息并实际发送；已被选择确认的包不会超时；
+ * 开销与到期的项数成正比，而非窗口大小
  * 
  * @param window 发送窗口指针
- * @param rto 重传超时时间（秒）
+ * @param rto_us 重传超时时间（微秒）
+ * @param expired 可选，输出超时包的序列号
+ * @param max_expired expired数组的容量
  * @return 返回需要重传的包数量
  */
-int check_send_timeouts(SendWindow* window, time_t rto);
+int check_send_timeouts(SendWindow* window, uint64_t rto_us, uint32_t* expired = NULL, int max_expired = 0);
+
+/**
+ * 获取下一个重传截止时间
+ * 
+ * 队首已失效的定时器在这里顺带丢弃，返回的是最早一个有效定时器的到期时刻，
+ * 供事件循环作为等待的截止时间
+ * 
+ * @param window 发送窗口指针
+ * @param rto_us 重传超时时间（微秒）
+ * @return 截止时间（单调时钟，微秒），没有在途数据包时返回0
+ */
+uint64_t get_next_send_deadline(SendWindow* window, uint64_t rto_us);
 
 /**
  * 重传指定序列号的数据包
  * 
  * @param window 发送窗口指针
  * @param seq_num 要重传的序列号
- * @return 成功返回true，否则返回false
+ * @return 成功返回true；包不存在或定时器无法登记时返回false，包状态不变，调用方不应发送
  */
 bool retransmit_packet(SendWindow* window, uint32_t seq_num);
 
@@ -230,9 +504,9 @@ bool retransmit_packet(SendWindow* window, uint32_t seq_num);
  * 实现exponential backoff机制
  * 
  * @param window 发送窗口指针
- * @param rto 当前RTO，返回新的RTO
- * @return 返回新的RTO值
+ * @param rto_us 当前RTO（微秒）
+ * @return 返回新的RTO值（微秒）
  */
-time_t apply_timeout_backoff(SendWindow* window, time_t rto);
+uint64_t apply_timeout_backoff(SendWindow* window, uint64_t rto_us);
 
 #endif // WINDOW_H
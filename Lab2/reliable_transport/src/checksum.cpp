@@ -2,6 +2,11 @@
 #include <cstdio>
 #include <cstring>
 
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+    #include <nmmintrin.h>
+    #define CRC32C_HAVE_SSE42 1
+#endif
+
 // ==================== Internet校验和计算（RFC 791标准） ====================
 
 /**
@@ -270,6 +275,147 @@ bool verify_frame_checksum(const Frame* frame)
     return result;
 }
 
+// ==================== CRC32C：slicing-by-8查表实现 ====================
+
+#define CRC32C_POLY_REFLECTED 0x82F63B78u  // Castagnoli多项式（反射形式）
+
+static uint32_t g_crc32c_table[8][256];
+
+/**
+ * 生成slicing-by-8所需的8张表
+ * 
+ * table[0]是普通的逐字节查表；table[k][b]表示字节b后面再跟k个0字节时的CRC，
+ * 这样一次可以独立查8张表处理8个字节，最后异或合并
+ */
+static bool crc32c_init_tables()
+{
+    for (uint32_t b = 0; b < 256; b++) {
+        uint32_t crc = b;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 1) ? (crc >> 1) ^ CRC32C_POLY_REFLECTED : (crc >> 1);
+        }
+        g_crc32c_table[0][b] = crc;
+    }
+
+    for (uint32_t b = 0; b < 256; b++) {
+        for (int k = 1; k < 8; k++) {
+            uint32_t prev = g_crc32c_table[k - 1][b];
+            g_crc32c_table[k][b] = (prev >> 8) ^ g_crc32c_table[0][prev & 0xFF];
+        }
+    }
+
+    return true;
+}
+
+/**
+ * slicing-by-8主循环（crc为取反后的内部状态）
+ */
+static uint32_t crc32c_slice8(uint32_t crc, const uint8_t* ptr, size_t length)
+{
+    // C++11保证局部静态变量的初始化是线程安全的，表只生成一次
+    static const bool tables_ready = crc32c_init_tables();
+    (void)tables_ready;
+
+    // 按8字节为一组处理（小端读取）
+    while (length >= 8) {
+        uint32_t lo = crc ^ ((uint32_t)ptr[0] | ((uint32_t)ptr[1] << 8) |
+                             ((uint32_t)ptr[2] << 16) | ((uint32_t)ptr[3] << 24));
+        uint32_t hi = (uint32_t)ptr[4] | ((uint32_t)ptr[5] << 8) |
+                      ((uint32_t)ptr[6] << 16) | ((uint32_t)ptr[7] << 24);
+
+        crc = g_crc32c_table[7][lo & 0xFF] ^
+              g_crc32c_table[6][(lo >> 8) & 0xFF] ^
+              g_crc32c_table[5][(lo >> 16) & 0xFF] ^
+              g_crc32c_table[4][lo >> 24] ^
+              g_crc32c_table[3][hi & 0xFF] ^
+              g_crc32c_table[2][(hi >> 8) & 0xFF] ^
+              g_crc32c_table[1][(hi >> 16) & 0xFF] ^
+              g_crc32c_table[0][hi >> 24];
+
+        ptr += 8;
+        length -= 8;
+    }
+
+    // 剩余不足8字节的部分逐字节处理
+    while (length--) {
+        crc = (crc >> 8) ^ g_crc32c_table[0][(crc ^ *ptr++) & 0xFF];
+    }
+
+    return crc;
+}
+
+// ==================== CRC32C：SSE4.2硬件实现 ====================
+
+#ifdef CRC32C_HAVE_SSE42
+/**
+ * 使用SSE4.2的CRC32指令（该指令计算的正是CRC32C）
+ * 只为本函数开启sse4.2代码生成，其余代码仍可在旧CPU上运行
+ */
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_sse42(uint32_t crc, const uint8_t* ptr, size_t length)
+{
+    uint64_t crc64 = crc;
+
+    while (length >= 8) {
+        uint64_t word;
+        memcpy(&word, ptr, sizeof(word));   // 避免非对齐访问
+        crc64 = _mm_crc32_u64(crc64, word);
+        ptr += 8;
+        length -= 8;
+    }
+
+    uint32_t crc32 = (uint32_t)crc64;
+    while (length--) {
+        crc32 = _mm_crc32_u8(crc32, *ptr++);
+    }
+
+    return crc32;
+}
+#endif
+
+/**
+ * 当前CPU是否支持硬件CRC32C指令
+ */
+bool crc32c_hardware_available()
+{
+#ifdef CRC32C_HAVE_SSE42
+    static const bool available = __builtin_cpu_supports("sse4.2");
+    return available;
+#else
+    return false;
+#endif
+}
+
+/**
+ * 计算CRC32C（只使用查表实现）
+ */
+uint32_t crc32c_update_software(uint32_t crc, const void* data, size_t length)
+{
+    if (data == NULL || length == 0) {
+        return crc;
+    }
+
+    return ~crc32c_slice8(~crc, (const uint8_t*)data, length);
+}
+
+/**
+ * 计算CRC32C（优先使用硬件指令）
+ */
+uint32_t crc32c_update(uint32_t crc, const void* data, size_t length)
+{
+    if (data == NULL || length == 0) {
+        return crc;
+    }
+
+#ifdef CRC32C_HAVE_SSE42
+    if (crc32c_hardware_available()) {
+        return ~crc32c_sse42(~crc, (const uint8_t*)data, length);
+    }
+#endif
+
+    return ~crc32c_slice8(~crc, (const uint8_t*)data, length);
+}
+
 // ==================== 范围校验和计算 ====================
 
 /**
@@ -1,20 +1,20 @@
 #include "congestion.h"
+#include "logger.h"
 #include <cstdio>
 #include <cstdlib>
 #include <cmath>
 
 // ==================== 日志宏定义 ====================
 
-#define LOG_INFO(fmt, ...) printf("[INFO] " fmt "\n", ##__VA_ARGS__)
-#define LOG_DEBUG(fmt, ...) printf("[DEBUG] " fmt "\n", ##__VA_ARGS__)
-#define LOG_WARN(fmt, ...) printf("[WARN] " fmt "\n", ##__VA_ARGS__)
+#define LOG_INFO(fmt, ...) log_message(LOG_LEVEL_INFO, fmt, ##__VA_ARGS__)
+#define LOG_DEBUG(fmt, ...) log_message(LOG_LEVEL_DEBUG, fmt, ##__VA_ARGS__)
+#define LOG_WARN(fmt, ...) log_message(LOG_LEVEL_WARNING, fmt, ##__VA_ARGS__)
 
 // ==================== 常量定义 ====================
 
 #define MSS (MAX_DATA_LENGTH)           // 最大报文段长度
 #define INITIAL_CWND (1 * MSS)          // 初始拥塞窗口 = 1 MSS
 #define INITIAL_SSTHRESH (65536)        // 初始慢启动阈值（很大）
-#define DUP_ACK_THRESHOLD 3             // 快速重传的重复ACK阈值
 
 // ==================== 状态字符串转换 ====================
 
@@ -45,7 +45,7 @@ const char* congestion_state_to_string(CongestionState state)
  * - ssthresh = 65536 bytes: 很大的初始阈值
  * - state = SLOW_START: 从慢启动开始
  * - dup_ack_count = 0: 无重复ACK
- * - rto = TIMEOUT_MS: 初始重传超时
+ * - rto = TIMEOUT_MS: 初始重传超时（首个RTT采样前使用）
  */
 CongestionControl* create_congestion_control()
 {
@@ -63,19 +63,21 @@ CongestionControl* create_congestion_control()
     // 初始化状态
     cc->state = SLOW_START;            // 从慢启动开始
     cc->dup_ack_count = 0;             // 无重复ACK
-    cc->recovery_point = 0;            // 无恢复点
+    cc->recovery_point = 0;
+    cc->recovery_active = false;       // 无恢复点
+    cc->last_ack = 0;
 
-    // 初始化RTT和RTO
-    cc->rtt = TIMEOUT_MS;              // 初始RTT = 1000ms
-    cc->rttvar = TIMEOUT_MS / 2;       // 初始RTT方差 = 500ms
-    cc->rto = TIMEOUT_MS;              // 初始RTO = 1000ms
+    // 初始化RTT和RTO（微秒）
+    cc->rtt_us = 0;                    // 尚无RTT采样
+    cc->rttvar_us = 0;
+    cc->rto_us = TIMEOUT_MS * 1000;    // 初始RTO = 1000ms
 
     // 初始化统计信息
     cc->congestion_events = 0;
     cc->fast_retransmits = 0;
 
-    LOG_INFO("Congestion control created: cwnd=%u, ssthresh=%u, rto=%u",
-             cc->cwnd, cc->ssthresh, cc->rto);
+    LOG_INFO("Congestion control created: cwnd=%u, ssthresh=%u, rto=%u us",
+             cc->cwnd, cc->ssthresh, cc->rto_us);
 
     return cc;
 }
@@ -264,25 +266,40 @@ void fast_recovery(CongestionControl* cc)
  * 状态转换：
  * - SLOW_START：调用slow_start()
  * - CONGESTION_AVOIDANCE：调用congestion_avoidance()
- * - FAST_RECOVERY（新ACK）：检查是否应退出
+ * - FAST_RECOVERY（新ACK）：确认到recovery_point则退出，否则为部分ACK
  * - FAST_RECOVERY（重复ACK）：增加cwnd以发送新数据
  * 
+ * NewReno部分ACK（RFC 6582）：
+ * 一个窗口内丢失多个包时，重传第一个包后的新ACK只确认到下一个空洞。
+ * RENO在这里退出快速恢复，之后要么再凑3个重复ACK再减半一次，
+ * 要么等到超时回到慢启动；NewReno留在快速恢复中，
+ * 每个部分ACK立即重传下一个空洞，整个窗口只减半一次
+ * 
  * @param cc 拥塞控制指针
- * @param ack_num 新的ACK号
+ * @param ack_num 确认号
  * @param is_duplicate_ack 是否为重复ACK
- * @return 成功返回true
+ * @param highest_sent 已发送的最高序列号
+ * @return 发送方需要执行的重传动作
  */
-bool update_congestion_control(CongestionControl* cc, uint32_t ack_num, bool is_duplicate_ack)
+CongestionAction update_congestion_control(CongestionControl* cc, uint32_t ack_num, bool is_duplicate_ack,
+                                           uint32_t highest_sent)
 {
     if (cc == NULL) {
         LOG_WARN("CongestionControl pointer is NULL");
-        return false;
+        return CC_ACTION_NONE;
     }
 
     if (!is_duplicate_ack) {
         // ===== 新ACK：清除重复ACK计数 =====
+        uint32_t acked_frames = (uint32_t)seq_diff(ack_num, cc->last_ack);
+        cc->last_ack = ack_num;
         cc->dup_ack_count = 0;
 
+        // 恢复点已被确认，之后的比较不再以它为准（序列号回绕后旧恢复点会重新显得"在前面"）
+        if (cc->recovery_active && seq_gt(ack_num, cc->recovery_point)) {
+            cc->recovery_active = false;
+        }
+
         // 根据当前状态处理新ACK
         switch (cc->state) {
             case SLOW_START:
@@ -296,29 +313,62 @@ bool update_congestion_control(CongestionControl* cc, uint32_t ack_num, bool is_
                 break;
 
             case FAST_RECOVERY:
-                // 快速恢复中收到新ACK
-                // 恢复完成，回到拥塞避免
-                cc->state = CONGESTION_AVOIDANCE;
-                cc->cwnd_inc = 0;
-                LOG_INFO("Exiting Fast Recovery, entering CONGESTION_AVOIDANCE at cwnd=%u", cc->cwnd);
-                break;
+                if (seq_gt(ack_num, cc->recovery_point)) {
+                    // 完整ACK：丢失前发出的数据已全部确认，收缩窗口，回到拥塞避免
+                    cc->cwnd = cc->ssthresh;
+                    cc->state = CONGESTION_AVOIDANCE;
+                    cc->cwnd_inc = 0;
+                    LOG_INFO("Exiting Fast Recovery, entering CONGESTION_AVOIDANCE at cwnd=%u", cc->cwnd);
+                    break;
+                }
+
+                // 部分ACK：扣除新确认的数据量，确认了至少1帧时加回1 MSS
+                {
+                    uint32_t deflate = acked_frames * MSS;
+                    cc->cwnd = (cc->cwnd > deflate + MSS) ? cc->cwnd - deflate : MSS;
+                    if (acked_frames > 0) {
+                        cc->cwnd += MSS;
+                    }
+                }
+                LOG_DEBUG("Fast Recovery: partial ACK %u (recovery point %u), cwnd=%u",
+                          ack_num, cc->recovery_point, cc->cwnd);
+                return CC_ACTION_PARTIAL_ACK;
 
             default:
                 LOG_WARN("Unknown congestion state: %d", cc->state);
                 break;
         }
 
+        // 超时后只重传了最早的包；超时前发出的数据尚未全部确认时，
+        // 新的窗口首部就是下一个空洞
+        if (cc->recovery_active && seq_leq(ack_num, cc->recovery_point)) {
+            return CC_ACTION_PARTIAL_ACK;
+        }
+
     } else {
         // ===== 重复ACK：增加计数 =====
+        // 重复ACK的确认号就是当前窗口首部；第一帧就丢失时还没有新ACK，
+        // 在这里记下它，部分ACK才能算出正确的确认帧数
+        cc->last_ack = ack_num;
         cc->dup_ack_count++;
 
         LOG_DEBUG("Duplicate ACK received: count=%d, state=%s",
                   cc->dup_ack_count, congestion_state_to_string(cc->state));
 
         // 检查是否触发快速重传
-        if (cc->dup_ack_count == DUP_ACK_THRESHOLD) {
-            // 第3个重复ACK：触发快速重传
+        if (cc->dup_ack_count == DUP_ACK_THRESHOLD && cc->state != FAST_RECOVERY) {
+            // 上一次恢复或超时前发出的数据尚未全部确认时，重复ACK可能来自
+            // 已经处理过的同一批丢包，不再减半
+            if (cc->recovery_active && seq_leq(ack_num, cc->recovery_point)) {
+                LOG_DEBUG("Duplicate ACKs below recovery point %u, no fast retransmit", cc->recovery_point);
+                return CC_ACTION_NONE;
+            }
+
+            // 第3个重复ACK：触发快速重传，记录恢复点
+            cc->recovery_point = highest_sent;
+            cc->recovery_active = true;
             fast_retransmit(cc);
+            return CC_ACTION_FAST_RETRANSMIT;
 
         } else if (cc->dup_ack_count > DUP_ACK_THRESHOLD && cc->state == FAST_RECOVERY) {
             // 在快速恢复中继续收到重复ACK
@@ -328,11 +378,42 @@ bool update_congestion_control(CongestionControl* cc, uint32_t ack_num, bool is_
         }
     }
 
-    return true;
+    return CC_ACTION_NONE;
 }
 
 // ==================== 超时处理 ====================
 
+/**
+ * 处理NACK
+ * 
+ * NACK表示接收端已经发现空洞，相当于立即凑够了重复ACK阈值：
+ * 不在快速恢复中、且确认号越过了上一次的恢复点时进入快速恢复，
+ * 之后的重复ACK照常膨胀cwnd
+ */
+CongestionAction handle_congestion_nack(CongestionControl* cc, uint32_t ack_num, uint32_t highest_sent)
+{
+    if (cc == NULL) {
+        LOG_WARN("CongestionControl pointer is NULL");
+        return CC_ACTION_NONE;
+    }
+
+    if (cc->state == FAST_RECOVERY) {
+        return CC_ACTION_NONE;
+    }
+
+    // 同一批丢包已经减半过（快速恢复或超时），不再减半
+    if (cc->recovery_active && seq_leq(ack_num, cc->recovery_point)) {
+        LOG_DEBUG("NACK below recovery point %u, no window reduction", cc->recovery_point);
+        return CC_ACTION_NONE;
+    }
+
+    cc->dup_ack_count = DUP_ACK_THRESHOLD;
+    cc->recovery_point = highest_sent;
+    cc->recovery_active = true;
+    fast_retransmit(cc);
+    return CC_ACTION_FAST_RETRANSMIT;
+}
+
 /**
  * 处理超时事件
  * 
@@ -340,7 +421,7 @@ bool update_congestion_control(CongestionControl* cc, uint32_t ack_num, bool is_
  * 需要大幅降低发送速率并回到慢启动
  * 
  * 算法步骤：
- * 1. 设置ssthresh = cwnd/2
+ * 1. 设置ssthresh = max(cwnd/2, 2*MSS)
  * 2. 设置cwnd = 1 MSS（保守重启）
  * 3. 回到SLOW_START状态
  * 4. 清除重复ACK计数
@@ -356,18 +437,20 @@ bool update_congestion_control(CongestionControl* cc, uint32_t ack_num, bool is_
  * - 给网络时间恢复
  * - 避免加重网络负担
  */
-bool handle_congestion_timeout(CongestionControl* cc)
+bool handle_congestion_timeout(CongestionControl* cc, uint32_t highest_sent)
 {
     if (cc == NULL) {
         LOG_WARN("CongestionControl pointer is NULL");
         return false;
     }
 
+    // 新的慢启动阈值：cwnd的一半，但不低于2 MSS
+    uint32_t new_ssthresh = (cc->cwnd / 2 > 2 * MSS) ? (cc->cwnd / 2) : (2 * MSS);
+
     LOG_INFO("Timeout detected! Backing off: cwnd=%u → 1 MSS, ssthresh=%u",
-             cc->cwnd, cc->cwnd / 2);
+             cc->cwnd, new_ssthresh);
 
-    // 设置新的慢启动阈值
-    cc->ssthresh = (cc->cwnd / 2 > 2 * MSS) ? (cc->cwnd / 2) : (2 * MSS);
+    cc->ssthresh = new_ssthresh;
 
     // 重置拥塞窗口（保守）
     cc->cwnd = INITIAL_CWND;
@@ -375,19 +458,22 @@ bool handle_congestion_timeout(CongestionControl* cc)
     // 回到慢启动
     cc->state = SLOW_START;
 
-    // 清除重复ACK计数
+    // 清除重复ACK计数；超时前发出的数据引起的重复ACK不再触发快速重传
     cc->dup_ack_count = 0;
+    cc->recovery_point = highest_sent;
+    cc->recovery_active = true;
 
     // 应用指数退避增加RTO
     // （这里简化处理，实际应在RTT计算中体现）
-    if (cc->rto < 32000) {  // 最大RTO = 32秒
-        cc->rto *= 2;
+    cc->rto_us *= 2;
+    if (cc->rto_us > MAX_RTO_MS * 1000) {
+        cc->rto_us = MAX_RTO_MS * 1000;
     }
 
     cc->congestion_events++;
 
-    LOG_INFO("Entering SLOW_START: cwnd=%u, ssthresh=%u, rto=%u",
-             cc->cwnd, cc->ssthresh, cc->rto);
+    LOG_INFO("Entering SLOW_START: cwnd=%u, ssthresh=%u, rto=%u us",
+             cc->cwnd, cc->ssthresh, cc->rto_us);
 
     return true;
 }
@@ -409,81 +495,102 @@ uint32_t get_congestion_window(CongestionControl* cc)
 /**
  * 获取当前可发送字节数
  */
-uint32_t get_send_allowance(CongestionControl* cc)
+uint32_t get_send_allowance(CongestionControl* cc, uint32_t peer_window, uint32_t bytes_in_flight)
 {
     if (cc == NULL) {
         return 0;
     }
 
-    return cc->cwnd;
+    // 受限传输：第1、2个重复ACK各允许多发1 MSS
+    uint32_t cwnd = cc->cwnd;
+    if (cc->state != FAST_RECOVERY && cc->dup_ack_count > 0 && cc->dup_ack_count < DUP_ACK_THRESHOLD) {
+        cwnd += (uint32_t)cc->dup_ack_count * MSS;
+    }
+
+    // 有效窗口取拥塞窗口和对端接收窗口的较小者，扣除已在途的字节
+    uint32_t limit = (cwnd < peer_window) ? cwnd : peer_window;
+    return (limit > bytes_in_flight) ? limit - bytes_in_flight : 0;
 }
 
 /**
  * 更新RTT估计值
  * 
- * 使用Karn/Partridge算法：
+ * 使用RFC 6298的估计方法（采样须遵守Karn算法：重传过的包不采样）：
  * 1. 测量往返时间（sample_rtt）
- * 2. 更新RTT估计：RTT = 7/8*RTT + 1/8*sample_rtt
- * 3. 更新方差：RTTVAR = 3/4*RTTVAR + 1/4*|sample_rtt - RTT|
+ * 2. 首个样本：RTT = sample_rtt，RTTVAR = sample_rtt/2
+ * 3. 之后：RTT = 7/8*RTT + 1/8*sample_rtt
+ *          RTTVAR = 3/4*RTTVAR + 1/4*|sample_rtt - RTT|
  * 4. 计算RTO：RTO = RTT + 4*RTTVAR
- * 5. RTO最小值：通常是200ms或1秒
+ * 5. RTO限制在 [MIN_RTO_MS, MAX_RTO_MS] 之间
+ * 
+ * 单位为微秒，局域网上RTO可以降到亚秒级，重传延迟跟随实际RTT
+ * 新的RTO同时撤销之前超时造成的指数退避
  * 
  * 优点：
  * - 对单个样本的变化不敏感
  * - 自适应网络变化
  * - 对抖动有良好的容忍度
  */
-bool update_rtt(CongestionControl* cc, uint32_t sample_rtt)
+bool update_rtt(CongestionControl* cc, uint32_t sample_rtt_us)
 {
-    if (cc == NULL || sample_rtt == 0) {
-        LOG_WARN("Invalid RTT sample: %u", sample_rtt);
+    if (cc == NULL) {
+        LOG_WARN("CongestionControl pointer is NULL");
         return false;
     }
 
-    // 计算RTT差值
-    int32_t delta = sample_rtt - cc->rtt;
-    if (delta < 0) {
-        delta = -delta;
+    // 回环上的样本可能小于时钟分辨率
+    if (sample_rtt_us == 0) {
+        sample_rtt_us = 1;
     }
 
-    // 更新RTT估计
-    // RTT_new = 7/8 * RTT_old + 1/8 * sample_rtt
-    cc->rtt = (cc->rtt * 7 + sample_rtt) / 8;
+    if (cc->rtt_us == 0) {
+        // 首个样本
+        cc->rtt_us = sample_rtt_us;
+        cc->rttvar_us = sample_rtt_us / 2;
+    } else {
+        // 计算RTT差值
+        int32_t delta = (int32_t)(sample_rtt_us - cc->rtt_us);
+        if (delta < 0) {
+            delta = -delta;
+        }
 
-    // 更新RTT方差
-    // RTTVAR_new = 3/4 * RTTVAR_old + 1/4 * |delta|
-    cc->rttvar = (cc->rttvar * 3 + delta) / 4;
+        // RTTVAR_new = 3/4 * RTTVAR_old + 1/4 * |delta|
+        cc->rttvar_us = (cc->rttvar_us * 3 + delta) / 4;
+
+        // RTT_new = 7/8 * RTT_old + 1/8 * sample_rtt
+        cc->rtt_us = (cc->rtt_us * 7 + sample_rtt_us) / 8;
+    }
 
     // 计算新的RTO
     // RTO = RTT + 4 * RTTVAR
-    uint32_t new_rto = cc->rtt + 4 * cc->rttvar;
+    uint32_t new_rto = cc->rtt_us + 4 * cc->rttvar_us;
 
     // RTO最小值和最大值
-    if (new_rto < 1000) {      // 最小1秒
-        new_rto = 1000;
+    if (new_rto < MIN_RTO_MS * 1000) {
+        new_rto = MIN_RTO_MS * 1000;
     }
-    if (new_rto > 60000) {     // 最大60秒
-        new_rto = 60000;
+    if (new_rto > MAX_RTO_MS * 1000) {
+        new_rto = MAX_RTO_MS * 1000;
     }
 
-    cc->rto = new_rto;
+    cc->rto_us = new_rto;
 
-    LOG_DEBUG("RTT Updated: sample=%u, rtt=%u, rttvar=%u, rto=%u",
-              sample_rtt, cc->rtt, cc->rttvar, cc->rto);
+    LOG_DEBUG("RTT Updated: sample=%u us, rtt=%u us, rttvar=%u us, rto=%u us",
+              sample_rtt_us, cc->rtt_us, cc->rttvar_us, cc->rto_us);
 
     return true;
 }
 
 /**
- * 获取重传超时时间
+ * 获取重传超时时间（微秒）
  */
 uint32_t get_rto(CongestionControl* cc)
 {
     if (cc == NULL) {
-        return TIMEOUT_MS;
+        return TIMEOUT_MS * 1000;
     }
 
-    return cc->rto;
+    return cc->rto_us;
 }
 
 // ==================== 调试和管理 ====================
@@ -506,9 +613,9 @@ void print_congestion_control(CongestionControl* cc)
     printf("Duplicate ACKs:    %d/%d\n", cc->dup_ack_count, DUP_ACK_THRESHOLD);
     printf("Recovery Point:    %u\n", cc->recovery_point);
     printf("\nTiming Information:\n");
-    printf("RTT Estimate:      %u ms\n", cc->rtt);
-    printf("RTT Variance:      %u ms\n", cc->rttvar);
-    printf("RTO:               %u ms\n", cc->rto);
+    printf("RTT Estimate:      %.3f ms\n", cc->rtt_us / 1000.0);
+    printf("RTT Variance:      %.3f ms\n", cc->rttvar_us / 1000.0);
+    printf("RTO:               %.3f ms\n", cc->rto_us / 1000.0);
     printf("\nStatistics:\n");
     printf("Congestion Events: %u\n", cc->congestion_events);
     printf("Fast Retransmits:  %u\n", cc->fast_retransmits);
@@ -14,9 +14,18 @@
 
 // ==================== 日志宏定义 ====================
 
-#define LOG_INFO(fmt, ...) printf("[INFO] " fmt "\n", ##__VA_ARGS__)
-#define LOG_WARN(fmt, ...) printf("[WARN] " fmt "\n", ##__VA_ARGS__)
-#define LOG_ERROR(fmt, ...) printf("[ERROR] " fmt "\n", ##__VA_ARGS__)
+#define LOG_INFO(fmt, ...) log_message(LOG_LEVEL_INFO, fmt, ##__VA_ARGS__)
+#define LOG_WARN(fmt, ...) log_message(LOG_LEVEL_WARNING, fmt, ##__VA_ARGS__)
+#define LOG_ERROR(fmt, ...) log_message(LOG_LEVEL_ERROR, fmt, ##__VA_ARGS__)
+#define LOG_DEBUG(fmt, ...) log_message(LOG_LEVEL_DEBUG, fmt, ##__VA_ARGS__)
+
+// ==================== 接收端写盘配置 ====================
+
+// 每个连接的写入缓冲区上限：单个缓冲区至少容纳一整个接收窗口（MAX_WINDOW_FRAMES帧），
+// 连接数可能很多，比单连接服务器的FILE_IO_BUFFER_SIZE × FILE_IO_BUFFER_COUNT小；
+// 缓冲区按需增长，数据量小的连接只占用FILE_WRITER_INITIAL_CAPACITY左右
+#define CONNECTION_IO_BUFFER_SIZE (2 * 1024 * 1024)
+#define CONNECTION_IO_BUFFER_COUNT 2
 
 // ==================== 连接状态转换表 ====================
 
@@ -26,7 +35,7 @@
  */
 static const int valid_transitions[10][10] = {
     // CLOSED
-    {0, 1, 0, 0, 0, 0, 0, 0, 0, 0},
+    {0, 1, 1, 0, 0, 0, 0, 0, 0, 0},
     // LISTEN
     {0, 0, 0, 1, 0, 0, 0, 0, 0, 0},
     // SYN_SENT
@@ -47,6 +56,50 @@ static const int valid_transitions[10][10] = {
     {1, 0, 0, 0, 0, 0, 0, 0, 0, 0}
 };
 
+// ==================== 状态机动作表 ====================
+
+// 表项缩写，仅用于下表
+#define A_DROP CONN_ACTION_DROP
+#define A_SYN  CONN_ACTION_SYN
+#define A_SACK CONN_ACTION_SYN_ACK
+#define A_ACK  CONN_ACTION_ACK
+#define A_DATA CONN_ACTION_DATA
+#define A_FIN  CONN_ACTION_FIN
+#define A_FACK CONN_ACTION_FIN_ACK
+#define A_PAR  CONN_ACTION_PARITY
+
+/**
+ * [连接状态][帧类型] → 动作
+ * 各处理函数仍自行检查状态，这张表决定哪些帧值得交给它们：
+ * - SYN_RECEIVED收到DATA/FIN：握手的最后一个ACK丢失，由处理函数补做状态转换
+ * - ESTABLISHED收到ACK：接收端为零窗口探测
+ * - LAST_ACK收到FIN：FIN_ACK丢失，对端重发了FIN
+ * - NACK只由接收端发出，这里的连接都不处理（客户端发送循环自行处理）
+ * - PARITY只在ESTABLISHED处理：SYN_RECEIVED时还没有可还原的数据
+ */
+static const uint8_t state_actions[CONN_STATE_COUNT][CONN_FRAME_TYPE_COUNT] = {
+    //                SYN     SYN_ACK  ACK     FIN     FIN_ACK  DATA    NACK    PARITY
+    /* CLOSED       */ {A_DROP, A_DROP, A_DROP, A_DROP, A_DROP, A_DROP, A_DROP, A_DROP},
+    /* LISTEN       */ {A_SYN,  A_DROP, A_DROP, A_DROP, A_DROP, A_DROP, A_DROP, A_DROP},
+    /* SYN_SENT     */ {A_DROP, A_SACK, A_DROP, A_DROP, A_DROP, A_DROP, A_DROP, A_DROP},
+    /* SYN_RECEIVED */ {A_SYN,  A_DROP, A_ACK,  A_FIN,  A_DROP, A_DATA, A_DROP, A_DROP},
+    /* ESTABLISHED  */ {A_DROP, A_DROP, A_ACK,  A_FIN,  A_DROP, A_DATA, A_DROP, A_PAR },
+    /* FIN_WAIT_1   */ {A_DROP, A_DROP, A_DROP, A_FIN,  A_FACK, A_DROP, A_DROP, A_DROP},
+    /* FIN_WAIT_2   */ {A_DROP, A_DROP, A_DROP, A_DROP, A_DROP, A_DROP, A_DROP, A_DROP},
+    /* TIME_WAIT    */ {A_DROP, A_DROP, A_DROP, A_DROP, A_DROP, A_DROP, A_DROP, A_DROP},
+    /* CLOSE_WAIT   */ {A_DROP, A_DROP, A_DROP, A_DROP, A_DROP, A_DROP, A_DROP, A_DROP},
+    /* LAST_ACK     */ {A_DROP, A_DROP, A_DROP, A_FIN,  A_DROP, A_DROP, A_DROP, A_DROP}
+};
+
+#undef A_DROP
+#undef A_SYN
+#undef A_SACK
+#undef A_ACK
+#undef A_DATA
+#undef A_FIN
+#undef A_FACK
+#undef A_PAR
+
 // ==================== 状态字符串转换 ====================
 
 /**
@@ -134,6 +187,40 @@ bool update_connection_state(Connection* conn, ConnectionState new_state)
     return true;
 }
 
+// ==================== 帧发送 ====================
+
+/**
+ * 向对端发送帧
+ * 连接没有关联套接字时（sockfd < 0）只计数不发送，由调用方在UDP层发送
+ */
+static void connection_send(Connection* conn, const Frame* frame)
+{
+    if (conn->sockfd >= 0) {
+        send_packet(conn->sockfd, &conn->peer_addr, frame, conn->checksum_mode);
+    }
+    connection_count(&conn->frames_sent, 1);
+}
+
+/**
+ * 接收端回复累积ACK（确认号为下一个期望的序列号），
+ * 并按协商的移位数通告当前可用的接收缓冲
+ * 协商了选择确认时附带乱序接收位图；frame_type为NACK时表示刚发现空洞
+ */
+static void connection_send_ack(Connection* conn, FrameType frame_type)
+{
+    ReceiveWindow* window = conn->recv_window;
+    conn->ack_num = window->expected_seq;
+
+    Frame ack_frame;
+    ack_frame.seq_num = window->expected_seq;
+    ack_frame.ack_num = window->expected_seq;
+    ack_frame.window_size = window_encode(get_receive_window_available(window), conn->wscale);
+    ack_frame.frame_type = frame_type;
+    ack_frame.data_len = conn->sack_enabled ? (uint16_t)get_receive_sack(window, ack_frame.data, SACK_MAX_BYTES) : 0;
+    ack_frame.checksum = 0;
+    connection_send(conn, &ack_frame);
+}
+
 // ==================== 连接创建 ====================
 
 /**
@@ -167,23 +254,20 @@ Connection* create_server_connection(int port)
     // 初始化窗口大小
     conn->window_size = WINDOW_SIZE;
     conn->peer_window_size = 0;
+    conn->wscale = 0;
+    conn->peer_wscale = 0;
 
     // 初始化拥塞控制（RENO算法）
     conn->cwnd = 1 * MAX_DATA_LENGTH;      // 初始拥塞窗口 = 1 MSS
     conn->ssthresh = 65535;                 // 初始阈值（很大）
-    conn->inflight = 0;
 
     // 初始化超时和重传
-    conn->rto = TIMEOUT_MS;
-    conn->rtt = TIMEOUT_MS;
-    conn->retransmit_count = 0;
+    conn->rto_us = TIMEOUT_MS * 1000;
+    conn->rtt_us = 0;
     conn->last_activity = time(NULL);
 
-    // 初始化统计信息
-    conn->bytes_sent = 0;
-    conn->bytes_received = 0;
-    conn->frames_sent = 0;
-    conn->frames_received = 0;
+    // 初始化统计信息（计数器已由memset清零）
+    conn->start_time_us = get_monotonic_time_us();
 
     LOG_INFO("Server connection created, port=%d, initial_seq=%u", port, conn->seq_num);
 
@@ -230,29 +314,79 @@ Connection* create_client_connection(const char* server_ip, int port)
     // 初始化窗口大小
     conn->window_size = WINDOW_SIZE;
     conn->peer_window_size = 0;
+    conn->wscale = 0;
+    conn->peer_wscale = 0;
 
     // 初始化拥塞控制（RENO算法）
     conn->cwnd = 1 * MAX_DATA_LENGTH;      // 初始拥塞窗口 = 1 MSS
     conn->ssthresh = 65535;                 // 初始阈值（很大）
-    conn->inflight = 0;
 
     // 初始化超时和重传
-    conn->rto = TIMEOUT_MS;
-    conn->rtt = TIMEOUT_MS;
-    conn->retransmit_count = 0;
+    conn->rto_us = TIMEOUT_MS * 1000;
+    conn->rtt_us = 0;
     conn->last_activity = time(NULL);
 
-    // 初始化统计信息
-    conn->bytes_sent = 0;
-    conn->bytes_received = 0;
-    conn->frames_sent = 0;
-    conn->frames_received = 0;
+    // 初始化统计信息（计数器已由memset清零）
+    conn->start_time_us = get_monotonic_time_us();
 
     LOG_INFO("Client connection created, server=%s:%d, initial_seq=%u", server_ip, port, conn->seq_num);
 
     return conn;
 }
 
+// ==================== 接收端 ====================
+
+/**
+ * 为服务器连接打开接收端
+ */
+bool connection_open_receiver(Connection* conn, int window_size, const char* output_path,
+                              FileWriteQueue* write_queue)
+{
+    if (conn == NULL || output_path == NULL || window_size <= 0) {
+        LOG_ERROR("Invalid parameters for receiver");
+        return false;
+    }
+
+    conn->recv_window = create_receive_window(window_size, MAX_DATA_LENGTH);
+    conn->output = create_file_writer(output_path, CONNECTION_IO_BUFFER_SIZE, CONNECTION_IO_BUFFER_COUNT,
+                                      write_queue);
+
+    if (conn->recv_window == NULL || conn->output == NULL) {
+        LOG_ERROR("Failed to open receiver: output=%s", output_path);
+        connection_close_receiver(conn);
+        return false;
+    }
+
+    conn->window_size = (uint16_t)window_size;
+
+    LOG_INFO("Receiver opened: window=%d, output=%s", window_size, output_path);
+    return true;
+}
+
+/**
+ * 关闭连接的接收端
+ */
+void connection_close_receiver(Connection* conn)
+{
+    if (conn == NULL) {
+        return;
+    }
+
+    if (conn->output != NULL) {
+        if (!close_file_writer(conn->output)) {
+            LOG_ERROR("Failed to write output file");
+        }
+        conn->output = NULL;
+    }
+
+    if (conn->recv_window != NULL && conn->recv_window->fec_k > 0) {
+        LOG_INFO("FEC recovered %u frames", conn->recv_window->fec_recovered);
+    }
+
+    free_receive_window(conn->recv_window);
+    conn->recv_window = NULL;
+}
+
 // ==================== 三次握手：服务器侧 ====================
 
 /**
@@ -280,7 +414,7 @@ bool server_listen(Connection* conn)
  * 
  * 三次握手第2步：
  * 1. 接收客户端的SYN帧
- * 2. 提取客户端的初始序列号
+ * 2. 提取客户端的初始序列号，协商握手选项
  * 3. 发送SYN-ACK响应
  * 4. 状态转为SYN_RECEIVED
  */
@@ -291,40 +425,97 @@ bool handle_syn(Connection* conn, const Frame* frame)
         return false;
     }
 
-    // 检查当前状态
-    if (conn->state != LISTEN) {
-        LOG_WARN("Received SYN in non-LISTEN state: %s", connection_state_to_string(conn->state));
-        return false;
-    }
-
     // 检查帧类型
     if (frame->frame_type != SYN) {
         LOG_ERROR("Expected SYN frame, got %s", frame_type_to_string((FrameType)frame->frame_type));
         return false;
     }
 
-    // 保存客户端的初始序列号
-    conn->peer_seq_num = frame->seq_num;
-    conn->ack_num = frame->seq_num + 1;  // 期望接收的下一个序列号
-    conn->peer_window_size = frame->window_size;
-
-    LOG_INFO("Received SYN from client: seq=%u, window=%u", frame->seq_num, frame->window_size);
+    // SYN-ACK丢失，客户端重发了SYN：按已协商的结果重发SYN-ACK
+    bool retransmitted = (conn->state == SYN_RECEIVED && frame->seq_num == conn->peer_seq_num);
 
-    // 状态转换：LISTEN → SYN_RECEIVED
-    if (!update_connection_state(conn, SYN_RECEIVED)) {
-        LOG_ERROR("Failed to transition to SYN_RECEIVED state");
+    // 检查当前状态
+    if (conn->state != LISTEN && !retransmitted) {
+        LOG_WARN("Received SYN in non-LISTEN state: %s", connection_state_to_string(conn->state));
         return false;
     }
 
-    // 构造SYN-ACK响应帧
+    if (!retransmitted) {
+        // 保存客户端的初始序列号
+        conn->peer_seq_num = frame->seq_num;
+        conn->ack_num = frame->seq_num + 1;  // 期望接收的下一个序列号
+        conn->peer_window_size = frame->window_size;
+
+        LOG_INFO("Received SYN from client: seq=%u, window=%u", frame->seq_num, frame->window_size);
+
+        if (conn->recv_window != NULL) {
+            // 第一个DATA帧的序列号为客户端ISN + 1
+            conn->recv_window->base = frame->seq_num + 1;
+            conn->recv_window->expected_seq = frame->seq_num + 1;
+
+            // SYN携带客户端的发送窗口（帧数）；接收窗口更小时扩大到同样大小
+            int client_window = frame->window_size;
+            if (client_window > conn->recv_window->window_size && client_window <= MAX_WINDOW_FRAMES) {
+                resize_receive_window(conn->recv_window, client_window);
+            }
+
+            // 客户端请求CRC32C帧尾时同意
+            if (frame_find_option(frame, OPT_CRC32C, NULL) != NULL) {
+                conn->checksum_mode = CHECKSUM_CRC32C;
+            }
+
+            // 客户端支持选择确认时同意：ACK附带位图，发现空洞时发送NACK
+            if (frame_find_option(frame, OPT_SACK, NULL) != NULL) {
+                conn->sack_enabled = true;
+            }
+
+            // 客户端开启了FEC：按它的分组大小接收校验帧
+            uint8_t fec_len = 0;
+            const uint8_t* fec = frame_find_option(frame, OPT_FEC, &fec_len);
+            if (fec != NULL && fec_len == 1) {
+                enable_receive_fec(conn->recv_window, fec[0], frame->seq_num + 1);
+            }
+        }
+
+        // 客户端带了窗口缩放选项时同意，本端移位数按（扩大后的）接收缓冲计算
+        uint8_t len = 0;
+        const uint8_t* wscale = frame_find_option(frame, OPT_WSCALE, &len);
+        if (wscale != NULL && len == 1) {
+            conn->peer_wscale = (wscale[0] > MAX_WSCALE) ? MAX_WSCALE : wscale[0];
+            int frames = (conn->recv_window != NULL) ? conn->recv_window->window_size : conn->window_size;
+            conn->wscale = window_scale_for((uint32_t)frames * MAX_DATA_LENGTH);
+        }
+
+        // 状态转换：LISTEN → SYN_RECEIVED
+        if (!update_connection_state(conn, SYN_RECEIVED)) {
+            LOG_ERROR("Failed to transition to SYN_RECEIVED state");
+            return false;
+        }
+    }
+
+    // 构造SYN-ACK响应帧：通告实际可用的接收缓冲（SYN_ACK的窗口不缩放），回显同意的选项
+    uint16_t window = (conn->recv_window != NULL) ? window_encode(get_receive_window_available(conn->recv_window), 0)
+                                                  : conn->window_size;
     Frame response;
-    response = create_frame(conn->seq_num, conn->ack_num, conn->window_size,
-                            SYN_ACK, NULL, 0);
+    response = create_frame(conn->seq_num, conn->ack_num, window, SYN_ACK, NULL, 0);
+    if (conn->checksum_mode == CHECKSUM_CRC32C) {
+        frame_add_option(&response, OPT_CRC32C, NULL, 0);
+    }
+    if (frame_find_option(frame, OPT_WSCALE, NULL) != NULL) {
+        frame_add_option(&response, OPT_WSCALE, &conn->wscale, 1);
+    }
+    if (conn->sack_enabled) {
+        frame_add_option(&response, OPT_SACK, NULL, 0);
+    }
+    if (conn->recv_window != NULL && conn->recv_window->fec_k > 0) {
+        uint8_t fec_k = (uint8_t)conn->recv_window->fec_k;
+        frame_add_option(&response, OPT_FEC, &fec_k, 1);
+    }
 
     LOG_INFO("Sending SYN-ACK: seq=%u, ack=%u, window=%u", response.seq_num, response.ack_num, response.window_size);
 
-    // 这里应该发送响应帧（实现在UDP层）
-    conn->frames_sent++;
+    // SYN/SYN_ACK不带帧尾，校验模式不影响其编码
+    connection_send(conn, &response);
 
     return true;
 }
@@ -363,10 +554,14 @@ bool client_connect(Connection* conn)
     syn_frame = create_frame(conn->seq_num, 0, conn->window_size,
                              SYN, NULL, 0);
 
-    LOG_INFO("Sending SYN: seq=%u, window=%u", syn_frame.seq_num, syn_frame.window_size);
+    // 提议窗口缩放；服务器回显之前先不启用
+    conn->wscale = window_scale_for((uint32_t)conn->window_size * MAX_DATA_LENGTH);
+    frame_add_option(&syn_frame, OPT_WSCALE, &conn->wscale, 1);
+    frame_add_option(&syn_frame, OPT_SACK, NULL, 0);
 
-    // 这里应该发送SYN帧（实现在UDP层）
-    conn->frames_sent++;
+    LOG_INFO("Sending SYN: seq=%u, window=%u, wscale=%u", syn_frame.seq_num, syn_frame.window_size, conn->wscale);
+
+    connection_send(conn, &syn_frame);
     conn->last_activity = time(NULL);
 
     return true;
@@ -411,6 +606,17 @@ bool handle_syn_ack(Connection* conn, const Frame* frame)
     conn->ack_num = frame->seq_num + 1;  // 期望接收的下一个序列号
     conn->peer_window_size = frame->window_size;
 
+    // 服务器回显了窗口缩放选项才启用，否则两个方向都不缩放
+    uint8_t len = 0;
+    const uint8_t* wscale = frame_find_option(frame, OPT_WSCALE, &len);
+    if (wscale != NULL && len == 1) {
+        conn->peer_wscale = (wscale[0] > MAX_WSCALE) ? MAX_WSCALE : wscale[0];
+    } else {
+        conn->wscale = 0;
+        conn->peer_wscale = 0;
+    }
+    conn->sack_enabled = (frame_find_option(frame, OPT_SACK, NULL) != NULL);
+
     LOG_INFO("Received SYN-ACK from server: seq=%u, ack=%u, window=%u", 
              frame->seq_num, frame->ack_num, frame->window_size);
 
@@ -427,8 +633,7 @@ bool handle_syn_ack(Connection* conn, const Frame* frame)
 
     LOG_INFO("Sending ACK: seq=%u, ack=%u", ack_frame.seq_num, ack_frame.ack_num);
 
-    // 这里应该发送ACK帧（实现在UDP层）
-    conn->frames_sent++;
+    connection_send(conn, &ack_frame);
 
     return true;
 }
@@ -439,6 +644,8 @@ bool handle_syn_ack(Connection* conn, const Frame* frame)
  * 三次握手第3步或常规数据确认：
  * 1. 在SYN_RECEIVED状态接收ACK→转为ESTABLISHED
  * 2. 在ESTABLISHED状态接收ACK→更新窗口
+ * 3. 接收端在ESTABLISHED状态收到的ACK是发送端的零窗口探测，
+ *    回复当前的累积ACK和可用窗口
  */
 bool handle_ack(Connection* conn, const Frame* frame)
 {
@@ -472,14 +679,20 @@ bool handle_ack(Connection* conn, const Frame* frame)
             return false;
         }
 
-        conn->peer_window_size = frame->window_size;
+        conn->peer_window_size = window_decode(frame->window_size, conn->peer_wscale);
+
+    } else if (conn->state == ESTABLISHED && conn->recv_window != NULL) {
+        // 零窗口探测：发送端在窗口重新打开前周期性发送，回复窗口更新
+        LOG_INFO("Window probe: seq=%u, advertising %u bytes",
+                 frame->seq_num, get_receive_window_available(conn->recv_window));
+        connection_send_ack(conn, ACK);
 
     } else if (conn->state == ESTABLISHED) {
         // 常规数据确认或连接状态帧
         
         // 更新ACK号和窗口大小
         conn->ack_num = frame->seq_num + 1;
-        conn->peer_window_size = frame->window_size;
+        conn->peer_window_size = window_decode(frame->window_size, conn->peer_wscale);
 
         LOG_INFO("Received ACK in ESTABLISHED: seq=%u, ack=%u, window=%u",
                  frame->seq_num, frame->ack_num, frame->window_size);
@@ -489,7 +702,109 @@ bool handle_ack(Connection* conn, const Frame* frame)
         return false;
     }
 
-    conn->frames_received++;
+    connection_count(&conn->frames_received, 1);
+    return true;
+}
+
+// ==================== 数据接收 ====================
+
+/**
+ * 把窗口首部的连续数据直接交付到写入器的缓冲区，不在网络循环中写盘
+ */
+static void deliver_contiguous(Connection* conn)
+{
+    ReceiveWindow* window = conn->recv_window;
+    uint8_t* dst = file_writer_reserve(conn->output, (size_t)window->window_size * MAX_DATA_LENGTH);
+    int contiguous = (dst != NULL) ? get_contiguous_data(window, dst) : 0;
+    if (contiguous > 0) {
+        file_writer_commit(conn->output, contiguous);
+        connection_count(&conn->bytes_received, (uint64_t)contiguous);
+    }
+}
+
+/**
+ * 处理接收到的DATA帧
+ * 
+ * 1. 序列号小于期望值：重复帧（之前的ACK丢失），只回复ACK
+ * 2. 超出接收窗口：丢弃，等待发送端重传
+ * 3. 否则缓冲到窗口中；填补了窗口首部的空洞时把连续数据一次写入文件
+ * 最后回复累积ACK（确认号为下一个期望的序列号）；协商了选择确认时，
+ * 新到的乱序帧前一个位置缺失（出现了新的空洞）则改为回复NACK，
+ * 发送端不必等3个重复ACK或超时
+ */
+bool handle_data(Connection* conn, const FrameView* view)
+{
+    if (conn == NULL || view == NULL || conn->recv_window == NULL) {
+        LOG_ERROR("Connection, frame view or receive window is NULL");
+        return false;
+    }
+
+    // 第三次握手的ACK丢失时，客户端已开始发送数据
+    if (conn->state == SYN_RECEIVED) {
+        LOG_WARN("Final handshake ACK lost, DATA received, connection established");
+        if (!update_connection_state(conn, ESTABLISHED)) {
+            return false;
+        }
+    }
+
+    if (conn->state != ESTABLISHED) {
+        LOG_WARN("Received DATA in unexpected state: %s", connection_state_to_string(conn->state));
+        return false;
+    }
+
+    ReceiveWindow* window = conn->recv_window;
+    uint32_t seq = view->seq_num;
+    uint32_t expected = window->expected_seq;
+    FrameType reply = ACK;
+
+    connection_count(&conn->frames_received, 1);
+
+    if (seq_lt(seq, expected)) {
+        // 重复数据包（之前的ACK丢失或发送端超时重传）
+        connection_count(&conn->retransmit_count, 1);
+    }
+    else if (seq - expected < (uint32_t)window->window_size) {
+        // 新到的乱序帧前一个位置还是空的：这里出现了新的空洞
+        bool new_gap = seq != expected && !is_seq_received(window, seq) && !is_seq_received(window, seq - 1);
+
+        if (receive_payload(window, seq, view->payload, view->data_len)) {
+            // 这一帧可能让FEC还原出了前面的空洞
+            if (new_gap && conn->sack_enabled && !is_seq_received(window, seq - 1)) {
+                reply = NACK;
+            }
+
+            deliver_contiguous(conn);
+        }
+    }
+
+    // 发送累积ACK（或NACK）
+    connection_send_ack(conn, reply);
+
+    return true;
+}
+
+/**
+ * 处理接收到的PARITY帧
+ * 
+ * 校验帧不占序列号，ack_num为组内帧数，window_size为组内各帧长度的异或
+ */
+bool handle_parity(Connection* conn, const FrameView* view)
+{
+    if (conn == NULL || view == NULL || conn->recv_window == NULL) {
+        LOG_ERROR("Connection, frame view or receive window is NULL");
+        return false;
+    }
+
+    connection_count(&conn->frames_received, 1);
+
+    if (view->ack_num > FEC_MAX_GROUP ||
+        !receive_parity(conn->recv_window, view->seq_num, (uint16_t)view->ack_num, view->window_size,
+                        view->payload, view->data_len)) {
+        return true;
+    }
+
+    deliver_contiguous(conn);
+    connection_send_ack(conn, ACK);
     return true;
 }
 
@@ -528,8 +843,7 @@ bool send_fin(Connection* conn)
 
     LOG_INFO("Sending FIN: seq=%u, ack=%u", fin_frame.seq_num, fin_frame.ack_num);
 
-    // 这里应该发送FIN帧（实现在UDP层）
-    conn->frames_sent++;
+    connection_send(conn, &fin_frame);
     conn->seq_num++;  // FIN消耗一个序列号
 
     return true;
@@ -556,28 +870,40 @@ bool handle_fin(Connection* conn, const Frame* frame)
         return false;
     }
 
+    // 握手的最后一个ACK丢失且没有数据（空文件）时，FIN同样表明连接已建立
+    if (conn->state == SYN_RECEIVED && conn->recv_window != NULL) {
+        update_connection_state(conn, ESTABLISHED);
+    }
+
     // 检查当前状态
-    if (conn->state == ESTABLISHED) {
-        // 被动关闭：收到FIN，进入CLOSE_WAIT
-        
-        conn->ack_num = frame->seq_num + 1;  // 确认FIN
+    if (conn->state == ESTABLISHED || conn->state == LAST_ACK) {
+        // 被动关闭：收到FIN，回复FIN_ACK
+        // FIN_ACK同时携带本端的FIN，对端不再回复ACK，因此经CLOSE_WAIT直接进入LAST_ACK，
+        // 在LAST_ACK停留期间收到重发的FIN（FIN_ACK丢失）时再次回复
+        bool retransmitted = (conn->state == LAST_ACK);
+        if (!retransmitted) {
+            conn->ack_num = frame->seq_num + 1;  // 确认FIN
+        }
 
-        LOG_INFO("Received FIN from peer: seq=%u", frame->seq_num);
+        LOG_INFO("Received FIN from peer: seq=%u%s", frame->seq_num, retransmitted ? " (retransmitted)" : "");
 
-        // 构造ACK响应
-        Frame ack_frame;
-        ack_frame = create_frame(conn->seq_num, conn->ack_num, conn->window_size,
-                                 ACK, NULL, 0);
+        // 构造FIN_ACK响应
+        Frame fin_ack_frame;
+        fin_ack_frame = create_frame(retransmitted ? conn->seq_num - 1 : conn->seq_num, conn->ack_num,
+                                     conn->window_size, FIN_ACK, NULL, 0);
 
-        LOG_INFO("Sending ACK: seq=%u, ack=%u", ack_frame.seq_num, ack_frame.ack_num);
+        LOG_INFO("Sending FIN-ACK: seq=%u, ack=%u", fin_ack_frame.seq_num, fin_ack_frame.ack_num);
 
-        // 这里应该发送ACK帧（实现在UDP层）
-        conn->frames_sent++;
+        connection_send(conn, &fin_ack_frame);
 
-        // 状态转换：ESTABLISHED → CLOSE_WAIT
-        if (!update_connection_state(conn, CLOSE_WAIT)) {
-            LOG_ERROR("Failed to transition to CLOSE_WAIT state");
-            return false;
+        if (!retransmitted) {
+            conn->seq_num++;  // FIN消耗一个序列号
+
+            // 状态转换：ESTABLISHED → CLOSE_WAIT → LAST_ACK
+            if (!update_connection_state(conn, CLOSE_WAIT) || !update_connection_state(conn, LAST_ACK)) {
+                LOG_ERROR("Failed to transition to LAST_ACK state");
+                return false;
+            }
         }
 
     } else if (conn->state == FIN_WAIT_1) {
@@ -594,8 +920,7 @@ bool handle_fin(Connection* conn, const Frame* frame)
 
         LOG_INFO("Sending ACK: seq=%u, ack=%u", ack_frame.seq_num, ack_frame.ack_num);
 
-        // 这里应该发送ACK帧（实现在UDP层）
-        conn->frames_sent++;
+        connection_send(conn, &ack_frame);
 
         // 状态转换：FIN_WAIT_1 → TIME_WAIT
         if (!update_connection_state(conn, TIME_WAIT)) {
@@ -608,7 +933,7 @@ bool handle_fin(Connection* conn, const Frame* frame)
         return false;
     }
 
-    conn->frames_received++;
+    connection_count(&conn->frames_received, 1);
     return true;
 }
 
@@ -655,7 +980,7 @@ bool close_connection(Connection* conn)
                 fin_frame = create_frame(conn->seq_num, conn->ack_num, conn->window_size,
                                          FIN, NULL, 0);
                 LOG_INFO("Sending FIN from CLOSE_WAIT: seq=%u", fin_frame.seq_num);
-                conn->frames_sent++;
+                connection_send(conn, &fin_frame);
                 conn->seq_num++;
                 update_connection_state(conn, LAST_ACK);
             }
@@ -681,25 +1006,135 @@ bool close_connection(Connection* conn)
     return true;
 }
 
+// ==================== 帧分派 ====================
+
+/**
+ * 查询状态机动作
+ */
+ConnectionAction connection_action(ConnectionState state, uint8_t frame_type)
+{
+    if ((unsigned)state >= CONN_STATE_COUNT || frame_type >= CONN_FRAME_TYPE_COUNT) {
+        return CONN_ACTION_DROP;
+    }
+    return (ConnectionAction)state_actions[state][frame_type];
+}
+
+/**
+ * 按状态机表处理一批帧
+ */
+int connection_dispatch(Connection* conn, const FrameView* views, int count)
+{
+    if (conn == NULL || views == NULL || count <= 0) {
+        return 0;
+    }
+
+    int accepted = 0;
+    Frame frame;
+
+    for (int i = 0; i < count; i++) {
+        const FrameView* view = &views[i];
+        bool ok = false;
+
+        // 控制帧数量少，复制为Frame交给原有的处理函数；DATA和PARITY直接按视图处理，不复制数据
+        switch (connection_action(conn->state, view->frame_type)) {
+            case CONN_ACTION_SYN:
+                frame_view_to_frame(view, &frame);
+                ok = handle_syn(conn, &frame);
+                break;
+
+            case CONN_ACTION_SYN_ACK:
+                frame_view_to_frame(view, &frame);
+                ok = handle_syn_ack(conn, &frame);
+                break;
+
+            case CONN_ACTION_ACK:
+                frame_view_to_frame(view, &frame);
+                ok = handle_ack(conn, &frame);
+                break;
+
+            case CONN_ACTION_DATA:
+                ok = handle_data(conn, view);
+                break;
+
+            case CONN_ACTION_PARITY:
+                ok = handle_parity(conn, view);
+                break;
+
+            case CONN_ACTION_FIN:
+                frame_view_to_frame(view, &frame);
+                ok = handle_fin(conn, &frame);
+                break;
+
+            case CONN_ACTION_FIN_ACK:
+                frame_view_to_frame(view, &frame);
+                ok = handle_fin_ack(conn, &frame);
+                break;
+
+            default:
+                LOG_DEBUG("Dropped %s in state %s", frame_type_to_string((FrameType)view->frame_type),
+                          connection_state_to_string(conn->state));
+                break;
+        }
+
+        if (ok) {
+            accepted++;
+        }
+    }
+
+    conn->last_activity = time(NULL);
+    return accepted;
+}
+
 // ==================== 连接信息和统计 ====================
 
 /**
- * 获取连接统计信息
+ * 获取连接统计快照
  */
-bool connection_get_stats(const Connection* conn, uint32_t* sent, uint32_t* received, uint32_t* retransmits)
+bool connection_get_stats(const Connection* conn, ConnectionStats* stats)
 {
-    if (conn == NULL || sent == NULL || received == NULL || retransmits == NULL) {
+    if (conn == NULL || stats == NULL) {
         LOG_ERROR("Invalid parameters");
         return false;
     }
 
-    *sent = conn->bytes_sent;
-    *received = conn->bytes_received;
-    *retransmits = conn->retransmit_count;
+    // 数据路径上的线程可能同时在更新，逐字段relaxed读取
+    stats->state = __atomic_load_n(&conn->state, __ATOMIC_RELAXED);
+    stats->bytes_sent = __atomic_load_n(&conn->bytes_sent, __ATOMIC_RELAXED);
+    stats->bytes_acked = __atomic_load_n(&conn->bytes_acked, __ATOMIC_RELAXED);
+    stats->bytes_received = __atomic_load_n(&conn->bytes_received, __ATOMIC_RELAXED);
+    stats->frames_sent = __atomic_load_n(&conn->frames_sent, __ATOMIC_RELAXED);
+    stats->frames_received = __atomic_load_n(&conn->frames_received, __ATOMIC_RELAXED);
+    stats->retransmit_count = __atomic_load_n(&conn->retransmit_count, __ATOMIC_RELAXED);
+    stats->cwnd = __atomic_load_n(&conn->cwnd, __ATOMIC_RELAXED);
+    stats->ssthresh = __atomic_load_n(&conn->ssthresh, __ATOMIC_RELAXED);
+    stats->rtt_us = __atomic_load_n(&conn->rtt_us, __ATOMIC_RELAXED);
+    stats->rto_us = __atomic_load_n(&conn->rto_us, __ATOMIC_RELAXED);
+
+    uint64_t now = get_monotonic_time_us();
+    stats->elapsed_us = (now > conn->start_time_us) ? now - conn->start_time_us : 0;
+
+    // 发送端统计已确认的字节，接收端统计已交付的字节；比特/微秒即Mbps
+    uint64_t payload = stats->bytes_acked + stats->bytes_received;
+    stats->goodput_mbps = (stats->elapsed_us > 0) ? (double)payload * 8 / stats->elapsed_us : 0.0;
 
     return true;
 }
 
+/**
+ * 把拥塞控制的当前值镜像到连接中
+ */
+void connection_update_congestion(Connection* conn, const CongestionControl* cc)
+{
+    if (conn == NULL || cc == NULL) {
+        return;
+    }
+
+    __atomic_store_n(&conn->cwnd, cc->cwnd, __ATOMIC_RELAXED);
+    __atomic_store_n(&conn->ssthresh, cc->ssthresh, __ATOMIC_RELAXED);
+    __atomic_store_n(&conn->rtt_us, cc->rtt_us, __ATOMIC_RELAXED);
+    __atomic_store_n(&conn->rto_us, cc->rto_us, __ATOMIC_RELAXED);
+}
+
 /**
  * 打印连接信息（调试用）
  */
@@ -719,13 +1154,14 @@ void connection_print(const Connection* conn)
     printf("Peer Window:       %u\n", conn->peer_window_size);
     printf("CWND:              %u\n", conn->cwnd);
     printf("SSTHRESH:          %u\n", conn->ssthresh);
-    printf("RTT:               %u ms\n", conn->rtt);
-    printf("RTO:               %u ms\n", conn->rto);
-    printf("Bytes Sent:        %u\n", conn->bytes_sent);
-    printf("Bytes Received:    %u\n", conn->bytes_received);
-    printf("Frames Sent:       %u\n", conn->frames_sent);
-    printf("Frames Received:   %u\n", conn->frames_received);
-    printf("Retransmissions:   %u\n", conn->retransmit_count);
+    printf("RTT:               %u us\n", conn->rtt_us);
+    printf("RTO:               %u us\n", conn->rto_us);
+    printf("Bytes Sent:        %llu\n", (unsigned long long)conn->bytes_sent);
+    printf("Bytes Acked:       %llu\n", (unsigned long long)conn->bytes_acked);
+    printf("Bytes Received:    %llu\n", (unsigned long long)conn->bytes_received);
+    printf("Frames Sent:       %llu\n", (unsigned long long)conn->frames_sent);
+    printf("Frames Received:   %llu\n", (unsigned long long)conn->frames_received);
+    printf("Retransmissions:   %llu\n", (unsigned long long)conn->retransmit_count);
     printf("===========================================\n");
 }
 
@@ -743,6 +1179,9 @@ void connection_free(Connection* conn)
         close_connection(conn);
     }
 
+    // 释放接收端
+    connection_close_receiver(conn);
+
     // 关闭套接字
     if (conn->sockfd >= 0) {
         // close(conn->sockfd);  // 实际实现
@@ -754,3 +1193,162 @@ void connection_free(Connection* conn)
 
     LOG_INFO("Connection freed");
 }
+
+// ==================== 连接表 ====================
+
+/**
+ * 对端地址的哈希值（IP和端口分别乘以奇数常量后混合）
+ */
+static uint32_t hash_peer(const struct sockaddr_in* addr)
+{
+    uint32_t h = (uint32_t)addr->sin_addr.s_addr * 2654435761u;
+    h ^= (uint32_t)addr->sin_port * 40503u;
+    h ^= h >> 16;
+    return h;
+}
+
+/**
+ * 桶数翻倍并重新分布所有连接
+ */
+static bool grow_connection_table(ConnectionTable* table)
+{
+    int new_count = table->bucket_count * 2;
+    Connection** new_buckets = (Connection**)calloc(new_count, sizeof(Connection*));
+    if (new_buckets == NULL) {
+        return false;
+    }
+
+    for (int i = 0; i < table->bucket_count; i++) {
+        Connection* conn = table->buckets[i];
+        while (conn != NULL) {
+            Connection* next = conn->hash_next;
+            uint32_t index = hash_peer(&conn->peer_addr) & (uint32_t)(new_count - 1);
+            conn->hash_next = new_buckets[index];
+            new_buckets[index] = conn;
+            conn = next;
+        }
+    }
+
+    free(table->buckets);
+    table->buckets = new_buckets;
+    table->bucket_count = new_count;
+    return true;
+}
+
+/**
+ * 创建连接表
+ */
+ConnectionTable* create_connection_table(int bucket_count)
+{
+    ConnectionTable* table = (ConnectionTable*)malloc(sizeof(ConnectionTable));
+    if (table == NULL) {
+        LOG_ERROR("Failed to allocate connection table");
+        return NULL;
+    }
+
+    // 桶数向上取整到2的幂，下标用位与代替取模
+    int count = 16;
+    while (count < bucket_count) {
+        count *= 2;
+    }
+
+    table->buckets = (Connection**)calloc(count, sizeof(Connection*));
+    if (table->buckets == NULL) {
+        LOG_ERROR("Failed to allocate connection table buckets");
+        free(table);
+        return NULL;
+    }
+    table->bucket_count = count;
+    table->count = 0;
+
+    return table;
+}
+
+/**
+ * 按对端地址查找连接
+ */
+Connection* connection_table_find(ConnectionTable* table, const struct sockaddr_in* addr)
+{
+    if (table == NULL || addr == NULL) {
+        return NULL;
+    }
+
+    uint32_t index = hash_peer(addr) & (uint32_t)(table->bucket_count - 1);
+    for (Connection* conn = table->buckets[index]; conn != NULL; conn = conn->hash_next) {
+        if (same_peer(&conn->peer_addr, addr)) {
+            return conn;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * 插入连接
+ */
+bool connection_table_insert(ConnectionTable* table, Connection* conn)
+{
+    if (table == NULL || conn == NULL) {
+        return false;
+    }
+
+    // 负载因子超过1时扩容；扩容失败时仍可插入，只是链更长
+    if (table->count >= table->bucket_count) {
+        grow_connection_table(table);
+    }
+
+    uint32_t index = hash_peer(&conn->peer_addr) & (uint32_t)(table->bucket_count - 1);
+    conn->hash_next = table->buckets[index];
+    table->buckets[index] = conn;
+    table->count++;
+
+    return true;
+}
+
+/**
+ * 从连接表中移除连接
+ */
+bool connection_table_remove(ConnectionTable* table, Connection* conn)
+{
+    if (table == NULL || conn == NULL) {
+        return false;
+    }
+
+    uint32_t index = hash_peer(&conn->peer_addr) & (uint32_t)(table->bucket_count - 1);
+    Connection** link = &table->buckets[index];
+    while (*link != NULL) {
+        if (*link == conn) {
+            *link = conn->hash_next;
+            conn->hash_next = NULL;
+            table->count--;
+            return true;
+        }
+        link = &(*link)->hash_next;
+    }
+
+    return false;
+}
+
+/**
+ * 释放连接表及表中所有连接
+ * 整表释放不是有意关闭某个连接（如服务器退出），不向对端发送FIN
+ */
+void free_connection_table(ConnectionTable* table)
+{
+    if (table == NULL) {
+        return;
+    }
+
+    for (int i = 0; i < table->bucket_count; i++) {
+        Connection* conn = table->buckets[i];
+        while (conn != NULL) {
+            Connection* next = conn->hash_next;
+            conn->sockfd = -1;
+            connection_free(conn);
+            conn = next;
+        }
+    }
+
+    free(table->buckets);
+    free(table);
+}
@@ -0,0 +1,623 @@
+#include "file_io.h"
+#include "utils.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _WIN32
+    #include <malloc.h>
+#endif
+
+// ==================== I/O缓冲区分配 ====================
+
+/**
+ * 分配一组按页对齐的I/O缓冲区
+ */
+static IoBuffer* alloc_io_buffers(size_t buffer_size, int buffer_count)
+{
+    IoBuffer* buffers = (IoBuffer*)calloc(buffer_count, sizeof(IoBuffer));
+    if (buffers == NULL) {
+        return NULL;
+    }
+
+    for (int i = 0; i < buffer_count; i++) {
+#ifdef _WIN32
+        buffers[i].data = (uint8_t*)_aligned_malloc(buffer_size, FILE_IO_ALIGNMENT);
+#else
+        void* ptr = NULL;
+        buffers[i].data = (posix_memalign(&ptr, FILE_IO_ALIGNMENT, buffer_size) == 0) ? (uint8_t*)ptr : NULL;
+#endif
+        if (buffers[i].data == NULL) {
+            for (int j = 0; j < i; j++) {
+#ifdef _WIN32
+                _aligned_free(buffers[j].data);
+#else
+                free(buffers[j].data);
+#endif
+            }
+            free(buffers);
+            return NULL;
+        }
+        buffers[i].capacity = buffer_size;
+    }
+
+    return buffers;
+}
+
+/**
+ * 把缓冲区扩大到至少needed字节（按页对齐，保留已有数据）
+ * 容量从FILE_WRITER_INITIAL_CAPACITY开始翻倍，不超过limit
+ */
+static bool grow_io_buffer(IoBuffer* buffer, size_t needed, size_t limit)
+{
+    size_t capacity = (buffer->capacity > 0) ? buffer->capacity : FILE_WRITER_INITIAL_CAPACITY;
+    while (capacity < needed) {
+        capacity *= 2;
+    }
+    if (capacity > limit) {
+        capacity = limit;
+    }
+
+    uint8_t* data;
+#ifdef _WIN32
+    data = (uint8_t*)_aligned_malloc(capacity, FILE_IO_ALIGNMENT);
+#else
+    void* ptr = NULL;
+    data = (posix_memalign(&ptr, FILE_IO_ALIGNMENT, capacity) == 0) ? (uint8_t*)ptr : NULL;
+#endif
+    if (data == NULL) {
+        return false;
+    }
+
+    if (buffer->data != NULL) {
+        memcpy(data, buffer->data, buffer->len);
+#ifdef _WIN32
+        _aligned_free(buffer->data);
+#else
+        free(buffer->data);
+#endif
+    }
+    buffer->data = data;
+    buffer->capacity = capacity;
+    return true;
+}
+
+/**
+ * 释放alloc_io_buffers()分配的缓冲区
+ */
+static void free_io_buffers(IoBuffer* buffers, int buffer_count)
+{
+    if (buffers == NULL) {
+        return;
+    }
+
+    for (int i = 0; i < buffer_count; i++) {
+#ifdef _WIN32
+        _aligned_free(buffers[i].data);
+#else
+        free(buffers[i].data);
+#endif
+    }
+    free(buffers);
+}
+
+// ==================== 预读文件读取器 ====================
+
+/**
+ * 预读线程：空闲缓冲区可用时读入下一块，读到文件末尾后退出
+ */
+static void* file_reader_main(void* arg)
+{
+    FileReader* reader = (FileReader*)arg;
+
+    while (1) {
+        pthread_mutex_lock(&reader->lock);
+        while (reader->filled == reader->buffer_count && !reader->stop) {
+            pthread_cond_wait(&reader->cond, &reader->lock);
+        }
+        if (reader->stop) {
+            pthread_mutex_unlock(&reader->lock);
+            break;
+        }
+        IoBuffer* buffer = &reader->buffers[(reader->head + reader->filled) % reader->buffer_count];
+        pthread_mutex_unlock(&reader->lock);
+
+        // 在锁外读盘：该缓冲区不在网络循环的可见范围内
+        size_t n = fread(buffer->data, 1, reader->buffer_size, reader->file);
+
+        pthread_mutex_lock(&reader->lock);
+        buffer->len = n;
+        if (n > 0) {
+            reader->filled++;
+        }
+        if (n < reader->buffer_size) {
+            reader->eof = true;
+            reader->error = (ferror(reader->file) != 0);
+        }
+        pthread_cond_signal(&reader->cond);
+        bool done = reader->eof;
+        pthread_mutex_unlock(&reader->lock);
+
+        if (done) {
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * 打开文件并启动预读线程
+ */
+FileReader* create_file_reader(const char* filename, size_t buffer_size, int buffer_count)
+{
+    if (filename == NULL || buffer_size == 0 || buffer_count < 2) {
+        log_message(2, "Invalid parameters for file reader");
+        return NULL;
+    }
+
+    FileReader* reader = (FileReader*)calloc(1, sizeof(FileReader));
+    if (reader == NULL) {
+        log_message(2, "Failed to allocate file reader");
+        return NULL;
+    }
+
+    reader->file = open_file_for_read(filename);
+    reader->buffers = alloc_io_buffers(buffer_size, buffer_count);
+    if (reader->file == NULL || reader->buffers == NULL) {
+        log_message(2, "Failed to open file reader: %s", filename);
+        if (reader->file != NULL) {
+            fclose(reader->file);
+        }
+        free_io_buffers(reader->buffers, buffer_count);
+        free(reader);
+        return NULL;
+    }
+
+    // 大块读取直接进入对齐缓冲区，关闭stdio的中间缓冲
+    setvbuf(reader->file, NULL, _IONBF, 0);
+
+    reader->buffer_count = buffer_count;
+    reader->buffer_size = buffer_size;
+    pthread_mutex_init(&reader->lock, NULL);
+    pthread_cond_init(&reader->cond, NULL);
+
+    if (pthread_create(&reader->thread, NULL, file_reader_main, reader) != 0) {
+        log_message(2, "Failed to start file reader thread");
+        pthread_mutex_destroy(&reader->lock);
+        pthread_cond_destroy(&reader->cond);
+        fclose(reader->file);
+        free_io_buffers(reader->buffers, buffer_count);
+        free(reader);
+        return NULL;
+    }
+
+    return reader;
+}
+
+/**
+ * 读取数据
+ *
+ * head缓冲区读完后归还给预读线程；下一块尚未读好时等待
+ */
+size_t file_reader_read(FileReader* reader, uint8_t* buffer, size_t length)
+{
+    if (reader == NULL || buffer == NULL) {
+        return 0;
+    }
+
+    size_t copied = 0;
+    while (copied < length) {
+        pthread_mutex_lock(&reader->lock);
+
+        // 当前缓冲区已读完：归还给预读线程
+        if (reader->filled > 0 && reader->offset == reader->buffers[reader->head].len) {
+            reader->head = (reader->head + 1) % reader->buffer_count;
+            reader->filled--;
+            reader->offset = 0;
+            pthread_cond_signal(&reader->cond);
+        }
+
+        while (reader->filled == 0 && !reader->eof) {
+            pthread_cond_wait(&reader->cond, &reader->lock);
+        }
+        if (reader->filled == 0) {
+            pthread_mutex_unlock(&reader->lock);
+            break;
+        }
+        const IoBuffer* current = &reader->buffers[reader->head];
+        pthread_mutex_unlock(&reader->lock);
+
+        // head缓冲区只由本线程读取，复制时不需要持锁
+        size_t n = current->len - reader->offset;
+        if (n > length - copied) {
+            n = length - copied;
+        }
+        memcpy(buffer + copied, current->data + reader->offset, n);
+        reader->offset += n;
+        copied += n;
+    }
+
+    return copied;
+}
+
+/**
+ * 停止预读线程，关闭文件并释放读取器
+ */
+bool close_file_reader(FileReader* reader)
+{
+    if (reader == NULL) {
+        return false;
+    }
+
+    pthread_mutex_lock(&reader->lock);
+    reader->stop = true;
+    pthread_cond_signal(&reader->cond);
+    pthread_mutex_unlock(&reader->lock);
+    pthread_join(reader->thread, NULL);
+
+    bool ok = !reader->error;
+
+    pthread_mutex_destroy(&reader->lock);
+    pthread_cond_destroy(&reader->cond);
+    fclose(reader->file);
+    free_io_buffers(reader->buffers, reader->buffer_count);
+    free(reader);
+
+    return ok;
+}
+
+// ==================== 批量文件写入器 ====================
+
+/**
+ * 把最早提交的缓冲区写入文件（调用方保证有已提交的缓冲区）
+ * 已提交的缓冲区不会再被网络循环修改，在锁外写盘
+ */
+static void write_head_buffer(FileWriter* writer)
+{
+    pthread_mutex_lock(&writer->lock);
+    IoBuffer* buffer = &writer->buffers[writer->head];
+    pthread_mutex_unlock(&writer->lock);
+
+    size_t n = fwrite(buffer->data, 1, buffer->len, writer->file);
+
+    pthread_mutex_lock(&writer->lock);
+    if (n != buffer->len) {
+        writer->error = true;
+    }
+    writer->bytes_written += n;
+    buffer->len = 0;
+    writer->head = (writer->head + 1) % writer->buffer_count;
+    writer->queued--;
+    pthread_cond_signal(&writer->cond);
+    pthread_mutex_unlock(&writer->lock);
+}
+
+/**
+ * 写回线程：按提交顺序把缓冲区写入文件
+ */
+static void* file_writer_main(void* arg)
+{
+    FileWriter* writer = (FileWriter*)arg;
+
+    while (1) {
+        pthread_mutex_lock(&writer->lock);
+        while (writer->queued == 0 && !writer->stop) {
+            pthread_cond_wait(&writer->cond, &writer->lock);
+        }
+        bool done = (writer->queued == 0);   // stop且队列已空
+        pthread_mutex_unlock(&writer->lock);
+        if (done) {
+            break;
+        }
+
+        write_head_buffer(writer);
+    }
+
+    return NULL;
+}
+
+// ==================== 共享写回线程 ====================
+
+/**
+ * 共享写回线程：每次取出队首的写入器写一个缓冲区，它还有已提交的缓冲区时排到队尾，
+ * 写入器之间轮流写盘
+ */
+static void* file_write_queue_main(void* arg)
+{
+    FileWriteQueue* queue = (FileWriteQueue*)arg;
+
+    pthread_mutex_lock(&queue->lock);
+    while (1) {
+        while (queue->head == NULL && !queue->stop) {
+            pthread_cond_wait(&queue->cond, &queue->lock);
+        }
+        if (queue->head == NULL) {
+            // stop且队列已空
+            break;
+        }
+
+        FileWriter* writer = queue->head;
+        queue->head = writer->next_pending;
+        if (queue->head == NULL) {
+            queue->tail = NULL;
+        }
+        writer->next_pending = NULL;
+        pthread_mutex_unlock(&queue->lock);
+
+        write_head_buffer(writer);
+
+        // 在queue->lock下检查是否还有已提交的缓冲区：与schedule_writer互斥，不会漏掉刚提交的缓冲区
+        pthread_mutex_lock(&queue->lock);
+        pthread_mutex_lock(&writer->lock);
+        bool more = (writer->queued > 0);
+        pthread_mutex_unlock(&writer->lock);
+        if (more) {
+            if (queue->tail != NULL) {
+                queue->tail->next_pending = writer;
+            } else {
+                queue->head = writer;
+            }
+            queue->tail = writer;
+        } else {
+            writer->pending = false;
+            pthread_cond_broadcast(&queue->cond);   // 唤醒等待该写入器写完的close_file_writer
+        }
+    }
+    pthread_mutex_unlock(&queue->lock);
+
+    return NULL;
+}
+
+/**
+ * 写入器有了已提交的缓冲区：不在共享写回线程的队列中时排到队尾
+ */
+static void schedule_writer(FileWriter* writer)
+{
+    FileWriteQueue* queue = writer->queue;
+
+    pthread_mutex_lock(&queue->lock);
+    if (!writer->pending) {
+        writer->pending = true;
+        writer->next_pending = NULL;
+        if (queue->tail != NULL) {
+            queue->tail->next_pending = writer;
+        } else {
+            queue->head = writer;
+        }
+        queue->tail = writer;
+        pthread_cond_broadcast(&queue->cond);
+    }
+    pthread_mutex_unlock(&queue->lock);
+}
+
+/**
+ * 启动共享写回线程
+ */
+FileWriteQueue* create_file_write_queue(void)
+{
+    FileWriteQueue* queue = (FileWriteQueue*)calloc(1, sizeof(FileWriteQueue));
+    if (queue == NULL) {
+        log_message(2, "Failed to allocate file write queue");
+        return NULL;
+    }
+
+    pthread_mutex_init(&queue->lock, NULL);
+    pthread_cond_init(&queue->cond, NULL);
+
+    if (pthread_create(&queue->thread, NULL, file_write_queue_main, queue) != 0) {
+        log_message(2, "Failed to start file write queue thread");
+        pthread_mutex_destroy(&queue->lock);
+        pthread_cond_destroy(&queue->cond);
+        free(queue);
+        return NULL;
+    }
+
+    return queue;
+}
+
+/**
+ * 停止共享写回线程并释放队列
+ */
+void free_file_write_queue(FileWriteQueue* queue)
+{
+    if (queue == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&queue->lock);
+    queue->stop = true;
+    pthread_cond_broadcast(&queue->cond);
+    pthread_mutex_unlock(&queue->lock);
+    pthread_join(queue->thread, NULL);
+
+    pthread_mutex_destroy(&queue->lock);
+    pthread_cond_destroy(&queue->cond);
+    free(queue);
+}
+
+// ==================== 写入器接口 ====================
+
+/**
+ * 把当前缓冲区提交给写回线程，并切换到下一个空闲缓冲区
+ * 所有缓冲区都在等待写盘时等待
+ */
+static void submit_current_buffer(FileWriter* writer)
+{
+    pthread_mutex_lock(&writer->lock);
+    writer->queued++;
+    pthread_cond_signal(&writer->cond);
+    pthread_mutex_unlock(&writer->lock);
+
+    if (writer->queue != NULL) {
+        schedule_writer(writer);
+    }
+
+    pthread_mutex_lock(&writer->lock);
+    while (writer->queued == writer->buffer_count) {
+        pthread_cond_wait(&writer->cond, &writer->lock);
+    }
+    writer->current = (writer->head + writer->queued) % writer->buffer_count;
+    pthread_mutex_unlock(&writer->lock);
+}
+
+/**
+ * 创建文件并启动写回线程
+ */
+FileWriter* create_file_writer(const char* filename, size_t buffer_size, int buffer_count,
+                               FileWriteQueue* queue)
+{
+    if (filename == NULL || buffer_size == 0 || buffer_count < 2) {
+        log_message(2, "Invalid parameters for file writer");
+        return NULL;
+    }
+
+    FileWriter* writer = (FileWriter*)calloc(1, sizeof(FileWriter));
+    if (writer == NULL) {
+        log_message(2, "Failed to allocate file writer");
+        return NULL;
+    }
+
+    // 缓冲区在file_writer_reserve中按需分配
+    writer->file = open_file_for_write(filename);
+    writer->buffers = (IoBuffer*)calloc(buffer_count, sizeof(IoBuffer));
+    if (writer->file == NULL || writer->buffers == NULL) {
+        log_message(2, "Failed to open file writer: %s", filename);
+        if (writer->file != NULL) {
+            fclose(writer->file);
+        }
+        free(writer->buffers);
+        free(writer);
+        return NULL;
+    }
+
+    // 缓冲区整块写出，关闭stdio的中间缓冲
+    setvbuf(writer->file, NULL, _IONBF, 0);
+
+    writer->buffer_count = buffer_count;
+    writer->buffer_size = buffer_size;
+    writer->queue = queue;
+    pthread_mutex_init(&writer->lock, NULL);
+    pthread_cond_init(&writer->cond, NULL);
+
+    if (queue == NULL && pthread_create(&writer->thread, NULL, file_writer_main, writer) != 0) {
+        log_message(2, "Failed to start file writer thread");
+        pthread_mutex_destroy(&writer->lock);
+        pthread_cond_destroy(&writer->cond);
+        fclose(writer->file);
+        free(writer->buffers);
+        free(writer);
+        return NULL;
+    }
+
+    return writer;
+}
+
+/**
+ * 在当前缓冲区中预留空间
+ */
+uint8_t* file_writer_reserve(FileWriter* writer, size_t length)
+{
+    if (writer == NULL || length > writer->buffer_size) {
+        return NULL;
+    }
+
+    // current缓冲区只由本线程填充，判断剩余空间不需要持锁
+    IoBuffer* buffer = &writer->buffers[writer->current];
+    if (buffer->len + length > writer->buffer_size) {
+        submit_current_buffer(writer);
+        buffer = &writer->buffers[writer->current];
+    }
+
+    // 未分配或容量不足时扩大（不超过buffer_size）
+    if (buffer->len + length > buffer->capacity &&
+        !grow_io_buffer(buffer, buffer->len + length, writer->buffer_size)) {
+        log_message(2, "Failed to grow file writer buffer to %zu bytes", buffer->len + length);
+        return NULL;
+    }
+
+    return buffer->data + buffer->len;
+}
+
+/**
+ * 提交预留空间中实际写入的字节数
+ */
+void file_writer_commit(FileWriter* writer, size_t length)
+{
+    if (writer == NULL) {
+        return;
+    }
+
+    writer->buffers[writer->current].len += length;
+}
+
+/**
+ * 追加数据
+ */
+bool file_writer_write(FileWriter* writer, const uint8_t* data, size_t length)
+{
+    if (writer == NULL || (data == NULL && length > 0)) {
+        return false;
+    }
+
+    // 超过单个缓冲区的数据分块追加
+    while (length > 0) {
+        size_t chunk = (length < writer->buffer_size) ? length : writer->buffer_size;
+        uint8_t* dst = file_writer_reserve(writer, chunk);
+        if (dst == NULL) {
+            return false;
+        }
+        memcpy(dst, data, chunk);
+        file_writer_commit(writer, chunk);
+        data += chunk;
+        length -= chunk;
+    }
+
+    return true;
+}
+
+/**
+ * 写出剩余数据，停止写回线程，关闭文件并释放写入器
+ */
+bool close_file_writer(FileWriter* writer)
+{
+    if (writer == NULL) {
+        return false;
+    }
+
+    pthread_mutex_lock(&writer->lock);
+    if (writer->buffers[writer->current].len > 0) {
+        writer->queued++;
+    }
+    bool flush = (writer->queued > 0);
+    writer->stop = true;
+    pthread_cond_signal(&writer->cond);
+    pthread_mutex_unlock(&writer->lock);
+
+    if (writer->queue == NULL) {
+        pthread_join(writer->thread, NULL);
+    } else {
+        // 共享写回线程写完该写入器的所有缓冲区并把它移出队列后才能释放
+        if (flush) {
+            schedule_writer(writer);
+        }
+        FileWriteQueue* queue = writer->queue;
+        pthread_mutex_lock(&queue->lock);
+        while (writer->pending) {
+            pthread_cond_wait(&queue->cond, &queue->lock);
+        }
+        pthread_mutex_unlock(&queue->lock);
+    }
+
+    bool ok = !writer->error;
+    if (fclose(writer->file) != 0) {
+        ok = false;
+    }
+
+    pthread_mutex_destroy(&writer->lock);
+    pthread_cond_destroy(&writer->cond);
+    free_io_buffers(writer->buffers, writer->buffer_count);
+    free(writer);
+
+    return ok;
+}
@@ -0,0 +1,567 @@
+#include "logger.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdarg>
+#include <ctime>
+#include <pthread.h>
+
+// ==================== 全局日志状态 ====================
+
+static FILE* g_log_file = NULL;               // 日志文件（NULL表示标准输出）
+static int g_log_level = LOG_LEVEL_DEBUG;     // 运行时日志级别（原子读写）
+static int g_logger_running = 0;              // 后台线程是否在运行（原子读写）
+static int g_logger_stop = 0;                 // 通知后台线程退出（受g_logger_lock保护）
+
+static pthread_t g_logger_thread;
+static pthread_mutex_t g_logger_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_logger_cond = PTHREAD_COND_INITIALIZER;
+
+// 已登记的环形缓冲区；只增不减，存活到进程结束（线程局部指针可能一直引用它们）
+static LogRing* g_rings[LOG_MAX_RINGS];
+static int g_ring_count = 0;                  // 原子读写，登记时另受g_logger_lock保护
+
+// 本线程的环形缓冲区；登记失败时为g_no_ring，此后该线程同步写日志
+static LogRing g_no_ring;
+static thread_local LogRing* t_ring = NULL;
+
+// 后台线程的批量输出缓冲区
+#define LOG_BATCH_SIZE (64 * 1024)
+static char g_batch[LOG_BATCH_SIZE];
+
+static const char* level_prefix(int level)
+{
+    switch (level) {
+        case LOG_LEVEL_DEBUG: return "[DEBUG] ";
+        case LOG_LEVEL_INFO: return "[INFO] ";
+        case LOG_LEVEL_WARNING: return "[WARNING] ";
+        case LOG_LEVEL_ERROR: return "[ERROR] ";
+        default: return "[UNKNOWN] ";
+    }
+}
+
+static FILE* log_output()
+{
+    return (g_log_file != NULL) ? g_log_file : stdout;
+}
+
+// ==================== 同步输出（后台线程未运行时） ====================
+
+static void log_message_sync(int level, const char* format, va_list args)
+{
+    FILE* output = log_output();
+
+    // 多线程服务器下保证一条日志完整输出，不与其他线程交错
+#ifndef _WIN32
+    flockfile(output);
+#endif
+
+    fputs(level_prefix(level), output);
+    vfprintf(output, format, args);
+    fputc('\n', output);
+    fflush(output);
+
+#ifndef _WIN32
+    funlockfile(output);
+#endif
+}
+
+// ==================== 环形缓冲区登记 ====================
+
+/**
+ * 获取本线程的环形缓冲区，首次调用时分配并登记
+ * @return 环形缓冲区指针；无法登记时返回NULL（调用方改为同步输出）
+ */
+static LogRing* get_thread_ring()
+{
+    if (t_ring != NULL) {
+        return (t_ring == &g_no_ring) ? NULL : t_ring;
+    }
+
+    t_ring = &g_no_ring;
+
+    LogRing* ring = (LogRing*)calloc(1, sizeof(LogRing));
+    if (ring == NULL) {
+        return NULL;
+    }
+    ring->records = (LogRecord*)malloc(sizeof(LogRecord) * LOG_RING_CAPACITY);
+    if (ring->records == NULL) {
+        free(ring);
+        return NULL;
+    }
+
+    pthread_mutex_lock(&g_logger_lock);
+    int count = g_ring_count;
+    if (count < LOG_MAX_RINGS) {
+        g_rings[count] = ring;
+        // 先写入数组元素再发布计数，后台线程按计数读取
+        __atomic_store_n(&g_ring_count, count + 1, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&g_logger_lock);
+
+    if (count >= LOG_MAX_RINGS) {
+        free(ring->records);
+        free(ring);
+        return NULL;
+    }
+
+    t_ring = ring;
+    return ring;
+}
+
+// ==================== 参数捕获和后台格式化 ====================
+
+/**
+ * 格式串中的一个转换说明 %[标志][宽度][.精度][长度]转换符
+ */
+typedef struct {
+    const char* spec;                    // 标志/宽度/精度部分的起始位置（'%'之后）
+    int spec_len;                        // 标志/宽度/精度部分的长度
+    char length;                         // 长度修饰符：0, 'H'(hh), 'h', 'l', 'q'(ll), 'z', 'j', 't', 'L'
+    char conv;                           // 转换符
+} LogConv;
+
+/**
+ * 解析p（指向'%'之后）处的转换说明
+ * @return 转换符之后的位置；遇到不支持的写法（*宽度/精度、格式串结束）返回NULL
+ */
+static const char* parse_conversion(const char* p, LogConv* conv)
+{
+    conv->spec = p;
+    while (*p != '\0' && strchr("-+ #0123456789.", *p) != NULL) {
+        p++;
+    }
+    conv->spec_len = (int)(p - conv->spec);
+    if (*p == '*' || conv->spec_len > 16) {
+        return NULL;
+    }
+
+    conv->length = 0;
+    if (p[0] == 'h' && p[1] == 'h') {
+        conv->length = 'H';
+        p += 2;
+    } else if (p[0] == 'l' && p[1] == 'l') {
+        conv->length = 'q';
+        p += 2;
+    } else if (*p != '\0' && strchr("hlzjtL", *p) != NULL) {
+        conv->length = *p++;
+    }
+
+    conv->conv = *p;
+    return (*p != '\0') ? p + 1 : NULL;
+}
+
+/**
+ * 按转换说明从可变参数中取出一个有符号整数
+ */
+static long long take_signed(char length, va_list* args)
+{
+    switch (length) {
+        case 'H': return (signed char)va_arg(*args, int);
+        case 'h': return (short)va_arg(*args, int);
+        case 'l': return va_arg(*args, long);
+        case 'q': return va_arg(*args, long long);
+        case 'z': return (long long)va_arg(*args, size_t);
+        case 'j': return (long long)va_arg(*args, intmax_t);
+        case 't': return (long long)va_arg(*args, ptrdiff_t);
+        default: return va_arg(*args, int);
+    }
+}
+
+/**
+ * 按转换说明从可变参数中取出一个无符号整数
+ */
+static unsigned long long take_unsigned(char length, va_list* args)
+{
+    switch (length) {
+        case 'H': return (unsigned char)va_arg(*args, unsigned int);
+        case 'h': return (unsigned short)va_arg(*args, unsigned int);
+        case 'l': return va_arg(*args, unsigned long);
+        case 'q': return va_arg(*args, unsigned long long);
+        case 'z': return va_arg(*args, size_t);
+        case 'j': return (unsigned long long)va_arg(*args, uintmax_t);
+        case 't': return (unsigned long long)va_arg(*args, ptrdiff_t);
+        default: return va_arg(*args, unsigned int);
+    }
+}
+
+/**
+ * 按格式串把参数捕获到记录中：数值原样保存，%s的字符串复制到text
+ * @return 格式串中全部转换都能捕获时返回true，否则调用方改为在本线程格式化
+ */
+static bool capture_args(LogRecord* record, const char* format, va_list* args)
+{
+    record->argc = 0;
+    record->text_len = 0;
+
+    for (const char* p = format; *p != '\0'; p++) {
+        if (*p != '%') {
+            continue;
+        }
+        if (p[1] == '%') {
+            p++;
+            continue;
+        }
+
+        LogConv conv;
+        const char* next = parse_conversion(p + 1, &conv);
+        if (next == NULL || record->argc == LOG_MAX_ARGS) {
+            return false;
+        }
+        LogArg* arg = &record->args[record->argc++];
+
+        switch (conv.conv) {
+            case 'd': case 'i':
+                arg->i = take_signed(conv.length, args);
+                break;
+            case 'u': case 'x': case 'X': case 'o':
+                arg->u = take_unsigned(conv.length, args);
+                break;
+            case 'c':
+                arg->i = va_arg(*args, int);
+                break;
+            case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+                if (conv.length == 'L') {
+                    return false;
+                }
+                arg->d = va_arg(*args, double);
+                break;
+            case 'p':
+                arg->p = va_arg(*args, void*);
+                break;
+            case 's': {
+                // 复制字符串，放不下时截断（仍以'\0'结尾）
+                const char* str = va_arg(*args, const char*);
+                if (str == NULL) {
+                    str = "(null)";
+                }
+                size_t room = sizeof(record->text) - record->text_len;
+                size_t len = strlen(str);
+                if (len >= room) {
+                    len = room - 1;
+                }
+                arg->u = record->text_len;
+                memcpy(record->text + record->text_len, str, len);
+                record->text[record->text_len + len] = '\0';
+                record->text_len = (uint16_t)(record->text_len + len + 1);
+                if (record->text_len == sizeof(record->text)) {
+                    record->text_len--;     // 后续的%s只能得到空串
+                }
+                break;
+            }
+            default:
+                return false;
+        }
+        p = next - 1;
+    }
+    return true;
+}
+
+/**
+ * 后台线程：按格式串和捕获的参数格式化一条记录
+ * @param out 输出位置
+ * @param cap 输出空间（含结尾'\0'）
+ * @return 写入的字符数（不含结尾'\0'）
+ */
+static size_t format_record(const LogRecord* record, char* out, size_t cap)
+{
+    if (record->format == NULL) {
+        size_t len = (record->text_len < cap) ? record->text_len : cap - 1;
+        memcpy(out, record->text, len);
+        return len;
+    }
+
+    size_t len = 0;
+    int argi = 0;
+    for (const char* p = record->format; *p != '\0' && len + 1 < cap; p++) {
+        if (*p != '%') {
+            out[len++] = *p;
+            continue;
+        }
+        if (p[1] == '%') {
+            out[len++] = '%';
+            p++;
+            continue;
+        }
+
+        // 捕获时已校验过格式串，这里的解析一定成功
+        LogConv conv;
+        const char* next = parse_conversion(p + 1, &conv);
+        const LogArg* arg = &record->args[argi++];
+
+        // 重新拼出转换说明：保留标志/宽度/精度，整数统一用ll长度
+        char spec[24];
+        int sl = 0;
+        spec[sl++] = '%';
+        memcpy(spec + sl, conv.spec, conv.spec_len);
+        sl += conv.spec_len;
+
+        int n = 0;
+        switch (conv.conv) {
+            case 'd': case 'i':
+                spec[sl++] = 'l'; spec[sl++] = 'l'; spec[sl++] = conv.conv; spec[sl] = '\0';
+                n = snprintf(out + len, cap - len, spec, arg->i);
+                break;
+            case 'u': case 'x': case 'X': case 'o':
+                spec[sl++] = 'l'; spec[sl++] = 'l'; spec[sl++] = conv.conv; spec[sl] = '\0';
+                n = snprintf(out + len, cap - len, spec, arg->u);
+                break;
+            case 'c':
+                spec[sl++] = 'c'; spec[sl] = '\0';
+                n = snprintf(out + len, cap - len, spec, (int)arg->i);
+                break;
+            case 'p':
+                spec[sl++] = 'p'; spec[sl] = '\0';
+                n = snprintf(out + len, cap - len, spec, arg->p);
+                break;
+            case 's':
+                spec[sl++] = 's'; spec[sl] = '\0';
+                n = snprintf(out + len, cap - len, spec, record->text + arg->u);
+                break;
+            default:
+                spec[sl++] = conv.conv; spec[sl] = '\0';
+                n = snprintf(out + len, cap - len, spec, arg->d);
+                break;
+        }
+        if (n > 0) {
+            len += ((size_t)n < cap - len) ? (size_t)n : cap - len - 1;
+        }
+        p = next - 1;
+    }
+    return len;
+}
+
+// ==================== 日志输出 ====================
+
+void log_message(int level, const char* format, ...)
+{
+    if (format == NULL || level < __atomic_load_n(&g_log_level, __ATOMIC_RELAXED)) {
+        return;
+    }
+
+    va_list args;
+    va_start(args, format);
+
+    LogRing* ring = NULL;
+    if (__atomic_load_n(&g_logger_running, __ATOMIC_ACQUIRE)) {
+        ring = get_thread_ring();
+    }
+    if (ring == NULL) {
+        log_message_sync(level, format, args);
+        va_end(args);
+        return;
+    }
+
+    // 生产者独占tail；head由后台线程推进，acquire保证读到的槽位已被写出
+    uint32_t tail = ring->tail;
+    uint32_t used = tail - __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    if (used >= LOG_RING_CAPACITY) {
+        __atomic_fetch_add(&ring->dropped, 1, __ATOMIC_RELAXED);
+        va_end(args);
+        return;
+    }
+
+    // 只捕获参数，格式化留给后台线程；捕获不了时在本线程格式化（va_list已被部分读取，用副本）
+    LogRecord* record = &ring->records[tail & (LOG_RING_CAPACITY - 1)];
+    va_list copy;
+    va_copy(copy, args);
+    record->format = format;
+    if (!capture_args(record, format, &args)) {
+        int len = vsnprintf(record->text, sizeof(record->text), format, copy);
+        if (len < 0) {
+            len = 0;
+        } else if (len >= (int)sizeof(record->text)) {
+            len = (int)sizeof(record->text) - 1;
+        }
+        record->format = NULL;
+        record->text_len = (uint16_t)len;
+    }
+    va_end(copy);
+    va_end(args);
+    record->level = (int8_t)level;
+
+    // release：后台线程看到新的tail时，记录内容一定已写完
+    __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+
+    // 缓冲区过半或出现警告/错误时提前唤醒后台线程，其余情况由定时刷新处理
+    if (used + 1 == LOG_RING_CAPACITY / 2 || level >= LOG_LEVEL_WARNING) {
+        pthread_cond_signal(&g_logger_cond);
+    }
+}
+
+// ==================== 后台写日志线程 ====================
+
+/**
+ * 把所有环形缓冲区中的记录格式化并批量写出，每批只调用一次fflush
+ * @param reported 已报告过的丢弃总数（输入输出参数）
+ * @return 本次写出的记录数
+ */
+static int drain_rings(uint64_t* reported)
+{
+    FILE* output = log_output();
+    size_t used = 0;
+    int written = 0;
+    uint64_t dropped = 0;
+
+    int count = __atomic_load_n(&g_ring_count, __ATOMIC_ACQUIRE);
+    for (int i = 0; i < count; i++) {
+        LogRing* ring = g_rings[i];
+        uint32_t head = ring->head;
+        uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+
+        while (head != tail) {
+            const LogRecord* record = &ring->records[head & (LOG_RING_CAPACITY - 1)];
+            const char* prefix = level_prefix(record->level);
+            size_t prefix_len = strlen(prefix);
+
+            if (used + prefix_len + LOG_LINE_MAX > LOG_BATCH_SIZE) {
+                fwrite(g_batch, 1, used, output);
+                used = 0;
+            }
+            memcpy(g_batch + used, prefix, prefix_len);
+            used += prefix_len;
+            used += format_record(record, g_batch + used, LOG_LINE_MAX);
+            g_batch[used++] = '\n';
+
+            head++;
+            written++;
+            // 每写完一条就归还槽位，生产者不必等整批结束
+            __atomic_store_n(&ring->head, head, __ATOMIC_RELEASE);
+        }
+
+        dropped += __atomic_load_n(&ring->dropped, __ATOMIC_RELAXED);
+    }
+
+    if (dropped > *reported) {
+        if (used + LOG_RECORD_SIZE > LOG_BATCH_SIZE) {
+            fwrite(g_batch, 1, used, output);
+            used = 0;
+        }
+        used += snprintf(g_batch + used, LOG_BATCH_SIZE - used,
+                         "%slogger: %llu messages dropped (ring full)\n",
+                         level_prefix(LOG_LEVEL_WARNING), (unsigned long long)(dropped - *reported));
+        *reported = dropped;
+    }
+
+    if (used > 0) {
+        fwrite(g_batch, 1, used, output);
+        fflush(output);
+    }
+    return written;
+}
+
+static void* logger_main(void* arg)
+{
+    (void)arg;
+    uint64_t reported = 0;
+
+    while (1) {
+        drain_rings(&reported);
+
+        // 等待缓冲区过半/警告的唤醒或定时刷新，持续输出时也按批写出
+        pthread_mutex_lock(&g_logger_lock);
+        if (g_logger_stop) {
+            pthread_mutex_unlock(&g_logger_lock);
+            break;
+        }
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += LOG_FLUSH_INTERVAL_MS * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec += 1;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        pthread_cond_timedwait(&g_logger_cond, &g_logger_lock, &deadline);
+        pthread_mutex_unlock(&g_logger_lock);
+    }
+
+    // 退出前写出剩余日志
+    drain_rings(&reported);
+    return NULL;
+}
+
+// ==================== 日志初始化 ====================
+
+int log_init(const char* filename)
+{
+    const char* env_level = getenv(LOG_LEVEL_ENV);
+    if (env_level != NULL && env_level[0] != '\0') {
+        log_set_level(atoi(env_level));
+    }
+
+    if (filename == NULL) {
+        g_log_file = NULL;
+    } else {
+        g_log_file = fopen(filename, "a");
+        if (g_log_file == NULL) {
+            return -1;
+        }
+    }
+
+    if (__atomic_load_n(&g_logger_running, __ATOMIC_ACQUIRE)) {
+        return 0;
+    }
+
+    g_logger_stop = 0;
+    if (pthread_create(&g_logger_thread, NULL, logger_main, NULL) != 0) {
+        // 后台线程启动失败时保持同步输出
+        return 0;
+    }
+    __atomic_store_n(&g_logger_running, 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+// ==================== 日志清理 ====================
+
+void log_cleanup()
+{
+    if (__atomic_load_n(&g_logger_running, __ATOMIC_ACQUIRE)) {
+        // 先切回同步输出，再让后台线程写完剩余记录后退出
+        __atomic_store_n(&g_logger_running, 0, __ATOMIC_RELEASE);
+
+        pthread_mutex_lock(&g_logger_lock);
+        g_logger_stop = 1;
+        pthread_cond_signal(&g_logger_cond);
+        pthread_mutex_unlock(&g_logger_lock);
+        pthread_join(g_logger_thread, NULL);
+    }
+
+    uint64_t dropped = log_get_dropped();
+    if (dropped > 0) {
+        fprintf(log_output(), "%slogger: %llu messages dropped in total\n",
+                level_prefix(LOG_LEVEL_WARNING), (unsigned long long)dropped);
+    }
+    fflush(log_output());
+
+    if (g_log_file != NULL) {
+        fclose(g_log_file);
+        g_log_file = NULL;
+    }
+}
+
+// ==================== 日志级别和统计 ====================
+
+void log_set_level(int level)
+{
+    if (level < LOG_LEVEL_DEBUG) {
+        level = LOG_LEVEL_DEBUG;
+    } else if (level > LOG_LEVEL_NONE) {
+        level = LOG_LEVEL_NONE;
+    }
+    __atomic_store_n(&g_log_level, level, __ATOMIC_RELAXED);
+}
+
+int log_get_level()
+{
+    return __atomic_load_n(&g_log_level, __ATOMIC_RELAXED);
+}
+
+uint64_t log_get_dropped()
+{
+    uint64_t total = 0;
+    int count = __atomic_load_n(&g_ring_count, __ATOMIC_ACQUIRE);
+    for (int i = 0; i < count; i++) {
+        total += __atomic_load_n(&g_rings[i]->dropped, __ATOMIC_RELAXED);
+    }
+    return total;
+}
@@ -3,6 +3,8 @@
 #include "packet.h"
 #include "window.h"
 #include "congestion.h"
+#include "server.h"
+#include "file_io.h"
 #include "utils.h"
 #include <cstdio>
 #include <cstring>
@@ -30,7 +32,7 @@ static int g_initialized = 0;
 #define MAX_FILENAME 256
 #define TRANSMISSION_TIMEOUT_SEC 300   // 30秒未有进度则超时
 #define HANDSHAKE_TIMEOUT_SEC 10        // 握手超时10秒
-#define IDLE_CHECK_INTERVAL_MS 100      // 100ms检查一次超时
+#define IDLE_CHECK_INTERVAL_MS 1000     // 空闲时每秒唤醒一次检查超时（数据报到达时立即唤醒）
 
 // ==================== 初始化 ====================
 
@@ -99,6 +101,7 @@ int server_main(int port, const char* output_file, int window_size)
         log_message(2, "ERROR: Failed to create UDP socket");
         return -1;
     }
+    set_socket_buffers(sockfd, SOCKET_BUFFER_SIZE);   // 容纳最大窗口的突发，避免内核静默丢包
 
     // 绑定端口
     if (!bind_socket(sockfd, port)) {
@@ -107,29 +110,35 @@ int server_main(int port, const char* output_file, int window_size)
         return -1;
     }
 
-    // 设置套接字超时（非阻塞接收）
-    set_socket_timeout(sockfd, 1000);
+    // 非阻塞套接字 + 事件循环：数据报到达即唤醒，不再轮询
+    EventLoop* loop = NULL;
+    if (!set_socket_nonblocking(sockfd) || (loop = create_event_loop(sockfd)) == NULL) {
+        log_message(2, "ERROR: Failed to set up event loop");
+        CLOSE_SOCKET(sockfd);
+        return -1;
+    }
 
-    // 打开输出文件
-    FILE* output = open_file_for_write(output_file);
-    if (output == NULL) {
-        log_message(2, "ERROR: Failed to open output file: %s", output_file);
+    // 与多客户端服务器使用同一套连接状态机：握手、数据、窗口探测和关闭都按状态机表处理，
+    // 接收窗口缓冲乱序帧，连续部分直接交付到写入器的缓冲区（后台线程批量写盘）
+    Connection* conn = create_server_connection(port);
+    if (conn == NULL || !server_listen(conn) || !connection_open_receiver(conn, window_size, output_file, NULL)) {
+        log_message(2, "ERROR: Failed to open receiver for output file: %s", output_file);
+        connection_free(conn);
+        free_event_loop(loop);
         CLOSE_SOCKET(sockfd);
         return -1;
     }
+    conn->sockfd = sockfd;
 
     // 统计变量
     long start_time = get_current_time_ms();
-    size_t total_bytes = 0;
-    int total_packets = 0;
-    int retransmitted_packets = 0;
-    int ack_count = 0;
+    uint64_t total_packets = 0;
 
+    // 一轮唤醒接收的数据报；同一对端的帧作为一批交给状态机
+    uint8_t rx_buffers[SERVER_RX_BATCH][MAX_PACKET_SIZE];
+    FrameView views[SERVER_RX_BATCH];
     struct sockaddr_in client_addr;
-    socklen_t client_addr_len = sizeof(client_addr);
-    Frame recv_frame, send_frame;
-    uint32_t expected_seq = 0;
-    int handshake_complete = 0;
+    bool have_peer = false;            // 收到第一个SYN后只接受该对端的数据报
 
     log_message(0, "Server: Waiting for client connection...");
 
@@ -137,9 +146,10 @@ int server_main(int port, const char* output_file, int window_size)
     time_t last_activity = time(NULL);
     int idle_counter = 0;
 
-    while (1) {
+    while (conn->state != LAST_ACK) {
         // 检查超时
         time_t current_time = time(NULL);
+        bool handshake_complete = (conn->state != LISTEN && conn->state != SYN_RECEIVED);
         if (!handshake_complete && (current_time - last_activity) > HANDSHAKE_TIMEOUT_SEC) {
             log_message(1, "WARNING: Handshake timeout, waiting for client");
             idle_counter++;
@@ -148,150 +158,140 @@ int server_main(int port, const char* output_file, int window_size)
                 break;
             }
         }
-
-        // 接收数据包
-        ssize_t recv_len = receive_packet(sockfd, &client_addr, &recv_frame);
-        
-        if (recv_len < 0) {
-            // 超时或错误，继续循环
-            sleep_ms(IDLE_CHECK_INTERVAL_MS);
-            continue;
+        if (handshake_complete && (current_time - last_activity) > TRANSMISSION_TIMEOUT_SEC) {
+            log_message(2, "ERROR: Transmission timeout");
+            break;
         }
 
-        if (recv_len == 0) {
-            sleep_ms(IDLE_CHECK_INTERVAL_MS);
-            continue;
+        // 等待数据报到达；空闲时最多等待IDLE_CHECK_INTERVAL_MS，以便检查超时
+        int event = event_loop_wait(loop, get_monotonic_time_us() + (uint64_t)IDLE_CHECK_INTERVAL_MS * 1000);
+        if (event == EVENT_ERROR) {
+            log_message(2, "ERROR: Event loop failure");
+            break;
         }
-
-        last_activity = time(NULL);
-        idle_counter = 0;
-        total_packets++;
-
-        log_message(0, "Server: Received packet seq=%u type=%d len=%zu", 
-                   recv_frame.seq_num, recv_frame.frame_type, recv_len);
-
-        // 处理三次握手
-        if (!handshake_complete) {
-            if (recv_frame.frame_type == SYN) {
-                log_message(0, "Server: Received SYN, sending SYN-ACK");
-                
-                // 发送SYN-ACK
-                memset(&send_frame, 0, sizeof(send_frame));
-                send_frame.seq_num = generate_random_seq();
-                send_frame.ack_num = recv_frame.seq_num + 1;
-                send_frame.window_size = window_size;
-                send_frame.frame_type = SYN_ACK;
-                send_frame.data_len = 0;
-                
-                expected_seq = recv_frame.seq_num + 1;
-                
-                ssize_t sent = send_packet(sockfd, &client_addr, &send_frame);
-                if (sent > 0) {
-                    log_message(0, "Server: Sent SYN-ACK");
-                }
-            }
-            else if (recv_frame.frame_type == ACK && recv_frame.ack_num > 0) {
-                log_message(0, "Server: Handshake complete, ready to receive data");
-                handshake_complete = 1;
-                ack_count = 0;
-            }
+        if (event == EVENT_TIMEOUT) {
             continue;
         }
 
-        // 握手完成后处理数据
-        switch (recv_frame.frame_type) {
-            case DATA: {
-                // 验证序列号
-                if (recv_frame.seq_num == expected_seq) {
-                    // 正确的数据包，写入文件
-                    size_t written = write_file_chunk(output, (const char*)recv_frame.data, recv_frame.data_len);
-                    total_bytes += written;
-                    log_message(0, "Server: Data received and saved: %zu bytes", written);
-                    
-                    expected_seq += recv_frame.data_len;
-                    ack_count++;
-                }
-                else if (recv_frame.seq_num < expected_seq) {
-                    // 重复数据包
-                    log_message(1, "WARNING: Duplicate packet seq=%u, expected=%u", 
-                               recv_frame.seq_num, expected_seq);
-                    retransmitted_packets++;
-                }
-                
-                // 发送ACK
-                memset(&send_frame, 0, sizeof(send_frame));
-                send_frame.seq_num = expected_seq;
-                send_frame.ack_num = expected_seq;
-                send_frame.window_size = window_size;
-                send_frame.frame_type = ACK;
-                send_frame.data_len = 0;
-                
-                ssize_t sent = send_packet(sockfd, &client_addr, &send_frame);
-                if (sent > 0) {
-                    log_message(0, "Server: Sent ACK for seq=%u", expected_seq);
-                }
+        // 连续接收直到套接字读空或凑满一批（数据报可能已被内核因校验失败丢弃）
+        int count = 0;
+        bool from_peer = false;
+        while (count < SERVER_RX_BATCH) {
+            struct sockaddr_in from;
+            ssize_t recv_len = receive_packet_view(sockfd, &from, rx_buffers[count], MAX_PACKET_SIZE,
+                                                   &views[count], conn->checksum_mode);
+            if (recv_len <= 0) {
                 break;
             }
+            total_packets++;
 
-            case FIN: {
-                log_message(0, "Server: Received FIN, closing connection");
-                
-                // 发送FIN-ACK
-                memset(&send_frame, 0, sizeof(send_frame));
-                send_frame.seq_num = expected_seq;
-                send_frame.ack_num = recv_frame.seq_num + 1;
-                send_frame.window_size = window_size;
-                send_frame.frame_type = FIN_ACK;
-                send_frame.data_len = 0;
-                
-                ssize_t sent = send_packet(sockfd, &client_addr, &send_frame);
-                if (sent > 0) {
-                    log_message(0, "Server: Sent FIN-ACK");
-                }
-                
-                // 接收完成，退出循环
-                handshake_complete = 0;
-                break;
+            if (!have_peer && views[count].frame_type == SYN) {
+                client_addr = from;
+                conn->peer_addr = from;
+                have_peer = true;
             }
-
-            default:
-                log_message(1, "WARNING: Unknown frame type: %d", recv_frame.frame_type);
-                break;
-        }
-
-        // 接收完整文件后退出
-        if (recv_frame.frame_type == FIN) {
-            log_message(0, "Server: File transfer complete");
-            break;
+            if (!have_peer || !same_peer(&from, &client_addr)) {
+                continue;
+            }
+            from_peer = true;
+            log_message(0, "Server: Received packet seq=%u type=%d len=%zd",
+                        views[count].seq_num, views[count].frame_type, recv_len);
+
+            // SYN协商校验模式，单独成批，之后的帧按协商结果解析
+            if (views[count].frame_type == SYN) {
+                connection_dispatch(conn, views, count);
+                connection_dispatch(conn, &views[count], 1);
+                count = 0;
+                continue;
+            }
+            count++;
         }
-
-        // 检查传输超时
-        if ((current_time - last_activity) > TRANSMISSION_TIMEOUT_SEC) {
-            log_message(2, "ERROR: Transmission timeout");
-            break;
+        if (from_peer) {
+            last_activity = time(NULL);
+            idle_counter = 0;
         }
+        connection_dispatch(conn, views, count);
     }
 
-    // 关闭文件和套接字
-    if (output != NULL) {
-        fclose(output);
+    if (conn->state == LAST_ACK) {
+        log_message(0, "Server: File transfer complete");
     }
+
+    // 写出剩余数据，关闭文件和套接字
+    connection_close_receiver(conn);
+    free_event_loop(loop);
     CLOSE_SOCKET(sockfd);
+    conn->sockfd = -1;
 
     // 计算统计信息
     long end_time = get_current_time_ms();
     long total_time = end_time - start_time;
+    ConnectionStats stats;
+    connection_get_stats(conn, &stats);
+    connection_free(conn);
 
     // 打印统计信息
     printf("\n");
-    print_statistics(NULL, total_bytes, total_time, total_packets, retransmitted_packets);
+    print_statistics(NULL, stats.bytes_received, total_time, total_packets, stats.retransmit_count);
 
-    log_message(0, "Server: Transfer complete - %zu bytes in %ld ms", total_bytes, total_time);
+    log_message(0, "Server: Transfer complete - %llu bytes in %ld ms",
+                (unsigned long long)stats.bytes_received, total_time);
     return 0;
 }
 
 // ==================== 客户端主函数 ====================
 
+/**
+ * 记录一次重传：重传的帧同样计入已发送的帧数和字节数
+ */
+static void count_retransmission(Connection* conn, const UnackedPacket* packet)
+{
+    connection_count(&conn->frames_sent, 1);
+    connection_count(&conn->bytes_sent, packet->data_len);
+    connection_count(&conn->retransmit_count, 1);
+}
+
+/**
+ * 发送当前FEC组的校验帧（组为空时什么也不做）
+ * 校验帧计入已发送的帧数，不计入数据字节数
+ */
+static void send_fec_parity(FecEncoder* fec, int sockfd, const struct sockaddr_in* addr,
+                            ChecksumMode mode, Connection* conn)
+{
+    uint8_t wire[FRAME_MAX_SIZE];
+    int wire_len = fec_encoder_flush(fec, wire, mode);
+    if (wire_len > 0 && send_wire_packet(sockfd, addr, wire, wire_len) > 0) {
+        connection_count(&conn->frames_sent, 1);
+    }
+}
+
+/**
+ * FEC模式下判断空洞是否暂缓重传：它是所在组唯一的空洞，且该组的校验帧
+ * 发出还不到hold_us，接收端可能正在用校验帧还原它。
+ * 已超时的包不再暂缓：它没有定时器了，暂缓会让发送循环无事可等
+ * 
+ * @param packet 空洞对应的未确认包
+ * @param holes 最近一次选择确认得出的空洞
+ */
+static bool fec_hold(const FecEncoder* fec, const UnackedPacket* packet, const uint32_t* holes, int hole_count,
+                     uint64_t now, uint64_t hold_us)
+{
+    if (fec == NULL || packet == NULL || packet->timed_out) {
+        return false;
+    }
+
+    uint32_t seq_num = packet->seq_num;
+    uint32_t group = fec_group_first(fec, seq_num);
+    for (int i = 0; i < hole_count; i++) {
+        if (holes[i] != seq_num && fec_group_first(fec, holes[i]) == group) {
+            return false;
+        }
+    }
+
+    uint64_t sent = fec_parity_sent_time(fec, seq_num);
+    return sent != 0 && now - sent < hold_us;
+}
+
 /**
  * 客户端主函数
  * - 连接到服务器
@@ -299,8 +299,12 @@ int server_main(int port, const char* output_file, int window_size)
  * - 发送文件数据（使用流水线方式）
  * - 等待传输完成
  * - 显示统计信息
+ * 
+ * fec_group > 0时提议FEC：每fec_group个数据帧发送一个XOR校验帧；
+ * max_retries为同一个包允许的超时重传次数，也用于窗口探测和FIN的重发次数
  */
-int client_main(const char* server_ip, int port, const char* input_file, int window_size)
+int client_main(const char* server_ip, int port, const char* input_file, int window_size, int fec_group,
+                int max_retries)
 {
     if (server_ip == NULL || strlen(server_ip) == 0) {
         log_message(2, "ERROR: Server IP is required");
@@ -328,9 +332,15 @@ int client_main(const char* server_ip, int port, const char* input_file, int win
         log_message(2, "ERROR: Failed to create UDP socket");
         return -1;
     }
+    set_socket_buffers(sockfd, SOCKET_BUFFER_SIZE);   // 容纳最大窗口的突发，避免内核静默丢包
 
-    // 设置套接字超时
-    set_socket_timeout(sockfd, 1000);
+    // 非阻塞套接字 + 事件循环：阻塞等待ACK到达或最早的重传截止时间
+    EventLoop* loop = NULL;
+    if (!set_socket_nonblocking(sockfd) || (loop = create_event_loop(sockfd)) == NULL) {
+        log_message(2, "ERROR: Failed to set up event loop");
+        CLOSE_SOCKET(sockfd);
+        return -1;
+    }
 
     // 构建服务器地址
     struct sockaddr_in server_addr;
@@ -340,23 +350,30 @@ int client_main(const char* server_ip, int port, const char* input_file, int win
     server_addr.sin_addr.s_addr = inet_addr(server_ip);
     if (server_addr.sin_addr.s_addr == INADDR_NONE) {
         log_message(2, "ERROR: Invalid server IP address: %s", server_ip);
+        free_event_loop(loop);
         CLOSE_SOCKET(sockfd);
         return -1;
     }
 
-    // 打开输入文件
-    FILE* input = open_file_for_read(input_file);
+    // 打开输入文件：后台线程按大块预读，领先于发送窗口
+    FileReader* input = create_file_reader(input_file, FILE_IO_BUFFER_SIZE, FILE_IO_BUFFER_COUNT);
     if (input == NULL) {
         log_message(2, "ERROR: Failed to open input file: %s", input_file);
+        free_event_loop(loop);
         CLOSE_SOCKET(sockfd);
         return -1;
     }
 
-    // 统计变量
+    // 统计计数器在Connection中（64位），可由其他线程通过connection_get_stats读取
+    Connection* conn = create_client_connection(server_ip, port);
+    if (conn == NULL) {
+        log_message(2, "ERROR: Failed to create connection");
+        close_file_reader(input);
+        free_event_loop(loop);
+        CLOSE_SOCKET(sockfd);
+        return -1;
+    }
     long start_time = get_current_time_ms();
-    size_t total_bytes = 0;
-    int total_packets = 0;
-    int retransmitted_packets = 0;
 
     Frame send_frame, recv_frame;
     struct sockaddr_in recv_addr;
@@ -371,26 +388,54 @@ int client_main(const char* server_ip, int port, const char* input_file, int win
     send_frame.window_size = window_size;
     send_frame.frame_type = SYN;
     send_frame.data_len = 0;
+    frame_add_option(&send_frame, OPT_CRC32C, NULL, 0);     // 请求CRC32C帧尾
+    uint8_t wscale = window_scale_for((uint32_t)window_size * MAX_DATA_LENGTH);
+    frame_add_option(&send_frame, OPT_WSCALE, &wscale, 1);  // 提议窗口缩放
+    frame_add_option(&send_frame, OPT_SACK, NULL, 0);       // 支持选择确认和NACK
+    if (fec_group > 0) {
+        uint8_t fec_k = (uint8_t)fec_group;
+        frame_add_option(&send_frame, OPT_FEC, &fec_k, 1);  // 提议前向纠错
+    }
 
     uint32_t client_seq = send_frame.seq_num;
     uint32_t server_seq = 0;
+    conn->initial_seq_num = client_seq;
+    update_connection_state(conn, SYN_SENT);
+    uint32_t peer_window = (uint32_t)window_size * MAX_DATA_LENGTH;   // 对端通告的接收窗口（字节）
+    uint8_t peer_wscale = 0;                        // 对端窗口的移位数，服务器回显选项后启用
+    ChecksumMode checksum_mode = CHECKSUM_LEGACY;   // 收到SYN-ACK后确定
+    bool sack_enabled = false;                      // 服务器回显OPT_SACK后启用
+    int fec_k = 0;                                  // 服务器回显OPT_FEC后启用
     int handshake_complete = 0;
     int handshake_tries = 0;
     const int MAX_HANDSHAKE_TRIES = 5;
 
     while (handshake_tries < MAX_HANDSHAKE_TRIES && !handshake_complete) {
-        ssize_t sent = send_packet(sockfd, &server_addr, &send_frame);
+        ssize_t sent = send_packet(sockfd, &server_addr, &send_frame, checksum_mode);
         if (sent > 0) {
             log_message(0, "Client: Sent SYN");
         }
 
-        // 等待SYN-ACK（第二步）
-        for (int i = 0; i < 10; i++) {
-            ssize_t recv_len = receive_packet(sockfd, &recv_addr, &recv_frame);
+        // 等待SYN-ACK（第二步），最多等待TIMEOUT_MS
+        uint64_t deadline = get_monotonic_time_us() + (uint64_t)TIMEOUT_MS * 1000;
+        while (!handshake_complete && event_loop_wait(loop, deadline) == EVENT_READABLE) {
+            ssize_t recv_len = receive_packet(sockfd, &recv_addr, &recv_frame, checksum_mode);
             if (recv_len > 0) {
                 if (recv_frame.frame_type == SYN_ACK && recv_frame.ack_num == client_seq + 1) {
                     log_message(0, "Client: Received SYN-ACK");
                     server_seq = recv_frame.seq_num;
+                    peer_window = recv_frame.window_size;   // SYN_ACK的窗口不缩放
+                    if (frame_find_option(&recv_frame, OPT_CRC32C, NULL) != NULL) {
+                        checksum_mode = CHECKSUM_CRC32C;
+                    }
+                    uint8_t opt_len = 0;
+                    const uint8_t* opt = frame_find_option(&recv_frame, OPT_WSCALE, &opt_len);
+                    if (opt != NULL && opt_len == 1) {
+                        peer_wscale = (opt[0] > MAX_WSCALE) ? MAX_WSCALE : opt[0];
+                    }
+                    sack_enabled = (frame_find_option(&recv_frame, OPT_SACK, NULL) != NULL);
+                    opt = frame_find_option(&recv_frame, OPT_FEC, &opt_len);
+                    fec_k = (opt != NULL && opt_len == 1 && opt[0] == fec_group) ? fec_group : 0;
 
                     // 第三步：发送ACK
                     memset(&send_frame, 0, sizeof(send_frame));
@@ -400,91 +445,319 @@ int client_main(const char* server_ip, int port, const char* input_file, int win
                     send_frame.frame_type = ACK;
                     send_frame.data_len = 0;
 
-                    sent = send_packet(sockfd, &server_addr, &send_frame);
+                    sent = send_packet(sockfd, &server_addr, &send_frame, checksum_mode);
                     if (sent > 0) {
                         log_message(0, "Client: Sent ACK, handshake complete");
                         handshake_complete = 1;
-                        break;
+                        conn->checksum_mode = checksum_mode;
+                        update_connection_state(conn, ESTABLISHED);
                     }
                 }
             }
-            sleep_ms(100);
         }
 
         if (!handshake_complete) {
             handshake_tries++;
             log_message(1, "WARNING: Handshake attempt %d failed, retrying...", handshake_tries);
-            sleep_ms(500);
         }
     }
 
     if (!handshake_complete) {
         log_message(2, "ERROR: Failed to complete handshake");
-        fclose(input);
+        connection_free(conn);
+        close_file_reader(input);
+        free_event_loop(loop);
+        CLOSE_SOCKET(sockfd);
+        return -1;
+    }
+
+    log_message(0, "Client: Connection established (checksum: %s, peer wscale: %u, sack: %s, fec k: %d), "
+                "starting file transmission",
+                checksum_mode == CHECKSUM_CRC32C ? "CRC32C" : "legacy", peer_wscale, sack_enabled ? "on" : "off", fec_k);
+    if (fec_group > 0 && fec_k == 0) {
+        log_message(1, "WARNING: Server did not accept FEC, sending without parity frames");
+    }
+
+    // ===== 数据传输阶段（流水线发送） =====
+    // 序列号按帧计数：第一个DATA帧为client_seq + 1，此后每帧加1，
+    // 与SendWindow内部的next_seq_num一致；服务器的累积ACK为下一个期望的帧序号
+    SendWindow* send_window = create_send_window(window_size, window_size);
+    CongestionControl* cc = create_congestion_control();
+    uint32_t* holes = (uint32_t*)malloc(sizeof(uint32_t) * window_size);   // NACK中的空洞序列号
+    if (send_window == NULL || cc == NULL || holes == NULL) {
+        log_message(2, "ERROR: Failed to create send window or congestion control");
+        free_send_window(send_window);
+        free_congestion_control(cc);
+        free(holes);
+        conn->state = CLOSED;
+        connection_free(conn);
+        close_file_reader(input);
+        free_event_loop(loop);
         CLOSE_SOCKET(sockfd);
         return -1;
     }
+    send_window->base = client_seq + 1;
+    send_window->next_seq_num = client_seq + 1;
+
+    // FEC编码器：分组从第一个DATA帧开始；创建失败时只是不发校验帧
+    FecEncoder* fec = (fec_k > 0) ? create_fec_encoder(fec_k, client_seq + 1, window_size) : NULL;
+
+    uint8_t rx_buffer[MAX_PACKET_SIZE];    // ACK接收缓冲区，recv_view引用其中的帧
+    FrameView recv_view;
+    int file_done = 0;
+    int transfer_failed = 0;
+
+    // 坚持定时器：对端通告零窗口且没有在途数据时，按退避间隔发送窗口探测，
+    // 探测不占用发送窗口，不触发重传和拥塞控制；连续max_retries次无应答视为对端失联
+    uint64_t persist_deadline = 0;
+    uint64_t persist_interval_us = 0;
+    int unanswered_probes = 0;
+
+    while (!file_done || has_unacked_packets(send_window)) {
+        // 1. 在允许范围内发送新数据：min(拥塞窗口, 对端通告窗口) - 在途字节数，
+        //    且不超过-w窗口的帧数。余量不足一个整帧时等待ACK或窗口更新，不发送小帧
+        while (!file_done && !is_send_window_full(send_window) &&
+               get_send_allowance(cc, peer_window, send_window->bytes_in_flight) >= MAX_DATA_LENGTH) {
+            // 文件数据直接读入发送窗口槽位的帧数据区，之后原地补帧头
+            uint8_t* wire = reserve_send_slot(send_window);
+            if (wire == NULL) {
+                log_message(2, "ERROR: Failed to reserve send window slot");
+                transfer_failed = 1;
+                break;
+            }
 
-    log_message(0, "Client: Connection established, starting file transmission");
+            size_t bytes_read = file_reader_read(input, wire + FRAME_HEADER_SIZE, MAX_DATA_LENGTH);
+            if (bytes_read == 0) {
+                // 文件读取完成，等待在途数据全部确认；最后一组不足K帧也发送校验帧
+                log_message(0, "Client: File fully read, waiting for outstanding ACKs");
+                file_done = 1;
+                if (fec != NULL) {
+                    send_fec_parity(fec, sockfd, &server_addr, checksum_mode, conn);
+                }
+                break;
+            }
+
+            // 创建DATA帧
+            uint32_t seq = send_window->next_seq_num;
+            int wire_len = frame_build_in_place(wire, FRAME_MAX_SIZE, seq, server_seq + 1, window_size,
+                                                DATA, (uint16_t)bytes_read, checksum_mode);
+            if (wire_len <= 0 || !commit_send_slot(send_window, wire_len, (uint16_t)bytes_read)) {
+                log_message(2, "ERROR: Failed to add frame to send window");
+                transfer_failed = 1;
+                break;
+            }
 
-    // ===== 数据传输阶段 =====
-    uint32_t next_seq = client_seq + 1;
-    char data_buffer[MAX_DATA_LENGTH];
-    int ack_received = 1;
-    int consecutive_timeouts = 0;
+            // 发送DATA帧（发送失败时由超时重传兜底）
+            ssize_t sent = send_wire_packet(sockfd, &server_addr, wire, wire_len);
+            if (sent > 0) {
+                connection_count(&conn->frames_sent, 1);
+                connection_count(&conn->bytes_sent, bytes_read);
+                log_message(0, "Client: Sent DATA packet seq=%u len=%zu", seq, bytes_read);
+            }
 
-    while (1) {
-        // 读取文件数据
-        size_t bytes_read = read_file_chunk(input, data_buffer, MAX_DATA_LENGTH);
+            // 凑满一组就发送校验帧
+            if (fec != NULL && fec_encoder_add(fec, seq, wire + FRAME_HEADER_SIZE, (uint16_t)bytes_read)) {
+                send_fec_parity(fec, sockfd, &server_addr, checksum_mode, conn);
+            }
+        }
 
-        if (bytes_read == 0) {
-            // 文件读取完成
-            log_message(0, "Client: File transmission complete, sending FIN");
+        if (transfer_failed) {
             break;
         }
 
-        // 创建DATA帧
-        memset(&send_frame, 0, sizeof(send_frame));
-        send_frame.seq_num = next_seq;
-        send_frame.ack_num = server_seq + 1;
-        send_frame.window_size = window_size;
-        send_frame.frame_type = DATA;
-        send_frame.data_len = bytes_read;
-        memcpy(send_frame.data, data_buffer, bytes_read);
-
-        // 发送DATA帧
-        ssize_t sent = send_packet(sockfd, &server_addr, &send_frame);
-        if (sent > 0) {
-            total_packets++;
-            total_bytes += bytes_read;
-            log_message(0, "Client: Sent DATA packet seq=%u len=%zu", next_seq, bytes_read);
+        // 2. 等待ACK到达或最早的重传截止时间（没有在途包时不等待）；
+        //    对端窗口关闭时改为等待窗口更新或坚持定时器到期
+        uint64_t deadline = get_next_send_deadline(send_window, get_rto(cc));
+        bool window_closed = !file_done && !has_unacked_packets(send_window);
+        if (window_closed) {
+            uint64_t now = get_monotonic_time_us();
+            if (persist_deadline == 0) {
+                persist_interval_us = get_rto(cc);
+                persist_deadline = now + persist_interval_us;
+                log_message(0, "Client: Peer window closed (%u bytes), starting persist timer", peer_window);
+            }
+            else if (now >= persist_deadline) {
+                if (unanswered_probes >= max_retries) {
+                    log_message(2, "ERROR: Peer did not answer %d window probes", unanswered_probes);
+                    transfer_failed = 1;
+                    break;
+                }
+                memset(&send_frame, 0, sizeof(send_frame));
+                send_frame.seq_num = send_window->next_seq_num;
+                send_frame.ack_num = server_seq + 1;
+                send_frame.window_size = window_size;
+                send_frame.frame_type = ACK;
+                send_frame.data_len = 0;
+                send_packet(sockfd, &server_addr, &send_frame, checksum_mode);
+                connection_count(&conn->frames_sent, 1);
+                unanswered_probes++;
+                log_message(0, "Client: Sent window probe #%d", unanswered_probes);
+
+                persist_interval_us *= 2;
+                if (persist_interval_us > (uint64_t)MAX_RTO_MS * 1000) {
+                    persist_interval_us = (uint64_t)MAX_RTO_MS * 1000;
+                }
+                persist_deadline = now + persist_interval_us;
+            }
+            deadline = persist_deadline;
+        }
+        else {
+            persist_deadline = 0;
+        }
+        int event = (deadline != 0) ? event_loop_wait(loop, deadline) : EVENT_TIMEOUT;
+        if (event == EVENT_ERROR) {
+            log_message(2, "ERROR: Event loop failure");
+            transfer_failed = 1;
+            break;
         }
 
-        next_seq += bytes_read;
-
-        // 等待ACK（简化版，实际应实现流水线）
-        int ack_received = 0;
-        for (int i = 0; i < 20; i++) {
-            ssize_t recv_len = receive_packet(sockfd, &recv_addr, &recv_frame);
-            if (recv_len > 0 && recv_frame.frame_type == ACK) {
-                log_message(0, "Client: Received ACK for seq=%u", recv_frame.ack_num);
-                server_seq = recv_frame.seq_num;
-                ack_received = 1;
-                consecutive_timeouts = 0;
-                break;
+        ssize_t recv_len = -1;
+        if (event == EVENT_READABLE) {
+            recv_len = receive_packet_view(sockfd, &recv_addr, rx_buffer, sizeof(rx_buffer),
+                                           &recv_view, checksum_mode);
+        }
+        if (recv_len > 0 && (recv_view.frame_type == ACK || recv_view.frame_type == NACK)) {
+            connection_count(&conn->frames_received, 1);
+            uint32_t ack = recv_view.ack_num;
+            server_seq = recv_view.seq_num;
+            peer_window = window_decode(recv_view.window_size, peer_wscale);
+            unanswered_probes = 0;
+
+            bool new_ack = seq_gt(ack, send_window->base) && seq_leq(ack, send_window->next_seq_num);
+            bool dup_ack = (ack == send_window->base && has_unacked_packets(send_window));
+            if (new_ack) {
+                // 新ACK：用本次确认的最后一个包采样RTT（Karn算法：重传过的包不采样）。
+                // 确认范围内只要有重传过的包就不采样：这个累积ACK可能是重传触发的，
+                // 用最后一个包的发送时间会把整段重传等待算进RTT，RTO被抬高后又被反复加倍
+                log_message(0, "Client: Received ACK for seq=%u", ack);
+                UnackedPacket* newest = get_unacked_packet(send_window, ack - 1);
+                bool karn_ok = (newest != NULL);
+                for (uint32_t s = send_window->base; karn_ok && s != ack; s++) {
+                    UnackedPacket* acked = get_unacked_packet(send_window, s);
+                    karn_ok = (acked == NULL || !acked->is_retransmitted);
+                }
+                if (karn_ok) {
+                    update_rtt(cc, (uint32_t)(get_monotonic_time_us() - newest->send_time));
+                }
+
+                // 滑动窗口
+                uint32_t inflight_before = send_window->bytes_in_flight;
+                update_send_window(send_window, ack);
+                connection_count(&conn->bytes_acked, inflight_before - send_window->bytes_in_flight);
+            }
+
+            // 选择确认：标记已到达接收端的包（不再超时重传），得出当前的空洞
+            int hole_count = 0;
+            if (sack_enabled && recv_view.data_len > 0 && seq_geq(ack, send_window->base)) {
+                hole_count = apply_send_sack(send_window, ack, recv_view.payload, recv_view.data_len,
+                                             holes, window_size);
+            }
+
+            // FEC：组内唯一的空洞在校验帧发出后约一个RTO内暂缓重传，等接收端还原；
+            // 暂缓期间的重复ACK不计数，还原成功时不触发重传也不减小拥塞窗口
+            uint64_t now = get_monotonic_time_us();
+            uint64_t fec_hold_us = (cc->rtt_us > 0) ? (uint64_t)cc->rtt_us + 4 * (uint64_t)cc->rttvar_us : get_rto(cc);
+
+            if (new_ack) {
+                // 拥塞窗口增长
+                CongestionAction action = update_congestion_control(cc, ack, false, send_window->next_seq_num - 1);
+                if (action == CC_ACTION_PARTIAL_ACK) {
+                    // 部分ACK：新的窗口首部就是下一个空洞，立即重传，不等超时
+                    // （超时恢复中只补发已超时的包，仍在计时的包留给自己的定时器）
+                    UnackedPacket* hole = get_unacked_packet(send_window, send_window->base);
+                    if (hole != NULL && (cc->state == FAST_RECOVERY || hole->timed_out) &&
+                        !fec_hold(fec, hole, holes, hole_count, now, fec_hold_us) &&
+                        retransmit_packet(send_window, hole->seq_num)) {
+                        log_message(1, "WARNING: Partial ACK, retransmit next hole seq=%u", hole->seq_num);
+                        send_wire_packet(sockfd, &server_addr, hole->wire, hole->wire_len);
+                        count_retransmission(conn, hole);
+                    }
+                }
+            }
+            else if (dup_ack &&
+                     !fec_hold(fec, get_unacked_packet(send_window, ack), holes, hole_count, now, fec_hold_us)) {
+                // 重复ACK：达到阈值时快速重传窗口首部的包；
+                // 第1、2个重复ACK通过get_send_allowance放行新数据（受限传输）
+                CongestionAction action = update_congestion_control(cc, ack, true, send_window->next_seq_num - 1);
+                if (action == CC_ACTION_FAST_RETRANSMIT) {
+                    UnackedPacket* lost = get_unacked_packet(send_window, send_window->base);
+                    if (lost != NULL && retransmit_packet(send_window, lost->seq_num)) {
+                        log_message(1, "WARNING: Triple duplicate ACK, fast retransmit seq=%u", lost->seq_num);
+                        send_wire_packet(sockfd, &server_addr, lost->wire, lost->wire_len);
+                        count_retransmission(conn, lost);
+                    }
+                }
+            }
+
+            // NACK表示接收端刚发现空洞，立即重传位图中缺失的包，而不是等超时逐个补发。
+            // 已经重传过的空洞每个RTT最多再重传一次，先前的重传可能还在路上。
+            // 这里的重传不计入max_retries：回环上一个RTT只有约100微秒，按NACK计数
+            // 会在几毫秒内耗尽一个持续空洞的重传次数，第一次超时就放弃传输
+            if (recv_view.frame_type == NACK && hole_count > 0) {
+                uint64_t min_interval = (cc->rtt_us > 0) ? cc->rtt_us : get_rto(cc);
+                int resent = 0;
+                for (int i = 0; i < hole_count; i++) {
+                    UnackedPacket* hole = get_unacked_packet(send_window, holes[i]);
+                    if (hole == NULL || (hole->is_retransmitted && now - hole->send_time < min_interval) ||
+                        fec_hold(fec, hole, holes, hole_count, now, fec_hold_us)) {
+                        continue;
+                    }
+                    if (resent == 0) {
+                        handle_congestion_nack(cc, ack, send_window->next_seq_num - 1);
+                    }
+                    if (!retransmit_packet(send_window, hole->seq_num)) {
+                        continue;
+                    }
+                    send_wire_packet(sockfd, &server_addr, hole->wire, hole->wire_len);
+                    count_retransmission(conn, hole);
+                    resent++;
+                }
+                log_message(1, "WARNING: NACK ack=%u, %d holes, %d retransmitted", ack, hole_count, resent);
             }
-            sleep_ms(50);
+            connection_update_congestion(conn, cc);
         }
 
-        if (!ack_received) {
-            consecutive_timeouts++;
-            if (consecutive_timeouts >= 3) {
-                log_message(1, "WARNING: Multiple ACK timeouts, may indicate packet loss");
-                retransmitted_packets++;
+        // 3. 超时重传：只重传窗口首部（RFC 6298 5.4），其余超时包保持timed_out标记，
+        //    ACK推进到它们时按部分ACK逐个补发，避免一次性重发整个窗口。
+        //    只有窗口首部确实超时并被重传时才做超时的拥塞响应，否则一次丢包
+        //    中后面的包陆续到期会让ssthresh和cwnd被反复减半、RTO被反复加倍
+        check_send_timeouts(send_window, get_rto(cc));
+        UnackedPacket* unacked = get_unacked_packet(send_window, send_window->base);
+        if (unacked != NULL && unacked->timed_out) {
+            if (unacked->timeout_count > max_retries) {
+                log_message(2, "ERROR: Packet seq=%u exceeded %d timeout retransmissions", unacked->seq_num, max_retries);
+                transfer_failed = 1;
+                break;
+            }
+            // 重传失败时包仍保持timed_out，下一轮再试，不重复做拥塞响应
+            if (retransmit_packet(send_window, unacked->seq_num)) {
+                handle_congestion_timeout(cc, send_window->next_seq_num - 1);
+                send_wire_packet(sockfd, &server_addr, unacked->wire, unacked->wire_len);
+                count_retransmission(conn, unacked);
+                connection_update_congestion(conn, cc);
             }
         }
     }
 
+    uint32_t next_seq = send_window->next_seq_num;
+    uint64_t fin_timeout_us = get_rto(cc);     // 等待FIN-ACK沿用最后的RTO
+    free_send_window(send_window);
+    free_congestion_control(cc);
+    free_fec_encoder(fec);
+    free(holes);
+
+    if (transfer_failed) {
+        log_message(2, "ERROR: File transmission aborted");
+        conn->state = CLOSED;
+        connection_free(conn);
+        close_file_reader(input);
+        free_event_loop(loop);
+        CLOSE_SOCKET(sockfd);
+        return -1;
+    }
+
+    log_message(0, "Client: File transmission complete, sending FIN");
+
     // ===== 四次挥手 =====
     log_message(0, "Client: Starting graceful shutdown...");
 
@@ -496,34 +769,53 @@ int client_main(const char* server_ip, int port, const char* input_file, int win
     send_frame.frame_type = FIN;
     send_frame.data_len = 0;
 
-    ssize_t sent = send_packet(sockfd, &server_addr, &send_frame);
-    if (sent > 0) {
-        log_message(0, "Client: Sent FIN");
-    }
+    update_connection_state(conn, FIN_WAIT_1);
 
-    // 等待FIN-ACK
-    for (int i = 0; i < 20; i++) {
-        ssize_t recv_len = receive_packet(sockfd, &recv_addr, &recv_frame);
-        if (recv_len > 0 && (recv_frame.frame_type == FIN_ACK || recv_frame.frame_type == ACK)) {
-            log_message(0, "Client: Received final ACK");
-            break;
+    // FIN丢失时重发，最多max_retries次
+    int fin_acked = 0;
+    for (int attempt = 0; attempt < max_retries && !fin_acked; attempt++) {
+        ssize_t sent = send_packet(sockfd, &server_addr, &send_frame, checksum_mode);
+        if (sent > 0) {
+            log_message(0, "Client: Sent FIN");
+        }
+
+        // 等待FIN-ACK（期间可能还会收到迟到的数据ACK）
+        uint64_t deadline = get_monotonic_time_us() + fin_timeout_us;
+        while (!fin_acked && event_loop_wait(loop, deadline) == EVENT_READABLE) {
+            ssize_t recv_len = receive_packet(sockfd, &recv_addr, &recv_frame, checksum_mode);
+            if (recv_len > 0 && recv_frame.frame_type == FIN_ACK) {
+                log_message(0, "Client: Received final ACK");
+                fin_acked = 1;
+            }
         }
-        sleep_ms(100);
+    }
+
+    if (!fin_acked) {
+        log_message(1, "WARNING: No FIN-ACK from server, closing anyway");
     }
 
     // 关闭文件和套接字
-    fclose(input);
+    if (!close_file_reader(input)) {
+        log_message(2, "ERROR: Failed to read input file: %s", input_file);
+    }
+    free_event_loop(loop);
     CLOSE_SOCKET(sockfd);
 
     // 计算统计信息
     long end_time = get_current_time_ms();
     long total_time = end_time - start_time;
 
-    // 打印统计信息
+    // 打印统计信息（有效字节数以对端确认为准）
+    ConnectionStats stats;
+    connection_get_stats(conn, &stats);
     printf("\n");
-    print_statistics(NULL, total_bytes, total_time, total_packets, retransmitted_packets);
+    print_statistics(NULL, stats.bytes_acked, total_time, stats.frames_sent, stats.retransmit_count);
+
+    log_message(0, "Client: Transfer complete - %llu bytes in %ld ms, srtt=%u us, rto=%u us, cwnd=%u",
+                (unsigned long long)stats.bytes_acked, total_time, stats.rtt_us, stats.rto_us, stats.cwnd);
 
-    log_message(0, "Client: Transfer complete - %zu bytes in %ld ms", total_bytes, total_time);
+    update_connection_state(conn, CLOSED);
+    connection_free(conn);
     return 0;
 }
 
@@ -547,7 +839,7 @@ void run_client_mode(const char* server_ip, uint16_t port)
     }
 
     // 调用新的client_main函数
-    client_main(server_ip, port, "input.dat", WINDOW_SIZE);
+    client_main(server_ip, port, "input.dat", WINDOW_SIZE, 0, MAX_RETRIES);
 }
 
 void run_server_mode(uint16_t port)
@@ -583,15 +875,20 @@ int main(int argc, char* argv[])
     char input_file[MAX_FILENAME];
     char output_file[MAX_FILENAME];
     int window_size = WINDOW_SIZE;
+    int workers = 0;
+    int fec_group = 0;
+    int max_retries = MAX_RETRIES;
 
     if (!parse_command_line(argc, argv, is_server, server_ip, port, 
-                           input_file, output_file, window_size)) {
+                           input_file, output_file, window_size, workers, fec_group, max_retries)) {
         if (argc > 1 && (strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0)) {
             // parse_command_line already printed help
         } else {
             printf("Usage examples:\n");
             printf("  %s -s -p 8888 -out output.dat               (Server mode)\n", argv[0]);
+            printf("  %s -s -p 8888 -out upload -j 4              (Multi-client server mode)\n", argv[0]);
             printf("  %s -c -i 127.0.0.1 -p 8888 -in input.dat  (Client mode)\n", argv[0]);
+            printf("  %s -c -i 127.0.0.1 -p 8888 -in input.dat -fec 8  (Client mode with XOR FEC)\n", argv[0]);
             printf("\n");
         }
         cleanup_reliable_transport();
@@ -604,6 +901,8 @@ int main(int argc, char* argv[])
         if (strlen(output_file) == 0) {
             log_message(2, "ERROR: Output file required for server mode");
             result = -1;
+        } else if (workers > 0) {
+            result = multi_server_main(port, output_file, window_size, workers);
         } else {
             result = server_main(port, output_file, window_size);
         }
@@ -612,7 +911,7 @@ int main(int argc, char* argv[])
             log_message(2, "ERROR: Input file required for client mode");
             result = -1;
         } else {
-            result = client_main(server_ip, port, input_file, window_size);
+            result = client_main(server_ip, port, input_file, window_size, fec_group, max_retries);
         }
     }
 
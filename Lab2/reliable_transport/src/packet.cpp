@@ -101,113 +101,181 @@ int frame_verify_checksum(const Frame* frame)
 // ==================== 字节序转换辅助函数 ====================
 
 /**
- * 主机字节序转网络字节序（32位）
+ * 按网络字节序（大端）写入/读取16位和32位整数
+ * 逐字节操作，与主机字节序和缓冲区对齐无关
  */
-static inline uint32_t htonl_custom(uint32_t value)
+static inline void put_be16(uint8_t* ptr, uint16_t value)
 {
-    return ((value & 0xFF000000) >> 24) |
-           ((value & 0x00FF0000) >> 8) |
-           ((value & 0x0000FF00) << 8) |
-           ((value & 0x000000FF) << 24);
+    ptr[0] = (value >> 8) & 0xFF;
+    ptr[1] = value & 0xFF;
 }
 
+static inline void put_be32(uint8_t* ptr, uint32_t value)
+{
+    ptr[0] = (value >> 24) & 0xFF;
+    ptr[1] = (value >> 16) & 0xFF;
+    ptr[2] = (value >> 8) & 0xFF;
+    ptr[3] = value & 0xFF;
+}
+
+static inline uint16_t get_be16(const uint8_t* ptr)
+{
+    return (uint16_t)(((uint16_t)ptr[0] << 8) | (uint16_t)ptr[1]);
+}
+
+static inline uint32_t get_be32(const uint8_t* ptr)
+{
+    return ((uint32_t)ptr[0] << 24) | ((uint32_t)ptr[1] << 16) |
+           ((uint32_t)ptr[2] << 8) | (uint32_t)ptr[3];
+}
+
+// ==================== 帧尾与握手选项 ====================
+
 /**
- * 网络字节序转主机字节序（32位）
+ * 判断帧是否带CRC32C帧尾
+ * SYN和SYN_ACK负责协商校验模式，始终不带帧尾
  */
-static inline uint32_t ntohl_custom(uint32_t value)
+static bool frame_has_trailer(uint8_t frame_type, ChecksumMode mode)
 {
-    return htonl_custom(value);  // 转换是对称的
+    return mode == CHECKSUM_CRC32C && frame_type != SYN && frame_type != SYN_ACK;
 }
 
 /**
- * 主机字节序转网络字节序（16位）
+ * 向帧的数据部分追加一个握手选项（TLV）
  */
-static inline uint16_t htons_custom(uint16_t value)
+bool frame_add_option(Frame* frame, uint8_t type, const uint8_t* value, uint8_t len)
 {
-    return ((value & 0xFF00) >> 8) | ((value & 0x00FF) << 8);
+    if (frame == NULL || (value == NULL && len > 0)) {
+        return false;
+    }
+
+    if (frame->data_len + 2 + len > MAX_DATA_LENGTH) {
+        return false;
+    }
+
+    uint8_t* ptr = frame->data + frame->data_len;
+    ptr[0] = type;
+    ptr[1] = len;
+    if (len > 0) {
+        memcpy(ptr + 2, value, len);
+    }
+    frame->data_len += 2 + len;
+
+    return true;
 }
 
 /**
- * 网络字节序转主机字节序（16位）
+ * 在选项区中查找指定类型的TLV选项
  */
-static inline uint16_t ntohs_custom(uint16_t value)
+static const uint8_t* find_option(const uint8_t* options, uint16_t options_len, uint8_t type, uint8_t* len)
 {
-    return htons_custom(value);  // 转换是对称的
+    size_t pos = 0;
+    while (pos + 2 <= options_len) {
+        uint8_t opt_type = options[pos];
+        uint8_t opt_len = options[pos + 1];
+
+        // 长度越界说明选项区已损坏，停止解析
+        if (pos + 2 + opt_len > options_len) {
+            break;
+        }
+
+        if (opt_type == type) {
+            if (len != NULL) {
+                *len = opt_len;
+            }
+            return options + pos + 2;
+        }
+
+        pos += 2 + opt_len;
+    }
+
+    return NULL;
 }
 
-// ==================== 帧序列化 ====================
+/**
+ * 在帧的数据部分查找握手选项
+ */
+const uint8_t* frame_find_option(const Frame* frame, uint8_t type, uint8_t* len)
+{
+    if (frame == NULL) {
+        return NULL;
+    }
+
+    return find_option(frame->data, frame->data_len, type, len);
+}
 
 /**
- * 将帧序列化为字节流
+ * 在帧视图的数据部分查找握手选项
+ */
+const uint8_t* frame_view_find_option(const FrameView* view, uint8_t type, uint8_t* len)
+{
+    if (view == NULL || view->payload == NULL) {
+        return NULL;
+    }
+
+    return find_option(view->payload, view->data_len, type, len);
+}
+
+// ==================== 原地构建帧 ====================
+
+/**
+ * 原地构建帧
  * 
- * 序列化格式（网络字节序，大端）：
+ * 帧格式（网络字节序，大端）：
  * [0-3]   : seq_num (32位)
  * [4-7]   : ack_num (32位)
  * [8-9]   : window_size (16位)
  * [10]    : frame_type (8位)
  * [11-12] : data_len (16位)
- * [13]    : checksum (8位)
- * [14+]   : data (可变长度)
+ * [13]    : checksum (8位，这里写0)
+ * [14+]   : data (可变长度，调用方已写入)
+ * [末尾]  : CRC32C (32位，仅CHECKSUM_CRC32C模式)
+ * 
+ * 数据不经过任何中间缓冲区：调用方直接把数据读到buffer + FRAME_HEADER_SIZE，
+ * 这里只补上帧头和帧尾
  */
-int frame_serialize(const Frame* frame, uint8_t* buffer, size_t buf_size)
+int frame_build_in_place(uint8_t* buffer, size_t buf_size, uint32_t seq_num, uint32_t ack_num,
+                         uint16_t window_size, FrameType frame_type, uint16_t data_len,
+                         ChecksumMode mode)
 {
-    if (frame == NULL || buffer == NULL) {
+    if (buffer == NULL || data_len > MAX_DATA_LENGTH) {
         return -1;
     }
 
     // 计算需要的缓冲区大小
-    size_t needed = FRAME_HEADER_SIZE + frame->data_len;
+    bool with_trailer = frame_has_trailer(frame_type, mode);
+    size_t covered = FRAME_HEADER_SIZE + data_len;
+    size_t needed = covered + (with_trailer ? FRAME_TRAILER_SIZE : 0);
 
     if (buf_size < needed) {
         return -1;
     }
 
-    // 序列化seq_num (网络字节序)
-    uint32_t seq_net = htonl_custom(frame->seq_num);
-    buffer[0] = (seq_net >> 24) & 0xFF;
-    buffer[1] = (seq_net >> 16) & 0xFF;
-    buffer[2] = (seq_net >> 8) & 0xFF;
-    buffer[3] = seq_net & 0xFF;
-
-    // 序列化ack_num (网络字节序)
-    uint32_t ack_net = htonl_custom(frame->ack_num);
-    buffer[4] = (ack_net >> 24) & 0xFF;
-    buffer[5] = (ack_net >> 16) & 0xFF;
-    buffer[6] = (ack_net >> 8) & 0xFF;
-    buffer[7] = ack_net & 0xFF;
-
-    // 序列化window_size (网络字节序)
-    uint16_t window_net = htons_custom(frame->window_size);
-    buffer[8] = (window_net >> 8) & 0xFF;
-    buffer[9] = window_net & 0xFF;
-
-    // 序列化frame_type
-    buffer[10] = frame->frame_type;
-
-    // 序列化data_len (网络字节序)
-    uint16_t data_len_net = htons_custom(frame->data_len);
-    buffer[11] = (data_len_net >> 8) & 0xFF;
-    buffer[12] = data_len_net & 0xFF;
-
-    // 序列化checksum
-    buffer[13] = frame->checksum;
+    put_be32(buffer, seq_num);
+    put_be32(buffer + 4, ack_num);
+    put_be16(buffer + 8, window_size);
+    buffer[10] = (uint8_t)frame_type;
+    put_be16(buffer + 11, data_len);
+    buffer[13] = 0;
 
-    // 复制数据部分
-    if (frame->data_len > 0) {
-        memcpy(buffer + FRAME_HEADER_SIZE, frame->data, frame->data_len);
+    // 追加CRC32C帧尾（网络字节序）
+    if (with_trailer) {
+        put_be32(buffer + covered, crc32c_update(0, buffer, covered));
     }
 
     return (int)needed;
 }
 
-// ==================== 帧反序列化 ====================
+// ==================== 帧视图解析 ====================
 
 /**
- * 将字节流反序列化为帧
+ * 解析帧视图
+ * 
+ * 只解码14字节帧头并验证帧尾，payload直接指向buffer中的数据部分
  */
-int frame_deserialize(const uint8_t* buffer, size_t buf_size, Frame* frame)
+int frame_view_parse(FrameView* view, const uint8_t* buffer, size_t buf_size, ChecksumMode mode)
 {
-    if (buffer == NULL || frame == NULL) {
+    if (buffer == NULL || view == NULL) {
         return -1;
     }
 
@@ -216,55 +284,116 @@ int frame_deserialize(const uint8_t* buffer, size_t buf_size, Frame* frame)
         return -1;
     }
 
-    // 反序列化seq_num (从网络字节序转换)
-    uint32_t seq_net = ((uint32_t)buffer[0] << 24) |
-                       ((uint32_t)buffer[1] << 16) |
-                       ((uint32_t)buffer[2] << 8) |
-                       (uint32_t)buffer[3];
-    frame->seq_num = ntohl_custom(seq_net);
+    view->seq_num = get_be32(buffer);
+    view->ack_num = get_be32(buffer + 4);
+    view->window_size = get_be16(buffer + 8);
+    view->frame_type = buffer[10];
+    view->data_len = get_be16(buffer + 11);
+    view->checksum = buffer[13];
+    view->payload = buffer + FRAME_HEADER_SIZE;
 
-    // 反序列化ack_num (从网络字节序转换)
-    uint32_t ack_net = ((uint32_t)buffer[4] << 24) |
-                       ((uint32_t)buffer[5] << 16) |
-                       ((uint32_t)buffer[6] << 8) |
-                       (uint32_t)buffer[7];
-    frame->ack_num = ntohl_custom(ack_net);
+    // 校验数据长度
+    if (view->data_len > MAX_DATA_LENGTH) {
+        return -1;
+    }
 
-    // 反序列化window_size (从网络字节序转换)
-    uint16_t window_net = ((uint16_t)buffer[8] << 8) | (uint16_t)buffer[9];
-    frame->window_size = ntohs_custom(window_net);
+    // 检查缓冲区大小是否足够
+    size_t covered = FRAME_HEADER_SIZE + view->data_len;
+    if (buf_size < covered) {
+        return -1;
+    }
 
-    // 反序列化frame_type
-    frame->frame_type = buffer[10];
+    // 验证CRC32C帧尾
+    if (frame_has_trailer(view->frame_type, mode)) {
+        if (buf_size < covered + FRAME_TRAILER_SIZE) {
+            return -2;
+        }
+        if (crc32c_update(0, buffer, covered) != get_be32(buffer + covered)) {
+            return -2;
+        }
+    }
 
-    // 反序列化data_len (从网络字节序转换)
-    uint16_t data_len_net = ((uint16_t)buffer[11] << 8) | (uint16_t)buffer[12];
-    frame->data_len = ntohs_custom(data_len_net);
+    return 0;
+}
 
-    // 反序列化checksum
-    frame->checksum = buffer[13];
+// ==================== 帧序列化 ====================
 
-    // 校验数据长度
-    if (frame->data_len > MAX_DATA_LENGTH) {
+/**
+ * 将帧序列化为字节流（格式见frame_build_in_place）
+ * 
+ * 数据部分复制一次到buffer，之后原地补帧头和帧尾
+ */
+int frame_serialize(const Frame* frame, uint8_t* buffer, size_t buf_size, ChecksumMode mode)
+{
+    if (frame == NULL || buffer == NULL) {
         return -1;
     }
 
-    // 检查缓冲区大小是否足够
-    if (buf_size < (size_t)(FRAME_HEADER_SIZE + frame->data_len)) {
+    if (frame->data_len > MAX_DATA_LENGTH || buf_size < (size_t)(FRAME_HEADER_SIZE + frame->data_len)) {
         return -1;
     }
 
-    // 初始化数据缓冲区
-    memset(frame->data, 0, MAX_DATA_LENGTH);
-
     // 复制数据部分
     if (frame->data_len > 0) {
-        memcpy(frame->data, buffer + FRAME_HEADER_SIZE, frame->data_len);
+        memcpy(buffer + FRAME_HEADER_SIZE, frame->data, frame->data_len);
+    }
+
+    int size = frame_build_in_place(buffer, buf_size, frame->seq_num, frame->ack_num, frame->window_size,
+                                    (FrameType)frame->frame_type, frame->data_len, mode);
+
+    // 传统模式下保留调用方填写的1字节校验和
+    if (size > 0 && !frame_has_trailer(frame->frame_type, mode)) {
+        buffer[13] = frame->checksum;
     }
 
+    return size;
+}
+
+// ==================== 帧反序列化 ====================
+
+/**
+ * 将字节流反序列化为帧
+ * 
+ * 先解析视图，再把数据部分复制一次到Frame中
+ */
+int frame_deserialize(const uint8_t* buffer, size_t buf_size, Frame* frame, ChecksumMode mode)
+{
+    if (buffer == NULL || frame == NULL) {
+        return -1;
+    }
+
+    FrameView view;
+    int result = frame_view_parse(&view, buffer, buf_size, mode);
+    if (result != 0) {
+        return result;
+    }
+
+    frame_view_to_frame(&view, frame);
     return 0;
 }
 
+/**
+ * 将帧视图复制为独立的Frame
+ */
+void frame_view_to_frame(const FrameView* view, Frame* frame)
+{
+    if (view == NULL || frame == NULL) {
+        return;
+    }
+
+    frame->seq_num = view->seq_num;
+    frame->ack_num = view->ack_num;
+    frame->window_size = view->window_size;
+    frame->frame_type = view->frame_type;
+    frame->data_len = view->data_len;
+    frame->checksum = view->checksum;
+
+    // 复制数据部分
+    if (view->data_len > 0) {
+        memcpy(frame->data, view->payload, view->data_len);
+    }
+}
+
 // ==================== 帧类型转字符串 ====================
 
 /**
@@ -285,6 +414,10 @@ const char* frame_type_to_string(FrameType frame_type)
             return "FIN_ACK";
         case DATA:
             return "DATA";
+        case NACK:
+            return "NACK";
+        case PARITY:
+            return "PARITY";
         default:
             return "UNKNOWN";
     }
@@ -0,0 +1,400 @@
+#include "server.h"
+#include "connection.h"
+#include "packet.h"
+#include "window.h"
+#include "utils.h"
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <csignal>
+#include <ctime>
+#include <pthread.h>
+
+// Platform-specific headers
+#ifdef _WIN32
+    #include <winsock2.h>
+#else
+    #include <unistd.h>
+    #include <arpa/inet.h>
+#endif
+
+// ==================== 常量定义 ====================
+
+#define SERVER_WAKEUP_INTERVAL_MS 1000  // 空闲时每秒唤醒一次：检查退出标志、回收连接
+#define CONNECTION_LINGER_SEC 2         // 连接进入LAST_ACK后保留的时间（应答重发的FIN）
+#define CONNECTION_IDLE_TIMEOUT_SEC 30  // 连接无任何数据报的最长时间
+#define INITIAL_TABLE_BUCKETS 64        // 每个工作线程连接表的初始桶数
+#define MAX_OUTPUT_PATH 512             // 输出文件路径（前缀 + 对端地址）的最大长度
+
+// ==================== 工作线程 ====================
+
+/**
+ * 工作线程上下文
+ * 套接字、事件循环和连接表都由该线程独占
+ */
+typedef struct {
+    int id;                            // 线程编号
+    int port;                          // 监听端口
+    const char* output_prefix;         // 输出文件名前缀
+    int window_size;                   // 每个连接的初始接收窗口
+    int sockfd;                        // 本线程的UDP套接字（SO_REUSEPORT）
+    EventLoop* loop;                   // 本线程的事件循环
+    ConnectionTable* table;            // 本线程的连接表
+    FileWriteQueue* write_queue;       // 本线程所有连接共用的写回线程
+    uint32_t completed;                // 已完成的传输数
+    time_t last_reap;                  // 上一次回收连接的时间
+    pthread_t thread;                  // 线程句柄
+} ServerWorker;
+
+// 收到SIGINT/SIGTERM后置位，工作线程在下一次唤醒时退出
+static volatile sig_atomic_t g_server_stop = 0;
+
+static void handle_stop_signal(int signum)
+{
+    (void)signum;
+    g_server_stop = 1;
+}
+
+/**
+ * 格式化对端地址（不使用inet_ntoa的静态缓冲区，多线程安全）
+ */
+static void format_peer(const struct sockaddr_in* addr, char* buffer, size_t size)
+{
+    const uint8_t* ip = (const uint8_t*)&addr->sin_addr.s_addr;
+    snprintf(buffer, size, "%u.%u.%u.%u_%u", ip[0], ip[1], ip[2], ip[3], ntohs(addr->sin_port));
+}
+
+/**
+ * 为新的SYN创建连接：进入LISTEN，打开接收端，加入连接表
+ */
+static Connection* accept_connection(ServerWorker* worker, const struct sockaddr_in* peer)
+{
+    char peer_name[32];
+    char output_path[MAX_OUTPUT_PATH];
+    format_peer(peer, peer_name, sizeof(peer_name));
+    snprintf(output_path, sizeof(output_path), "%s.%s", worker->output_prefix, peer_name);
+
+    Connection* conn = create_server_connection(worker->port);
+    if (conn == NULL) {
+        return NULL;
+    }
+
+    conn->sockfd = worker->sockfd;
+    conn->peer_addr = *peer;
+
+    if (!server_listen(conn) || !connection_open_receiver(conn, worker->window_size, output_path, worker->write_queue)) {
+        log_message(2, "ERROR: Worker %d failed to accept connection from %s", worker->id, peer_name);
+        conn->sockfd = -1;
+        connection_free(conn);
+        return NULL;
+    }
+
+    connection_table_insert(worker->table, conn);
+    log_message(0, "Server[%d]: New connection from %s (%d active)", worker->id, peer_name, worker->table->count);
+
+    return conn;
+}
+
+/**
+ * 从连接表中移除并释放连接
+ * @param notify_peer 为false时不再向对端发送任何帧（对端已结束或已失联）
+ */
+static void retire_connection(ServerWorker* worker, Connection* conn, bool notify_peer)
+{
+    connection_table_remove(worker->table, conn);
+    if (!notify_peer) {
+        conn->sockfd = -1;
+    }
+    if (conn->state == LAST_ACK) {
+        update_connection_state(conn, CLOSED);
+    }
+    connection_free(conn);
+}
+
+/**
+ * 回收连接：LAST_ACK停留超过CONNECTION_LINGER_SEC的正常结束连接，
+ * 以及超过CONNECTION_IDLE_TIMEOUT_SEC没有任何数据报的失联连接
+ */
+static void reap_connections(ServerWorker* worker)
+{
+    time_t now = time(NULL);
+    if (now == worker->last_reap) {
+        return;
+    }
+    worker->last_reap = now;
+
+    for (int i = 0; i < worker->table->bucket_count; i++) {
+        Connection* conn = worker->table->buckets[i];
+        while (conn != NULL) {
+            Connection* next = conn->hash_next;
+            time_t idle = now - conn->last_activity;
+
+            if (conn->state == LAST_ACK && idle > CONNECTION_LINGER_SEC) {
+                retire_connection(worker, conn, false);
+            }
+            else if (idle > CONNECTION_IDLE_TIMEOUT_SEC) {
+                char peer_name[32];
+                format_peer(&conn->peer_addr, peer_name, sizeof(peer_name));
+                log_message(1, "WARNING: Server[%d]: Connection from %s idle for %ld s, dropped",
+                            worker->id, peer_name, (long)idle);
+                retire_connection(worker, conn, false);
+            }
+
+            conn = next;
+        }
+    }
+}
+
+/**
+ * 应答不属于任何连接的FIN（连接已回收后FIN_ACK丢失，客户端重发FIN）
+ * 校验模式无从查起，按FIN自身是否带帧尾推断
+ */
+static void answer_orphan_fin(ServerWorker* worker, const struct sockaddr_in* peer,
+                              const uint8_t* buffer, size_t len, const FrameView* view)
+{
+    ChecksumMode mode = (len >= (size_t)(FRAME_HEADER_SIZE + view->data_len + FRAME_TRAILER_SIZE))
+                        ? CHECKSUM_CRC32C : CHECKSUM_LEGACY;
+    FrameView verified;
+    if (frame_view_parse(&verified, buffer, len, mode) != 0) {
+        return;
+    }
+
+    Frame fin_ack = create_frame(0, view->seq_num + 1, 0, FIN_ACK, NULL, 0);
+    send_packet(worker->sockfd, peer, &fin_ack, mode);
+}
+
+/**
+ * 查找数据报所属的连接
+ * 新的SYN创建连接（同一地址的旧连接被替换），不属于任何连接的FIN直接应答
+ * @return 所属连接，数据报无需交给状态机时返回NULL
+ */
+static Connection* find_connection(ServerWorker* worker, const struct sockaddr_in* peer,
+                                   const uint8_t* buffer, size_t len, const FrameView* view)
+{
+    Connection* conn = connection_table_find(worker->table, peer);
+
+    // 同一地址的新SYN（客户端复用了已结束连接的端口）：替换旧连接
+    if (conn != NULL && view->frame_type == SYN &&
+        !(conn->state == SYN_RECEIVED && view->seq_num == conn->peer_seq_num)) {
+        retire_connection(worker, conn, false);
+        conn = NULL;
+    }
+
+    if (conn == NULL) {
+        if (view->frame_type == SYN) {
+            conn = accept_connection(worker, peer);
+        }
+        else if (view->frame_type == FIN) {
+            answer_orphan_fin(worker, peer, buffer, len, view);
+        }
+    }
+    return conn;
+}
+
+/**
+ * 把同一连接的一批帧交给状态机，并在连接进入LAST_ACK时完成该次传输
+ */
+static void dispatch_batch(ServerWorker* worker, Connection* conn, const FrameView* views, int count)
+{
+    ConnectionState before = conn->state;
+    connection_dispatch(conn, views, count);
+
+    if (before != LAST_ACK && conn->state == LAST_ACK) {
+        char peer_name[32];
+        ConnectionStats stats;
+        format_peer(&conn->peer_addr, peer_name, sizeof(peer_name));
+        connection_get_stats(conn, &stats);
+        log_message(0, "Server[%d]: Transfer from %s complete - %llu bytes, %llu frames, "
+                    "%llu duplicates, %.2f Mbps",
+                    worker->id, peer_name, (unsigned long long)stats.bytes_received,
+                    (unsigned long long)stats.frames_received,
+                    (unsigned long long)stats.retransmit_count, stats.goodput_mbps);
+
+        // 数据已全部写入，立即关闭文件；连接在LAST_ACK停留一段时间再回收
+        connection_close_receiver(conn);
+        worker->completed++;
+    }
+}
+
+/**
+ * 把一次唤醒接收到的数据报按连接分批交给状态机
+ * 
+ * 同一对端连续到达的数据报（通常是一串DATA）只查一次连接表，作为一批处理；
+ * SYN单独成批，协商出的校验模式对同一轮中之后的帧生效
+ */
+static void dispatch_datagrams(ServerWorker* worker, uint8_t (*buffers)[MAX_PACKET_SIZE], const size_t* lens,
+                               const struct sockaddr_in* peers, FrameView* views, int count)
+{
+    FrameView batch[SERVER_RX_BATCH];
+    int i = 0;
+
+    while (i < count) {
+        Connection* conn = find_connection(worker, &peers[i], buffers[i], lens[i], &views[i]);
+        if (conn == NULL) {
+            i++;
+            continue;
+        }
+
+        int batch_count = 0;
+        int j = i;
+        do {
+            // 数据报先按无帧尾解析（尚不知道所属连接）；协商了CRC32C的连接在这里补做校验
+            if (conn->checksum_mode != CHECKSUM_LEGACY &&
+                frame_view_parse(&views[j], buffers[j], lens[j], conn->checksum_mode) != 0) {
+                log_message(1, "CRC32C mismatch, frame dropped (%zu bytes)", lens[j]);
+            }
+            else {
+                batch[batch_count++] = views[j];
+            }
+            j++;
+        } while (j < count && views[i].frame_type != SYN && views[j].frame_type != SYN &&
+                 same_peer(&peers[j], &peers[i]));
+
+        if (batch_count > 0) {
+            dispatch_batch(worker, conn, batch, batch_count);
+        }
+        i = j;
+    }
+}
+
+/**
+ * 工作线程主循环
+ */
+static void* server_worker_main(void* arg)
+{
+    ServerWorker* worker = (ServerWorker*)arg;
+    uint8_t rx_buffers[SERVER_RX_BATCH][MAX_PACKET_SIZE];
+    size_t rx_lens[SERVER_RX_BATCH];
+    struct sockaddr_in peers[SERVER_RX_BATCH];
+    FrameView views[SERVER_RX_BATCH];
+
+    while (!g_server_stop) {
+        uint64_t deadline = get_monotonic_time_us() + (uint64_t)SERVER_WAKEUP_INTERVAL_MS * 1000;
+        int event = event_loop_wait(worker->loop, deadline);
+        if (event == EVENT_ERROR) {
+            log_message(2, "ERROR: Server[%d]: Event loop failure", worker->id);
+            break;
+        }
+
+        // 一次唤醒连续接收多个数据报，直到套接字读空或凑满一轮，再按连接分批处理
+        if (event == EVENT_READABLE) {
+            int received = 0;
+            while (received < SERVER_RX_BATCH) {
+                ssize_t len = receive_packet_view(worker->sockfd, &peers[received], rx_buffers[received],
+                                                  MAX_PACKET_SIZE, &views[received]);
+                if (len <= 0) {
+                    break;
+                }
+                rx_lens[received++] = (size_t)len;
+            }
+            dispatch_datagrams(worker, rx_buffers, rx_lens, peers, views, received);
+        }
+
+        reap_connections(worker);
+    }
+
+    return NULL;
+}
+
+// ==================== 多客户端服务器主函数 ====================
+
+/**
+ * 多客户端服务器主函数
+ */
+int multi_server_main(int port, const char* output_prefix, int window_size, int workers)
+{
+    if (output_prefix == NULL || strlen(output_prefix) == 0) {
+        log_message(2, "ERROR: Output file prefix is required");
+        return -1;
+    }
+
+#ifndef SO_REUSEPORT
+    if (workers > 1) {
+        log_message(1, "WARNING: SO_REUSEPORT unavailable, using a single worker");
+        workers = 1;
+    }
+#endif
+    if (workers < 1) {
+        workers = 1;
+    }
+
+    log_message(0, "\n========== MULTI-CLIENT SERVER MODE ==========");
+    log_message(0, "Listening on port: %d", port);
+    log_message(0, "Output prefix: %s", output_prefix);
+    log_message(0, "Window size: %d", window_size);
+    log_message(0, "Workers: %d", workers);
+
+    ServerWorker* pool = (ServerWorker*)calloc(workers, sizeof(ServerWorker));
+    if (pool == NULL) {
+        log_message(2, "ERROR: Failed to allocate worker pool");
+        return -1;
+    }
+
+    // 在主线程中创建所有套接字，绑定失败时不启动任何线程
+    int ready = 0;
+    for (; ready < workers; ready++) {
+        ServerWorker* worker = &pool[ready];
+        worker->id = ready;
+        worker->port = port;
+        worker->output_prefix = output_prefix;
+        worker->window_size = window_size;
+        worker->last_reap = time(NULL);
+        worker->sockfd = create_udp_socket();
+        if (worker->sockfd < 0) {
+            break;
+        }
+        set_socket_buffers(worker->sockfd, SOCKET_BUFFER_SIZE);
+
+        if ((workers > 1 && !set_socket_reuseport(worker->sockfd)) || !bind_socket(worker->sockfd, port) ||
+            !set_socket_nonblocking(worker->sockfd) ||
+            (worker->loop = create_event_loop(worker->sockfd)) == NULL ||
+            (worker->table = create_connection_table(INITIAL_TABLE_BUCKETS)) == NULL ||
+            (worker->write_queue = create_file_write_queue()) == NULL) {
+            free_connection_table(worker->table);
+            free_event_loop(worker->loop);
+            CLOSE_SOCKET(worker->sockfd);
+            break;
+        }
+    }
+
+    int result = 0;
+    if (ready < workers) {
+        log_message(2, "ERROR: Failed to set up worker %d on port %d", ready, port);
+        result = -1;
+    }
+    else {
+        g_server_stop = 0;
+        signal(SIGINT, handle_stop_signal);
+        signal(SIGTERM, handle_stop_signal);
+
+        int started = 0;
+        for (; started < workers; started++) {
+            if (pthread_create(&pool[started].thread, NULL, server_worker_main, &pool[started]) != 0) {
+                log_message(2, "ERROR: Failed to start worker thread %d", started);
+                g_server_stop = 1;
+                result = -1;
+                break;
+            }
+        }
+
+        log_message(0, "Server: %d workers running, press Ctrl+C to stop", started);
+
+        for (int i = 0; i < started; i++) {
+            pthread_join(pool[i].thread, NULL);
+        }
+    }
+
+    // 释放所有工作线程的资源
+    uint32_t completed = 0;
+    for (int i = 0; i < ready; i++) {
+        completed += pool[i].completed;
+        free_connection_table(pool[i].table);
+        free_file_write_queue(pool[i].write_queue);   // 连接（及其写入器）已全部释放
+        free_event_loop(pool[i].loop);
+        CLOSE_SOCKET(pool[i].sockfd);
+    }
+    free(pool);
+
+    log_message(0, "Server: Stopped after %u completed transfers", completed);
+    return result;
+}
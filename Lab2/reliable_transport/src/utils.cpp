@@ -4,7 +4,7 @@
 #include <cstdlib>
 #include <cstring>
 #include <ctime>
-#include <cstdarg>
+#include <cerrno>
 
 // Platform-specific headers
 #ifdef _WIN32
@@ -18,17 +18,18 @@
     #define SHUT_RDWR 2
 #else
     #include <sys/time.h>
+    #include <sys/resource.h>
     #include <sys/socket.h>
     #include <netinet/in.h>
     #include <arpa/inet.h>
     #include <unistd.h>
     #include <fcntl.h>
+    #include <poll.h>
+    #ifdef __linux__
+        #include <sys/epoll.h>
+    #endif
 #endif
 
-// ==================== 全局日志文件指针 ====================
-
-static FILE* g_log_file = NULL;
-
 // ==================== 获取时间戳 ====================
 
 uint64_t get_timestamp_ms()
@@ -49,6 +50,26 @@ uint64_t get_timestamp_ms()
 #endif
 }
 
+// ==================== 单调时钟（微秒） ====================
+
+uint64_t get_monotonic_time_us()
+{
+#ifdef _WIN32
+    static LARGE_INTEGER frequency = {0};
+    if (frequency.QuadPart == 0) {
+        QueryPerformanceFrequency(&frequency);
+    }
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return (uint64_t)(counter.QuadPart / frequency.QuadPart) * 1000000ULL +
+           (uint64_t)(counter.QuadPart % frequency.QuadPart) * 1000000ULL / frequency.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000;
+#endif
+}
+
 // ==================== 计算时间差 ====================
 
 uint64_t get_time_diff_ms(uint64_t end_time, uint64_t start_time)
@@ -103,58 +124,6 @@ void print_buffer_ascii(const uint8_t* buffer, size_t len, const char* label)
     printf("\n");
 }
 
-// ==================== 日志输出 ====================
-
-void log_message(int level, const char* format, ...)
-{
-    if (format == NULL) {
-        return;
-    }
-
-    FILE* output = (g_log_file != NULL) ? g_log_file : stdout;
-
-    const char* level_str = "";
-    switch (level) {
-        case 0: level_str = "[INFO] "; break;
-        case 1: level_str = "[WARNING] "; break;
-        case 2: level_str = "[ERROR] "; break;
-        default: level_str = "[UNKNOWN] "; break;
-    }
-
-    fprintf(output, "%s", level_str);
-
-    va_list args;
-    va_start(args, format);
-    vfprintf(output, format, args);
-    va_end(args);
-
-    fprintf(output, "\n");
-    fflush(output);
-}
-
-// ==================== 日志初始化 ====================
-
-int log_init(const char* filename)
-{
-    if (filename == NULL) {
-        g_log_file = NULL;
-        return 0;
-    }
-
-    g_log_file = fopen(filename, "a");
-    return (g_log_file != NULL) ? 0 : -1;
-}
-
-// ==================== 日志清理 ====================
-
-void log_cleanup()
-{
-    if (g_log_file != NULL) {
-        fclose(g_log_file);
-        g_log_file = NULL;
-    }
-}
-
 // ==================== 生成随机序列号 ====================
 
 uint32_t generate_random_seq()
@@ -277,9 +246,55 @@ bool bind_socket(int sockfd, int port)
 }
 
 /**
- * 向指定地址发送数据包
+ * 设置SO_REUSEPORT
  */
-ssize_t send_packet(int sockfd, const struct sockaddr_in* addr, const Frame* frame)
+bool set_socket_reuseport(int sockfd)
+{
+    if (sockfd < 0) {
+        log_message(2, "Invalid socket");
+        return false;
+    }
+
+#ifdef SO_REUSEPORT
+    int reuse = 1;
+    if (setsockopt(sockfd, SOL_SOCKET, SO_REUSEPORT, (const char*)&reuse, sizeof(reuse)) < 0) {
+        log_message(2, "Failed to set SO_REUSEPORT");
+        return false;
+    }
+    return true;
+#else
+    log_message(1, "Warning: SO_REUSEPORT is not supported on this platform");
+    return false;
+#endif
+}
+
+/**
+ * 设置套接字收发缓冲区大小
+ */
+bool set_socket_buffers(int sockfd, int bytes)
+{
+    if (sockfd < 0 || bytes <= 0) {
+        log_message(2, "Invalid socket or buffer size");
+        return false;
+    }
+
+    bool ok = true;
+    if (setsockopt(sockfd, SOL_SOCKET, SO_RCVBUF, (const char*)&bytes, sizeof(bytes)) < 0) {
+        log_message(1, "Warning: Failed to set SO_RCVBUF to %d bytes", bytes);
+        ok = false;
+    }
+    if (setsockopt(sockfd, SOL_SOCKET, SO_SNDBUF, (const char*)&bytes, sizeof(bytes)) < 0) {
+        log_message(1, "Warning: Failed to set SO_SNDBUF to %d bytes", bytes);
+        ok = false;
+    }
+    return ok;
+}
+
+/**
+ * 发送数据包
+ * 序列化到栈上缓冲区后交给send_wire_packet，数据部分只复制一次
+ */
+ssize_t send_packet(int sockfd, const struct sockaddr_in* addr, const Frame* frame, ChecksumMode mode)
 {
     if (sockfd < 0 || addr == NULL || frame == NULL) {
         log_message(2, "Invalid parameters for send_packet");
@@ -288,15 +303,28 @@ ssize_t send_packet(int sockfd, const struct sockaddr_in* addr, const Frame* fra
 
     // 序列化Frame
     uint8_t buffer[MAX_PACKET_SIZE];
-    int frame_size = frame_serialize(frame, buffer, MAX_PACKET_SIZE);
+    int frame_size = frame_serialize(frame, buffer, MAX_PACKET_SIZE, mode);
     
     if (frame_size <= 0) {
         log_message(2, "Failed to serialize frame");
         return -1;
     }
 
+    return send_wire_packet(sockfd, addr, buffer, frame_size);
+}
+
+/**
+ * 发送已构建好的帧
+ */
+ssize_t send_wire_packet(int sockfd, const struct sockaddr_in* addr, const uint8_t* wire, size_t wire_len)
+{
+    if (sockfd < 0 || addr == NULL || wire == NULL || wire_len == 0) {
+        log_message(2, "Invalid parameters for send_wire_packet");
+        return -1;
+    }
+
     // 发送数据包
-    ssize_t sent = sendto(sockfd, (const char*)buffer, frame_size, 0,
+    ssize_t sent = sendto(sockfd, (const char*)wire, wire_len, 0,
                          (struct sockaddr*)addr, sizeof(*addr));
     
     if (sent < 0) {
@@ -312,8 +340,9 @@ ssize_t send_packet(int sockfd, const struct sockaddr_in* addr, const Frame* fra
 
 /**
  * 从套接字接收数据包
+ * 在栈上缓冲区解析视图后，把数据部分复制一次到Frame
  */
-ssize_t receive_packet(int sockfd, struct sockaddr_in* addr, Frame* frame)
+ssize_t receive_packet(int sockfd, struct sockaddr_in* addr, Frame* frame, ChecksumMode mode)
 {
     if (sockfd < 0 || addr == NULL || frame == NULL) {
         log_message(2, "Invalid parameters for receive_packet");
@@ -321,13 +350,51 @@ ssize_t receive_packet(int sockfd, struct sockaddr_in* addr, Frame* frame)
     }
 
     uint8_t buffer[MAX_PACKET_SIZE];
+    FrameView view;
+    ssize_t received = receive_packet_view(sockfd, addr, buffer, sizeof(buffer), &view, mode);
+    if (received <= 0) {
+        return received;
+    }
+
+    frame_view_to_frame(&view, frame);
+    return received;
+}
+
+/**
+ * 接收数据包并解析帧视图
+ */
+ssize_t receive_packet_view(int sockfd, struct sockaddr_in* addr, uint8_t* buffer, size_t buf_size,
+                            FrameView* view, ChecksumMode mode)
+{
+    if (sockfd < 0 || addr == NULL || buffer == NULL || view == NULL) {
+        log_message(2, "Invalid parameters for receive_packet_view");
+        return -1;
+    }
+
     socklen_t addr_len = sizeof(*addr);
 
     // 接收数据包
-    ssize_t received = recvfrom(sockfd, (char*)buffer, MAX_PACKET_SIZE, 0,
+    ssize_t received = recvfrom(sockfd, (char*)buffer, buf_size, 0,
                                (struct sockaddr*)addr, &addr_len);
     
     if (received < 0) {
+        // 接收超时和非阻塞套接字已读空是轮询的正常结果，不记为错误
+#ifdef _WIN32
+        int err = WSAGetLastError();
+        if (err == WSAETIMEDOUT || err == WSAEWOULDBLOCK) {
+            return -1;
+        }
+        // 之前发往对端的数据报触发了ICMP端口不可达（对端已退出），Winsock在UDP套接字上
+        // 把它报告为WSAECONNRESET；这只影响那一个对端，套接字本身仍然可用
+        if (err == WSAECONNRESET) {
+            log_message(0, "Peer port unreachable (WSAECONNRESET), ignored");
+            return -1;
+        }
+#else
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return -1;
+        }
+#endif
         log_message(2, "Failed to receive packet");
         return -1;
     }
@@ -337,11 +404,15 @@ ssize_t receive_packet(int sockfd, struct sockaddr_in* addr, Frame* frame)
         return 0;
     }
 
-    // 反序列化Frame
-    int frame_size = frame_deserialize(buffer, received, frame);
+    // 解析帧视图，frame_view_parse成功时返回0
+    int result = frame_view_parse(view, buffer, received, mode);
     
-    if (frame_size <= 0) {
-        log_message(2, "Failed to deserialize frame");
+    if (result == -2) {
+        log_message(1, "CRC32C mismatch, frame dropped (%zd bytes)", received);
+        return -1;
+    }
+    if (result < 0) {
+        log_message(2, "Failed to parse frame");
         return -1;
     }
 
@@ -392,6 +463,157 @@ bool set_socket_timeout(int sockfd, int timeout_ms)
     return true;
 }
 
+/**
+ * 将套接字设为非阻塞模式
+ */
+bool set_socket_nonblocking(int sockfd)
+{
+    if (sockfd < 0) {
+        log_message(2, "Invalid socket");
+        return false;
+    }
+
+#ifdef _WIN32
+    u_long mode = 1;
+    if (ioctlsocket(sockfd, FIONBIO, &mode) != 0) {
+        log_message(2, "Failed to set non-blocking mode");
+        return false;
+    }
+#else
+    int flags = fcntl(sockfd, F_GETFL, 0);
+    if (flags < 0 || fcntl(sockfd, F_SETFL, flags | O_NONBLOCK) < 0) {
+        log_message(2, "Failed to set non-blocking mode");
+        return false;
+    }
+#endif
+
+    return true;
+}
+
+// ==================== 事件循环 ====================
+
+/**
+ * 创建事件循环
+ */
+EventLoop* create_event_loop(int sockfd)
+{
+    if (sockfd < 0) {
+        log_message(2, "Invalid socket for event loop");
+        return NULL;
+    }
+
+    EventLoop* loop = (EventLoop*)malloc(sizeof(EventLoop));
+    if (loop == NULL) {
+        log_message(2, "Failed to allocate event loop");
+        return NULL;
+    }
+
+    loop->sockfd = sockfd;
+    loop->epoll_fd = -1;
+
+#if defined(__linux__)
+    loop->epoll_fd = epoll_create1(0);
+    if (loop->epoll_fd < 0) {
+        log_message(2, "Failed to create epoll instance");
+        free(loop);
+        return NULL;
+    }
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = sockfd;
+    if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, sockfd, &ev) < 0) {
+        log_message(2, "Failed to register socket with epoll");
+        close(loop->epoll_fd);
+        free(loop);
+        return NULL;
+    }
+#endif
+
+    return loop;
+}
+
+/**
+ * 等待套接字可读或截止时间到达
+ * 
+ * 等待时间按毫秒向上取整，避免在截止时间之前被提前唤醒后空转
+ */
+int event_loop_wait(EventLoop* loop, uint64_t deadline_us)
+{
+    if (loop == NULL) {
+        return EVENT_ERROR;
+    }
+
+    // 计算剩余等待时间（毫秒），-1表示无限等待
+    int timeout_ms = -1;
+    if (deadline_us != 0) {
+        uint64_t now = get_monotonic_time_us();
+        if (deadline_us <= now) {
+            timeout_ms = 0;
+        }
+        else {
+            uint64_t remaining_ms = (deadline_us - now + 999) / 1000;
+            timeout_ms = (remaining_ms > 0x7FFFFFFF) ? 0x7FFFFFFF : (int)remaining_ms;
+        }
+    }
+
+#if defined(_WIN32)
+    fd_set read_set;
+    FD_ZERO(&read_set);
+    FD_SET(loop->sockfd, &read_set);
+
+    struct timeval tv;
+    struct timeval* tv_ptr = NULL;
+    if (timeout_ms >= 0) {
+        tv.tv_sec = timeout_ms / 1000;
+        tv.tv_usec = (timeout_ms % 1000) * 1000;
+        tv_ptr = &tv;
+    }
+    int ready = select(0, &read_set, NULL, NULL, tv_ptr);
+#elif defined(__linux__)
+    struct epoll_event ev;
+    int ready = epoll_wait(loop->epoll_fd, &ev, 1, timeout_ms);
+#else
+    struct pollfd pfd;
+    pfd.fd = loop->sockfd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    int ready = poll(&pfd, 1, timeout_ms);
+#endif
+
+    if (ready < 0) {
+#ifndef _WIN32
+        // 被信号打断视为超时，由调用方重新计算截止时间
+        if (errno == EINTR) {
+            return EVENT_TIMEOUT;
+        }
+#endif
+        log_message(2, "Event loop wait failed");
+        return EVENT_ERROR;
+    }
+
+    return (ready > 0) ? EVENT_READABLE : EVENT_TIMEOUT;
+}
+
+/**
+ * 释放事件循环
+ */
+void free_event_loop(EventLoop* loop)
+{
+    if (loop == NULL) {
+        return;
+    }
+
+#if defined(__linux__)
+    if (loop->epoll_fd >= 0) {
+        close(loop->epoll_fd);
+    }
+#endif
+
+    free(loop);
+}
+
 // ==================== 文件操作函数 ====================
 
 /**
@@ -484,8 +706,38 @@ size_t write_file_chunk(FILE* file, const char* buffer, size_t length)
 /**
  * 打印传输统计信息
  */
-void print_statistics(const char* filename, size_t total_bytes, 
-                      long total_time_ms, int total_packets, int retransmitted_packets)
+/**
+ * 获取本进程的CPU时间和峰值常驻内存
+ * 峰值内存不可用时peak_rss_kb为-1
+ */
+static void get_process_usage(double* user_ms, double* sys_ms, long* peak_rss_kb)
+{
+#ifdef _WIN32
+    FILETIME create_time, exit_time, kernel_time, user_time;
+    *user_ms = 0;
+    *sys_ms = 0;
+    if (GetProcessTimes(GetCurrentProcess(), &create_time, &exit_time, &kernel_time, &user_time)) {
+        // FILETIME以100ns为单位
+        *user_ms = (((uint64_t)user_time.dwHighDateTime << 32) | user_time.dwLowDateTime) / 10000.0;
+        *sys_ms = (((uint64_t)kernel_time.dwHighDateTime << 32) | kernel_time.dwLowDateTime) / 10000.0;
+    }
+    *peak_rss_kb = -1;
+#else
+    struct rusage usage;
+    memset(&usage, 0, sizeof(usage));
+    getrusage(RUSAGE_SELF, &usage);
+    *user_ms = usage.ru_utime.tv_sec * 1000.0 + usage.ru_utime.tv_usec / 1000.0;
+    *sys_ms = usage.ru_stime.tv_sec * 1000.0 + usage.ru_stime.tv_usec / 1000.0;
+#ifdef __APPLE__
+    *peak_rss_kb = usage.ru_maxrss / 1024;   // macOS以字节为单位
+#else
+    *peak_rss_kb = usage.ru_maxrss;
+#endif
+#endif
+}
+
+void print_statistics(const char* filename, uint64_t total_bytes, 
+                      long total_time_ms, uint64_t total_packets, uint64_t retransmitted_packets)
 {
     FILE* output = stdout;
     
@@ -500,10 +752,10 @@ void print_statistics(const char* filename, size_t total_bytes,
 
     fprintf(output, "\n");
     fprintf(output, "========== 传输统计信息 ==========\n");
-    fprintf(output, "总传输字节数:     %zu bytes\n", total_bytes);
+    fprintf(output, "总传输字节数:     %llu bytes\n", (unsigned long long)total_bytes);
     fprintf(output, "传输总耗时:       %ld ms (%.2f s)\n", total_time_ms, total_time_ms / 1000.0);
-    fprintf(output, "总包数:          %d packets\n", total_packets);
-    fprintf(output, "重传包数:        %d packets\n", retransmitted_packets);
+    fprintf(output, "总包数:          %llu packets\n", (unsigned long long)total_packets);
+    fprintf(output, "重传包数:        %llu packets\n", (unsigned long long)retransmitted_packets);
     
     // 计算传输速率
     if (total_time_ms > 0) {
@@ -514,7 +766,8 @@ void print_statistics(const char* filename, size_t total_bytes,
     // 计算包丢失率
     if (total_packets > 0) {
         double loss_rate = (double)retransmitted_packets / total_packets * 100;
-        fprintf(output, "包丢失率:        %.2f%% (%d/%d)\n", loss_rate, retransmitted_packets, total_packets);
+        fprintf(output, "包丢失率:        %.2f%% (%llu/%llu)\n", loss_rate,
+                (unsigned long long)retransmitted_packets, (unsigned long long)total_packets);
     }
     
     // 计算平均包大小
@@ -522,6 +775,15 @@ void print_statistics(const char* filename, size_t total_bytes,
         double avg_size = (double)total_bytes / total_packets;
         fprintf(output, "平均包大小:      %.0f bytes\n", avg_size);
     }
+
+    // 进程资源占用（含文件I/O线程）
+    double user_ms, sys_ms;
+    long peak_rss_kb;
+    get_process_usage(&user_ms, &sys_ms, &peak_rss_kb);
+    fprintf(output, "CPU时间:         %.0f ms (user %.0f ms, sys %.0f ms)\n", user_ms + sys_ms, user_ms, sys_ms);
+    if (peak_rss_kb >= 0) {
+        fprintf(output, "峰值内存:        %ld KB\n", peak_rss_kb);
+    }
     
     fprintf(output, "===================================\n");
     fflush(output);
@@ -547,6 +809,10 @@ static void print_usage(const char* program_name)
     printf("  -in, --input <FILE>       输入文件名（客户端模式）\n");
     printf("  -out, --output <FILE>     输出文件名（服务器模式）\n");
     printf("  -w, --window <SIZE>       窗口大小（默认%d）\n", WINDOW_SIZE);
+    printf("  -j, --workers <N>         多客户端服务器的工作线程数（服务器模式，默认单连接）\n");
+    printf("  -fec, --fec <K>           每K个数据帧发送一个XOR校验帧（客户端模式，2-%d，默认关闭）\n", FEC_MAX_GROUP);
+    printf("  -retries, --retries <N>   同一个包允许的超时重传次数（客户端模式，1-%d，默认%d）\n",
+           MAX_RETRIES_LIMIT, MAX_RETRIES);
     printf("  -h, --help                显示此帮助信息\n");
 }
 
@@ -555,7 +821,8 @@ static void print_usage(const char* program_name)
  */
 bool parse_command_line(int argc, char* argv[], 
                        bool& is_server, char* server_ip, int& port, 
-                       char* input_file, char* output_file, int& window_size)
+                       char* input_file, char* output_file, int& window_size,
+                       int& workers, int& fec_group, int& max_retries)
 {
     // 设置默认值
     is_server = false;
@@ -565,6 +832,9 @@ bool parse_command_line(int argc, char* argv[],
     strcpy(input_file, "");
     strcpy(output_file, "");
     window_size = WINDOW_SIZE;
+    workers = 0;
+    fec_group = 0;
+    max_retries = MAX_RETRIES;
 
     for (int i = 1; i < argc; i++) {
         const char* arg = argv[i];
@@ -637,6 +907,42 @@ bool parse_command_line(int argc, char* argv[],
             }
             log_message(0, "Window size set to: %d", window_size);
         }
+        else if (strcmp(arg, "-j") == 0 || strcmp(arg, "--workers") == 0) {
+            if (i + 1 >= argc) {
+                log_message(2, "Missing value for %s", arg);
+                return false;
+            }
+            workers = atoi(argv[++i]);
+            if (workers <= 0 || workers > MAX_SERVER_WORKERS) {
+                log_message(2, "Invalid worker count: %d (must be 1-%d)", workers, MAX_SERVER_WORKERS);
+                return false;
+            }
+            log_message(0, "Server workers set to: %d", workers);
+        }
+        else if (strcmp(arg, "-fec") == 0 || strcmp(arg, "--fec") == 0) {
+            if (i + 1 >= argc) {
+                log_message(2, "Missing value for %s", arg);
+                return false;
+            }
+            fec_group = atoi(argv[++i]);
+            if (fec_group < 2 || fec_group > FEC_MAX_GROUP) {
+                log_message(2, "Invalid FEC group size: %d (must be 2-%d)", fec_group, FEC_MAX_GROUP);
+                return false;
+            }
+            log_message(0, "FEC group size set to: %d", fec_group);
+        }
+        else if (strcmp(arg, "-retries") == 0 || strcmp(arg, "--retries") == 0) {
+            if (i + 1 >= argc) {
+                log_message(2, "Missing value for %s", arg);
+                return false;
+            }
+            max_retries = atoi(argv[++i]);
+            if (max_retries < 1 || max_retries > MAX_RETRIES_LIMIT) {
+                log_message(2, "Invalid retry limit: %d (must be 1-%d)", max_retries, MAX_RETRIES_LIMIT);
+                return false;
+            }
+            log_message(0, "Retry limit set to: %d", max_retries);
+        }
         else {
             log_message(2, "Unknown option: %s", arg);
             print_usage(argv[0]);
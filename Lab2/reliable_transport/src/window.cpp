@@ -1,4 +1,5 @@
 #include "window.h"
+#include "utils.h"
 #include <cstdio>
 #include <cstring>
 #include <cstdlib>
@@ -6,12 +7,53 @@
 
 // ==================== 日志宏 ====================
 
-#define LOG_INFO(fmt, ...) printf("[INFO] " fmt "\n", ##__VA_ARGS__)
-#define LOG_WARN(fmt, ...) printf("[WARN] " fmt "\n", ##__VA_ARGS__)
-#define LOG_DEBUG(fmt, ...) printf("[DEBUG] " fmt "\n", ##__VA_ARGS__)
+#define LOG_INFO(fmt, ...) log_message(LOG_LEVEL_INFO, fmt, ##__VA_ARGS__)
+#define LOG_WARN(fmt, ...) log_message(LOG_LEVEL_WARNING, fmt, ##__VA_ARGS__)
+#define LOG_DEBUG(fmt, ...) log_message(LOG_LEVEL_DEBUG, fmt, ##__VA_ARGS__)
 
 // ==================== 发送窗口实现 ====================
 
+#define INITIAL_TIMER_CAPACITY 64       // 定时器队列的初始容量
+
+/**
+ * 计算序列号在环形缓冲区中的槽位
+ * 调用方需保证 base <= seq_num < next_seq_num
+ */
+static int send_slot(const SendWindow* window, uint32_t seq_num)
+{
+    return (int)((window->head + (seq_num - window->base)) % (uint32_t)window->max_packets);
+}
+
+/**
+ * 在定时器队列队尾追加一项，队列满时容量翻倍
+ */
+static bool push_send_timer(SendWindow* window, uint32_t seq_num, uint64_t send_time)
+{
+    if (window->timer_count == window->timer_capacity) {
+        int new_capacity = window->timer_capacity * 2;
+        SendTimer* grown = (SendTimer*)malloc(sizeof(SendTimer) * new_capacity);
+        if (grown == NULL) {
+            LOG_WARN("Failed to grow send timer queue to %d", new_capacity);
+            return false;
+        }
+
+        // 按先后顺序搬到新数组开头
+        for (int i = 0; i < window->timer_count; i++) {
+            grown[i] = window->timers[(window->timer_head + i) % window->timer_capacity];
+        }
+        free(window->timers);
+        window->timers = grown;
+        window->timer_head = 0;
+        window->timer_capacity = new_capacity;
+    }
+
+    int tail = (window->timer_head + window->timer_count) % window->timer_capacity;
+    window->timers[tail].seq_num = seq_num;
+    window->timers[tail].send_time = send_time;
+    window->timer_count++;
+    return true;
+}
+
 /**
  * 创建发送窗口
  * 
@@ -40,14 +82,30 @@ SendWindow* create_send_window(int window_size, int max_packets)
         return NULL;
     }
 
+    // 分配定时器队列
+    window->timers = (SendTimer*)malloc(sizeof(SendTimer) * INITIAL_TIMER_CAPACITY);
+    if (window->timers == NULL) {
+        LOG_WARN("Failed to allocate send timer queue");
+        free(window->packets);
+        free(window);
+        return NULL;
+    }
+
     // 初始化结构字段
     memset(window->packets, 0, sizeof(UnackedPacket) * max_packets);
     
+    window->head = 0;                  // base对应的槽位
     window->window_size = window_size;
     window->base = 0;                  // 窗口基序列号
     window->next_seq_num = 0;          // 下一个要发送的序列号
     window->max_packets = max_packets;
     window->packet_count = 0;          // 当前窗口中的包数量
+    window->bytes_in_flight = 0;       // 在途字节数
+
+    window->timer_head = 0;
+    window->timer_count = 0;
+    window->timer_capacity = INITIAL_TIMER_CAPACITY;
+    window->timer_restart = 0;
 
     LOG_INFO("Send window created: size=%d, max_packets=%d", window_size, max_packets);
 
@@ -57,45 +115,91 @@ SendWindow* create_send_window(int window_size, int max_packets)
 /**
  * 添加数据包到发送窗口
  * 
- * 将新的数据包加入窗口，等待发送
- * 计算窗口中的位置并存储数据包信息
+ * 将帧序列化到窗口尾部槽位的发送缓冲区中，等待发送
  */
-bool add_to_send_window(SendWindow* window, const Frame* frame)
+bool add_to_send_window(SendWindow* window, const Frame* frame, ChecksumMode mode)
 {
     if (window == NULL || frame == NULL) {
         LOG_WARN("Invalid parameters: window=%p, frame=%p", window, frame);
         return false;
     }
 
+    uint8_t* wire = reserve_send_slot(window);
+    if (wire == NULL) {
+        return false;
+    }
+
+    int wire_len = frame_serialize(frame, wire, FRAME_MAX_SIZE, mode);
+    if (wire_len <= 0) {
+        LOG_WARN("Failed to serialize frame: seq=%u", frame->seq_num);
+        return false;
+    }
+
+    return commit_send_slot(window, wire_len, frame->data_len);
+}
+
+/**
+ * 预留发送窗口尾部的槽位
+ * 
+ * 新包总是放在环形缓冲区的尾部，这里只返回槽位的发送缓冲区，
+ * 窗口状态在commit_send_slot中才更新
+ */
+uint8_t* reserve_send_slot(SendWindow* window)
+{
+    if (window == NULL) {
+        return NULL;
+    }
+
     // 检查窗口是否已满
-    if (is_send_window_full(window)) {
+    if (is_send_window_full(window) || window->packet_count >= window->max_packets) {
         LOG_WARN("Send window is full: count=%d, size=%d", window->packet_count, window->window_size);
+        return NULL;
+    }
+
+    return window->packets[send_slot(window, window->next_seq_num)].wire;
+}
+
+/**
+ * 提交预留的槽位
+ */
+bool commit_send_slot(SendWindow* window, int wire_len, uint16_t data_len)
+{
+    if (window == NULL || wire_len <= 0 || wire_len > FRAME_MAX_SIZE) {
+        LOG_WARN("Invalid parameters: window=%p, wire_len=%d", window, wire_len);
         return false;
     }
 
-    // 计算在数组中的位置
-    int index = window->next_seq_num % window->max_packets;
+    if (is_send_window_full(window) || window->packet_count >= window->max_packets) {
+        LOG_WARN("Send window is full: count=%d, size=%d", window->packet_count, window->window_size);
+        return false;
+    }
 
-    // 检查是否超出数组边界
-    if (index >= window->max_packets) {
-        LOG_WARN("Index out of bounds: index=%d, max_packets=%d", index, window->max_packets);
+    // 先登记定时器：队列扩容失败时槽位不提交，调用方按发送失败处理，
+    // 不会留下一个永远不超时的在途包
+    uint64_t send_time = get_monotonic_time_us();
+    if (!push_send_timer(window, window->next_seq_num, send_time)) {
+        LOG_WARN("Failed to start timer, slot not committed: seq=%u", window->next_seq_num);
         return false;
     }
 
-    // 在该位置存储数据包
-    UnackedPacket* unacked = &window->packets[index];
-    unacked->frame = *frame;
+    UnackedPacket* unacked = &window->packets[send_slot(window, window->next_seq_num)];
+    unacked->wire_len = wire_len;
+    unacked->data_len = data_len;
     unacked->seq_num = window->next_seq_num;
-    unacked->send_time = time(NULL);
+    unacked->send_time = send_time;
     unacked->retry_count = 0;
+    unacked->timeout_count = 0;
     unacked->is_retransmitted = false;
+    unacked->timed_out = false;
+    unacked->sacked = false;
     unacked->is_valid = true;
 
     window->next_seq_num++;
     window->packet_count++;
+    window->bytes_in_flight += data_len;
 
     LOG_DEBUG("Added packet to send window: seq=%u, count=%d/%d", 
-              frame->seq_num, window->packet_count, window->window_size);
+              unacked->seq_num, window->packet_count, window->window_size);
 
     return true;
 }
@@ -129,7 +233,7 @@ bool has_unacked_packets(SendWindow* window)
 /**
  * 获取指定序列号的未确认数据包
  * 
- * 根据序列号在窗口中查找对应的数据包
+ * 序列号减去base即为相对head的偏移，直接定位槽位
  */
 UnackedPacket* get_unacked_packet(SendWindow* window, uint32_t seq_num)
 {
@@ -137,14 +241,12 @@ UnackedPacket* get_unacked_packet(SendWindow* window, uint32_t seq_num)
         return NULL;
     }
 
-    // 计算索引
-    int index = seq_num % window->max_packets;
-
-    if (index >= window->max_packets) {
+    // 不在 [base, next_seq_num) 范围内的序列号没有对应的包
+    if (seq_num - window->base >= (uint32_t)window->packet_count) {
         return NULL;
     }
 
-    UnackedPacket* unacked = &window->packets[index];
+    UnackedPacket* unacked = &window->packets[send_slot(window, seq_num)];
 
     // 检查该槽位是否有效且序列号匹配
     if (unacked->is_valid && unacked->seq_num == seq_num) {
@@ -161,9 +263,10 @@ UnackedPacket* get_unacked_packet(SendWindow* window, uint32_t seq_num)
  * 
  * 算法：
  * 1. 检查ACK号是否有效
- * 2. 释放所有序列号 < ACK号的数据包
- * 3. 更新窗口基序列号
- * 4. 滑动窗口
+ * 2. 从head开始释放 ack_num - base 个数据包
+ * 3. 更新窗口基序列号和head
+ * 
+ * 开销与本次确认的包数成正比；对应的定时器项留在队列中惰性删除
  */
 bool update_send_window(SendWindow* window, uint32_t ack_num)
 {
@@ -172,34 +275,82 @@ bool update_send_window(SendWindow* window, uint32_t ack_num)
         return false;
     }
 
-    // ACK号应该在窗口范围内
-    if (ack_num < window->base || ack_num > window->next_seq_num) {
+    // ACK号应该在窗口范围内（模2^32比较，序列号可能已回绕）
+    if (seq_lt(ack_num, window->base) || seq_gt(ack_num, window->next_seq_num)) {
         LOG_WARN("ACK number out of range: ack=%u, base=%u, next=%u",
                  ack_num, window->base, window->next_seq_num);
         return false;
     }
 
     // 计算需要释放的数据包数量
-    int packets_to_release = ack_num - window->base;
+    int packets_to_release = seq_diff(ack_num, window->base);
 
     LOG_DEBUG("Updating send window: ack=%u, releasing %d packets", ack_num, packets_to_release);
 
+    // 确认了新数据：重传定时器重新计时
+    if (packets_to_release > 0) {
+        window->timer_restart = get_monotonic_time_us();
+    }
+
     // 释放已确认的数据包
     for (int i = 0; i < packets_to_release && window->packet_count > 0; i++) {
-        int index = window->base % window->max_packets;
-        
-        if (window->packets[index].is_valid) {
-            window->packets[index].is_valid = false;
-            memset(&window->packets[index], 0, sizeof(UnackedPacket));
-            window->packet_count--;
-        }
-
+        window->packets[window->head].is_valid = false;
+        window->bytes_in_flight -= window->packets[window->head].data_len;
+        window->head = (window->head + 1) % window->max_packets;
+        window->packet_count--;
         window->base++;
     }
 
     return true;
 }
 
+/**
+ * 处理选择确认位图
+ * 
+ * 从窗口首部扫描到位图覆盖的最后一个包：置位的标记为sacked，
+ * 其余未被选择确认的包暂记为空洞；只有之后还有已选择确认的包时，
+ * 它们才确实是空洞（最后一个置位之后的包可能仍在途中）
+ */
+int apply_send_sack(SendWindow* window, uint32_t ack_num, const uint8_t* bitmap, uint16_t len,
+                    uint32_t* holes, int max_holes)
+{
+    if (window == NULL || bitmap == NULL || len == 0) {
+        return 0;
+    }
+
+    // 位图覆盖 (ack_num, ack_num + len * 8]，与窗口 [base, next_seq_num) 取交集
+    uint32_t end = ack_num + 1 + (uint32_t)len * 8;
+    if (seq_gt(end, window->next_seq_num)) {
+        end = window->next_seq_num;
+    }
+
+    int hole_count = 0;
+    int confirmed_holes = 0;
+    for (uint32_t seq = window->base; seq_lt(seq, end); seq++) {
+        UnackedPacket* unacked = get_unacked_packet(window, seq);
+        if (unacked == NULL) {
+            continue;
+        }
+        if (!unacked->sacked && sack_test(bitmap, len, ack_num, seq)) {
+            unacked->sacked = true;
+            unacked->timed_out = false;
+        }
+        if (unacked->sacked) {
+            confirmed_holes = hole_count;
+        } else {
+            if (holes != NULL && hole_count < max_holes) {
+                holes[hole_count] = seq;
+            }
+            hole_count++;
+        }
+    }
+
+    if (holes != NULL && confirmed_holes > max_holes) {
+        confirmed_holes = max_holes;
+    }
+    return confirmed_holes;
+}
+
 /**
  * 获取可用的发送窗口大小（字节）
  */
@@ -227,6 +378,11 @@ void free_send_window(SendWindow* window)
         window->packets = NULL;
     }
 
+    if (window->timers != NULL) {
+        free(window->timers);
+        window->timers = NULL;
+    }
+
     free(window);
 
     LOG_INFO("Send window freed");
@@ -247,17 +403,19 @@ void print_send_window(SendWindow* window)
     printf("Base Seq:          %u\n", window->base);
     printf("Next Seq:          %u\n", window->next_seq_num);
     printf("Packet Count:      %d/%d\n", window->packet_count, window->window_size);
+    printf("Bytes In Flight:   %u\n", window->bytes_in_flight);
+    printf("Pending Timers:    %d\n", window->timer_count);
     printf("\nUnacked Packets:\n");
 
-    for (int i = 0; i < window->max_packets && i < 10; i++) {
-        if (window->packets[i].is_valid) {
-            printf("  [%d] Seq=%u, Retries=%d, Retransmitted=%s, Time=%ld\n",
-                   i,
-                   window->packets[i].seq_num,
-                   window->packets[i].retry_count,
-                   window->packets[i].is_retransmitted ? "Yes" : "No",
-                   window->packets[i].send_time);
-        }
+    for (int i = 0; i < window->packet_count && i < 10; i++) {
+        const UnackedPacket* unacked = &window->packets[(window->head + i) % window->max_packets];
+        printf("  [%d] Seq=%u, Retries=%d, Timeouts=%d, Retransmitted=%s, Time=%llu us\n",
+               i,
+               unacked->seq_num,
+               unacked->retry_count,
+               unacked->timeout_count,
+               unacked->is_retransmitted ? "Yes" : "No",
+               (unsigned long long)unacked->send_time);
     }
 
     printf("========================================\n");
@@ -265,10 +423,84 @@ void print_send_window(SendWindow* window)
 
 // ==================== 接收窗口实现 ====================
 
+#define CACHE_LINE_SIZE 64              // slab内各区域及数据槽的对齐单位
+
+/**
+ * 向上取整到缓存行大小
+ */
+static size_t align_to_cache_line(size_t size)
+{
+    return (size + CACHE_LINE_SIZE - 1) & ~((size_t)CACHE_LINE_SIZE - 1);
+}
+
+/**
+ * 分配按缓存行对齐的内存
+ */
+static uint8_t* alloc_aligned(size_t size)
+{
+#ifdef _WIN32
+    return (uint8_t*)_aligned_malloc(size, CACHE_LINE_SIZE);
+#else
+    void* ptr = NULL;
+    if (posix_memalign(&ptr, CACHE_LINE_SIZE, size) != 0) {
+        return NULL;
+    }
+    return (uint8_t*)ptr;
+#endif
+}
+
+/**
+ * 释放alloc_aligned()分配的内存
+ */
+static void free_aligned(uint8_t* ptr)
+{
+#ifdef _WIN32
+    _aligned_free(ptr);
+#else
+    free(ptr);
+#endif
+}
+
+/**
+ * 计算序列号在接收环形槽位中的位置
+ * 调用方需保证 expected_seq <= seq_num < expected_seq + window_size
+ */
+static int recv_slot(const ReceiveWindow* window, uint32_t seq_num)
+{
+    return (int)((window->head + (seq_num - window->expected_seq)) % (uint32_t)window->window_size);
+}
+
+/**
+ * 为指定窗口大小分配一块新的slab并划分各区域
+ * 
+ * 布局：[received × N][data_len × N][数据槽 × N]，每个区域起始地址按缓存行对齐
+ * 成功时只填写slab/received/data_len/data四个指针，元数据区域清零
+ */
+static bool build_receive_slab(ReceiveWindow* layout, int window_size, size_t slot_stride)
+{
+    size_t flags_bytes = align_to_cache_line(sizeof(uint8_t) * window_size);
+    size_t lens_bytes = align_to_cache_line(sizeof(uint16_t) * window_size);
+    size_t data_bytes = slot_stride * window_size;
+
+    uint8_t* slab = alloc_aligned(flags_bytes + lens_bytes + data_bytes);
+    if (slab == NULL) {
+        return false;
+    }
+
+    // 只清零标志和长度，数据槽在写入前不会被读取
+    memset(slab, 0, flags_bytes + lens_bytes);
+
+    layout->slab = slab;
+    layout->received = slab;
+    layout->data_len = (uint16_t*)(slab + flags_bytes);
+    layout->data = slab + flags_bytes + lens_bytes;
+    return true;
+}
+
 /**
  * 创建接收窗口
  * 
- * 初始化接收窗口，为乱序接收的数据包分配缓冲区
+ * 初始化接收窗口，为乱序接收的数据包分配一整块slab缓冲区
  */
 ReceiveWindow* create_receive_window(int window_size, int buffer_size)
 {
@@ -285,63 +517,256 @@ ReceiveWindow* create_receive_window(int window_size, int buffer_size)
         return NULL;
     }
 
-    // 分配缓冲区指针数组
-    window->buffer = (uint8_t**)malloc(sizeof(uint8_t*) * window_size);
-    if (window->buffer == NULL) {
-        LOG_WARN("Failed to allocate buffer array");
+    // 分配slab（所有槽位的数据、长度和接收标志）
+    window->slot_stride = align_to_cache_line(buffer_size);
+    if (!build_receive_slab(window, window_size, window->slot_stride)) {
+        LOG_WARN("Failed to allocate receive slab: window_size=%d, slot_stride=%zu",
+                 window_size, window->slot_stride);
         free(window);
         return NULL;
     }
 
-    // 分配数据长度数组
-    window->data_len = (uint16_t*)malloc(sizeof(uint16_t) * window_size);
-    if (window->data_len == NULL) {
-        LOG_WARN("Failed to allocate data_len array");
-        free(window->buffer);
-        free(window);
-        return NULL;
-    }
-
-    // 分配接收标志数组
-    window->received = (bool*)malloc(sizeof(bool) * window_size);
-    if (window->received == NULL) {
-        LOG_WARN("Failed to allocate received array");
-        free(window->buffer);
-        free(window->data_len);
-        free(window);
-        return NULL;
-    }
-
-    // 初始化缓冲区数组（每个位置分配一个数据缓冲）
-    for (int i = 0; i < window_size; i++) {
-        window->buffer[i] = (uint8_t*)malloc(buffer_size);
-        if (window->buffer[i] == NULL) {
-            LOG_WARN("Failed to allocate buffer[%d]", i);
-            // 释放已分配的缓冲
-            for (int j = 0; j < i; j++) {
-                free(window->buffer[j]);
-            }
-            free(window->buffer);
-            free(window->data_len);
-            free(window->received);
-            free(window);
-            return NULL;
-        }
-    }
-
     // 初始化结构字段
     window->window_size = window_size;
+    window->head = 0;
+    window->received_count = 0;
     window->base = 0;
     window->expected_seq = 0;
     window->max_buffer_size = buffer_size;
-    memset(window->received, 0, sizeof(bool) * window_size);
-    memset(window->data_len, 0, sizeof(uint16_t) * window_size);
+    window->fec_groups = NULL;
+    window->fec_slots = 0;
+    window->fec_k = 0;
+    window->fec_origin = 0;
+    window->fec_recovered = 0;
 
     LOG_INFO("Receive window created: size=%d, buffer_size=%d", window_size, buffer_size);
 
     return window;
 }
 
+/**
+ * 生成选择确认位图
+ * 
+ * 偏移0对应expected_seq，总是未接收；偏移i对应位图的第i-1位
+ */
+int get_receive_sack(ReceiveWindow* window, uint8_t* bitmap, int max_bytes)
+{
+    if (window == NULL || bitmap == NULL || max_bytes <= 0) {
+        return 0;
+    }
+
+    // 找到最后一个已接收的位置，位图只覆盖到它
+    int last = window->window_size - 1;
+    if (last > max_bytes * 8) {
+        last = max_bytes * 8;
+    }
+    while (last > 0 && !window->received[recv_slot(window, window->expected_seq + last)]) {
+        last--;
+    }
+    if (last == 0) {
+        return 0;
+    }
+
+    size_t len = ((size_t)last + 7) / 8;
+    memset(bitmap, 0, len);
+    for (int i = 1; i <= last; i++) {
+        if (window->received[recv_slot(window, window->expected_seq + i)]) {
+            bitmap[(i - 1) >> 3] |= (uint8_t)(1 << ((i - 1) & 7));
+        }
+    }
+
+    return (int)len;
+}
+
+/**
+ * 扩大接收窗口
+ * 
+ * 分配更大的slab，把环形中的槽位按序列号顺序复制到新slab开头（head归0），再释放旧slab
+ */
+bool resize_receive_window(ReceiveWindow* window, int new_size)
+{
+    if (window == NULL || new_size < window->window_size) {
+        LOG_WARN("Invalid resize parameters: window=%p, new_size=%d", window, new_size);
+        return false;
+    }
+
+    if (new_size == window->window_size) {
+        return true;
+    }
+
+    ReceiveWindow grown = *window;
+    if (!build_receive_slab(&grown, new_size, window->slot_stride)) {
+        LOG_WARN("Failed to allocate receive slab for resize: new_size=%d", new_size);
+        return false;
+    }
+
+    int old_size = window->window_size;
+    for (int i = 0; i < old_size; i++) {
+        int slot = (window->head + i) % old_size;
+        if (window->received[slot]) {
+            grown.received[i] = 1;
+            grown.data_len[i] = window->data_len[slot];
+            memcpy(grown.data + i * window->slot_stride,
+                   window->data + slot * window->slot_stride, window->data_len[slot]);
+        }
+    }
+
+    free_aligned(window->slab);
+    window->slab = grown.slab;
+    window->received = grown.received;
+    window->data_len = grown.data_len;
+    window->data = grown.data;
+    window->window_size = new_size;
+    window->head = 0;
+
+    LOG_INFO("Receive window resized: %d -> %d", old_size, new_size);
+
+    return true;
+}
+
+/**
+ * 取得seq_num所在的FEC分组；槽位还属于更早的组时重置为该组
+ * 槽位数超过窗口能跨越的组数，窗口内的组不会互相覆盖
+ */
+static FecGroup* fec_group_for(ReceiveWindow* window, uint32_t seq_num)
+{
+    uint32_t group_index = (seq_num - window->fec_origin) / (uint32_t)window->fec_k;
+    uint32_t first_seq = window->fec_origin + group_index * (uint32_t)window->fec_k;
+    FecGroup* group = &window->fec_groups[group_index % (uint32_t)window->fec_slots];
+
+    if (!group->in_use || group->first_seq != first_seq) {
+        group->first_seq = first_seq;
+        group->received = 0;
+        group->count = 0;
+        group->len_xor = 0;
+        group->acc_len = 0;
+        group->has_parity = false;
+        group->in_use = true;
+    }
+    return group;
+}
+
+/**
+ * 把一帧数据（或校验数据）异或进分组，比当前累加长度长的部分先补0
+ */
+static void fec_group_add(FecGroup* group, const uint8_t* data, uint16_t data_len)
+{
+    if (data_len > group->acc_len) {
+        memset(group->acc + group->acc_len, 0, data_len - group->acc_len);
+        group->acc_len = data_len;
+    }
+    if (data_len > 0) {
+        fec_xor(group->acc, data, data_len);
+    }
+}
+
+/**
+ * 分组已有校验帧且只缺一帧时，把累加结果作为缺失帧放入窗口
+ * 已交付的帧都在expected_seq之前，缺失帧只可能在窗口内
+ */
+static bool fec_try_recover(ReceiveWindow* window, FecGroup* group)
+{
+    if (!group->has_parity || group->received + 1 != group->count) {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < group->count; i++) {
+        uint32_t seq_num = group->first_seq + i;
+        if (seq_lt(seq_num, window->expected_seq)) {
+            continue;
+        }
+        if (seq_num - window->expected_seq >= (uint32_t)window->window_size) {
+            break;
+        }
+        int index = recv_slot(window, seq_num);
+        if (window->received[index]) {
+            continue;
+        }
+
+        // 长度不合理说明组内数据不一致（如校验帧属于另一次连接），放弃还原
+        uint16_t data_len = group->len_xor;
+        if (data_len > window->max_buffer_size || data_len > group->acc_len) {
+            LOG_WARN("FEC group %u inconsistent, recovered length %u", group->first_seq, data_len);
+            return false;
+        }
+
+        memcpy(window->data + index * window->slot_stride, group->acc, data_len);
+        window->data_len[index] = data_len;
+        window->received[index] = 1;
+        window->received_count++;
+        group->received++;
+        window->fec_recovered++;
+
+        LOG_INFO("FEC recovered frame: seq=%u, group=%u, data_len=%u", seq_num, group->first_seq, data_len);
+        return true;
+    }
+
+    return false;
+}
+
+/**
+ * 启用前向纠错
+ */
+bool enable_receive_fec(ReceiveWindow* window, int k, uint32_t origin)
+{
+    if (window == NULL || k < 2 || k > FEC_MAX_GROUP) {
+        LOG_WARN("Invalid FEC parameters: window=%p, k=%d", window, k);
+        return false;
+    }
+
+    int slots = MAX_WINDOW_FRAMES / k + 2;
+    FecGroup* groups = (FecGroup*)malloc(sizeof(FecGroup) * slots);
+    if (groups == NULL) {
+        LOG_WARN("Failed to allocate %d FEC groups", slots);
+        return false;
+    }
+    memset(groups, 0, sizeof(FecGroup) * slots);
+
+    free(window->fec_groups);
+    window->fec_groups = groups;
+    window->fec_slots = slots;
+    window->fec_k = k;
+    window->fec_origin = origin;
+
+    LOG_INFO("Receive FEC enabled: k=%d, origin=%u, groups=%d", k, origin, slots);
+    return true;
+}
+
+/**
+ * 接收FEC校验帧
+ * 
+ * 整组都已交付时校验帧已无用；同一组重复的校验帧忽略
+ */
+bool receive_parity(ReceiveWindow* window, uint32_t first_seq, uint16_t count, uint16_t len_xor,
+                    const uint8_t* data, uint16_t data_len)
+{
+    if (window == NULL || window->fec_groups == NULL || (data == NULL && data_len > 0) ||
+        data_len > MAX_DATA_LENGTH) {
+        return false;
+    }
+
+    if (count == 0 || count > window->fec_k || (first_seq - window->fec_origin) % (uint32_t)window->fec_k != 0) {
+        LOG_WARN("Invalid parity frame: first_seq=%u, count=%u, k=%d", first_seq, count, window->fec_k);
+        return false;
+    }
+
+    if (seq_leq(first_seq + count, window->expected_seq)) {
+        return false;
+    }
+
+    FecGroup* group = fec_group_for(window, first_seq);
+    if (group->has_parity) {
+        return false;
+    }
+
+    fec_group_add(group, data, data_len);
+    group->len_xor ^= len_xor;
+    group->count = count;
+    group->has_parity = true;
+
+    return fec_try_recover(window, group);
+}
+
 /**
  * 接收数据包到接收窗口
  * 
@@ -360,18 +785,31 @@ bool receive_packet(ReceiveWindow* window, const Frame* frame)
         return false;
     }
 
-    uint32_t seq_num = frame->seq_num;
+    return receive_payload(window, frame->seq_num, frame->data, frame->data_len);
+}
+
+/**
+ * 接收数据到接收窗口
+ * 
+ * 数据从调用方的接收缓冲区直接复制到窗口槽位，这是数据在接收路径上唯一的一次复制
+ */
+bool receive_payload(ReceiveWindow* window, uint32_t seq_num, const uint8_t* data, uint16_t data_len)
+{
+    if (window == NULL || (data == NULL && data_len > 0)) {
+        LOG_WARN("Invalid parameters: window=%p, data=%p", window, data);
+        return false;
+    }
 
     // 检查序列号是否在接收窗口范围内
-    int32_t diff = seq_num - window->expected_seq;
+    int32_t diff = seq_diff(seq_num, window->expected_seq);
     if (diff < 0 || diff >= window->window_size) {
         LOG_WARN("Packet out of window: seq=%u, expected=%u, window_size=%d",
                  seq_num, window->expected_seq, window->window_size);
         return false;
     }
 
-    // 计算在窗口中的位置
-    int index = diff;
+    // 计算在环形槽位中的位置
+    int index = recv_slot(window, seq_num);
 
     // 如果已经接收过该数据包，忽略
     if (window->received[index]) {
@@ -380,22 +818,45 @@ bool receive_packet(ReceiveWindow* window, const Frame* frame)
     }
 
     // 复制数据到缓冲区
-    if (frame->data_len > window->max_buffer_size) {
+    if (data_len > window->max_buffer_size) {
         LOG_WARN("Data length exceeds buffer size: data_len=%u, buffer_size=%d",
-                 frame->data_len, window->max_buffer_size);
+                 data_len, window->max_buffer_size);
         return false;
     }
 
-    memcpy(window->buffer[index], frame->data, frame->data_len);
-    window->data_len[index] = frame->data_len;
-    window->received[index] = true;
+    if (data_len > 0) {
+        memcpy(window->data + index * window->slot_stride, data, data_len);
+    }
+    window->data_len[index] = data_len;
+    window->received[index] = 1;
+    window->received_count++;
 
     LOG_DEBUG("Packet received: seq=%u, data_len=%u, position=%d", 
-              seq_num, frame->data_len, index);
+              seq_num, data_len, index);
+
+    // 累加到所在的FEC分组，组内只差一帧且已有校验帧时顺带还原
+    if (window->fec_groups != NULL) {
+        FecGroup* group = fec_group_for(window, seq_num);
+        fec_group_add(group, data, data_len);
+        group->len_xor ^= data_len;
+        group->received++;
+        fec_try_recover(window, group);
+    }
 
     return true;
 }
 
+/**
+ * 查询窗口内某个序列号的帧是否已缓冲
+ */
+bool is_seq_received(const ReceiveWindow* window, uint32_t seq_num)
+{
+    if (window == NULL || seq_num - window->expected_seq >= (uint32_t)window->window_size) {
+        return false;
+    }
+    return window->received[recv_slot(window, seq_num)] != 0;
+}
+
 /**
  * 获取连续的已接收数据
  * 
@@ -413,38 +874,25 @@ int get_contiguous_data(ReceiveWindow* window, uint8_t* output)
 
     int total_bytes = 0;
     int i = 0;
+    int slot = window->head;
 
-    // 从窗口基开始，提取连续的已接收数据
-    while (i < window->window_size && window->received[i]) {
-        int copy_len = window->data_len[i];
-        
-        // 检查缓冲区大小是否足够
-        // （在实际应用中应该有更好的边界检查）
+    // 从窗口基开始，提取连续的已接收数据；交付后的槽位立即清除标志，供窗口后沿复用
+    while (i < window->window_size && window->received[slot]) {
+        int copy_len = window->data_len[slot];
 
-        memcpy(output + total_bytes, window->buffer[i], copy_len);
+        memcpy(output + total_bytes, window->data + slot * window->slot_stride, copy_len);
         total_bytes += copy_len;
+        window->received[slot] = 0;
+        window->data_len[slot] = 0;
 
         i++;
+        slot = (slot + 1 == window->window_size) ? 0 : slot + 1;
     }
 
-    // 如果有连续数据被提取，滑动窗口
+    // 如果有连续数据被提取，滑动窗口（只移动head，不搬动数据）
     if (i > 0) {
-        // 滑动窗口
-        for (int j = i; j < window->window_size; j++) {
-            window->received[j - i] = window->received[j];
-            window->data_len[j - i] = window->data_len[j];
-            
-            if (window->received[j - i]) {
-                memcpy(window->buffer[j - i], window->buffer[j], window->data_len[j]);
-            }
-        }
-
-        // 清除滑过的位置
-        for (int j = window->window_size - i; j < window->window_size; j++) {
-            window->received[j] = false;
-            window->data_len[j] = 0;
-            memset(window->buffer[j], 0, window->max_buffer_size);
-        }
+        window->head = slot;
+        window->received_count -= i;
 
         // 更新期望序列号
         window->expected_seq += i;
@@ -459,21 +907,14 @@ int get_contiguous_data(ReceiveWindow* window, uint8_t* output)
 /**
  * 获取接收窗口的可用空间（字节）
  */
-uint16_t get_receive_window_available(ReceiveWindow* window)
+uint32_t get_receive_window_available(ReceiveWindow* window)
 {
     if (window == NULL) {
         return 0;
     }
 
-    // 计算还有多少个未接收的位置
-    int unrecv_count = 0;
-    for (int i = 0; i < window->window_size; i++) {
-        if (!window->received[i]) {
-            unrecv_count++;
-        }
-    }
-
-    return unrecv_count * MAX_DATA_LENGTH;
+    // 按字节返回，由调用方按窗口缩放编码到16位字段
+    return (uint32_t)(window->window_size - window->received_count) * MAX_DATA_LENGTH;
 }
 
 /**
@@ -485,21 +926,12 @@ void free_receive_window(ReceiveWindow* window)
         return;
     }
 
-    if (window->buffer != NULL) {
-        for (int i = 0; i < window->window_size; i++) {
-            if (window->buffer[i] != NULL) {
-                free(window->buffer[i]);
-            }
-        }
-        free(window->buffer);
-    }
-
-    if (window->data_len != NULL) {
-        free(window->data_len);
+    if (window->slab != NULL) {
+        free_aligned(window->slab);
     }
 
-    if (window->received != NULL) {
-        free(window->received);
+    if (window->fec_groups != NULL) {
+        free(window->fec_groups);
     }
 
     free(window);
@@ -519,72 +951,258 @@ void print_receive_window(ReceiveWindow* window)
 
     printf("========== Receive Window Status ==========\n");
     printf("Window Size:       %d\n", window->window_size);
+    printf("Slot Stride:       %zu bytes\n", window->slot_stride);
+    printf("Head Slot:         %d\n", window->head);
     printf("Base Seq:          %u\n", window->base);
     printf("Expected Seq:      %u\n", window->expected_seq);
     printf("\nReceived Status:\n");
 
     for (int i = 0; i < window->window_size; i++) {
+        int slot = recv_slot(window, window->expected_seq + i);
         printf("  [%d] Expected=%u, Received=%s, DataLen=%u\n",
-               i,
+               slot,
                window->expected_seq + i,
-               window->received[i] ? "Yes" : "No",
-               window->data_len[i]);
+               window->received[slot] ? "Yes" : "No",
+               window->data_len[slot]);
     }
 
     printf("==========================================\n");
 }
 
+// ==================== FEC编码实现 ====================
+
+/**
+ * 创建FEC编码器
+ * 
+ * 只需记住还可能有未确认包的组的校验帧发送时间：
+ * 发送窗口最多跨越 window_size / k + 1 个组
+ */
+FecEncoder* create_fec_encoder(int k, uint32_t origin, int window_size)
+{
+    if (k < 2 || k > FEC_MAX_GROUP || window_size <= 0) {
+        LOG_WARN("Invalid FEC encoder parameters: k=%d, window_size=%d", k, window_size);
+        return NULL;
+    }
+
+    FecEncoder* enc = (FecEncoder*)malloc(sizeof(FecEncoder));
+    if (enc == NULL) {
+        return NULL;
+    }
+
+    enc->k = k;
+    enc->origin = origin;
+    enc->first_seq = origin;
+    enc->count = 0;
+    enc->len_xor = 0;
+    enc->parity_len = 0;
+    enc->slots = window_size / k + 2;
+    enc->sent_first = (uint32_t*)malloc(sizeof(uint32_t) * enc->slots);
+    enc->sent_time = (uint64_t*)malloc(sizeof(uint64_t) * enc->slots);
+    if (enc->sent_first == NULL || enc->sent_time == NULL) {
+        LOG_WARN("Failed to allocate FEC encoder state: slots=%d", enc->slots);
+        free_fec_encoder(enc);
+        return NULL;
+    }
+    memset(enc->sent_first, 0, sizeof(uint32_t) * enc->slots);
+    memset(enc->sent_time, 0, sizeof(uint64_t) * enc->slots);
+
+    LOG_INFO("FEC encoder created: k=%d, origin=%u", k, origin);
+    return enc;
+}
+
+/**
+ * 把一个新的DATA帧累加到当前组
+ */
+bool fec_encoder_add(FecEncoder* enc, uint32_t seq_num, const uint8_t* data, uint16_t data_len)
+{
+    if (enc == NULL || (data == NULL && data_len > 0) || data_len > MAX_DATA_LENGTH) {
+        return false;
+    }
+
+    if (enc->count == 0) {
+        enc->first_seq = seq_num;
+        enc->len_xor = 0;
+        enc->parity_len = 0;
+    }
+
+    if (data_len > enc->parity_len) {
+        memset(enc->parity + enc->parity_len, 0, data_len - enc->parity_len);
+        enc->parity_len = data_len;
+    }
+    if (data_len > 0) {
+        fec_xor(enc->parity, data, data_len);
+    }
+    enc->len_xor ^= data_len;
+    enc->count++;
+
+    return enc->count >= enc->k;
+}
+
+/**
+ * 生成当前组的校验帧
+ */
+int fec_encoder_flush(FecEncoder* enc, uint8_t* wire, ChecksumMode mode)
+{
+    if (enc == NULL || wire == NULL || enc->count == 0) {
+        return 0;
+    }
+
+    memcpy(wire + FRAME_HEADER_SIZE, enc->parity, enc->parity_len);
+    int wire_len = frame_build_in_place(wire, FRAME_MAX_SIZE, enc->first_seq, (uint32_t)enc->count,
+                                        enc->len_xor, PARITY, enc->parity_len, mode);
+
+    int slot = (int)(((enc->first_seq - enc->origin) / (uint32_t)enc->k) % (uint32_t)enc->slots);
+    enc->sent_first[slot] = enc->first_seq;
+    enc->sent_time[slot] = get_monotonic_time_us();
+
+    LOG_DEBUG("FEC parity built: group=%u, count=%d, len=%u", enc->first_seq, enc->count, enc->parity_len);
+
+    enc->count = 0;
+    return wire_len;
+}
+
+/**
+ * 获取seq_num所在组的组首序列号
+ */
+uint32_t fec_group_first(const FecEncoder* enc, uint32_t seq_num)
+{
+    return enc->origin + (seq_num - enc->origin) / (uint32_t)enc->k * (uint32_t)enc->k;
+}
+
+/**
+ * 获取seq_num所在组的校验帧发送时间
+ */
+uint64_t fec_parity_sent_time(const FecEncoder* enc, uint32_t seq_num)
+{
+    if (enc == NULL) {
+        return 0;
+    }
+
+    uint32_t first_seq = fec_group_first(enc, seq_num);
+    int slot = (int)(((first_seq - enc->origin) / (uint32_t)enc->k) % (uint32_t)enc->slots);
+    return (enc->sent_first[slot] == first_seq) ? enc->sent_time[slot] : 0;
+}
+
+/**
+ * 释放FEC编码器
+ */
+void free_fec_encoder(FecEncoder* enc)
+{
+    if (enc == NULL) {
+        return;
+    }
+
+    free(enc->sent_first);
+    free(enc->sent_time);
+    free(enc);
+}
+
 // ==================== 超时重传实现 ====================
 
+/**
+ * 定时器的计时起点：发送时间与最近一次确认新数据的时间中较晚者
+ */
+static uint64_t timer_start(const SendWindow* window, const SendTimer* timer)
+{
+    return (timer->send_time > window->timer_restart) ? timer->send_time : window->timer_restart;
+}
+
+/**
+ * 判断定时器项是否已失效：包已被确认、已被选择确认、已重传（发送时间变了）或已标记超时
+ */
+static bool is_stale_timer(SendWindow* window, const SendTimer* timer, UnackedPacket** unacked)
+{
+    *unacked = get_unacked_packet(window, timer->seq_num);
+    return (*unacked == NULL || (*unacked)->send_time != timer->send_time ||
+            (*unacked)->timed_out || (*unacked)->sacked);
+}
+
 /**
  * 检查发送窗口中的超时包
  * 
- * 扫描所有未确认的数据包，检查是否超时
- * 如果超时（当前时间 - 发送时间 > rto），标记为需要重传
+ * 定时器队列按发送时间排列，只需从队首取出已到期的项：
+ * - 包已被确认，或之后又重传过（send_time不一致）：过期项，直接丢弃
+ * - 否则该包超时，标记为需要重传
+ * 队首未到期时即可停止，开销与到期项数成正比
+ * 这里只做标记，重传次数在retransmit_packet()中累加
  * 
  * @param window 发送窗口指针
- * @param rto 重传超时时间（秒）
+ * @param rto_us 重传超时时间（微秒）
+ * @param expired 可选，输出超时包的序列号
+ * @param max_expired expired数组的容量
  * @return 返回需要重传的包数量
  */
-int check_send_timeouts(SendWindow* window, time_t rto)
+int check_send_timeouts(SendWindow* window, uint64_t rto_us, uint32_t* expired, int max_expired)
 {
     if (window == NULL) {
         return 0;
     }
 
-    time_t current_time = time(NULL);
+    uint64_t current_time = get_monotonic_time_us();
     int timeout_count = 0;
 
-    // 扫描所有未确认的数据包
-    for (int i = 0; i < window->max_packets; i++) {
-        UnackedPacket* unacked = &window->packets[i];
+    while (window->timer_count > 0) {
+        SendTimer* timer = &window->timers[window->timer_head];
+        UnackedPacket* unacked = NULL;
+        bool stale = is_stale_timer(window, timer, &unacked);
 
-        if (!unacked->is_valid) {
-            continue;  // 跳过无效槽位
+        // 队首是仍在等待的有效定时器，后面的项都更晚到期
+        if (!stale && current_time - timer_start(window, timer) <= rto_us) {
+            break;
         }
 
-        time_t elapsed = current_time - unacked->send_time;
+        window->timer_head = (window->timer_head + 1) % window->timer_capacity;
+        window->timer_count--;
 
-        // 检查是否超时
-        if (elapsed > rto) {
-            LOG_WARN("Packet timeout detected: seq=%u, elapsed=%ld, rto=%ld",
-                     unacked->seq_num, elapsed, rto);
+        if (stale) {
+            continue;
+        }
 
-            timeout_count++;
+        LOG_WARN("Packet timeout detected: seq=%u, elapsed=%llu us, rto=%llu us",
+                 unacked->seq_num, (unsigned long long)(current_time - unacked->send_time),
+                 (unsigned long long)rto_us);
 
-            // 标记为需要重传
-            unacked->retry_count++;
-            unacked->is_retransmitted = true;
+        // 标记为需要重传
+        unacked->timed_out = true;
+        unacked->timeout_count++;
+        if (expired != NULL && timeout_count < max_expired) {
+            expired[timeout_count] = unacked->seq_num;
         }
+        timeout_count++;
     }
 
     return timeout_count;
 }
 
+/**
+ * 获取下一个重传截止时间
+ */
+uint64_t get_next_send_deadline(SendWindow* window, uint64_t rto_us)
+{
+    if (window == NULL) {
+        return 0;
+    }
+
+    while (window->timer_count > 0) {
+        SendTimer* timer = &window->timers[window->timer_head];
+        UnackedPacket* unacked = NULL;
+        bool stale = is_stale_timer(window, timer, &unacked);
+
+        if (!stale) {
+            return timer_start(window, timer) + rto_us;
+        }
+
+        window->timer_head = (window->timer_head + 1) % window->timer_capacity;
+        window->timer_count--;
+    }
+
+    return 0;
+}
+
 /**
  * 重传指定序列号的数据包
  * 
- * 更新发送时间和重传标志
+ * 更新发送时间和重传标志，并为新的发送时间登记定时器
  */
 bool retransmit_packet(SendWindow* window, uint32_t seq_num)
 {
@@ -598,15 +1216,22 @@ bool retransmit_packet(SendWindow* window, uint32_t seq_num)
         return false;
     }
 
+    // 定时器登记失败时保持原状态：仍在计时的包继续由原定时器覆盖，
+    // 已超时的包保留timed_out标记，下一轮再尝试重传
+    uint64_t send_time = get_monotonic_time_us();
+    if (!push_send_timer(window, seq_num, send_time)) {
+        LOG_WARN("Failed to start retransmission timer: seq=%u", seq_num);
+        return false;
+    }
+
     // 更新重传信息
-    unacked->send_time = time(NULL);
+    unacked->send_time = send_time;
     unacked->retry_count++;
     unacked->is_retransmitted = true;
+    unacked->timed_out = false;
 
     LOG_INFO("Retransmitting packet: seq=%u, retry=%d", seq_num, unacked->retry_count);
 
-    // 这里应该实际发送数据包（实现在UDP层）
-
     return true;
 }
 
@@ -618,19 +1243,20 @@ bool retransmit_packet(SendWindow* window, uint32_t seq_num)
  * 
  * @return 返回新的RTO值
  */
-time_t apply_timeout_backoff(SendWindow* window, time_t rto)
+uint64_t apply_timeout_backoff(SendWindow* window, uint64_t rto_us)
 {
-    if (window == NULL || rto <= 0) {
-        return TIMEOUT_MS / 1000;  // 返回默认值
+    if (window == NULL || rto_us == 0) {
+        return (uint64_t)TIMEOUT_MS * 1000;  // 返回默认值
     }
 
-    // Exponential backoff: RTO *= 2，最大不超过 60秒
-    time_t new_rto = rto * 2;
-    if (new_rto > 60) {
-        new_rto = 60;
+    // Exponential backoff: RTO *= 2，最大不超过 MAX_RTO_MS
+    uint64_t new_rto = rto_us * 2;
+    if (new_rto > (uint64_t)MAX_RTO_MS * 1000) {
+        new_rto = (uint64_t)MAX_RTO_MS * 1000;
     }
 
-    LOG_DEBUG("Applying timeout backoff: old_rto=%ld, new_rto=%ld", rto, new_rto);
+    LOG_DEBUG("Applying timeout backoff: old_rto=%llu us, new_rto=%llu us",
+              (unsigned long long)rto_us, (unsigned long long)new_rto);
 
     return new_rto;
 }
@@ -0,0 +1,92 @@
+#!/bin/bash
+# ==========================================
+# test.sh / performance_test.sh 共用的辅助函数
+# 使用方式：在脚本中 source tests/common.sh（工作目录为项目根目录）
+# ==========================================
+
+PROG=${PROG:-./bin/reliable_transport}
+PROXY_SRC=tests/udp_impair.cpp
+PROXY=${PROXY:-./bin/udp_impair}
+CXX=${CXX:-g++}
+
+# 服务器在客户端结束后最多再等待的秒数（FIN_ACK丢失时服务器靠超时退出）
+SERVER_GRACE_SEC=${SERVER_GRACE_SEC:-5}
+
+# ==================== 链路损伤代理 ====================
+
+# 编译UDP损伤代理；平台不支持（如MinGW）时返回非0，调用方应跳过有损/有时延的用例
+rt_build_proxy()
+{
+    if [ -x "$PROXY" ] && [ "$PROXY" -nt "$PROXY_SRC" ]; then
+        return 0
+    fi
+    mkdir -p "$(dirname "$PROXY")"
+    $CXX -std=c++11 -O2 -Wall -o "$PROXY" "$PROXY_SRC" 2>/dev/null
+}
+
+# ==================== 单次传输 ====================
+
+# 在回环地址上完成一次传输并校验输出文件
+# 用法: rt_run_transfer <输入文件> <窗口> <丢包率%> <RTT ms> <日志目录> <服务器端口>
+# 丢包率或RTT非0时经由损伤代理（端口为服务器端口+1）转发
+# 日志: <日志目录>/server.log client.log proxy.log；返回0表示输出与输入一致
+# 环境变量 CLIENT_ARGS 中的额外选项（如 "-fec 8"）原样传给客户端，
+# IMPAIR_SEED 固定代理的随机种子（默认用端口号），
+# IMPAIR_ARGS 追加在代理的随机种子之后（如持续空洞 "<hole_offset> <hole_drops>"）
+rt_run_transfer()
+{
+    local input=$1 window=$2 loss=$3 rtt=$4 log_dir=$5 port=$6
+    local output=$log_dir/output.dat
+    local timeout_sec=${RUN_TIMEOUT:-300}
+    local target=$port proxy_pid="" server_pid i
+
+    mkdir -p "$log_dir"
+    rm -f "$output" "$log_dir"/*.log
+
+    timeout "$timeout_sec" "$PROG" -s -p "$port" -out "$output" -w "$window" > "$log_dir/server.log" 2>&1 &
+    server_pid=$!
+
+    if [ "$loss" != "0" ] || [ "$rtt" != "0" ]; then
+        target=$((port + 1))
+        "$PROXY" "$target" "$port" "$loss" "$rtt" "${IMPAIR_SEED:-$port}" $IMPAIR_ARGS 2> "$log_dir/proxy.log" &
+        proxy_pid=$!
+    fi
+    sleep 0.3
+
+    timeout "$timeout_sec" "$PROG" -c -i 127.0.0.1 -p "$target" -in "$input" -w "$window" \
+        $CLIENT_ARGS > "$log_dir/client.log" 2>&1
+
+    # 服务器收到FIN后自行退出；宽限期过后仍未退出则终止
+    for ((i = 0; i < SERVER_GRACE_SEC * 10; i++)); do
+        kill -0 "$server_pid" 2>/dev/null || break
+        sleep 0.1
+    done
+    kill "$server_pid" 2>/dev/null
+    wait "$server_pid" 2>/dev/null
+
+    if [ -n "$proxy_pid" ]; then
+        kill "$proxy_pid" 2>/dev/null
+        wait "$proxy_pid" 2>/dev/null
+    fi
+
+    cmp -s "$input" "$output"
+}
+
+# 从print_statistics的输出中取出某一项的数值（第二列），不存在时输出空串
+# 用法: rt_stat <日志文件> <项目名，如 传输总耗时>
+rt_stat()
+{
+    grep -a "^$2:" "$1" 2>/dev/null | tail -1 | awk '{print $2}'
+}
+
+# 生成指定大小的随机输入文件（已存在且大小一致时复用）
+# 用法: rt_make_input <文件> <字节数>
+rt_make_input()
+{
+    local file=$1 bytes=$2
+    if [ -f "$file" ] && [ "$(wc -c < "$file")" -eq "$bytes" ]; then
+        return 0
+    fi
+    mkdir -p "$(dirname "$file")"
+    head -c "$bytes" /dev/urandom > "$file"
+}
@@ -0,0 +1,115 @@
+#!/bin/bash
+# ==========================================
+# reliable_transport 性能基准测试
+#
+# 在回环地址上对 文件大小 × 窗口 × 丢包率 × RTT × FEC分组 做矩阵测试，
+# 每次运行记录吞吐量、重传比例、CPU时间和峰值内存，结果写入CSV报告，
+# 作为评估协议改动的基线。
+#
+# 用法（在项目根目录）:
+#   make perf_test
+#   SIZES_MB="1 16 128 1024" WINDOWS="16 64 256 1024" LOSSES="0 0.5 2 5" RTTS="0 10 50" \
+#       bash tests/performance_test.sh
+#   LOSSES="0 1 2 5" RTTS=20 FECS="0 8" bash tests/performance_test.sh   # FEC开/关的吞吐量对比
+#
+# 环境变量:
+#   SIZES_MB     文件大小（MB）           默认 "1 16"
+#   WINDOWS      窗口大小（帧）           默认 "32 256"
+#   LOSSES       双向丢包率（%）          默认 "0 1"
+#   RTTS         往返时延（ms）           默认 "0 20"
+#   FECS         FEC分组大小K，0=关闭     默认 "0"
+#   RUN_TIMEOUT  单次运行超时（秒）       默认 300
+#   BASE_PORT    起始端口                 默认 19500
+#   REPORT       报告文件                 默认 data/perf_<时间>.csv
+#
+# 丢包和时延由 tests/udp_impair.cpp 代理模拟，不需要root权限；
+# 代理无法编译的平台上只运行丢包率和RTT都为0的用例。
+# ==========================================
+
+cd "$(dirname "$0")/.." || exit 1
+source tests/common.sh
+
+SIZES_MB=${SIZES_MB:-"1 16"}
+WINDOWS=${WINDOWS:-"32 256"}
+LOSSES=${LOSSES:-"0 1"}
+RTTS=${RTTS:-"0 20"}
+FECS=${FECS:-"0"}
+BASE_PORT=${BASE_PORT:-19500}
+WORK_DIR=${WORK_DIR:-data/test_perf}
+REPORT=${REPORT:-data/perf_$(date +%Y%m%d_%H%M%S).csv}
+
+if [ ! -x "$PROG" ]; then
+    echo "[Perf] $PROG not found, run make first"
+    exit 1
+fi
+
+have_proxy=1
+if ! rt_build_proxy; then
+    have_proxy=0
+    echo "[Perf] WARNING: udp_impair unavailable, skipping lossy/delayed cases"
+fi
+
+mkdir -p "$(dirname "$REPORT")" "$WORK_DIR"
+commit=$(git rev-parse --short HEAD 2>/dev/null || echo unknown)
+
+# 报告格式：每次运行一行
+echo "commit,size_mb,window,loss_pct,rtt_ms,fec_k,status,elapsed_ms,goodput_mbps,packets,retransmits,retx_ratio,client_cpu_ms,server_cpu_ms,client_rss_kb,server_rss_kb" > "$REPORT"
+
+printf "%-8s %-6s %-6s %-6s %-4s %-6s %10s %12s %10s %10s %10s\n" \
+    "size_mb" "window" "loss%" "rtt" "fec" "status" "elapsed_ms" "goodput_Mbps" "retx_ratio" "cpu_c_ms" "rss_c_kb"
+
+run_id=0
+failures=0
+for size in $SIZES_MB; do
+    input=$WORK_DIR/input_${size}MB.dat
+    rt_make_input "$input" $((size * 1024 * 1024))
+
+    for window in $WINDOWS; do
+        for loss in $LOSSES; do
+            for rtt in $RTTS; do
+                for fec in $FECS; do
+                    if [ $have_proxy -eq 0 ] && { [ "$loss" != "0" ] || [ "$rtt" != "0" ]; }; then
+                        continue
+                    fi
+
+                    # 每次运行使用新端口，避免上一轮残留的数据报
+                    port=$((BASE_PORT + run_id * 2))
+                    run_id=$((run_id + 1))
+                    log_dir=$WORK_DIR/run_${size}MB_w${window}_l${loss}_r${rtt}_f${fec}
+
+                    # K为0时不加-fec，和未引入FEC前的运行方式相同
+                    CLIENT_ARGS=""
+                    [ "$fec" != "0" ] && CLIENT_ARGS="-fec $fec"
+
+                    if rt_run_transfer "$input" "$window" "$loss" "$rtt" "$log_dir" "$port"; then
+                        status=ok
+                    else
+                        status=fail
+                        failures=$((failures + 1))
+                    fi
+
+                    elapsed=$(rt_stat "$log_dir/client.log" "传输总耗时")
+                    packets=$(rt_stat "$log_dir/client.log" "总包数")
+                    retx=$(rt_stat "$log_dir/client.log" "重传包数")
+                    cpu_c=$(rt_stat "$log_dir/client.log" "CPU时间")
+                    cpu_s=$(rt_stat "$log_dir/server.log" "CPU时间")
+                    rss_c=$(rt_stat "$log_dir/client.log" "峰值内存")
+                    rss_s=$(rt_stat "$log_dir/server.log" "峰值内存")
+
+                    # 吞吐量按有效载荷（文件字节）计算，不含帧头和重传
+                    read -r goodput ratio < <(awk -v mb="$size" -v ms="${elapsed:-0}" -v p="${packets:-0}" -v r="${retx:-0}" \
+                        'BEGIN { printf "%.2f %.4f\n", (ms > 0 ? mb * 1048576 * 8 / (ms / 1000) / 1e6 : 0), (p > 0 ? r / p : 0) }')
+
+                    echo "$commit,$size,$window,$loss,$rtt,$fec,$status,${elapsed},$goodput,${packets},${retx},$ratio,${cpu_c},${cpu_s},${rss_c},${rss_s}" >> "$REPORT"
+                    printf "%-8s %-6s %-6s %-6s %-4s %-6s %10s %12s %10s %10s %10s\n" \
+                        "$size" "$window" "$loss" "$rtt" "$fec" "$status" "${elapsed:--}" "$goodput" "$ratio" "${cpu_c:--}" "${rss_c:--}"
+
+                    [ "$status" = ok ] && rm -f "$log_dir/output.dat"
+                done
+            done
+        done
+    done
+done
+
+echo "[Perf] $run_id runs, $failures failed, report: $REPORT"
+[ $failures -eq 0 ]
@@ -0,0 +1,136 @@
+#!/bin/bash
+# ==========================================
+# reliable_transport 基本功能测试
+#
+# 在回环地址上传输各种边界大小的文件并逐字节校验，
+# 覆盖不同窗口、有损链路和多客户端服务器。
+#
+# 用法（在项目根目录）: make test 或 bash tests/test.sh
+# ==========================================
+
+cd "$(dirname "$0")/.." || exit 1
+source tests/common.sh
+
+WORK_DIR=${WORK_DIR:-data/test_basic}
+BASE_PORT=${BASE_PORT:-19400}
+RUN_TIMEOUT=${RUN_TIMEOUT:-60}
+
+if [ ! -x "$PROG" ]; then
+    echo "[Test] $PROG not found, run make first"
+    exit 1
+fi
+
+passed=0
+failed=0
+skipped=0
+port=$BASE_PORT
+
+# 用法: check <用例名> <输入字节数> <窗口> <丢包率%> <RTT ms> [服务器日志须匹配的正则]
+check()
+{
+    local name=$1 bytes=$2 window=$3 loss=$4 rtt=$5 expect=$6
+    local input=$WORK_DIR/input_${bytes}.dat
+
+    if [ $have_proxy -eq 0 ] && { [ "$loss" != "0" ] || [ "$rtt" != "0" ]; }; then
+        printf "  %-40s SKIP\n" "$name"
+        skipped=$((skipped + 1))
+        return
+    fi
+
+    rt_make_input "$input" "$bytes"
+    if rt_run_transfer "$input" "$window" "$loss" "$rtt" "$WORK_DIR/$name" "$port" &&
+       { [ -z "$expect" ] || grep -aq "$expect" "$WORK_DIR/$name/server.log"; }; then
+        printf "  %-40s PASS\n" "$name"
+        passed=$((passed + 1))
+    else
+        printf "  %-40s FAIL (logs: %s)\n" "$name" "$WORK_DIR/$name"
+        failed=$((failed + 1))
+    fi
+    port=$((port + 2))
+}
+
+# 多客户端服务器：多个客户端同时上传，逐个校验各自的输出文件
+check_multi_client()
+{
+    local name=multi_client clients=4 workers=2
+    local dir=$WORK_DIR/$name server_pid i ok=1
+
+    mkdir -p "$dir"
+    rm -f "$dir"/*
+    for ((i = 1; i <= clients; i++)); do
+        head -c $((i * 150 * 1024 + i)) /dev/urandom > "$dir/input_$i.dat"
+    done
+
+    timeout "$RUN_TIMEOUT" "$PROG" -s -p "$port" -out "$dir/upload" -j $workers > "$dir/server.log" 2>&1 &
+    server_pid=$!
+    sleep 0.3
+
+    local pids=""
+    for ((i = 1; i <= clients; i++)); do
+        timeout "$RUN_TIMEOUT" "$PROG" -c -i 127.0.0.1 -p "$port" -in "$dir/input_$i.dat" > "$dir/client_$i.log" 2>&1 &
+        pids="$pids $!"
+    done
+    wait $pids
+    kill -INT "$server_pid" 2>/dev/null
+    wait "$server_pid" 2>/dev/null
+
+    # 输出文件以客户端地址命名，按内容与输入匹配
+    for ((i = 1; i <= clients; i++)); do
+        local matched=0 f
+        for f in "$dir"/upload.*; do
+            cmp -s "$dir/input_$i.dat" "$f" && matched=1
+        done
+        [ $matched -eq 1 ] || ok=0
+    done
+
+    if [ $ok -eq 1 ]; then
+        printf "  %-40s PASS\n" "$name"
+        passed=$((passed + 1))
+    else
+        printf "  %-40s FAIL (logs: %s)\n" "$name" "$dir"
+        failed=$((failed + 1))
+    fi
+    port=$((port + 2))
+}
+
+have_proxy=1
+if ! rt_build_proxy; then
+    have_proxy=0
+    echo "[Test] WARNING: udp_impair unavailable, lossy cases will be skipped"
+fi
+
+echo "[Test] Boundary sizes"
+check empty_file            0        32 0 0
+check one_byte              1        32 0 0
+check one_frame             1000     32 0 0
+check one_frame_plus_one    1001     32 0 0
+check window_exact          32000    32 0 0
+check medium_5mb            5242880  32 0 0
+
+echo "[Test] Window sizes"
+check window_1              200000   1    0 0
+check window_1024           5242880  1024 0 0
+
+echo "[Test] Impaired link"
+check loss_5pct             1048576  32  5  0
+# 双向20%丢包：代理按 (种子, 相对序列号, 第几次发送) 决定DATA帧是否丢弃，固定种子后数据方向的
+# 丢包序列可复现；ACK方向按到达序号决定，而ACK的个数随时序变化，这一方向仍有随机性。
+# 单个包的连续超时可能超过默认上限，所以把超时重传上限放宽到10次
+IMPAIR_SEED=2 CLIENT_ARGS="-retries 10" \
+check loss_20pct            262144   16  20 0
+check rtt_50ms              524288   64  0  50
+check loss_2pct_rtt_20ms    1048576  128 2  20
+
+# 第400个DATA帧（含重传）前6次都被代理丢弃，期间的乱序帧反复触发NACK重传这个空洞；
+# NACK重传不计入MAX_RETRIES，否则第一次超时就会因重传次数耗尽而放弃
+IMPAIR_ARGS="400 6" check nack_persistent_hole 1048576 256 5 0
+
+# FEC模式下有损传输：除逐字节校验外，服务器统计的还原帧数必须非0
+CLIENT_ARGS="-fec 8" \
+check fec_loss_5pct         1048576  64  5  0 "FEC recovered [1-9][0-9]* frames"
+
+echo "[Test] Multi-client server"
+check_multi_client
+
+echo "[Test] $passed passed, $failed failed, $skipped skipped"
+[ $failed -eq 0 ]
@@ -0,0 +1,241 @@
+/**
+ * UDP链路损伤代理（仅用于测试，POSIX）
+ *
+ * 在回环地址上模拟有损、有时延的链路：
+ *   客户端 --> 127.0.0.1:<listen_port> --> 代理 --> 127.0.0.1:<server_port> --> 服务器
+ * 两个方向上的每个数据报都以 loss_pct% 的概率丢弃，未丢弃的延迟 rtt_ms/2 后转发。
+ * 时延固定，每个方向的队列按到期时间天然有序。
+ *
+ * 丢弃与否由 (seed, 方向, 键) 的哈希决定，不依赖两个方向数据报的交错顺序：
+ * 客户端发出的DATA帧以 (相对序列号, 第几次发送) 为键，同一种子下"哪个序列号的第几次发送
+ * 被丢弃"总是相同；其余数据报以它在本方向上（不含DATA帧）的到达序号为键
+ *
+ * 持续空洞：给出hole_offset和hole_drops时，客户端发出的第一个DATA帧序列号之后
+ * 第hole_offset个序列号的DATA帧（含所有重传）前hole_drops次一律丢弃，
+ * 用于让同一个空洞反复触发NACK重传
+ *
+ * 用法: udp_impair <listen_port> <server_port> <loss_pct> <rtt_ms> [seed] [hole_offset hole_drops]
+ * 收到SIGINT/SIGTERM后退出，并在stderr输出转发/丢弃计数。
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <csignal>
+#include <deque>
+#include <vector>
+#include <unordered_map>
+#include <ctime>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define MAX_DATAGRAM 2048
+#define FRAME_SEQ_OFFSET 0             // 帧头中seq_num的偏移（网络字节序）
+#define FRAME_TYPE_OFFSET 10           // 帧头中frame_type的偏移
+#define FRAME_TYPE_DATA 5
+
+typedef struct {
+    uint64_t due_us;                   // 转发时刻
+    std::vector<uint8_t> data;
+} Pending;
+
+static volatile sig_atomic_t g_stop = 0;
+
+static void on_signal(int)
+{
+    g_stop = 1;
+}
+
+/**
+ * 判定一个数据报是否丢弃（splitmix64哈希映射到[0,1)）
+ *
+ * @param seed 随机种子
+ * @param kind 键空间：0=客户端DATA帧，1=客户端其他帧，2=服务器发出的帧
+ * @param key 键空间内的键
+ * @param loss 丢包概率
+ * @return 需要丢弃时返回true
+ */
+static bool should_drop(uint64_t seed, int kind, uint64_t key, double loss)
+{
+    uint64_t z = seed * 0x9E3779B97F4A7C15ULL + (uint64_t)kind * 0xBF58476D1CE4E5B9ULL + key;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    z ^= z >> 31;
+    return (double)(z >> 11) / (double)(1ULL << 53) < loss;
+}
+
+static uint64_t now_us()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+static int open_udp(int port)
+{
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+
+    // 大接收缓冲区：代理本身不应成为丢包来源
+    int bufsize = 8 * 1024 * 1024;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &bufsize, sizeof(bufsize));
+    setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &bufsize, sizeof(bufsize));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 5) {
+        fprintf(stderr, "Usage: %s <listen_port> <server_port> <loss_pct> <rtt_ms> [seed] [hole_offset hole_drops]\n",
+                argv[0]);
+        return 1;
+    }
+
+    int listen_port = atoi(argv[1]);
+    int server_port = atoi(argv[2]);
+    double loss = atof(argv[3]) / 100.0;
+    uint64_t delay_us = (uint64_t)(atof(argv[4]) * 1000.0 / 2);
+    uint64_t seed = argc > 5 ? (uint64_t)atoi(argv[5]) : 1;
+    uint32_t hole_offset = argc > 7 ? (uint32_t)atoi(argv[6]) : 0;
+    int hole_drops = argc > 7 ? atoi(argv[7]) : 0;
+    bool have_origin = false;
+    uint32_t origin = 0;
+
+    // client_fd面向客户端，server_fd（临时端口）面向服务器
+    int client_fd = open_udp(listen_port);
+    int server_fd = open_udp(0);
+    if (client_fd < 0 || server_fd < 0) {
+        perror("udp_impair: bind");
+        return 1;
+    }
+
+    struct sockaddr_in server_addr;
+    memset(&server_addr, 0, sizeof(server_addr));
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    server_addr.sin_port = htons(server_port);
+
+    struct sockaddr_in client_addr;
+    memset(&client_addr, 0, sizeof(client_addr));
+    bool have_client = false;
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    std::deque<Pending> to_server, to_client;
+    unsigned long forwarded = 0, dropped = 0;
+    uint64_t arrivals[2] = {0, 0};                     // 各方向非DATA数据报的到达序号
+    std::unordered_map<uint32_t, uint32_t> copies;     // DATA帧序列号 -> 已收到的次数
+    uint8_t buffer[MAX_DATAGRAM];
+
+    while (!g_stop) {
+        // 等到下一个到期的数据报或新数据报到达
+        int timeout_ms = -1;
+        uint64_t now = now_us();
+        for (int dir = 0; dir < 2; dir++) {
+            const std::deque<Pending>& queue = dir ? to_client : to_server;
+            if (!queue.empty()) {
+                uint64_t wait = queue.front().due_us > now ? queue.front().due_us - now : 0;
+                int ms = (int)((wait + 999) / 1000);
+                if (timeout_ms < 0 || ms < timeout_ms) {
+                    timeout_ms = ms;
+                }
+            }
+        }
+
+        struct pollfd fds[2];
+        fds[0].fd = client_fd;
+        fds[0].events = POLLIN;
+        fds[1].fd = server_fd;
+        fds[1].events = POLLIN;
+        if (poll(fds, 2, timeout_ms) < 0) {
+            continue;   // EINTR
+        }
+
+        now = now_us();
+        for (int i = 0; i < 2; i++) {
+            if (!(fds[i].revents & POLLIN)) {
+                continue;
+            }
+            struct sockaddr_in from;
+            socklen_t from_len = sizeof(from);
+            ssize_t n = recvfrom(fds[i].fd, buffer, sizeof(buffer), 0, (struct sockaddr*)&from, &from_len);
+            if (n <= 0) {
+                continue;
+            }
+            int kind = i == 0 ? 1 : 2;
+            uint64_t key = 0;
+            if (i == 0) {
+                client_addr = from;
+                have_client = true;
+
+                if (n > FRAME_TYPE_OFFSET && buffer[FRAME_TYPE_OFFSET] == FRAME_TYPE_DATA) {
+                    uint32_t seq;
+                    memcpy(&seq, buffer + FRAME_SEQ_OFFSET, sizeof(seq));
+                    seq = ntohl(seq);
+                    if (!have_origin) {
+                        origin = seq;
+                        have_origin = true;
+                    }
+                    // 初始序列号每次连接都不同，键用相对第一个DATA帧的偏移
+                    kind = 0;
+                    key = ((uint64_t)(seq - origin) << 32) | copies[seq]++;
+                    if (hole_drops > 0 && seq == origin + hole_offset) {
+                        hole_drops--;
+                        dropped++;
+                        continue;
+                    }
+                }
+            }
+            if (kind != 0) {
+                key = arrivals[i]++;
+            }
+            if (should_drop(seed, kind, key, loss)) {
+                dropped++;
+                continue;
+            }
+            Pending pending;
+            pending.due_us = now + delay_us;
+            pending.data.assign(buffer, buffer + n);
+            (i == 0 ? to_server : to_client).push_back(pending);
+        }
+
+        // 转发所有到期的数据报
+        now = now_us();
+        while (!to_server.empty() && to_server.front().due_us <= now) {
+            const Pending& p = to_server.front();
+            sendto(server_fd, p.data.data(), p.data.size(), 0, (struct sockaddr*)&server_addr, sizeof(server_addr));
+            forwarded++;
+            to_server.pop_front();
+        }
+        while (!to_client.empty() && to_client.front().due_us <= now) {
+            const Pending& p = to_client.front();
+            if (have_client) {
+                sendto(client_fd, p.data.data(), p.data.size(), 0, (struct sockaddr*)&client_addr, sizeof(client_addr));
+                forwarded++;
+            }
+            to_client.pop_front();
+        }
+    }
+
+    fprintf(stderr, "udp_impair: forwarded=%lu dropped=%lu\n", forwarded, dropped);
+    close(client_fd);
+    close(server_fd);
+    return 0;
+}